@@ -11,9 +11,9 @@ color_names = ['r','g','b','a']
 # forward definition of all ctle classes
 fwd_classes = [
     ['status.h', ['enum class status_code : int','status']],
-	['data_source.h', ['file_data_source']],
-	['data_destination.h', ['file_data_destination']],
-	['hasher.h', ['hasher_sha256', 'hasher_xxh64', 'hasher_xxh128', 'template <size_t _Size> class hasher_noop']],
+	['data_source.h', ['file_data_source','memory_data_source']],
+	['data_destination.h', ['file_data_destination','memory_data_destination','template<class _DataDestATy, class _DataDestBTy> class tee_data_destination']],
+	['hasher.h', ['hasher_sha256', 'hasher_xxh64', 'hasher_xxh128', 'template <size_t _Size> class hasher_noop', 'template <class _HashATy, class _HashBTy> class hasher_pair']],
 	['read_stream.h', ['template<class _DataSourceTy, class _HashTy = hasher_noop<64>> class read_stream']],
 	['write_stream.h', ['template<class _DataDestTy, class _HashTy = hasher_noop<64>> class write_stream']],
 	['ntup.h', ['template<class _Ty, size_t _Size> class n_tup','template<class _Ty, size_t _InnerSize, size_t _OuterSize> class mn_tup']],
@@ -23,6 +23,20 @@ fwd_classes = [
 	['hash.h', ['template<size_t _Size> struct hash']],
 	['idx_vector.h', ['template <class _Ty, class _IdxTy = std::vector<i32>, class _VecTy = std::vector<_Ty>> class idx_vector']],
 	['string_funcs.h', ['template<class _Ty> struct string_span']],
+	['util.h', ['template<class _Ty> struct identity_hash']],
+	['sorted_id_index.h', ['template<class _IdTy, class _IdxTy = u32> class sorted_id_index']],
+	['flat_id_map.h', ['template<class _Kty, class _Ty, class _Hash = identity_hash<_Kty>> class flat_id_map']],
+	['blob_store.h', ['template<class _HashTy = hasher_sha256> class blob_store']],
+	['file_hash_cache.h', ['template<class _HashTy = hasher_sha256> class file_hash_cache']],
+	['pack_file.h', ['template<class _KeyTy, class _HashTy = hasher_xxh128> class pack_file_writer', 'template<class _KeyTy, class _HashTy = hasher_xxh128> class pack_file_reader']],
+	['id_filter.h', ['template<class _IdTy, class _Hash = identity_hash<_IdTy>> class blocked_bloom_filter', 'template<class _IdTy, class _Hash = identity_hash<_IdTy>> class cuckoo_filter']],
+	['block_compression.h', ['template<class _DataDestTy> class compressed_data_destination', 'template<class _DataSourceTy> class compressed_data_source']],
+	['serialization.h', ['template<class _Ty, class = void> struct is_bulk_serializable']],
+	['value_equality.h', ['template<class _Ty> struct bitwise_equality', 'template<class _Ty> class quantized_equality']],
+	['idx_vector_builder.h', ['template<class _Ty, class _IdxTy = std::vector<i32>, class _VecTy = std::vector<_Ty>, class _EqualityTy = bitwise_equality<_Ty>> class idx_vector_builder']],
+	['vector_view.h', ['template<class _Ty> class vector_view', 'template<class _Ty, class _IdxTy = i32> class idx_vector_view', 'template<class _Ty> class optional_vector_view']],
+	['packed_index_vector.h', ['packed_index_vector']],
+	['nullable_vector.h', ['template<class _Ty, class _Alloc = std::allocator<_Ty>> class nullable_vector']],
 ]
 
 def generate_types_dict():
@@ -457,6 +471,16 @@ def define_n_tuples( out:formatted_output ):
 
 		out.ln()
 
+	out.comment_ln('Byte swapping n-tuples and mn-tuples swaps each of their values.')
+	out.ln('template<class _Ty, size_t _Size> struct byte_swap_value_size<n_tup<_Ty,_Size>> : byte_swap_value_size<_Ty> {};')
+	out.ln('template<class _Ty, size_t _InnerSize, size_t _OuterSize> struct byte_swap_value_size<mn_tup<_Ty,_InnerSize,_OuterSize>> : byte_swap_value_size<_Ty> {};')
+	out.ln()
+
+	out.comment_ln('n-tuples and mn-tuples of bulk serializable values are serialized as raw contiguous blocks (see serialization.h).')
+	out.ln('template<class _Ty, size_t _Size> struct is_bulk_serializable<n_tup<_Ty,_Size>> : is_bulk_serializable<_Ty> {};')
+	out.ln('template<class _Ty, size_t _InnerSize, size_t _OuterSize> struct is_bulk_serializable<mn_tup<_Ty,_InnerSize,_OuterSize>> : is_bulk_serializable<_Ty> {};')
+	out.ln()
+
 	out.ln('#ifdef CTLE_IMPLEMENTATION', no_indent=True)		
 
 	out.ln()
@@ -645,23 +669,17 @@ def generate_unit_tests_variants( test_path:str ):
 #include <ctle/data_source.h>
 #include <ctle/write_stream.h>
 #include <ctle/data_destination.h>
+#include <ctle/serialization.h>
 		
 template<class _Ty> ctle::status _read_from_stream( ctle::read_stream<ctle::file_data_source,ctle::hasher_xxh128> &strm, std::vector<_Ty> &data )
 {
-	u32 cnt = 0;
-	ctle::status res = strm.read<u32>( &cnt, 1 );
-	if( !res ) 
-  		return res; 
-	data.resize(cnt);
-	return strm.read<_Ty>( data.data(), data.size() );
+	static_assert( ctle::is_bulk_serializable<_Ty>::value, "all variant types must be bulk serializable" );
+	return ctle::deserialize( strm, data );
 }
 		
 template<class _Ty> ctle::status _write_to_stream( ctle::write_stream<ctle::file_data_destination,ctle::hasher_xxh128> &strm, const std::vector<_Ty> &data )
 {
-	ctle::status res = strm.write<u32>( (u32)data.size() );
-	if( !res ) 
-  		return res; 
-	return strm.write<_Ty>( data.data(), data.size() );
+	return ctle::serialize( strm, data );
 }
 		
 bool _are_equal( const variant &a , const variant &b )
@@ -715,6 +733,7 @@ def generate_types( src_path:str, test_path:str ):
 	out.ln('#include "string_funcs.h"')
 	out.ln('#include "status.h"')	
 	out.ln('#include "status_return.h"')	
+	out.ln('#include "endianness.h"')	
 	out.ln()
 	out.ln('namespace ctle')
 	with out.blk( no_indent = True ):
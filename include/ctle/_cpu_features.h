@@ -0,0 +1,124 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE__CPU_FEATURES_H_
+#define _CTLE__CPU_FEATURES_H_
+
+#if defined(CTLE_IMPLEMENTATION) && defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_IX86) )
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#include <cstdint>
+
+namespace ctle
+{
+
+// cpu feature detection, used to select SIMD kernels at runtime. returns false on other architectures than x86.
+bool _cpu_has_ssse3() noexcept;
+bool _cpu_has_popcnt() noexcept;
+bool _cpu_has_avx2() noexcept;
+bool _cpu_has_avx512f() noexcept;
+bool _cpu_has_avx512vpopcntdq() noexcept;
+
+#ifdef CTLE_IMPLEMENTATION
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+
+#if defined(_MSC_VER)
+// check that the cpu supports the extended registers, and that the os saves the register bits in the xcr0 mask
+static bool _cpu_os_saves_registers( uint64_t xcr0_mask ) noexcept
+{
+	int info[4];
+	__cpuid( info, 1 );
+	const bool has_xsave = ( info[2] & ( 1 << 27 ) ) != 0;
+	return has_xsave && ( _xgetbv( 0 ) & xcr0_mask ) == xcr0_mask;
+}
+
+// get the extended features (ebx of cpuid leaf 7)
+static int _cpu_extended_features() noexcept
+{
+	int info[4];
+	__cpuid( info, 0 );
+	if( info[0] < 7 )
+		return 0;
+	__cpuidex( info, 7, 0 );
+	return info[1];
+}
+#endif
+
+bool _cpu_has_ssse3() noexcept
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid( info, 1 );
+	return ( info[2] & ( 1 << 9 ) ) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "ssse3" ) != 0;
+#endif
+}
+
+bool _cpu_has_popcnt() noexcept
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid( info, 1 );
+	return ( info[2] & ( 1 << 23 ) ) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "popcnt" ) != 0;
+#endif
+}
+
+bool _cpu_has_avx2() noexcept
+{
+#if defined(_MSC_VER)
+	// the os must save the AVX registers (xmm and ymm)
+	return _cpu_os_saves_registers( 0x6 ) && ( _cpu_extended_features() & ( 1 << 5 ) ) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+}
+
+bool _cpu_has_avx512f() noexcept
+{
+#if defined(_MSC_VER)
+	// the os must save the AVX-512 registers (xmm, ymm, opmask and zmm)
+	return _cpu_os_saves_registers( 0xe6 ) && ( _cpu_extended_features() & ( 1 << 16 ) ) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "avx512f" ) != 0;
+#endif
+}
+
+bool _cpu_has_avx512vpopcntdq() noexcept
+{
+#if defined(_MSC_VER)
+	if( !_cpu_has_avx512f() )
+		return false;
+	int info[4];
+	__cpuidex( info, 7, 0 );
+	return ( info[2] & ( 1 << 14 ) ) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "avx512f" ) != 0 && __builtin_cpu_supports( "avx512vpopcntdq" ) != 0;
+#endif
+}
+
+#else
+
+bool _cpu_has_ssse3() noexcept { return false; }
+bool _cpu_has_popcnt() noexcept { return false; }
+bool _cpu_has_avx2() noexcept { return false; }
+bool _cpu_has_avx512f() noexcept { return false; }
+bool _cpu_has_avx512vpopcntdq() noexcept { return false; }
+
+#endif
+
+#endif//CTLE_IMPLEMENTATION
+
+}
+//namespace ctle
+#endif//_CTLE__CPU_FEATURES_H_
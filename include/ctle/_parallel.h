@@ -0,0 +1,153 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE__PARALLEL_H_
+#define _CTLE__PARALLEL_H_
+
+// internal thread helpers, used by the headers which run work on multiple threads. kept out of util.h, so 
+// that headers which only need the basic utilities do not pull in the threading headers.
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+
+namespace ctle
+{
+
+// run func(index) for all indices in [0,count), on up to thread_count threads, including the calling thread
+template<class _Func> inline void _parallel_for( size_t count, size_t thread_count, const _Func &func )
+{
+	std::atomic<size_t> next_index( 0 );
+	auto worker = [&]()
+	{
+		for( size_t index = next_index.fetch_add( 1 ); index < count; index = next_index.fetch_add( 1 ) )
+			func( index );
+	};
+
+	std::vector<std::thread> threads;
+	const size_t worker_count = std::min( thread_count, count );
+	for( size_t inx = 1; inx < worker_count; ++inx )
+		threads.emplace_back( worker );
+	worker();
+	for( auto &thread : threads )
+		thread.join();
+}
+
+// get the number of threads to use, where 0 means the hardware concurrency
+inline size_t _resolve_thread_count( size_t thread_count )
+{
+	if( thread_count == 0 )
+		thread_count = (size_t)std::thread::hardware_concurrency();
+	return std::max<size_t>( thread_count, 1 );
+}
+
+// a pool of persistent worker threads, which run submitted jobs in submission order. Unlike _parallel_for, the threads
+// are started once, and the caller is free to do other work (e.g. i/o) while the jobs run. Jobs which have not started when 
+// the pool is destroyed are dropped, and running jobs are waited for.
+class _worker_pool
+{
+public:
+	explicit _worker_pool( size_t thread_count );
+	~_worker_pool();
+
+	// queue a job. done is set to false, and is set to true (under the pool lock) when the job has run. 
+	// done must stay valid until the job has run, or the pool is destroyed.
+	void submit( std::function<void()> job, bool &done );
+
+	// check if a job has run, without waiting
+	bool is_done( const bool &done );
+
+	// wait until a job has run
+	void wait( const bool &done );
+
+	size_t thread_count() const noexcept { return this->threads.size(); }
+
+private:
+	struct _job
+	{
+		std::function<void()> func;
+		bool *done;
+	};
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable job_cv;
+	std::condition_variable done_cv;
+	std::deque<_job> jobs;
+	bool stop = false;
+
+	void worker_loop();
+};
+
+#ifdef CTLE_IMPLEMENTATION
+
+_worker_pool::_worker_pool( size_t thread_count )
+{
+	for( size_t inx = 0; inx < thread_count; ++inx )
+		this->threads.emplace_back( &_worker_pool::worker_loop, this );
+}
+
+_worker_pool::~_worker_pool()
+{
+	{
+		const std::lock_guard<std::mutex> lock( this->mutex );
+		this->stop = true;
+	}
+	this->job_cv.notify_all();
+	for( auto &thread : this->threads )
+		thread.join();
+}
+
+void _worker_pool::submit( std::function<void()> job, bool &done )
+{
+	{
+		const std::lock_guard<std::mutex> lock( this->mutex );
+		done = false;
+		this->jobs.push_back( _job{ std::move( job ), &done } );
+	}
+	this->job_cv.notify_one();
+}
+
+bool _worker_pool::is_done( const bool &done )
+{
+	const std::lock_guard<std::mutex> lock( this->mutex );
+	return done;
+}
+
+void _worker_pool::wait( const bool &done )
+{
+	std::unique_lock<std::mutex> lock( this->mutex );
+	this->done_cv.wait( lock, [&done]() { return done; } );
+}
+
+void _worker_pool::worker_loop()
+{
+	std::unique_lock<std::mutex> lock( this->mutex );
+	for( ;; )
+	{
+		this->job_cv.wait( lock, [this]() { return !this->jobs.empty() || this->stop; } );
+		if( this->stop )
+			return;
+
+		// run the job without holding the lock
+		_job job = std::move( this->jobs.front() );
+		this->jobs.pop_front();
+		lock.unlock();
+		job.func();
+		lock.lock();
+
+		*job.done = true;
+		this->done_cv.notify_all();
+	}
+}
+
+#endif//CTLE_IMPLEMENTATION
+
+}
+//namespace ctle
+#endif//_CTLE__PARALLEL_H_
@@ -0,0 +1,308 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_BLOB_STORE_H_
+#define _CTLE_BLOB_STORE_H_
+
+/// @file blob_store.h
+/// @brief A content-addressed blob store on the local file system, where each blob is stored under the digest of its contents.
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include "fwd.h"
+#include "status.h"
+#include "status_return.h"
+#include "status_error.h"
+#include "file_funcs.h"
+#include "string_funcs.h"
+#include "flat_id_map.h"
+#include "uuid.h"
+#include "write_stream.h"
+
+namespace ctle
+{
+
+/// @brief A content-addressed blob store, which stores blobs in files named by the digest of the blob contents.
+/// @details Blobs are stored in a fan-out directory tree, where the first two hex characters of the digest names the
+/// sub directory, and the remaining characters names the file. Storing a blob which is already in the store is a no-op,
+/// so identical blobs are only stored once. Blobs are first written to a temporary file in the "tmp" sub directory, which
+/// is synced to disk and then atomically renamed into place, so multiple writers (threads or processes) can add blobs to the 
+/// same store, and readers never see partially written blobs, even after a crash. Known blobs are tracked in an in-memory 
+/// index, so repeated lookups do not need to query the file system.
+/// @tparam _HashTy The hasher used to address the blobs, e.g. hasher_sha256 or hasher_xxh128.
+template<class _HashTy /* = hasher_sha256 */>
+class blob_store
+{
+public:
+	using hasher_type = _HashTy;
+	using hash_type = typename _HashTy::hash_type;
+
+	/// @brief Open a blob store in a directory. The directory (and the temporary directory) is created if it does not exist.
+	/// @param root_path the path of the store directory
+	/// @throws ctle::status_error if the directory can't be created
+	explicit blob_store( const std::string &root_path );
+
+	/// @brief Add a blob from memory. The data is streamed to a temporary file while it is hashed, the same way as put_from().
+	/// @return status::ok and the digest of the blob, or an error status if the blob could not be stored.
+	status_return<status, hash_type> put( const void *data, size_t size );
+	status_return<status, hash_type> put( const std::vector<u8> &data ) { return this->put( data.data(), data.size() ); } ///< @copydoc put(const void*,size_t)
+
+	/// @brief Add a blob from a data source, e.g. a file_data_source. The data is streamed to a temporary file while it is hashed.
+	/// @return status::ok and the digest of the blob, or an error status if the blob could not be stored.
+	template<class _DataSourceTy> status_return<status, hash_type> put_from( _DataSourceTy &source );
+
+	/// @brief Check if a blob is in the store.
+	bool contains( const hash_type &id );
+
+	/// @brief Get the size of a blob.
+	/// @return status::ok and the size of the blob, or status::not_found if the blob is not in the store.
+	status_return<status, u64> blob_size( const hash_type &id );
+
+	/// @brief Read a blob into a vector.
+	/// @return status::ok, status::not_found if the blob is not in the store, or an error status if the read failed.
+	status get( const hash_type &id, std::vector<u8> &dest );
+
+	/// @brief Memory map a blob for zero-copy reading.
+	/// @return status::ok, status::not_found if the blob is not in the store, or an error status if the mapping failed.
+	status map( const hash_type &id, mapped_file &dest );
+
+	/// @brief Rehash the contents of a stored blob, and check that it matches the digest.
+	/// @return status::ok, status::not_found if the blob is not in the store, or status::corrupted if the contents does not match.
+	status verify( const hash_type &id );
+
+	/// @brief Get the file path of a blob. The path can be used to stream the blob using a file_data_source and a read_stream.
+	std::string blob_path( const hash_type &id ) const;
+
+	/// @brief Get the path of the store directory.
+	const std::string &root_path() const { return this->root_path_m; }
+
+	/// @brief Get the number of blobs in the in-memory index.
+	size_t indexed_count() const;
+
+private:
+	// data destination of the temporary files, which are opened for an atomic replace, and renamed to the blob path when committed
+	class _temp_file_destination
+	{
+	public:
+		_file_object file;
+		status_return<status, u64> write( const u8 *src_buffer, u64 write_count )
+		{
+			if( write_count > 0 )
+			{
+				const status result = this->file.write( src_buffer, write_count );
+				if( !result )
+					return result;
+			}
+			return write_count;
+		}
+	};
+
+	std::string root_path_m;
+	std::string temp_path_m;
+
+	mutable std::mutex index_mutex_m;
+	flat_id_map<hash_type, u64> index_m;
+
+	using _temp_write_stream = write_stream<_temp_file_destination, _HashTy>;
+
+	std::string new_temp_file_path() const { return this->temp_path_m + "/" + to_string( uuid::generate() ); }
+	template<class _WriteFuncTy> status_return<status, hash_type> put_streamed( _WriteFuncTy write_func );
+	status commit_temp_file( _file_object &temp_file, const hash_type &id, u64 size );
+	void add_to_index( const hash_type &id, u64 size );
+};
+
+}
+//namespace ctle
+
+#include "log.h"
+#include "_macros.inl"
+
+namespace ctle
+{
+
+template<class _HashTy>
+inline blob_store<_HashTy>::blob_store( const std::string &root_path )
+	: root_path_m( root_path )
+	, temp_path_m( root_path + "/tmp" )
+{
+	ctStatusCallThrow( create_directory( this->root_path_m ) );
+	ctStatusCallThrow( create_directory( this->temp_path_m ) );
+}
+
+template<class _HashTy>
+inline std::string blob_store<_HashTy>::blob_path( const hash_type &id ) const
+{
+	const std::string hex = to_string( id );
+	return this->root_path_m + "/" + hex.substr( 0, 2 ) + "/" + hex.substr( 2 );
+}
+
+template<class _HashTy>
+inline size_t blob_store<_HashTy>::indexed_count() const
+{
+	const std::lock_guard<std::mutex> lock( this->index_mutex_m );
+	return this->index_m.size();
+}
+
+template<class _HashTy>
+inline void blob_store<_HashTy>::add_to_index( const hash_type &id, u64 size )
+{
+	const std::lock_guard<std::mutex> lock( this->index_mutex_m );
+	this->index_m.insert( id, size );
+}
+
+template<class _HashTy>
+inline status_return<status, u64> blob_store<_HashTy>::blob_size( const hash_type &id )
+{
+	{
+		const std::lock_guard<std::mutex> lock( this->index_mutex_m );
+		if( const u64 *size = this->index_m.find( id ) )
+			return *size;
+	}
+
+	// not indexed, check if another writer has added the blob
+	_file_object file;
+	if( !file.open_read( this->blob_path( id ) ) )
+		return status::not_found;
+	const u64 size = file.size();
+	file.close();
+
+	this->add_to_index( id, size );
+	return size;
+}
+
+template<class _HashTy>
+inline bool blob_store<_HashTy>::contains( const hash_type &id )
+{
+	return this->blob_size( id ).status() == status::ok;
+}
+
+template<class _HashTy>
+inline status blob_store<_HashTy>::commit_temp_file( _file_object &temp_file, const hash_type &id, u64 size )
+{
+	const std::string path = this->blob_path( id );
+	const status dir_result = create_directory( path.substr( 0, path.find_last_of( '/' ) ) );
+	if( !dir_result )
+	{
+		temp_file.discard();
+		return dir_result;
+	}
+
+	// the temporary file is synced before it is renamed, so a blob file never has partial contents. a rename replaces 
+	// an existing blob atomically, and since the contents are identical, racing writers are harmless
+	if( !temp_file.close_and_rename( path ) )
+	{
+		ctValidate( file_exists( path ), status::cant_write ) << "Failed to move the blob into the store: " << path << ctValidateEnd;
+	}
+
+	this->add_to_index( id, size );
+	return status::ok;
+}
+
+template<class _HashTy>
+template<class _WriteFuncTy>
+inline status_return<status, typename blob_store<_HashTy>::hash_type> blob_store<_HashTy>::put_streamed( _WriteFuncTy write_func )
+{
+	_temp_file_destination dest;
+	ctStatusCall( dest.file.open_write( this->new_temp_file_path(), file_write_mode::atomic_replace ) );
+
+	// stream the data to the temporary file, hashing it on the way
+	hash_type id;
+	u64 size = 0;
+	status result = status::ok;
+	{
+		_temp_write_stream ws( dest );
+		result = write_func( ws );
+		if( result )
+			result = ws.end();
+		if( result )
+		{
+			id = ws.get_digest().value();
+			size = ws.get_position();
+		}
+	}
+
+	// on failure, or if the blob already exists, drop the temporary file
+	if( !result )
+	{
+		dest.file.discard();
+		return result;
+	}
+	if( this->contains( id ) )
+	{
+		dest.file.discard();
+		return id;
+	}
+
+	ctStatusCall( this->commit_temp_file( dest.file, id, size ) );
+	return id;
+}
+
+template<class _HashTy>
+inline status_return<status, typename blob_store<_HashTy>::hash_type> blob_store<_HashTy>::put( const void *data, size_t size )
+{
+	ctValidate( data || size == 0, status::invalid_param ) << "data can only be nullptr if size is 0" << ctValidateEnd;
+
+	return this->put_streamed( [data, size]( _temp_write_stream &ws ) -> status
+		{
+			return ws.write_bytes( (const u8 *)data, size );
+		} );
+}
+
+template<class _HashTy>
+template<class _DataSourceTy>
+inline status_return<status, typename blob_store<_HashTy>::hash_type> blob_store<_HashTy>::put_from( _DataSourceTy &source )
+{
+	return this->put_streamed( [&source]( _temp_write_stream &ws ) -> status
+		{
+			const size_t chunk_size = 1024 * 1024;
+			std::vector<u8> chunk( chunk_size );
+			for( ;; )
+			{
+				auto read_result = source.read( chunk.data(), chunk.size() );
+				if( !read_result.status() )
+					return read_result.status();
+				if( read_result.value() == 0 )
+					return status::ok;
+				ctStatusCall( ws.write_bytes( chunk.data(), (size_t)read_result.value() ) );
+			}
+		} );
+}
+
+template<class _HashTy>
+inline status blob_store<_HashTy>::get( const hash_type &id, std::vector<u8> &dest )
+{
+	ctValidate( this->contains( id ), status::not_found ) << "The blob is not in the store" << ctValidateEnd;
+	ctStatusCall( read_file( this->blob_path( id ), dest ) );
+	return status::ok;
+}
+
+template<class _HashTy>
+inline status blob_store<_HashTy>::map( const hash_type &id, mapped_file &dest )
+{
+	ctValidate( this->contains( id ), status::not_found ) << "The blob is not in the store" << ctValidateEnd;
+	ctStatusCall( dest.open( this->blob_path( id ) ) );
+	return status::ok;
+}
+
+template<class _HashTy>
+inline status blob_store<_HashTy>::verify( const hash_type &id )
+{
+	mapped_file file;
+	ctStatusCall( this->map( id, file ) );
+
+	hash_type file_id;
+	hasher_type hasher;
+	ctStatusCall( hasher.update( file.data(), (size_t)file.size() ) );
+	ctStatusReturnCall( file_id, hasher.finish() );
+	ctValidate( file_id == id, status::corrupted ) << "The blob contents does not match the digest: " << this->blob_path( id ) << ctValidateEnd;
+	return status::ok;
+}
+
+}
+//namespace ctle
+
+#include "_undef_macros.inl"
+
+#endif//_CTLE_BLOB_STORE_H_
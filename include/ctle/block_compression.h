@@ -0,0 +1,681 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_BLOCK_COMPRESSION_H_
+#define _CTLE_BLOCK_COMPRESSION_H_
+
+/// @file block_compression.h
+/// @brief A fast LZ block compression codec, and compressing data source/destination wrappers using a framed, block-independent format.
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+
+#include "fwd.h"
+#include "status.h"
+#include "status_return.h"
+#include "status_error.h"
+#include "_parallel.h"
+
+namespace ctle
+{
+
+/// @brief The default size of the raw data blocks of compressed_data_destination
+constexpr const size_t compression_default_block_size = 256 * 1024;
+
+/// @brief The max size of the raw data blocks of compressed_data_destination
+constexpr const size_t compression_max_block_size = 64 * 1024 * 1024;
+
+/// @brief Get the max size of the compressed data of a block of src_size bytes, to use as the size of the destination in lz_compress()
+size_t lz_compress_bound( size_t src_size );
+
+/// @brief Compress a block of data using the LZ codec. The codec is a byte-oriented LZ77 codec, with 64KB match offsets, tuned for speed.
+/// @param src the source data
+/// @param src_size the size of the source data
+/// @param dest the destination buffer
+/// @param dest_capacity the size of the destination buffer. If the capacity is at least lz_compress_bound(src_size), the compression will not fail.
+/// @return the size of the compressed data, or 0 if the compressed data does not fit in the destination buffer
+size_t lz_compress( const u8 *src, size_t src_size, u8 *dest, size_t dest_capacity );
+
+/// @brief Decompress a block of data which was compressed with lz_compress(). All reads and writes are bounds checked, so corrupt data is detected and not over-read or over-written.
+/// @param src the compressed data
+/// @param src_size the size of the compressed data
+/// @param dest the destination buffer
+/// @param dest_size the size of the decompressed data, which must be known
+/// @return status::ok, or status::corrupted if the compressed data is not valid, or does not decompress to exactly dest_size bytes
+status lz_decompress( const u8 *src, size_t src_size, u8 *dest, size_t dest_size );
+
+/// @brief Calculate the checksum of a block of data, which is stored in the block headers of the compressed frames.
+u32 block_checksum( const u8 *data, size_t size );
+
+/// @brief A data destination which compresses the data in independent blocks, and writes the compressed frame to another data destination.
+/// @details The written data is collected into blocks of block_size bytes. Each full block is handed to a pool of worker threads, which
+/// are started once and kept for the lifetime of the destination. The compressed blocks are written in order to the destination on the 
+/// calling thread, as soon as they are done, so the i/o overlaps the compression of the following blocks. Up to two blocks per thread 
+/// are in flight. Each block is written with a header which has the raw size, the compressed size and a checksum of the raw data. Blocks which do not compress are stored uncompressed. Use as the destination of a write_stream, e.g.
+/// write_stream<compressed_data_destination<file_data_destination>>.
+/// @note end() must be called after the last write (and after write_stream::end()), to write the last block and the end of the frame.
+/// If not called, end() is called by the destructor, but then any error is lost.
+/// @tparam _DataDestTy the destination of the compressed frame
+template<class _DataDestTy>
+class compressed_data_destination
+{
+public:
+	/// @brief Set up the compressed destination
+	/// @param data_dest the destination of the compressed frame
+	/// @param block_size the size of the raw data blocks, max compression_max_block_size
+	/// @param thread_count the number of worker threads which compress blocks in parallel, or 0 to use the hardware concurrency
+	/// @throws ctle::status_error if the block size is not valid
+	compressed_data_destination( _DataDestTy &data_dest, size_t block_size = compression_default_block_size, size_t thread_count = 0 );
+	~compressed_data_destination();
+
+	/// @brief Write data to the compressed destination
+	/// @return status::ok and the number of bytes written, or an error status if a block could not be written to the destination
+	status_return<status, u64> write( const u8 *src_buffer, u64 write_count );
+
+	/// @brief Compress and write the last block, and the end of the frame
+	status end();
+
+	/// @brief The number of raw bytes written to the destination
+	u64 raw_size() const { return this->raw_size_m; }
+
+	/// @brief The number of bytes of the compressed frame written to the underlying destination, so far
+	u64 compressed_size() const { return this->compressed_size_m; }
+
+private:
+	struct _block
+	{
+		std::vector<u8> raw;
+		std::vector<u8> compressed;
+		u32 compressed_size = 0;
+		u32 checksum = 0;
+		bool done = true;
+	};
+
+	_DataDestTy &data_dest_m;
+	const size_t block_size_m;
+
+	// ring of blocks, indexed by the running block number modulo the ring size. blocks in [write_index_m,fill_index_m) 
+	// are compressing or compressed, and the block at fill_index_m is being filled
+	std::vector<_block> blocks_m;
+	size_t fill_index_m = 0;
+	size_t write_index_m = 0;
+
+	bool header_written_m = false;
+	bool ended_m = false;
+	u64 raw_size_m = 0;
+	u64 compressed_size_m = 0;
+
+	// declared last, so the workers are stopped before the blocks are destroyed
+	_worker_pool workers_m;
+
+	status write_to_destination( const void *src, u64 size );
+	void queue_block();
+	status write_blocks( size_t wait_index );
+};
+
+/// @brief A data source which reads a compressed frame written by compressed_data_destination from another data source, and decompresses it.
+/// @details Blocks are read ahead from the source on the calling thread, and handed to a pool of worker threads, which are started once
+/// and kept for the lifetime of the source. The blocks are decompressed in parallel while the following blocks are read, with up to two
+/// blocks per thread in flight. The checksum of each block is verified after decompression. Use as the source of a read_stream, e.g. read_stream<compressed_data_source<file_data_source>>.
+/// @tparam _DataSourceTy the source of the compressed frame
+template<class _DataSourceTy>
+class compressed_data_source
+{
+public:
+	/// @brief Set up the compressed source
+	/// @param data_source the source of the compressed frame
+	/// @param thread_count the number of worker threads which decompress blocks in parallel, or 0 to use the hardware concurrency
+	compressed_data_source( _DataSourceTy &data_source, size_t thread_count = 0 );
+	~compressed_data_source() = default;
+
+	/// @brief Read decompressed data from the source
+	/// @return status::ok and the number of bytes read (0 at the end of the frame), or status::corrupted if the frame or a block is not valid
+	status_return<status, u64> read( u8 *dest_buffer, u64 read_count );
+
+private:
+	struct _block
+	{
+		std::vector<u8> raw;
+		std::vector<u8> compressed;
+		u32 raw_size = 0;
+		u32 compressed_size = 0;
+		u32 checksum = 0;
+		status result = status::ok;
+		bool done = true;
+	};
+
+	_DataSourceTy &data_source_m;
+
+	// ring of blocks, indexed by the running block number modulo the ring size. blocks in [current_block_m,read_index_m) 
+	// are decompressing or decompressed, and the block at current_block_m is being copied from
+	std::vector<_block> blocks_m;
+	size_t read_index_m = 0;
+	size_t current_block_m = 0;
+	size_t block_position_m = 0;
+	size_t block_size_m = 0;
+	bool header_read_m = false;
+	bool frame_ended_m = false;
+
+	// declared last, so the workers are stopped before the blocks are destroyed
+	_worker_pool workers_m;
+
+	status read_from_source( void *dest, u64 size );
+	status read_ahead();
+};
+
+}
+//namespace ctle
+
+#include "log.h"
+#include "_macros.inl"
+
+namespace ctle
+{
+
+// the magic value of a compressed frame ("CTLZ")
+constexpr const u32 _compressed_frame_magic = 0x5a4c5443;
+constexpr const u32 _compressed_frame_version = 1;
+
+// flag in the compressed size of a block header, which marks that the block is stored uncompressed
+constexpr const u32 _compressed_block_stored_flag = 0x80000000u;
+
+struct _compressed_frame_header
+{
+	u32 magic;
+	u32 version;
+	u32 block_size;
+	u32 reserved;
+};
+
+// the block header, a block with raw_size 0 marks the end of the frame
+struct _compressed_block_header
+{
+	u32 raw_size;
+	u32 compressed_size;
+	u32 checksum;
+};
+
+// compress a block. blocks which do not compress are stored.
+inline void _compress_block( const std::vector<u8> &raw, std::vector<u8> &compressed, u32 &compressed_size, u32 &checksum )
+{
+	compressed.resize( lz_compress_bound( raw.size() ) );
+	const size_t size = lz_compress( raw.data(), raw.size(), compressed.data(), raw.size() - 1 );
+	compressed_size = ( size > 0 ) ? (u32)size : ( (u32)raw.size() | _compressed_block_stored_flag );
+	checksum = block_checksum( raw.data(), raw.size() );
+}
+
+template<class _DataDestTy>
+inline compressed_data_destination<_DataDestTy>::compressed_data_destination( _DataDestTy &data_dest, size_t block_size, size_t thread_count )
+	: data_dest_m( data_dest )
+	, block_size_m( block_size )
+	, blocks_m( 2 * _resolve_thread_count( thread_count ) )
+	, workers_m( _resolve_thread_count( thread_count ) )
+{
+	if( block_size == 0 || block_size > compression_max_block_size )
+		throw ctle::status_error( status::invalid_param, "The block size must be in the range 1 to compression_max_block_size" );
+
+	for( _block &block : this->blocks_m )
+		block.raw.reserve( block_size );
+}
+
+template<class _DataDestTy>
+inline compressed_data_destination<_DataDestTy>::~compressed_data_destination()
+{
+	this->end();
+}
+
+template<class _DataDestTy>
+inline status compressed_data_destination<_DataDestTy>::write_to_destination( const void *src, u64 size )
+{
+	u64 written_count = 0;
+	ctStatusReturnCall( written_count, this->data_dest_m.write( (const u8 *)src, size ) );
+	ctValidate( written_count == size, status::cant_write ) << "The write operation failed. " << written_count << " of " << size << " bytes were written." << ctValidateEnd;
+	this->compressed_size_m += size;
+	return status::ok;
+}
+
+template<class _DataDestTy>
+inline status_return<status, u64> compressed_data_destination<_DataDestTy>::write( const u8 *src_buffer, u64 write_count )
+{
+	ctValidate( !this->ended_m, status::invalid ) << "The compressed frame has ended" << ctValidateEnd;
+
+	u64 written = 0;
+	while( written < write_count )
+	{
+		// fill the current block, and hand it to the workers when it is full
+		_block &block = this->blocks_m[this->fill_index_m % this->blocks_m.size()];
+		const size_t copy_size = (size_t)std::min<u64>( this->block_size_m - block.raw.size(), write_count - written );
+		block.raw.insert( block.raw.end(), &src_buffer[written], &src_buffer[written] + copy_size );
+		written += copy_size;
+
+		if( block.raw.size() == this->block_size_m )
+		{
+			// write the blocks which are already compressed, and if the ring is full, wait for the oldest block, 
+			// which is the next block to fill. the frame can't be continued after a failed write.
+			this->queue_block();
+			const size_t wait_index = ( this->fill_index_m - this->write_index_m == this->blocks_m.size() ) ? ( this->write_index_m + 1 ) : 0;
+			const status result = this->write_blocks( wait_index );
+			if( !result )
+			{
+				this->ended_m = true;
+				return result;
+			}
+		}
+	}
+
+	this->raw_size_m += write_count;
+	return write_count;
+}
+
+template<class _DataDestTy>
+inline void compressed_data_destination<_DataDestTy>::queue_block()
+{
+	_block &block = this->blocks_m[this->fill_index_m % this->blocks_m.size()];
+	this->workers_m.submit( [&block]() { _compress_block( block.raw, block.compressed, block.compressed_size, block.checksum ); }, block.done );
+	++this->fill_index_m;
+}
+
+template<class _DataDestTy>
+inline status compressed_data_destination<_DataDestTy>::write_blocks( size_t wait_index )
+{
+	if( !this->header_written_m )
+	{
+		const _compressed_frame_header header = { _compressed_frame_magic, _compressed_frame_version, (u32)this->block_size_m, 0 };
+		ctStatusCall( this->write_to_destination( &header, sizeof( header ) ) );
+		this->header_written_m = true;
+	}
+
+	// write the blocks in order. blocks before wait_index are waited for, the rest are only written if they are done.
+	while( this->write_index_m < this->fill_index_m )
+	{
+		_block &block = this->blocks_m[this->write_index_m % this->blocks_m.size()];
+		if( this->write_index_m < wait_index )
+			this->workers_m.wait( block.done );
+		else if( !this->workers_m.is_done( block.done ) )
+			break;
+
+		const _compressed_block_header header = { (u32)block.raw.size(), block.compressed_size, block.checksum };
+		ctStatusCall( this->write_to_destination( &header, sizeof( header ) ) );
+		if( block.compressed_size & _compressed_block_stored_flag )
+		{
+			ctStatusCall( this->write_to_destination( block.raw.data(), block.raw.size() ) );
+		}
+		else
+		{
+			ctStatusCall( this->write_to_destination( block.compressed.data(), block.compressed_size ) );
+		}
+		block.raw.clear();
+		++this->write_index_m;
+	}
+	return status::ok;
+}
+
+template<class _DataDestTy>
+inline status compressed_data_destination<_DataDestTy>::end()
+{
+	if( this->ended_m )
+		return status::ok;
+	this->ended_m = true;
+
+	// include the partially filled block, and write all blocks
+	if( !this->blocks_m[this->fill_index_m % this->blocks_m.size()].raw.empty() )
+		this->queue_block();
+	ctStatusCall( this->write_blocks( this->fill_index_m ) );
+
+	const _compressed_block_header end_marker = { 0, 0, 0 };
+	ctStatusCall( this->write_to_destination( &end_marker, sizeof( end_marker ) ) );
+	return status::ok;
+}
+
+// decompress a block, if it is not stored, and verify the checksum
+inline status _decompress_block( std::vector<u8> &raw, const std::vector<u8> &compressed, u32 raw_size, u32 compressed_size, u32 checksum )
+{
+	if( !( compressed_size & _compressed_block_stored_flag ) )
+	{
+		raw.resize( raw_size );
+		const status result = lz_decompress( compressed.data(), compressed_size, raw.data(), raw_size );
+		if( !result )
+			return result;
+	}
+	if( block_checksum( raw.data(), raw.size() ) != checksum )
+		return status::corrupted;
+	return status::ok;
+}
+
+template<class _DataSourceTy>
+inline compressed_data_source<_DataSourceTy>::compressed_data_source( _DataSourceTy &data_source, size_t thread_count )
+	: data_source_m( data_source )
+	, blocks_m( 2 * _resolve_thread_count( thread_count ) )
+	, workers_m( _resolve_thread_count( thread_count ) )
+{
+}
+
+template<class _DataSourceTy>
+inline status compressed_data_source<_DataSourceTy>::read_from_source( void *dest, u64 size )
+{
+	u64 read_count = 0;
+	ctStatusReturnCall( read_count, this->data_source_m.read( (u8 *)dest, size ) );
+	ctValidate( read_count == size, status::corrupted ) << "The compressed frame ended unexpectedly" << ctValidateEnd;
+	return status::ok;
+}
+
+template<class _DataSourceTy>
+inline status compressed_data_source<_DataSourceTy>::read_ahead()
+{
+	if( !this->header_read_m )
+	{
+		_compressed_frame_header header = {};
+		ctStatusCall( this->read_from_source( &header, sizeof( header ) ) );
+		ctValidate( header.magic == _compressed_frame_magic && header.version == _compressed_frame_version, status::corrupted ) << "The source is not a compatible compressed frame" << ctValidateEnd;
+		ctValidate( header.block_size > 0 && header.block_size <= compression_max_block_size, status::corrupted ) << "The block size of the compressed frame is not valid" << ctValidateEnd;
+		this->block_size_m = header.block_size;
+		this->header_read_m = true;
+	}
+
+	// read blocks from the source into the free slots of the ring, and hand them to the workers
+	while( !this->frame_ended_m && this->read_index_m - this->current_block_m < this->blocks_m.size() )
+	{
+		_compressed_block_header header = {};
+		ctStatusCall( this->read_from_source( &header, sizeof( header ) ) );
+		if( header.raw_size == 0 )
+		{
+			this->frame_ended_m = true;
+			break;
+		}
+
+		const bool stored = ( header.compressed_size & _compressed_block_stored_flag ) != 0;
+		const u32 payload_size = header.compressed_size & ~_compressed_block_stored_flag;
+		ctValidate( header.raw_size <= this->block_size_m && ( stored ? ( payload_size == header.raw_size ) : ( payload_size < header.raw_size ) ), status::corrupted ) << "A block header of the compressed frame is not valid" << ctValidateEnd;
+
+		_block &block = this->blocks_m[this->read_index_m % this->blocks_m.size()];
+		block.raw_size = header.raw_size;
+		block.compressed_size = header.compressed_size;
+		block.checksum = header.checksum;
+		std::vector<u8> &payload = stored ? block.raw : block.compressed;
+		payload.resize( payload_size );
+		ctStatusCall( this->read_from_source( payload.data(), payload_size ) );
+
+		this->workers_m.submit( [&block]() { block.result = _decompress_block( block.raw, block.compressed, block.raw_size, block.compressed_size, block.checksum ); }, block.done );
+		++this->read_index_m;
+	}
+	return status::ok;
+}
+
+template<class _DataSourceTy>
+inline status_return<status, u64> compressed_data_source<_DataSourceTy>::read( u8 *dest_buffer, u64 read_count )
+{
+	u64 read_bytes = 0;
+	while( read_bytes < read_count )
+	{
+		// copy from the current block, when it is decompressed
+		if( this->current_block_m < this->read_index_m )
+		{
+			_block &block = this->blocks_m[this->current_block_m % this->blocks_m.size()];
+			this->workers_m.wait( block.done );
+			ctValidate( block.result, block.result ) << "A block of the compressed frame is corrupted" << ctValidateEnd;
+
+			const size_t copy_size = (size_t)std::min<u64>( block.raw.size() - this->block_position_m, read_count - read_bytes );
+			memcpy( &dest_buffer[read_bytes], &block.raw[this->block_position_m], copy_size );
+			read_bytes += copy_size;
+			this->block_position_m += copy_size;
+			if( this->block_position_m == block.raw.size() )
+			{
+				// the block is used, read the next block into its slot while the workers decompress
+				++this->current_block_m;
+				this->block_position_m = 0;
+				ctStatusCall( this->read_ahead() );
+			}
+			continue;
+		}
+
+		// all blocks are used, read ahead
+		if( this->frame_ended_m )
+			break;
+		ctStatusCall( this->read_ahead() );
+	}
+	return read_bytes;
+}
+
+}
+//namespace ctle
+
+#ifdef CTLE_IMPLEMENTATION
+
+namespace ctle
+{
+
+// codec constants
+constexpr const size_t _lz_min_match = 4;
+constexpr const size_t _lz_max_offset = 65535;
+constexpr const size_t _lz_hash_bits = 14;
+
+// matches are not searched in the last bytes of the block, so that the end of the block is always literals
+constexpr const size_t _lz_match_end_margin = 12;
+
+inline u32 _lz_read_u32( const u8 *ptr )
+{
+	u32 value;
+	memcpy( &value, ptr, sizeof( value ) );
+	return value;
+}
+
+inline u32 _lz_hash( u32 sequence )
+{
+	return ( sequence * 2654435761u ) >> ( 32 - _lz_hash_bits );
+}
+
+// write a length which did not fit in the token nibble, as a run of 255 bytes and a final byte
+inline u8 *_lz_write_length( u8 *op, size_t length )
+{
+	while( length >= 255 )
+	{
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = (u8)length;
+	return op;
+}
+
+// write a sequence of literals, and a match (unless it is the last sequence)
+inline u8 *_lz_write_sequence( u8 *op, u8 *const op_end, const u8 *literals, size_t literal_count, size_t offset, size_t match_length )
+{
+	// worst case size of the sequence
+	const size_t sequence_size = 1 + ( literal_count / 255 + 1 ) + literal_count + 2 + ( match_length / 255 + 1 );
+	if( (size_t)( op_end - op ) < sequence_size )
+		return nullptr;
+
+	const size_t match_code = ( match_length > 0 ) ? ( match_length - _lz_min_match ) : 0;
+	u8 *token = op++;
+	*token = (u8)( ( std::min<size_t>( literal_count, 15 ) << 4 ) | std::min<size_t>( match_code, 15 ) );
+	if( literal_count >= 15 )
+		op = _lz_write_length( op, literal_count - 15 );
+	memcpy( op, literals, literal_count );
+	op += literal_count;
+
+	if( match_length > 0 )
+	{
+		*op++ = (u8)( offset & 0xff );
+		*op++ = (u8)( offset >> 8 );
+		if( match_code >= 15 )
+			op = _lz_write_length( op, match_code - 15 );
+	}
+	return op;
+}
+
+size_t lz_compress_bound( size_t src_size )
+{
+	// worst case is all literals
+	return src_size + src_size / 255 + 16;
+}
+
+size_t lz_compress( const u8 *src, size_t src_size, u8 *dest, size_t dest_capacity )
+{
+	u8 *op = dest;
+	u8 *const op_end = dest + dest_capacity;
+	size_t anchor = 0;
+
+	if( src_size > _lz_match_end_margin )
+	{
+		std::vector<u32> table( size_t( 1 ) << _lz_hash_bits, 0 );
+		const size_t match_limit = src_size - _lz_match_end_margin;
+		const size_t extend_limit = src_size - 5;
+
+		size_t ip = 1;
+		while( ip < match_limit )
+		{
+			// look up the last position with the same hash
+			const u32 sequence = _lz_read_u32( &src[ip] );
+			const u32 hash = _lz_hash( sequence );
+			size_t ref = table[hash];
+			table[hash] = (u32)ip;
+
+			if( ip - ref > _lz_max_offset || _lz_read_u32( &src[ref] ) != sequence || ref >= ip )
+			{
+				// no match, step faster through data which does not compress
+				ip += 1 + ( ( ip - anchor ) >> 6 );
+				continue;
+			}
+
+			// extend the match backwards and forwards
+			while( ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1] )
+			{
+				--ip;
+				--ref;
+			}
+			size_t match_length = _lz_min_match;
+			while( ip + match_length < extend_limit && src[ip + match_length] == src[ref + match_length] )
+				++match_length;
+
+			op = _lz_write_sequence( op, op_end, &src[anchor], ip - anchor, ip - ref, match_length );
+			if( !op )
+				return 0;
+
+			// add a position inside the match to the table, and continue after the match
+			ip += match_length;
+			anchor = ip;
+			if( ip - 2 < match_limit )
+				table[_lz_hash( _lz_read_u32( &src[ip - 2] ) )] = (u32)( ip - 2 );
+		}
+	}
+
+	// the last sequence is only literals
+	op = _lz_write_sequence( op, op_end, &src[anchor], src_size - anchor, 0, 0 );
+	if( !op )
+		return 0;
+	return (size_t)( op - dest );
+}
+
+status lz_decompress( const u8 *src, size_t src_size, u8 *dest, size_t dest_size )
+{
+	size_t ip = 0;
+	size_t op = 0;
+
+	for( ;; )
+	{
+		if( ip >= src_size )
+			return status::corrupted;
+		const u8 token = src[ip++];
+
+		// read the length and copy the literals
+		size_t literal_count = token >> 4;
+		if( literal_count == 15 )
+		{
+			u8 value = 0;
+			do
+			{
+				if( ip >= src_size )
+					return status::corrupted;
+				value = src[ip++];
+				literal_count += value;
+			} while( value == 255 );
+		}
+		if( literal_count > src_size - ip || literal_count > dest_size - op )
+			return status::corrupted;
+		memcpy( &dest[op], &src[ip], literal_count );
+		ip += literal_count;
+		op += literal_count;
+
+		// the last sequence has no match
+		if( ip == src_size )
+			break;
+
+		// read the offset and length, and copy the match
+		if( src_size - ip < 2 )
+			return status::corrupted;
+		const size_t offset = size_t( src[ip] ) | ( size_t( src[ip + 1] ) << 8 );
+		ip += 2;
+		if( offset == 0 || offset > op )
+			return status::corrupted;
+
+		size_t match_length = ( token & 15 ) + _lz_min_match;
+		if( ( token & 15 ) == 15 )
+		{
+			u8 value = 0;
+			do
+			{
+				if( ip >= src_size )
+					return status::corrupted;
+				value = src[ip++];
+				match_length += value;
+			} while( value == 255 );
+		}
+		if( match_length > dest_size - op )
+			return status::corrupted;
+
+		// copy the match forward in 8 byte words, which is correct also for overlapping matches if the offset is at 
+		// least 8, and if there is room for the over-copy at the end. short offsets repeat the data, and are copied byte by byte.
+		const u8 *match = &dest[op - offset];
+		u8 *out = &dest[op];
+		if( offset >= 8 && dest_size - op >= match_length + 8 )
+		{
+			for( size_t inx = 0; inx < match_length; inx += 8 )
+				memcpy( &out[inx], &match[inx], 8 );
+		}
+		else
+		{
+			for( size_t inx = 0; inx < match_length; ++inx )
+				out[inx] = match[inx];
+		}
+		op += match_length;
+	}
+
+	return ( op == dest_size ) ? status::ok : status::corrupted;
+}
+
+u32 block_checksum( const u8 *data, size_t size )
+{
+	u64 h = u64( size ) * 0x9e3779b97f4a7c15ull;
+	size_t inx = 0;
+	for( ; inx + 8 <= size; inx += 8 )
+	{
+		u64 word;
+		memcpy( &word, &data[inx], sizeof( word ) );
+		h ^= word * 0xc2b2ae3d27d4eb4full;
+		h = ( ( h << 31 ) | ( h >> 33 ) ) * 0x9e3779b97f4a7c15ull;
+	}
+	if( inx < size )
+	{
+		u64 word = 0;
+		memcpy( &word, &data[inx], size - inx );
+		h ^= word * 0xc2b2ae3d27d4eb4full;
+		h = ( ( h << 31 ) | ( h >> 33 ) ) * 0x9e3779b97f4a7c15ull;
+	}
+
+	// final avalanche
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	return (u32)h;
+}
+
+}
+//namespace ctle
+
+#endif//CTLE_IMPLEMENTATION
+
+#include "_undef_macros.inl"
+
+#endif//_CTLE_BLOCK_COMPRESSION_H_
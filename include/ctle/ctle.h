@@ -33,15 +33,26 @@
 #include "bimap.h"
 #include "base_types.h"
 #include "bitmap_font.h"
+#include "blob_store.h"
+#include "block_compression.h"
 #include "endianness.h"
 #include "file_funcs.h"
+#include "file_hash_cache.h"
+#include "flat_id_map.h"
+#include "id_filter.h"
+#include "gather.h"
 #include "idx_vector.h"
+#include "value_equality.h"
+#include "idx_vector_builder.h"
 #include "log.h"
 #include "ntup.h"
 #include "optional_idx_vector.h"
 #include "optional_value.h"
 #include "optional_vector.h"
+#include "pack_file.h"
 #include "readers_writer_lock.h"
+#include "serialization.h"
+#include "sorted_id_index.h"
 #include "prop.h"
 #include "status.h"
 #include "status_return.h"
@@ -49,6 +60,10 @@
 #include "thread_safe_map.h"
 #include "util.h"
 #include "uuid.h"
+#include "varint.h"
+#include "vector_view.h"
+#include "packed_index_vector.h"
+#include "nullable_vector.h"
 #include "digest.h"
 #include "sockets.h"
 #include "read_stream.h"
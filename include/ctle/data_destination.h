@@ -13,6 +13,13 @@
 #include "status_error.h"
 #include "file_funcs.h"
 
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
 namespace ctle
 {
 
@@ -20,9 +27,28 @@ namespace ctle
 class file_data_destination
 {
 public:
-	file_data_destination( const std::string &filepath, bool overwrite_existing = true );
+	/// @brief Open the file for writing.
+	/// @param filepath the path of the file
+	/// @param overwrite_existing if true, an existing file is overwritten, else the open fails if the file exists
+	/// @param mode the i/o mode, file_io_mode::streaming or file_io_mode::direct avoids filling the page cache when writing large files
+	file_data_destination( const std::string &filepath, bool overwrite_existing = true, file_io_mode mode = file_io_mode::buffered );
+
+	/// @brief Open the file for writing, with a specific write mode.
+	/// @param filepath the path of the file
+	/// @param write_mode how the file is created. With file_write_mode::atomic_replace, the file is replaced when the destination is closed, and readers never see partial data.
+	/// @param preallocate_size if not 0, disk space for this many bytes is reserved up front (best effort)
+	/// @param mode the i/o mode
+	file_data_destination( const std::string &filepath, file_write_mode write_mode, u64 preallocate_size = 0, file_io_mode mode = file_io_mode::buffered );
 	~file_data_destination();
 
+	/// @brief Close the file. With file_write_mode::atomic_replace, this replaces the destination file, unless a write failed.
+	/// @return status::ok, or status::cant_write if the file could not be replaced
+	status close();
+
+	/// @brief Close the file without replacing the destination file. With file_write_mode::atomic_replace, the temporary file is removed.
+	/// @details A destination which is destroyed without a call to close() is discarded, so an abandoned write never replaces the destination file.
+	void discard();
+
 	/// @brief Write from source buffer into file.
 	/// 
 	/// @param src_buffer the buffer to write from
@@ -34,25 +60,261 @@ private:
 	_file_object file;
 };
 
+/// @brief Data destination object for writing data to memory, into a chain of memory chunks.
+/// @details The chunks are never reallocated, so growing the destination does not copy the data already written. 
+/// The chunks can be used directly, e.g. for a vectored (scatter/gather) send, or copied into a single contiguous area.
+/// write_stream writes directly to memory destinations, so no intermediate buffer is used.
+class memory_data_destination
+{
+public:
+	/// @brief Marks the destination as a memory destination, which write_stream writes to directly
+	static constexpr const bool is_memory_data_destination = true;
+
+	/// @brief A chunk of written data
+	struct chunk
+	{
+		const u8 *data;
+		u64 size;
+	};
+
+	/// @brief Set up the destination
+	/// @param chunk_size the minimum size of each allocated chunk. Writes which are larger than the chunk size get a chunk of their own size.
+	explicit memory_data_destination( u64 chunk_size = 1024 * 1024 );
+
+	/// @brief Write from source buffer into the memory chunks.
+	/// @param src_buffer the buffer to write from
+	/// @param write_count the number of bytes to write
+	/// @return status::ok, along with the number of bytes written, or status::cant_allocate if a chunk could not be allocated.
+	status_return<status, u64> write(const u8* src_buffer, u64 write_count)
+	{
+		// fast path, the data fits in the current chunk
+		if( !this->chunk_list.empty() )
+		{
+			_chunk_allocation &current = this->chunk_list.back();
+			if( current.capacity - current.size >= write_count )
+			{
+				if( write_count > 0 )
+					memcpy( &current.data[current.size], src_buffer, (size_t)write_count );
+				current.size += write_count;
+				this->total_size += write_count;
+				return write_count;
+			}
+		}
+		return this->write_new_chunks( src_buffer, write_count );
+	}
+
+	/// @brief Get the total number of bytes written
+	u64 size() const { return this->total_size; }
+
+	/// @brief Get the written chunks, in order. The pointers are valid until the destination is cleared or destroyed.
+	std::vector<chunk> chunks() const;
+
+	/// @brief Copy all written data to a memory area
+	/// @param dest the destination, which must be at least size() bytes
+	void copy_to( u8 *dest ) const;
+
+	/// @brief Copy all written data to a vector
+	std::vector<u8> to_vector() const;
+
+	/// @brief Remove all written data, and release the chunks
+	void clear();
+
+private:
+	struct _chunk_allocation
+	{
+		std::unique_ptr<u8[]> data;
+		u64 capacity;
+		u64 size;
+	};
+
+	u64 chunk_size = 0;
+	u64 total_size = 0;
+	std::vector<_chunk_allocation> chunk_list;
+
+	status_return<status, u64> write_new_chunks(const u8* src_buffer, u64 write_count);
+};
+
+/// @brief Data destination object which writes the same data to two destinations, so one stream pass can feed multiple targets.
+/// @details Tee destinations can be nested to fan out to more than two destinations, e.g. tee_data_destination<A,tee_data_destination<B,C>>.
+/// If parallel is set, the second destination is written on a worker thread, while the first destination is written on the calling 
+/// thread. Each write still waits for both destinations to finish, since the source buffer is only valid during the call.
+/// @tparam _DataDestATy the type of the first destination
+/// @tparam _DataDestBTy the type of the second destination
+template<class _DataDestATy, class _DataDestBTy>
+class tee_data_destination
+{
+public:
+	/// @brief Set up the tee destination
+	/// @param dest_a the first destination
+	/// @param dest_b the second destination
+	/// @param parallel if true, the second destination is written on a worker thread, in parallel with the first destination
+	tee_data_destination( _DataDestATy &dest_a, _DataDestBTy &dest_b, bool parallel = false );
+	~tee_data_destination();
+
+	/// @brief Write from source buffer into both destinations.
+	/// @param src_buffer the buffer to write from
+	/// @param write_count the number of bytes to write
+	/// @return status::ok, along with the number of bytes written, or an error status if either destination failed to write all bytes.
+	status_return<status, u64> write(const u8* src_buffer, u64 write_count);
+
+	/// @brief Get the first destination
+	_DataDestATy &destination_a() { return this->dest_a; }
+
+	/// @brief Get the second destination
+	_DataDestBTy &destination_b() { return this->dest_b; }
+
+private:
+	_DataDestATy &dest_a;
+	_DataDestBTy &dest_b;
+
+	// the worker thread which writes to dest_b, if parallel
+	std::thread worker;
+	std::mutex worker_mutex;
+	std::condition_variable worker_cv;
+	const u8 *job_src = nullptr;
+	u64 job_count = 0;
+	bool job_pending = false;
+	bool job_done = false;
+	bool worker_stop = false;
+	status job_result = status::ok;
+
+	template<class _DataDestTy> static status write_all( _DataDestTy &dest, const u8 *src_buffer, u64 write_count );
+	void worker_loop();
+};
+
 }
 // namespace ctle
 
-#ifdef CTLE_IMPLEMENTATION
-
 #include "log.h"
 #include "_macros.inl"
 
 namespace ctle
 {
 
-file_data_destination::file_data_destination( const std::string &filepath, bool overwrite_existing )
+template<class _DataDestATy, class _DataDestBTy>
+inline tee_data_destination<_DataDestATy,_DataDestBTy>::tee_data_destination( _DataDestATy &_dest_a, _DataDestBTy &_dest_b, bool parallel )
+	: dest_a( _dest_a )
+	, dest_b( _dest_b )
+{
+	if( parallel )
+		this->worker = std::thread( &tee_data_destination::worker_loop, this );
+}
+
+template<class _DataDestATy, class _DataDestBTy>
+inline tee_data_destination<_DataDestATy,_DataDestBTy>::~tee_data_destination()
 {
-	ctStatusCallThrow(this->file.open_write(filepath,overwrite_existing));
+	if( this->worker.joinable() )
+	{
+		{
+			const std::lock_guard<std::mutex> lock( this->worker_mutex );
+			this->worker_stop = true;
+		}
+		this->worker_cv.notify_all();
+		this->worker.join();
+	}
+}
+
+template<class _DataDestATy, class _DataDestBTy>
+template<class _DataDestTy>
+inline status tee_data_destination<_DataDestATy,_DataDestBTy>::write_all( _DataDestTy &dest, const u8 *src_buffer, u64 write_count )
+{
+	u64 written_count = 0;
+	ctStatusReturnCall( written_count, dest.write( src_buffer, write_count ) );
+	ctValidate( written_count == write_count, status::cant_write ) << "The tee destination write failed. " << written_count << " of " << write_count << " bytes were written." << ctValidateEnd;
+	return status::ok;
+}
+
+template<class _DataDestATy, class _DataDestBTy>
+inline void tee_data_destination<_DataDestATy,_DataDestBTy>::worker_loop()
+{
+	std::unique_lock<std::mutex> lock( this->worker_mutex );
+	for( ;; )
+	{
+		this->worker_cv.wait( lock, [this]() { return this->job_pending || this->worker_stop; } );
+		if( this->worker_stop )
+			return;
+
+		// write without holding the lock, the caller waits for the job to be done
+		const u8 *src_buffer = this->job_src;
+		const u64 write_count = this->job_count;
+		this->job_pending = false;
+		lock.unlock();
+		const status result = write_all( this->dest_b, src_buffer, write_count );
+		lock.lock();
+
+		this->job_result = result;
+		this->job_done = true;
+		this->worker_cv.notify_all();
+	}
+}
+
+template<class _DataDestATy, class _DataDestBTy>
+inline status_return<status, u64> tee_data_destination<_DataDestATy,_DataDestBTy>::write( const u8* src_buffer, u64 write_count )
+{
+	if( !this->worker.joinable() )
+	{
+		ctStatusCall( write_all( this->dest_a, src_buffer, write_count ) );
+		ctStatusCall( write_all( this->dest_b, src_buffer, write_count ) );
+		return write_count;
+	}
+
+	// hand the write of dest_b to the worker, and write dest_a on this thread
+	{
+		const std::lock_guard<std::mutex> lock( this->worker_mutex );
+		this->job_src = src_buffer;
+		this->job_count = write_count;
+		this->job_pending = true;
+		this->job_done = false;
+	}
+	this->worker_cv.notify_all();
+
+	const status result_a = write_all( this->dest_a, src_buffer, write_count );
+
+	// always wait for the worker, since it reads from the source buffer
+	status result_b = status::ok;
+	{
+		std::unique_lock<std::mutex> lock( this->worker_mutex );
+		this->worker_cv.wait( lock, [this]() { return this->job_done; } );
+		result_b = this->job_result;
+	}
+
+	ctStatusCall( result_a );
+	ctStatusCall( result_b );
+	return write_count;
+}
+
+}
+// namespace ctle
+
+#ifdef CTLE_IMPLEMENTATION
+
+namespace ctle
+{
+
+
+file_data_destination::file_data_destination( const std::string &filepath, bool overwrite_existing, file_io_mode mode )
+{
+	ctStatusCallThrow(this->file.open_write(filepath,overwrite_existing,mode));
+}
+
+file_data_destination::file_data_destination( const std::string &filepath, file_write_mode write_mode, u64 preallocate_size, file_io_mode mode )
+{
+	ctStatusCallThrow(this->file.open_write(filepath,write_mode,preallocate_size,mode));
+}
+
+status file_data_destination::close()
+{
+	return this->file.close();
+}
+
+void file_data_destination::discard()
+{
+	this->file.discard();
 }
 
 file_data_destination::~file_data_destination()
 {
-	this->file.close();
+	this->file.discard();
 }
 
 status_return<status, u64> file_data_destination::write(const u8* src_buffer, u64 write_count)
@@ -65,11 +327,80 @@ status_return<status, u64> file_data_destination::write(const u8* src_buffer, u6
 	return write_count;
 }
 
+memory_data_destination::memory_data_destination( u64 _chunk_size )
+	: chunk_size( ( _chunk_size > 0 ) ? _chunk_size : 1 )
+{
 }
-// namespace ctle
 
-#include "_undef_macros.inl"
+status_return<status, u64> memory_data_destination::write_new_chunks(const u8* src_buffer, u64 write_count)
+{
+	u64 written = 0;
+	while( written < write_count )
+	{
+		// fill up the current chunk, then allocate a new chunk, which fits all of the rest of the data
+		if( !this->chunk_list.empty() )
+		{
+			_chunk_allocation &current = this->chunk_list.back();
+			const u64 copy_size = std::min( current.capacity - current.size, write_count - written );
+			if( copy_size > 0 )
+			{
+				memcpy( &current.data[current.size], &src_buffer[written], (size_t)copy_size );
+				current.size += copy_size;
+				written += copy_size;
+				continue;
+			}
+		}
+
+		const u64 capacity = std::max( this->chunk_size, write_count - written );
+		std::unique_ptr<u8[]> data( new (std::nothrow) u8[(size_t)capacity] );
+		ctValidate( data != nullptr, status::cant_allocate ) << "Failed to allocate a memory chunk of " << capacity << " bytes" << ctValidateEnd;
+		this->chunk_list.push_back( { std::move( data ), capacity, 0 } );
+	}
+
+	this->total_size += write_count;
+	return write_count;
+}
+
+std::vector<memory_data_destination::chunk> memory_data_destination::chunks() const
+{
+	std::vector<chunk> ret;
+	ret.reserve( this->chunk_list.size() );
+	for( const _chunk_allocation &alloc : this->chunk_list )
+	{
+		if( alloc.size > 0 )
+			ret.push_back( { alloc.data.get(), alloc.size } );
+	}
+	return ret;
+}
+
+void memory_data_destination::copy_to( u8 *dest ) const
+{
+	for( const _chunk_allocation &alloc : this->chunk_list )
+	{
+		if( alloc.size > 0 )
+			memcpy( dest, alloc.data.get(), (size_t)alloc.size );
+		dest += alloc.size;
+	}
+}
+
+std::vector<u8> memory_data_destination::to_vector() const
+{
+	std::vector<u8> ret( (size_t)this->total_size );
+	this->copy_to( ret.data() );
+	return ret;
+}
+
+void memory_data_destination::clear()
+{
+	this->chunk_list.clear();
+	this->total_size = 0;
+}
+
+}
+// namespace ctle
 
 #endif//CTLE_IMPLEMENTATION
 
+#include "_undef_macros.inl"
+
 #endif//_CTLE_DATA_DESTINATION_H_
@@ -13,6 +13,9 @@
 #include "status_error.h"
 #include "file_funcs.h"
 
+#include <cstring>
+#include <algorithm>
+
 namespace ctle
 {
 
@@ -20,7 +23,10 @@ namespace ctle
 class file_data_source
 {
 public:
-	file_data_source( const std::string &filepath );
+	/// @brief Open the file for reading.
+	/// @param filepath the path of the file
+	/// @param mode the i/o mode, file_io_mode::streaming or file_io_mode::direct avoids filling the page cache when reading large files once
+	file_data_source( const std::string &filepath, file_io_mode mode = file_io_mode::buffered );
 	~file_data_source();
 
 	/// @brief read from source into dest_buffer, return number of bytes actually read
@@ -30,11 +36,54 @@ public:
 	/// @return status::ok, along with the number of bytes read, or an error status if the read failed.
 	status_return<status, u64> read(u8* dest_buffer, u64 read_count);
 
+	/// @brief Move the read position of the source, used by read_stream::seek()
+	/// @param position the new read position, which can't be beyond the end of the file
+	/// @return status::ok, or status::invalid_param if the position is beyond the end of the file
+	status seek(u64 position);
+
 private:
 	u64 file_position = 0;
 	_file_object file;
 };
 
+/// @brief Data source object for reading data from a memory area. The memory is not copied, and must be kept alive while the source is used.
+/// @details read_stream reads memory sources in place, so no intermediate buffer is allocated or copied to.
+class memory_data_source
+{
+public:
+	/// @brief Marks the source as a memory source, which read_stream reads directly using data() and size()
+	static constexpr const bool is_memory_data_source = true;
+
+	/// @brief Set up the source over a memory area
+	/// @param data the memory area, can be nullptr if size is 0
+	/// @param size the size of the memory area in bytes
+	memory_data_source( const void *data, u64 size );
+
+	/// @brief read from source into dest_buffer, return number of bytes actually read
+	/// @param dest_buffer the buffer to read into
+	/// @param read_count the number of bytes to read
+	/// @return status::ok, along with the number of bytes read
+	status_return<status, u64> read(u8* dest_buffer, u64 read_count);
+
+	/// @brief Move the read position of the source
+	/// @return status::ok, or status::invalid_param if the position is beyond the end of the memory area
+	status seek(u64 position);
+
+	/// @brief Get the memory area of the source
+	const u8 *data() const { return this->source_data; }
+
+	/// @brief Get the size of the memory area of the source
+	u64 size() const { return this->source_size; }
+
+	/// @brief Get the current read position
+	u64 position() const { return this->source_position; }
+
+private:
+	const u8 *source_data = nullptr;
+	u64 source_size = 0;
+	u64 source_position = 0;
+};
+
 }
 // namespace ctle
 
@@ -46,9 +95,9 @@ private:
 namespace ctle
 {
 
-file_data_source::file_data_source( const std::string &filepath )
+file_data_source::file_data_source( const std::string &filepath, file_io_mode mode )
 {
-	ctStatusCallThrow(this->file.open_read(filepath));
+	ctStatusCallThrow(this->file.open_read(filepath, mode));
 }
 
 file_data_source::~file_data_source()
@@ -71,6 +120,39 @@ status_return<status, u64> file_data_source::read(u8* dest_buffer, u64 read_coun
 	return read_size;
 }
 
+status file_data_source::seek(u64 position)
+{
+	ctStatusCall(this->file.seek(position));
+	this->file_position = position;
+	return status::ok;
+}
+
+memory_data_source::memory_data_source( const void *data, u64 size )
+	: source_data( (const u8*)data )
+	, source_size( size )
+{
+	if( !data && size > 0 )
+		throw ctle::status_error( status::invalid_param, "data can only be nullptr if size is 0" );
+}
+
+status_return<status, u64> memory_data_source::read(u8* dest_buffer, u64 read_count)
+{
+	const u64 read_size = std::min( read_count, this->source_size - this->source_position );
+	if( read_size > 0 )
+	{
+		memcpy( dest_buffer, &this->source_data[this->source_position], (size_t)read_size );
+		this->source_position += read_size;
+	}
+	return read_size;
+}
+
+status memory_data_source::seek(u64 position)
+{
+	ctValidate( position <= this->source_size, status::invalid_param ) << "The position is beyond the end of the memory area" << ctValidateEnd;
+	this->source_position = position;
+	return status::ok;
+}
+
 }
 // namespace ctle
 
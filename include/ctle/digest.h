@@ -12,6 +12,8 @@
 #include <iosfwd>
 
 #include "status.h"
+#include "endianness.h"
+#include "util.h"
 
 namespace ctle
 {
@@ -46,24 +48,15 @@ struct digest
 template<size_t _Size>
 inline bool digest<_Size>::operator<(const digest& right) const noexcept
 {
-	const uint8_t* u1 = this->data;
-	const uint8_t* u2 = right.data;
-
 	// digest values are stored big-endian, so MSB is first byte (index 0), LSB is last byte (index 7, 15, 31 or 63)
-	size_t n = _Size / 8;
-	do
+	// find the first 64bit word which differs, and only compare that word as a big-endian value
+	for (size_t inx = 0; inx < (_Size / 64); ++inx)
 	{
-		if (*u1 != *u2)	// not equal, early exit, check if more or less than
+		if (this->_data_q[inx] != right._data_q[inx])
 		{
-			if (*u1 < *u2)
-				return true;	// less than
-			else
-				return false;	// more than
+			return from_bigendian<uint64_t>(&this->data[inx * 8]) < from_bigendian<uint64_t>(&right.data[inx * 8]);
 		}
-		++u1;
-		++u2;
-		--n;
-	} while (n > 0);
+	}
 
 	return false; // equal, so not less
 };
@@ -96,17 +89,29 @@ inline bool digest<_Size>::operator!=(const digest& right) const noexcept
 	return !this->operator==(right);
 };
 
+/// @brief Calculate a well-distributed size_t hash value of a digest, used by std::hash<digest<_Size>>.
 template<size_t _Size>
 inline size_t calculate_size_hash(const digest<_Size>& value)
 {
 	static_assert(sizeof(std::size_t) == sizeof(std::uint64_t), "The hash code only works for 64bit size_t");
-	size_t hval = value._data_q[0];
-	for (size_t inx = 1; inx < (_Size / 64); ++inx)
+	return hash_mix_64(value._data_q, _Size / 64);
+}
+
+/// @brief Identity hash of a digest, which xors the words of the digest. Only use for uniformly random digests, e.g. cryptographic hashes.
+template<size_t _Size>
+struct identity_hash<digest<_Size>>
+{
+	size_t operator()(const digest<_Size>& value) const noexcept
 	{
-		hval ^= value._data_q[inx];
+		static_assert(sizeof(std::size_t) == sizeof(std::uint64_t), "The hash code only works for 64bit size_t");
+		size_t hval = value._data_q[0];
+		for (size_t inx = 1; inx < (_Size / 64); ++inx)
+		{
+			hval ^= value._data_q[inx];
+		}
+		return hval;
 	}
-	return hval;
-}
+};
 
 }
 //namespace ctle
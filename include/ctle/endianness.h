@@ -9,12 +9,82 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 
 #include <utility>
+#include <type_traits>
+
+#include "_cpu_features.h"
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
 
 namespace ctle
 {
 
+/// @brief True if the host stores multi-byte values with the least significant byte first.
+/// @note MSVC only targets little-endian platforms, GCC and Clang define __BYTE_ORDER__.
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__))
+constexpr const bool host_is_little_endian = true;
+#else
+constexpr const bool host_is_little_endian = false;
+#endif
+
+/// @brief The byte order of multi-byte values, e.g. the declared byte order of a file format.
+enum class byte_order
+{
+    little_endian,
+    big_endian
+};
+
+/// @brief The byte order of the host.
+constexpr const byte_order host_byte_order = host_is_little_endian ? byte_order::little_endian : byte_order::big_endian;
+
+/// @brief The size of the values which are byte swapped when values of type T are converted between byte orders, or 0 if T is not converted.
+/// @details Arithmetic types of 2, 4 and 8 bytes are swapped as whole values. Other types are copied as is.
+/// @tparam T The type of the values.
+template <class T, class = void> struct byte_swap_value_size : std::integral_constant<size_t, 0> {};
+template <class T> struct byte_swap_value_size<T, typename std::enable_if<std::is_arithmetic<T>::value && ( sizeof( T ) == 2 || sizeof( T ) == 4 || sizeof( T ) == 8 )>::type> : std::integral_constant<size_t, sizeof( T )> {};
+
+/// @brief Reverse the byte order of a 16, 32 or 64 bit value, using the compiler intrinsics where available.
+/// @param value The value to byte swap.
+/// @return The byte swapped value.
+inline uint16_t byte_swap( uint16_t value )
+{
+#if defined(_MSC_VER)
+    return _byteswap_ushort( value );
+#elif defined(__GNUC__)
+    return __builtin_bswap16( value );
+#else
+    return uint16_t( ( value << 8 ) | ( value >> 8 ) );
+#endif
+}
+
+/// @copydoc byte_swap(uint16_t)
+inline uint32_t byte_swap( uint32_t value )
+{
+#if defined(_MSC_VER)
+    return _byteswap_ulong( value );
+#elif defined(__GNUC__)
+    return __builtin_bswap32( value );
+#else
+    return ( uint32_t( byte_swap( uint16_t( value & 0xffff ) ) ) << 16 ) | uint32_t( byte_swap( uint16_t( value >> 16 ) ) );
+#endif
+}
+
+/// @copydoc byte_swap(uint16_t)
+inline uint64_t byte_swap( uint64_t value )
+{
+#if defined(_MSC_VER)
+    return _byteswap_uint64( value );
+#elif defined(__GNUC__)
+    return __builtin_bswap64( value );
+#else
+    return ( uint64_t( byte_swap( uint32_t( value & 0xffffffff ) ) ) << 32 ) | uint64_t( byte_swap( uint32_t( value >> 32 ) ) );
+#endif
+}
+
 /// @brief Creates values from big-endian raw 2, 4, or 8 byte data.
 /// @details Template specialization is implemented for uint16_t, uint32_t, and uint64_t.
 /// @tparam T The type of the value to create.
@@ -41,9 +111,12 @@ template <> inline uint32_t from_bigendian<uint32_t>( const uint8_t *src )
 /// @brief Creates values from big-endian raw data. Specialization for uint64_t.
 /// @param src Pointer to the source big-endian data.
 /// @return The uint64_t value created from the big-endian data.
+/// @note Loads the full word at once (the source does not need to be aligned), and swaps it on little-endian hosts.
 template <> inline uint64_t from_bigendian<uint64_t>( const uint8_t *src )
 {
-    return ( uint64_t( from_bigendian<uint32_t>( &src[0] ) ) << 32 ) | uint64_t( from_bigendian<uint32_t>( &src[4] ) );
+    uint64_t value;
+    memcpy( &value, src, sizeof( value ) );
+    return host_is_little_endian ? byte_swap( value ) : value;
 }
 
 /// @brief Creates big-endian raw 2, 4, or 8 byte data from values. Template specialization is implemented for uint16_t, uint32_t, and uint64_t.
@@ -79,6 +152,56 @@ template <> inline void to_bigendian<uint64_t>( uint8_t *dst, uint64_t value )
     to_bigendian<uint32_t>( &dst[4], uint32_t( value & 0xffffffff ) );
 }
 
+// Copy count values of value_size (2, 4 or 8) bytes from src to dest, reversing the byte order of each value, one value at a time.
+inline void _byte_swap_copy_scalar( uint8_t *d, const uint8_t *s, size_t count, size_t value_size )
+{
+    const size_t total = count * value_size;
+    if( value_size == 2 )
+    {
+        for( size_t inx = 0; inx < total; inx += 2 )
+        {
+            uint16_t v;
+            memcpy( &v, &s[inx], 2 );
+            v = byte_swap( v );
+            memcpy( &d[inx], &v, 2 );
+        }
+    }
+    else if( value_size == 4 )
+    {
+        for( size_t inx = 0; inx < total; inx += 4 )
+        {
+            uint32_t v;
+            memcpy( &v, &s[inx], 4 );
+            v = byte_swap( v );
+            memcpy( &d[inx], &v, 4 );
+        }
+    }
+    else
+    {
+        for( size_t inx = 0; inx < total; inx += 8 )
+        {
+            uint64_t v;
+            memcpy( &v, &s[inx], 8 );
+            v = byte_swap( v );
+            memcpy( &d[inx], &v, 8 );
+        }
+    }
+}
+
+// Bulk version of _byte_swap_copy, using SIMD shuffles (AVX2, SSSE3 or NEON). The instruction set is selected at runtime, from the capabilities of the cpu.
+void _byte_swap_copy_bulk( uint8_t *d, const uint8_t *s, size_t count, size_t value_size );
+
+// Copy count values of value_size (2, 4 or 8) bytes from src to dest, reversing the byte order of each value. 
+// src and dest may be the same memory area, but must not otherwise overlap.
+inline void _byte_swap_copy( void *dest, const void *src, size_t count, size_t value_size )
+{
+    // short arrays are swapped inline, longer arrays use the SIMD kernels
+    if( count * value_size < 64 )
+        _byte_swap_copy_scalar( (uint8_t *)dest, (const uint8_t *)src, count, value_size );
+    else
+        _byte_swap_copy_bulk( (uint8_t *)dest, (const uint8_t *)src, count, value_size );
+}
+
 /// @brief Swap two bytes.
 /// @param pA Pointer to the first byte.
 /// @param pB Pointer to the second byte.
@@ -89,11 +212,16 @@ inline void swap_bytes( uint8_t *pA, uint8_t *pB )
     *pB = tmp;
 }
 
-/// @brief Swap byte order of a single value. Template specialization is implemented for uint16_t, uint32_t, and uint64_t.
+/// @brief Swap byte order of a single value. Template specialization is implemented for uint16_t, uint32_t, and uint64_t. Other types
+/// with a non-zero byte_swap_value_size (e.g. float, double, and n_tup of these) swap each of their values.
 /// 
 /// @tparam T The type of the value to swap byte order.
 /// @param dest Pointer to the value to swap byte order.
-template <class T> void swap_byte_order( T *dest );
+template <class T> inline void swap_byte_order( T *dest )
+{
+    static_assert( byte_swap_value_size<T>::value != 0, "The byte order of type T can not be swapped" );
+    _byte_swap_copy_scalar( (uint8_t *)dest, (const uint8_t *)dest, sizeof( T ) / byte_swap_value_size<T>::value, byte_swap_value_size<T>::value );
+}
 
 
 /// @brief Swap byte order of a single value. Specialization for uint16_t.
@@ -124,58 +252,169 @@ template<> inline void swap_byte_order<uint64_t>( uint64_t *dest )
     swap_bytes( &( (uint8_t *)dest )[3], &( (uint8_t *)dest )[4] );
 }
 
-/// @brief Swap byte order of multiple values. Template specialization is implemented for uint16_t, uint32_t, and uint64_t.
+/// @brief Swap byte order of multiple values, in place.
+/// @details Implemented for all types with a non-zero byte_swap_value_size, which are 2, 4 and 8 byte arithmetic types (including 
+/// float and double), and n_tup and mn_tup of these. Large arrays are swapped using SIMD shuffles (AVX2, SSSE3 or NEON), selected at runtime.
 /// 
 /// @tparam T The type of the values to swap byte order.
 /// @param dest Pointer to the array of values to swap byte order.
 /// @param count The number of values in the array.
-template <class T> void swap_byte_order( T *dest, size_t count );
-
+template <class T> inline void swap_byte_order( T *dest, size_t count )
+{
+    static_assert( byte_swap_value_size<T>::value != 0, "The byte order of type T can not be swapped" );
+    _byte_swap_copy( dest, dest, count * ( sizeof( T ) / byte_swap_value_size<T>::value ), byte_swap_value_size<T>::value );
+}
 
-/// @brief Swap byte order of multiple values. Specialization for uint16_t.
+/// @brief Copy multiple values, and swap their byte order. 
+/// @details Swapping while copying only reads and writes the data once, unlike a copy followed by an in-place swap. @see swap_byte_order(T*,size_t)
 /// 
-/// @param dest Pointer to the array of uint16_t values to swap byte order.
+/// @tparam T The type of the values to swap byte order.
+/// @param dest Pointer to the destination array. The destination must not overlap the source, unless it is the same array.
+/// @param src Pointer to the source array.
 /// @param count The number of values in the array.
-template<> inline void swap_byte_order<uint16_t>( uint16_t *dest, size_t count )
+template <class T> inline void swap_byte_order( T *dest, const T *src, size_t count )
 {
-    for( size_t i = 0; i < count; ++i )
+    static_assert( byte_swap_value_size<T>::value != 0, "The byte order of type T can not be swapped" );
+    _byte_swap_copy( dest, src, count * ( sizeof( T ) / byte_swap_value_size<T>::value ), byte_swap_value_size<T>::value );
+}
+
+}
+//namespace ctle
+
+#ifdef CTLE_IMPLEMENTATION
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define _CTLE_ENDIANNESS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define _CTLE_ENDIANNESS_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang need the target instruction set of functions which use intrinsics beyond the compiler flags, MSVC does not
+#if defined(__GNUC__)
+#define _CTLE_ENDIANNESS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define _CTLE_ENDIANNESS_TARGET(isa)
+#endif
+
+namespace ctle
+{
+
+#if defined(_CTLE_ENDIANNESS_X86)
+
+// shuffle masks which reverse the bytes of 2, 4 and 8 byte values, repeated for both 128 bit lanes of AVX2
+alignas(32) static const uint8_t _byte_swap_masks[3][32] = {
+    { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 },
+    { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 },
+    { 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 }
+};
+
+static const uint8_t *_byte_swap_mask( size_t value_size )
+{
+    return _byte_swap_masks[( value_size == 2 ) ? 0 : ( ( value_size == 4 ) ? 1 : 2 )];
+}
+
+_CTLE_ENDIANNESS_TARGET("ssse3") static void _byte_swap_copy_ssse3( uint8_t *d, const uint8_t *s, size_t count, size_t value_size )
+{
+    const size_t total = count * value_size;
+    const __m128i mask = _mm_load_si128( (const __m128i *)_byte_swap_mask( value_size ) );
+    size_t inx = 0;
+    for( ; inx + 64 <= total; inx += 64 )
     {
-        swap_bytes( &( (uint8_t *)dest )[0], &( (uint8_t *)dest )[1] );
-        ++dest;
+        const __m128i v0 = _mm_loadu_si128( (const __m128i *)&s[inx] );
+        const __m128i v1 = _mm_loadu_si128( (const __m128i *)&s[inx + 16] );
+        const __m128i v2 = _mm_loadu_si128( (const __m128i *)&s[inx + 32] );
+        const __m128i v3 = _mm_loadu_si128( (const __m128i *)&s[inx + 48] );
+        _mm_storeu_si128( (__m128i *)&d[inx], _mm_shuffle_epi8( v0, mask ) );
+        _mm_storeu_si128( (__m128i *)&d[inx + 16], _mm_shuffle_epi8( v1, mask ) );
+        _mm_storeu_si128( (__m128i *)&d[inx + 32], _mm_shuffle_epi8( v2, mask ) );
+        _mm_storeu_si128( (__m128i *)&d[inx + 48], _mm_shuffle_epi8( v3, mask ) );
     }
+    for( ; inx + 16 <= total; inx += 16 )
+        _mm_storeu_si128( (__m128i *)&d[inx], _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)&s[inx] ), mask ) );
+    _byte_swap_copy_scalar( &d[inx], &s[inx], ( total - inx ) / value_size, value_size );
 }
 
-/// @brief Swap byte order of multiple values. Specialization for uint32_t.
-/// 
-/// @param dest Pointer to the array of uint32_t values to swap byte order.
-/// @param count The number of values in the array.
-template<> inline void swap_byte_order<uint32_t>( uint32_t *dest, size_t count )
+_CTLE_ENDIANNESS_TARGET("avx2") static void _byte_swap_copy_avx2( uint8_t *d, const uint8_t *s, size_t count, size_t value_size )
 {
-    for( size_t i = 0; i < count; ++i )
+    const size_t total = count * value_size;
+    const __m256i mask = _mm256_load_si256( (const __m256i *)_byte_swap_mask( value_size ) );
+    size_t inx = 0;
+    for( ; inx + 128 <= total; inx += 128 )
     {
-        swap_bytes( &( (uint8_t *)dest )[0], &( (uint8_t *)dest )[3] );
-        swap_bytes( &( (uint8_t *)dest )[1], &( (uint8_t *)dest )[2] );
-        ++dest;
+        const __m256i v0 = _mm256_loadu_si256( (const __m256i *)&s[inx] );
+        const __m256i v1 = _mm256_loadu_si256( (const __m256i *)&s[inx + 32] );
+        const __m256i v2 = _mm256_loadu_si256( (const __m256i *)&s[inx + 64] );
+        const __m256i v3 = _mm256_loadu_si256( (const __m256i *)&s[inx + 96] );
+        _mm256_storeu_si256( (__m256i *)&d[inx], _mm256_shuffle_epi8( v0, mask ) );
+        _mm256_storeu_si256( (__m256i *)&d[inx + 32], _mm256_shuffle_epi8( v1, mask ) );
+        _mm256_storeu_si256( (__m256i *)&d[inx + 64], _mm256_shuffle_epi8( v2, mask ) );
+        _mm256_storeu_si256( (__m256i *)&d[inx + 96], _mm256_shuffle_epi8( v3, mask ) );
     }
+    for( ; inx + 32 <= total; inx += 32 )
+        _mm256_storeu_si256( (__m256i *)&d[inx], _mm256_shuffle_epi8( _mm256_loadu_si256( (const __m256i *)&s[inx] ), mask ) );
+    _byte_swap_copy_scalar( &d[inx], &s[inx], ( total - inx ) / value_size, value_size );
 }
 
-/// @brief Swap byte order of multiple values. Specialization for uint64_t.
-/// 
-/// @param dest Pointer to the array of uint64_t values to swap byte order.
-/// @param count The number of values in the array.
-template<> inline void swap_byte_order<uint64_t>( uint64_t *dest, size_t count )
+#elif defined(_CTLE_ENDIANNESS_NEON)
+
+static void _byte_swap_copy_neon( uint8_t *d, const uint8_t *s, size_t count, size_t value_size )
 {
-    for( size_t i = 0; i < count; ++i )
+    const size_t total = count * value_size;
+    size_t inx = 0;
+    if( value_size == 2 )
+    {
+        for( ; inx + 16 <= total; inx += 16 )
+            vst1q_u8( &d[inx], vrev16q_u8( vld1q_u8( &s[inx] ) ) );
+    }
+    else if( value_size == 4 )
     {
-        swap_bytes( &( (uint8_t *)dest )[0], &( (uint8_t *)dest )[7] );
-        swap_bytes( &( (uint8_t *)dest )[1], &( (uint8_t *)dest )[6] );
-        swap_bytes( &( (uint8_t *)dest )[2], &( (uint8_t *)dest )[5] );
-        swap_bytes( &( (uint8_t *)dest )[3], &( (uint8_t *)dest )[4] );
-        ++dest;
+        for( ; inx + 16 <= total; inx += 16 )
+            vst1q_u8( &d[inx], vrev32q_u8( vld1q_u8( &s[inx] ) ) );
     }
+    else
+    {
+        for( ; inx + 16 <= total; inx += 16 )
+            vst1q_u8( &d[inx], vrev64q_u8( vld1q_u8( &s[inx] ) ) );
+    }
+    _byte_swap_copy_scalar( &d[inx], &s[inx], ( total - inx ) / value_size, value_size );
+}
+
+#endif
+
+typedef void ( *_byte_swap_copy_func )( uint8_t *d, const uint8_t *s, size_t count, size_t value_size );
+
+static _byte_swap_copy_func _byte_swap_copy_select()
+{
+#if defined(_CTLE_ENDIANNESS_X86)
+    if( _cpu_has_avx2() )
+        return &_byte_swap_copy_avx2;
+    if( _cpu_has_ssse3() )
+        return &_byte_swap_copy_ssse3;
+    return &_byte_swap_copy_scalar;
+#elif defined(_CTLE_ENDIANNESS_NEON)
+    return &_byte_swap_copy_neon;
+#else
+    return &_byte_swap_copy_scalar;
+#endif
+}
+
+void _byte_swap_copy_bulk( uint8_t *d, const uint8_t *s, size_t count, size_t value_size )
+{
+    // the kernel is selected on first use
+    static const _byte_swap_copy_func kernel = _byte_swap_copy_select();
+    kernel( d, s, count, value_size );
 }
 
 }
 //namespace ctle
 
+#undef _CTLE_ENDIANNESS_TARGET
+
+#endif//CTLE_IMPLEMENTATION
+
 #endif//_CTLE_ENDIANNESS_H_
@@ -11,13 +11,35 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <functional>
+#include <atomic>
 
 #include "fwd.h"
 #include "status.h"
+#include "util.h"
 
 namespace ctle
 {
 
+/// @brief The i/o mode of a file opened with _file_object, file_data_source or file_data_destination.
+enum class file_io_mode : unsigned int
+{
+	buffered = 0,	// regular i/o through the os file cache, with a sequential access hint
+	streaming = 1,	// i/o through the os file cache, but the cached pages are dropped after they have been read or written, so that large files do not evict other cached data
+	direct = 2,		// bypass the os file cache (O_DIRECT / FILE_FLAG_NO_BUFFERING). Reads and writes are fastest when buffers and sizes are aligned to direct_io_alignment.
+};
+
+/// @brief The alignment of buffers, file offsets and sizes for direct i/o. 
+constexpr const size_t direct_io_alignment = 4096;
+
+/// @brief How a file is created when it is opened for writing.
+enum class file_write_mode : unsigned int
+{
+	create = 0,			// create a new file, fail with status::already_exists if the file exists
+	overwrite = 1,		// create the file, or truncate and rewrite an existing file in place
+	atomic_replace = 2,	// write to a temporary file in the same directory, which is synced to disk and renamed over the file when closed. Readers see either the old or the new file, never partial data, even if the process crashes.
+};
+
 /// @brief Enum class for file access modes in file_access() function.
 enum class access_mode : unsigned int
 {
@@ -44,6 +66,26 @@ bool file_exists(const std::string& path); ///< @copydoc ctle::file_exists
 status file_access(const char* path, access_mode amode);
 status file_access(const std::string& path, access_mode amode); ///< @copydoc ctle::file_access
 
+/// @brief File information, as returned by get_file_info()
+struct file_info
+{
+	u64 size = 0;		// the size of the file in bytes
+	u64 mtime_ns = 0;	// the last modification time, in nanoseconds since the platform epoch
+	u64 inode = 0;		// the inode (posix) or file index (windows), which identifies the file on the volume
+};
+
+/// @brief Get the size, modification time and inode of a file
+/// @param path the file path
+/// @param dest the destination info
+/// @return 
+/// - status::ok if the info was retrieved
+/// - status::not_found if the file doesn't exist
+/// - status::cant_access if the file info can't be read
+status get_file_info(const std::string& path, file_info& dest);
+
+/// @brief Get the current time of the system clock, in nanoseconds since the platform epoch, so it can be compared to file_info::mtime_ns
+u64 get_file_time_now();
+
 /// @brief Read a file in binary mode into a vector of bytes
 /// @param filepath the source file path
 /// @param dest the destination vector
@@ -53,6 +95,26 @@ status file_access(const std::string& path, access_mode amode); ///< @copydoc ct
 /// - status::cant_read if the file could not be read
 status read_file(const std::string & filepath, std::vector<uint8_t>&dest);
 
+/// @brief Callback for read_files(), called once per file with the index of the file in the path list, the read status, and the file data.
+/// @note The callback is called concurrently from the reader threads. The data vector is reused by the thread after the callback returns, but can be moved from.
+using read_files_callback = std::function<void( size_t index, status result, std::vector<uint8_t> &data )>;
+
+/// @brief Read multiple files concurrently, using a bounded pool of reader threads.
+/// @details Each thread repeatedly picks the next file in the list, allocates the buffer using the file size, and reads the file. 
+/// Reading many files at once hides the per-file open and read latency, which dominates when loading many small files.
+/// @param paths the file paths
+/// @param callback called with the data of each file (or the error status), from the reader threads
+/// @param max_threads the max number of reader threads, or 0 to select a default count from the hardware concurrency
+/// @return the read status of each file, same as read_file()
+std::vector<status> read_files(const std::vector<std::string>& paths, const read_files_callback& callback, size_t max_threads = 0);
+
+/// @brief Read multiple files concurrently into a vector of byte vectors. @see read_files()
+/// @param paths the file paths
+/// @param dest the destination vectors, resized to the number of paths
+/// @param max_threads the max number of reader threads, or 0 to select a default count from the hardware concurrency
+/// @return the read status of each file, same as read_file()
+std::vector<status> read_files_into(const std::vector<std::string>& paths, std::vector<std::vector<uint8_t>>& dest, size_t max_threads = 0);
+
 /// @brief Write a file in binary mode from a pointer to or a container.
 /// @param filepath the destination file path
 /// @param src the source data 
@@ -78,13 +140,86 @@ template<class _Ty> inline status write_file(const std::string& filepath, const
 	return write_file( filepath, (const void *)src.data(), src.size() * sizeof( typename _Ty::value_type ), overwrite_existing );
 }
 
+/// @brief Write a file in binary mode from a pointer to or a container, with a specific write mode.
+/// @details With file_write_mode::atomic_replace, the file is preallocated to the data size, written to a temporary file 
+/// in the same directory, synced to disk and renamed into place, so readers never see a partially written file.
+/// @param filepath the destination file path
+/// @param src the source data 
+/// @param src_size the source data size
+/// @param write_mode how the file is created
+/// @return 
+/// - status::ok if the file was written successfully
+/// - status::cant_write if the file could not be written
+/// - status::already_exists if the file already exists and write_mode is file_write_mode::create
+status write_file(const std::string& filepath, const void* src, size_t src_size, file_write_mode write_mode);
+template<class _Ty> inline status write_file(const std::string& filepath, const _Ty& src, file_write_mode write_mode)
+{
+	return write_file( filepath, (const void *)src.data(), src.size() * sizeof( typename _Ty::value_type ), write_mode );
+}
+
+/// @brief Create a directory. The parent directory must exist.
+/// @param path the directory path
+/// @return 
+/// - status::ok if the directory was created, or already exists
+/// - status::cant_write if the directory could not be created
+status create_directory(const std::string& path);
+
+/// @brief Rename (move) a file, replacing the destination file if it exists. If the paths are on the same volume, the rename is atomic.
+/// @param from_path the current file path
+/// @param to_path the new file path
+/// @return 
+/// - status::ok if the file was renamed
+/// - status::cant_write if the file could not be renamed
+status rename_file(const std::string& from_path, const std::string& to_path);
+
+/// @brief Remove a file
+/// @param path the file path
+/// @return 
+/// - status::ok if the file was removed
+/// - status::not_found if the file does not exist
+/// - status::cant_write if the file could not be removed
+status remove_file(const std::string& path);
+
 /// @brief Class for file reading/writing, encapsulating a file object.
 /// @details This class is portable, but uses native interfaces when possible. Mainly for internal use, but can be used directly.
+/// In file_io_mode::direct, aligned reads and writes go directly to the file, while unaligned buffers and sizes are handled
+/// through an aligned bounce buffer. Only the last write of a file may have a size which is not a multiple of direct_io_alignment.
+/// If the file system does not support direct i/o, the file is opened in file_io_mode::streaming instead.
 class _file_object
 {
 private:
 	void* file_handle = nullptr;
 	u64 file_size = 0;
+	u64 file_position = 0;
+	u64 cache_drop_position = 0;
+	u64 direct_end_of_file = 0;
+	file_io_mode io_mode = file_io_mode::buffered;
+	bool write_access = false;
+	bool direct_tail_written = false;
+	std::atomic<bool> write_failed{ false };
+	std::string atomic_temp_path;
+	std::string atomic_target_path;
+
+	// positional read/write of the native file, all sizes and offsets must be aligned in direct mode
+	status raw_read(u8 * dest, const u64 size, const u64 offset, u64 &bytes_read);
+	status raw_write(const u8 * src, const u64 size, const u64 offset);
+
+	status read_direct(u8 * dest, u64 size, u64 offset);
+	status write_direct_aligned(const u8 * src, const u64 size, const u64 offset);
+	status write_direct(const u8 * src, u64 size);
+	status write_direct_tail(const u8 * src, const u64 size);
+	void drop_cached_pages(bool final_drop);
+
+	// platform open and close of the native file
+	status open_write_handle(const std::string & filepath, bool overwrite_existing, file_io_mode mode);
+	void close_handle();
+
+	// flush written data to disk, and (best effort) reserve disk space for the file
+	status sync_data();
+	void preallocate(u64 size);
+
+	// sync and close the temporary file of an atomic replace, and rename it over the target path
+	status commit_atomic_replace(std::string target_path);
 	
 public:
 	_file_object();
@@ -92,30 +227,69 @@ public:
 
 	/// @brief Open a file for reading
 	/// @param filepath the file path
+	/// @param mode the i/o mode
 	/// @return 
 	/// - status::ok if the file was opened successfully
 	/// - status::cant_open if the file could not be opened
 	/// - status::corrupted if the file size could not be determined
-	status open_read(const std::string & filepath);
+	status open_read(const std::string & filepath, file_io_mode mode = file_io_mode::buffered);
 
 	/// @brief Open a file for writing
 	/// @param filepath the file path
 	/// @param overwrite_existing if false, the file will not be overwritten if it already exists, and the function will return status::already_exists
+	/// @param mode the i/o mode
 	/// @return 
 	/// - status::ok if the file was opened successfully
 	/// - status::cant_write if the file could not be opened
 	/// - status::already_exists if the file already exists and overwrite_existing is false
-	status open_write(const std::string & filepath, bool overwrite_existing = false);
+	status open_write(const std::string & filepath, bool overwrite_existing = false, file_io_mode mode = file_io_mode::buffered);
+
+	/// @brief Open a file for writing, with a specific write mode
+	/// @param filepath the file path
+	/// @param write_mode how the file is created. With file_write_mode::atomic_replace, the data is written to a temporary file, which replaces the file when closed.
+	/// @param preallocate_size if not 0, disk space for this many bytes is reserved up front (best effort), which avoids fragmenting large files
+	/// @param mode the i/o mode
+	/// @return 
+	/// - status::ok if the file was opened successfully
+	/// - status::cant_write if the file could not be opened
+	/// - status::already_exists if the file already exists and write_mode is file_write_mode::create
+	status open_write(const std::string & filepath, file_write_mode write_mode, u64 preallocate_size = 0, file_io_mode mode = file_io_mode::buffered);
 
 	/// @brief Close the file
+	/// @details If the file was opened with file_write_mode::atomic_replace, the temporary file is synced to disk and renamed over
+	/// the destination file, and the directory is synced. If any write failed, the temporary file is removed instead, and the 
+	/// destination file is left untouched.
+	/// @return 
+	/// - status::ok if the file was closed (and replaced) successfully
+	/// - status::cant_write if an atomic replace failed
 	status close();
 
+	/// @brief Close a file which was opened with file_write_mode::atomic_replace, and replace to_path instead of the path the file was opened with.
+	/// @details Use this when the final path is only known after the data is written, e.g. a file named by the digest of its contents.
+	/// The temporary file is synced to disk and renamed over to_path, which must be on the same volume, and the directory of to_path is synced.
+	/// If any write failed, the temporary file is removed instead.
+	/// @return 
+	/// - status::ok if the file was closed and renamed successfully
+	/// - status::not_ready if the file is not open with file_write_mode::atomic_replace
+	/// - status::cant_write if the replace failed
+	status close_and_rename(const std::string & to_path);
+
+	/// @brief Close the file, and if the file was opened with file_write_mode::atomic_replace, remove the temporary file without replacing the destination file.
+	/// @details This is also what the destructor does, so a file which is not explicitly closed never replaces the destination file.
+	void discard();
+
 	/// @brief Check if the file is open
 	bool is_open() const;
 
 	/// @brief Get the size of the file
 	u64 size() const { return this->file_size; };
 
+	/// @brief Get the current read or write position in the file
+	u64 position() const { return this->file_position; }
+
+	/// @brief Get the i/o mode of the file. If direct i/o is not supported, this is file_io_mode::streaming even if direct i/o was requested.
+	file_io_mode get_io_mode() const { return this->io_mode; }
+
 	/// @brief Read data from the file
 	/// @param dest the destination buffer
 	/// @param size the number of bytes to read
@@ -124,20 +298,94 @@ public:
 	/// - status::cant_read if the data could not be read
 	status read(u8 * dest, const u64 size);
 
+	/// @brief Move the read or write position of the file
+	/// @param position the new position. For files opened for reading, the position can't be beyond the end of the file.
+	/// @return 
+	/// - status::ok if the position was moved
+	/// - status::invalid_param if the position is beyond the end of a file opened for reading
+	status seek(const u64 position);
+
+	/// @brief Read data from a specific offset in the file, without moving the file position
+	/// @details read_at uses positional reads (pread / ReadFile with an offset), and can be called concurrently from multiple threads.
+	/// In direct i/o mode, unaligned offsets and sizes are handled through a bounce buffer.
+	/// @param offset the offset in the file
+	/// @param dest the destination buffer
+	/// @param size the number of bytes to read
+	/// @return 
+	/// - status::ok if the data was read successfully
+	/// - status::cant_read if the data could not be read, or is beyond the end of the file
+	status read_at(const u64 offset, u8 * dest, const u64 size);
+
+	/// @brief Write data to a specific offset in the file, without moving the file position
+	/// @details write_at uses positional writes (pwrite / WriteFile with an offset), and can be called concurrently from multiple threads for non-overlapping ranges.
+	/// @param offset the offset in the file
+	/// @param src the source buffer
+	/// @param size the number of bytes to write
+	/// @return 
+	/// - status::ok if the data was written successfully
+	/// - status::cant_write if the data could not be written
+	/// - status::invalid_param if in direct i/o mode and the offset or size is not a multiple of direct_io_alignment
+	status write_at(const u64 offset, const u8 * src, const u64 size);
+
 	/// @brief Write data to the file
 	/// @param src the source buffer
 	/// @param size the number of bytes to write
 	/// @return 
 	/// - status::ok if the data was written successfully
 	/// - status::cant_write if the data could not be written
+	/// - status::invalid if writing after a direct i/o write with an unaligned size
 	status write(const u8 * src, const u64 size);
 };
 
+/// @brief A read-only memory mapping of a whole file.
+/// @details The file contents can be accessed directly through data() without copying, until the mapping is closed. 
+class mapped_file
+{
+private:
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+	const u8* file_data = nullptr;
+	u64 file_size = 0;
+
+public:
+	mapped_file() = default;
+	mapped_file( const mapped_file & ) = delete;
+	mapped_file &operator=( const mapped_file & ) = delete;
+	mapped_file( mapped_file &&other ) noexcept;
+	mapped_file &operator=( mapped_file &&other ) noexcept;
+	~mapped_file();
+
+	/// @brief Map a file for reading
+	/// @param filepath the file path
+	/// @return 
+	/// - status::ok if the file was mapped successfully
+	/// - status::cant_open if the file could not be opened
+	/// - status::cant_read if the file could not be mapped
+	status open(const std::string & filepath);
+
+	/// @brief Unmap and close the file
+	status close();
+
+	/// @brief Check if the file is mapped. Note that an empty file is open, but has no data.
+	bool is_open() const { return this->file_handle != nullptr; }
+
+	/// @brief The mapped file data, or nullptr if the file is empty or not open
+	const u8* data() const { return this->file_data; }
+
+	/// @brief Get the size of the file
+	u64 size() const { return this->file_size; }
+};
+
 }
 //namespace ctle
 
 #ifdef CTLE_IMPLEMENTATION
 
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+
 #include "log.h"
 #include "_macros.inl"
 
@@ -189,6 +437,385 @@ status write_file( const std::string &filepath, const void *src, size_t src_size
 	return status::ok;
 }
 
+status write_file( const std::string &filepath, const void *src, size_t src_size, file_write_mode write_mode )
+{
+	// src can only be nullptr if src_size is 0
+	if( !src && src_size > 0 )
+		return status::invalid_param;
+
+	_file_object f;
+	ctStatusCall(f.open_write(filepath, write_mode, (write_mode == file_write_mode::atomic_replace) ? src_size : 0));
+	ctStatusCall(f.write( (u8*)src, src_size));
+	ctStatusCall(f.close());
+	return status::ok;
+}
+
+std::vector<status> read_files( const std::vector<std::string> &paths, const read_files_callback &callback, size_t max_threads )
+{
+	std::vector<status> results( paths.size(), status::ok );
+	if( paths.empty() )
+		return results;
+
+	// reads are latency bound, so use more threads than cores by default
+	if( max_threads == 0 )
+		max_threads = std::max<size_t>( 4, 2 * (size_t)std::thread::hardware_concurrency() );
+	const size_t thread_count = std::min( max_threads, paths.size() );
+
+	std::atomic<size_t> next_index( 0 );
+	auto reader = [&]()
+		{
+			std::vector<uint8_t> data;
+			for( ;; )
+			{
+				const size_t index = next_index++;
+				if( index >= paths.size() )
+					break;
+
+				data.clear();
+				results[index] = read_file( paths[index], data );
+				if( callback )
+					callback( index, results[index], data );
+			}
+		};
+
+	// the calling thread is one of the readers
+	std::vector<std::thread> threads;
+	threads.reserve( thread_count - 1 );
+	for( size_t inx = 1; inx < thread_count; ++inx )
+	{
+		threads.emplace_back( reader );
+	}
+	reader();
+	for( auto &thread : threads )
+	{
+		thread.join();
+	}
+
+	return results;
+}
+
+std::vector<status> read_files_into( const std::vector<std::string> &paths, std::vector<std::vector<uint8_t>> &dest, size_t max_threads )
+{
+	dest.clear();
+	dest.resize( paths.size() );
+	return read_files( paths, [&dest]( size_t index, status result, std::vector<uint8_t> &data )
+		{
+			if( result )
+				dest[index] = std::move( data );
+		}, max_threads );
+}
+
+// the size of the bounce buffer used for unaligned direct i/o
+constexpr const u64 _file_object_bounce_size = 1024 * 1024;
+
+// the number of bytes read or written in streaming mode between each drop of cached pages
+constexpr const u64 _file_object_cache_drop_interval = 8 * 1024 * 1024;
+
+status _file_object::read( u8 *dest, const u64 size )
+{
+	ctValidate( this->is_open(), status::not_ready ) << "The file stream is not open" << ctValidateEnd;
+
+	if( this->io_mode == file_io_mode::direct )
+	{
+		ctStatusCall( this->read_direct( dest, size, this->file_position ) );
+		this->file_position += size;
+		return status::ok;
+	}
+
+	u64 bytes_read = 0;
+	ctStatusCall( this->raw_read( dest, size, this->file_position, bytes_read ) );
+	if( bytes_read != size )
+		return status::cant_read;
+	this->file_position += size;
+
+	if( this->io_mode == file_io_mode::streaming )
+		this->drop_cached_pages( false );
+	return status::ok;
+}
+
+// sync the renamed file and its directory to disk (platform specific)
+static status _file_replace_durable( const std::string &from_path, const std::string &to_path );
+
+// generate a unique temporary file path in the same directory as a file
+static std::string _file_temp_path( const std::string &filepath )
+{
+	static std::atomic<u64> counter( 0 );
+	const u64 words[3] = { 
+		(u64)std::chrono::high_resolution_clock::now().time_since_epoch().count(),
+		(u64)std::hash<std::thread::id>()( std::this_thread::get_id() ),
+		counter.fetch_add( 1 ) 
+		};
+
+	static const char hex[] = "0123456789abcdef";
+	std::string name = filepath + ".";
+	const u64 id = hash_mix_64( words, 3 );
+	for( int shift = 60; shift >= 0; shift -= 4 )
+		name += hex[( id >> shift ) & 0xf];
+	return name + ".tmp";
+}
+
+status _file_object::open_write( const std::string &filepath, bool overwrite_existing, file_io_mode mode )
+{
+	return this->open_write( filepath, ( overwrite_existing ) ? ( file_write_mode::overwrite ) : ( file_write_mode::create ), 0, mode );
+}
+
+status _file_object::open_write( const std::string &filepath, file_write_mode write_mode, u64 preallocate_size, file_io_mode mode )
+{
+	if( this->is_open() )
+		this->close();
+
+	if( write_mode == file_write_mode::atomic_replace )
+	{
+		const std::string temp_path = _file_temp_path( filepath );
+		ctStatusCall( this->open_write_handle( temp_path, false, mode ) );
+		this->atomic_temp_path = temp_path;
+		this->atomic_target_path = filepath;
+	}
+	else
+	{
+		ctStatusCall( this->open_write_handle( filepath, write_mode == file_write_mode::overwrite, mode ) );
+	}
+	this->write_failed = false;
+
+	if( preallocate_size > 0 )
+		this->preallocate( preallocate_size );
+	return status::ok;
+}
+
+status _file_object::close()
+{
+	if( !this->is_open() )
+		return status::ok;
+
+	if( this->atomic_target_path.empty() )
+	{
+		this->close_handle();
+		return status::ok;
+	}
+	return this->commit_atomic_replace( this->atomic_target_path );
+}
+
+status _file_object::close_and_rename( const std::string &to_path )
+{
+	ctValidate( this->is_open() && !this->atomic_target_path.empty(), status::not_ready ) << "The file is not open for an atomic replace" << ctValidateEnd;
+	return this->commit_atomic_replace( to_path );
+}
+
+status _file_object::commit_atomic_replace( std::string target_path )
+{
+	// make sure the data is on disk before the temporary file is renamed over the target
+	const std::string temp_path = std::move( this->atomic_temp_path );
+	this->atomic_temp_path.clear();
+	this->atomic_target_path.clear();
+
+	status result = ( this->write_failed ) ? ( status::cant_write ) : ( this->sync_data() );
+	this->close_handle();
+	if( result )
+		result = _file_replace_durable( temp_path, target_path );
+	if( !result )
+	{
+		remove_file( temp_path );
+		ctLogError << "Failed to replace the file: " << target_path << ctLogEnd;
+	}
+	return result;
+}
+
+void _file_object::discard()
+{
+	if( !this->is_open() )
+		return;
+
+	this->close_handle();
+	if( !this->atomic_temp_path.empty() )
+	{
+		remove_file( this->atomic_temp_path );
+		this->atomic_temp_path.clear();
+		this->atomic_target_path.clear();
+	}
+}
+
+status _file_object::write( const u8 *src, const u64 size )
+{
+	ctValidate( this->is_open(), status::not_ready ) << "The file stream is not open" << ctValidateEnd;
+
+	status result = status::ok;
+	if( this->io_mode == file_io_mode::direct )
+	{
+		result = this->write_direct( src, size );
+	}
+	else
+	{
+		result = this->raw_write( src, size, this->file_position );
+		if( result )
+		{
+			this->file_position += size;
+			if( this->io_mode == file_io_mode::streaming )
+				this->drop_cached_pages( false );
+		}
+	}
+
+	// a failed write marks the file, so that an atomic replace is not committed
+	if( !result )
+		this->write_failed = true;
+	return result;
+}
+
+status _file_object::read_direct( u8 *dest, u64 size, u64 offset )
+{
+	const u64 alignment = direct_io_alignment;
+
+	// read the aligned part directly into the destination
+	if( ( offset % alignment ) == 0 && ( (uintptr_t)dest % alignment ) == 0 )
+	{
+		const u64 direct_size = size - ( size % alignment );
+		if( direct_size > 0 )
+		{
+			u64 bytes_read = 0;
+			ctStatusCall( this->raw_read( dest, direct_size, offset, bytes_read ) );
+			if( bytes_read != direct_size )
+				return status::cant_read;
+			dest += direct_size;
+			size -= direct_size;
+			offset += direct_size;
+		}
+	}
+
+	// read the unaligned rest through the bounce buffer, reading whole aligned blocks
+	if( size > 0 )
+	{
+		std::vector<u8, aligned_allocator<u8, direct_io_alignment>> bounce( (size_t)_file_object_bounce_size );
+		while( size > 0 )
+		{
+			const u64 block_start = offset - ( offset % alignment );
+			const u64 skip = offset - block_start;
+			const u64 chunk = std::min( size, _file_object_bounce_size - skip );
+			const u64 read_size = ( ( skip + chunk + alignment - 1 ) / alignment ) * alignment;
+
+			u64 bytes_read = 0;
+			ctStatusCall( this->raw_read( bounce.data(), read_size, block_start, bytes_read ) );
+			if( bytes_read < skip + chunk )
+				return status::cant_read;
+
+			memcpy( dest, bounce.data() + skip, (size_t)chunk );
+			dest += chunk;
+			size -= chunk;
+			offset += chunk;
+		}
+	}
+
+	return status::ok;
+}
+
+status _file_object::write_direct_aligned( const u8 *src, const u64 size, const u64 offset )
+{
+	// write directly from the source if it is aligned, else through the bounce buffer
+	if( ( (uintptr_t)src % direct_io_alignment ) == 0 )
+	{
+		ctStatusCall( this->raw_write( src, size, offset ) );
+	}
+	else
+	{
+		std::vector<u8, aligned_allocator<u8, direct_io_alignment>> bounce( (size_t)_file_object_bounce_size );
+		u64 written = 0;
+		while( written < size )
+		{
+			const u64 chunk = std::min( size - written, _file_object_bounce_size );
+			memcpy( bounce.data(), src + written, (size_t)chunk );
+			ctStatusCall( this->raw_write( bounce.data(), chunk, offset + written ) );
+			written += chunk;
+		}
+	}
+	return status::ok;
+}
+
+status _file_object::write_direct( const u8 *src, u64 size )
+{
+	const u64 alignment = direct_io_alignment;
+	ctValidate( !this->direct_tail_written, status::invalid ) << "Only the last direct write of a file can have a size which is not a multiple of direct_io_alignment" << ctValidateEnd;
+
+	// write the aligned part
+	const u64 aligned_size = size - ( size % alignment );
+	if( aligned_size > 0 )
+	{
+		ctStatusCall( this->write_direct_aligned( src, aligned_size, this->file_position ) );
+		this->file_position += aligned_size;
+		src += aligned_size;
+		size -= aligned_size;
+	}
+
+	// the unaligned tail is handled by the platform
+	if( size > 0 )
+	{
+		ctStatusCall( this->write_direct_tail( src, size ) );
+	}
+
+	return status::ok;
+}
+
+status _file_object::seek( const u64 position )
+{
+	ctValidate( this->is_open(), status::not_ready ) << "The file stream is not open" << ctValidateEnd;
+	ctValidate( this->write_access || position <= this->file_size, status::invalid_param ) << "Can't seek beyond the end of the file" << ctValidateEnd;
+
+	// pages behind the old position are dropped before moving, since the drop range starts at the position
+	if( this->io_mode == file_io_mode::streaming )
+		this->drop_cached_pages( true );
+	this->file_position = position;
+	this->cache_drop_position = position;
+	return status::ok;
+}
+
+status _file_object::read_at( const u64 offset, u8 *dest, const u64 size )
+{
+	ctValidate( this->is_open(), status::not_ready ) << "The file stream is not open" << ctValidateEnd;
+	ctValidate( offset <= this->file_size && size <= this->file_size - offset, status::cant_read ) << "The read is beyond the end of the file" << ctValidateEnd;
+
+	if( this->io_mode == file_io_mode::direct )
+		return this->read_direct( dest, size, offset );
+
+	u64 bytes_read = 0;
+	ctStatusCall( this->raw_read( dest, size, offset, bytes_read ) );
+	if( bytes_read != size )
+		return status::cant_read;
+	return status::ok;
+}
+
+status _file_object::write_at( const u64 offset, const u8 *src, const u64 size )
+{
+	ctValidate( this->is_open(), status::not_ready ) << "The file stream is not open" << ctValidateEnd;
+	ctValidate( this->io_mode != file_io_mode::direct || ( ( offset | size ) % direct_io_alignment ) == 0, status::invalid_param ) << "In direct i/o mode, the offset and size of write_at must be multiples of direct_io_alignment" << ctValidateEnd;
+
+	const status result = ( this->io_mode == file_io_mode::direct ) ? ( this->write_direct_aligned( src, size, offset ) ) : ( this->raw_write( src, size, offset ) );
+
+	// a failed write marks the file, so that an atomic replace is not committed
+	if( !result )
+		this->write_failed = true;
+	return result;
+}
+
+mapped_file::mapped_file( mapped_file &&other ) noexcept
+{
+	*this = std::move( other );
+}
+
+mapped_file &mapped_file::operator=( mapped_file &&other ) noexcept
+{
+	if( this != &other )
+	{
+		this->close();
+		std::swap( this->file_handle, other.file_handle );
+		std::swap( this->mapping_handle, other.mapping_handle );
+		std::swap( this->file_data, other.file_data );
+		std::swap( this->file_size, other.file_size );
+	}
+	return *this;
+}
+
+mapped_file::~mapped_file()
+{
+	this->close();
+}
+
 }
 //namespace ctle
 
@@ -240,10 +867,18 @@ _file_object::_file_object()
 
 _file_object::~_file_object()
 {
-	this->close();
+	// a file which was not explicitly closed is abandoned, so an atomic replace must not install it
+	this->discard();
+}
+
+static DWORD _file_object_flags( file_io_mode mode, DWORD attributes )
+{
+	if( mode == file_io_mode::direct )
+		return attributes | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH;
+	return attributes | FILE_FLAG_SEQUENTIAL_SCAN;
 }
 
-status _file_object::open_read(const std::string& filepath)
+status _file_object::open_read(const std::string& filepath, file_io_mode mode)
 {
 	if (this->is_open())
 		this->close();
@@ -251,12 +886,15 @@ status _file_object::open_read(const std::string& filepath)
 	// convert the utf8 string to wstring fullpath for the API call
 	const auto wpath = utf8string_to_wstringfullpath(filepath);
 
-	this->file_handle = ::CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, nullptr);
+	this->file_handle = ::CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, _file_object_flags( mode, FILE_ATTRIBUTE_READONLY ), nullptr);
 	if (this->file_handle == INVALID_HANDLE_VALUE)
 	{
 		// failed to open the file
 		return status::cant_open;
 	}
+	this->io_mode = mode;
+	this->write_access = false;
+	this->file_position = 0;
 
 	// get the size
 	LARGE_INTEGER dfilesize = {};
@@ -270,14 +908,11 @@ status _file_object::open_read(const std::string& filepath)
 	return status::ok;
 }
 
-status _file_object::open_write(const std::string& filepath, bool overwrite_existing)
+status _file_object::open_write_handle(const std::string& filepath, bool overwrite_existing, file_io_mode mode)
 {
-	if (this->is_open())
-		this->close();
-
 	// convert the utf8 string to wstring fullpath for the API call
 	const auto wpath = utf8string_to_wstringfullpath(filepath);
-	this->file_handle = (void*)::CreateFileW( wpath.c_str(), GENERIC_WRITE,	FILE_SHARE_WRITE, nullptr, ( overwrite_existing ) ? ( CREATE_ALWAYS ) : ( CREATE_NEW ),	FILE_ATTRIBUTE_NORMAL, nullptr );
+	this->file_handle = (void*)::CreateFileW( wpath.c_str(), GENERIC_WRITE,	FILE_SHARE_WRITE, nullptr, ( overwrite_existing ) ? ( CREATE_ALWAYS ) : ( CREATE_NEW ), _file_object_flags( mode, FILE_ATTRIBUTE_NORMAL ), nullptr );
 	if( this->file_handle == INVALID_HANDLE_VALUE )
 	{
 		// file open failed. return reason in error code
@@ -291,19 +926,33 @@ status _file_object::open_write(const std::string& filepath, bool overwrite_exis
 			return status::cant_write;
 		}
 	}
+	this->io_mode = mode;
+	this->write_access = true;
+	this->file_position = 0;
+	this->direct_tail_written = false;
 
 	return status::ok;
 }
 
-status _file_object::close()
+void _file_object::close_handle()
 {
 	if (this->is_open())
 	{
+		// a padded direct write tail is cut off, to set the correct file size
+		if( this->direct_tail_written )
+		{
+			LARGE_INTEGER end_of_file = {};
+			end_of_file.QuadPart = (LONGLONG)this->direct_end_of_file;
+			::SetFilePointerEx( this->file_handle, end_of_file, nullptr, FILE_BEGIN );
+			::SetEndOfFile( this->file_handle );
+			this->direct_tail_written = false;
+		}
+
 		::CloseHandle(file_handle);
 		this->file_handle = INVALID_HANDLE_VALUE;
 		this->file_size = 0;
+		this->file_position = 0;
 	}
-	return status::ok;
 }
 
 bool _file_object::is_open() const
@@ -311,52 +960,64 @@ bool _file_object::is_open() const
 	return this->file_handle != INVALID_HANDLE_VALUE;
 }
 
-status _file_object::read(u8* dest, const u64 size)
+status _file_object::raw_read(u8* dest, const u64 size, const u64 offset, u64 &bytes_read)
 {
-	ctValidate(this->is_open(), status::not_ready) << "The file stream is not open" << ctValidateEnd;
-
-	u64 bytes_read = 0;
+	bytes_read = 0;
 	while( bytes_read < size )
 	{
-		// check how much to read and cap each read at UINT_MAX
+		// check how much to read and cap each read at 2GB (which is aligned for direct i/o)
 		const u64 bytes_left = size - bytes_read;
-		const DWORD bytes_to_read_this_time = (bytes_left < UINT_MAX) ? ((DWORD)bytes_left) : (UINT_MAX);
+		const DWORD bytes_to_read_this_time = (bytes_left < 0x80000000ull) ? ((DWORD)bytes_left) : (0x80000000ul);
 
-		// read in bytes into the memory allocation
+		// read in bytes at the offset into the memory allocation
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = (DWORD)( ( offset + bytes_read ) & 0xffffffff );
+		overlapped.OffsetHigh = (DWORD)( ( offset + bytes_read ) >> 32 );
 		DWORD bytes_that_were_read = 0;
-		if( !::ReadFile( this->file_handle, &dest[bytes_read], bytes_to_read_this_time, &bytes_that_were_read, nullptr ) )
+		if( !::ReadFile( this->file_handle, &dest[bytes_read], bytes_to_read_this_time, &bytes_that_were_read, &overlapped ) )
 		{
+			// reading at end of file is not an error
+			if( GetLastError() == ERROR_HANDLE_EOF )
+				break;
+
 			// failed to read from the file
 			return status::cant_read;
 		}
 
-		// update number of bytes that were read
+		// update number of bytes that were read, stop at end of file
 		bytes_read += bytes_that_were_read;
+		if( bytes_that_were_read < bytes_to_read_this_time )
+			break;
 	}
 
 	return status::ok;
 }
 
-status _file_object::write(const u8* src, const u64 size)
+status _file_object::raw_write(const u8* src, const u64 size, const u64 offset)
 {
-	ctValidate(this->is_open(), status::not_ready) << "The file stream is not open" << ctValidateEnd;
-
 	// write the file
 	u64 bytes_written = 0;
 	while( bytes_written < size )
 	{
-		// check how much to write, capped at UINT_MAX
+		// check how much to write, capped at 2GB (which is aligned for direct i/o)
 		const u64 bytes_left = size - bytes_written;
-		const DWORD bytes_to_write_this_time = (bytes_left < UINT_MAX) ? ((DWORD)bytes_left) : (UINT_MAX);
+		const DWORD bytes_to_write_this_time = (bytes_left < 0x80000000ull) ? ((DWORD)bytes_left) : (0x80000000ul);
 		
-		// write the bytes to file
+		// write the bytes to file at the offset
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = (DWORD)( ( offset + bytes_written ) & 0xffffffff );
+		overlapped.OffsetHigh = (DWORD)( ( offset + bytes_written ) >> 32 );
 		DWORD bytes_that_were_written = 0;
-		if( !::WriteFile( this->file_handle, &src[bytes_written], (DWORD)bytes_to_write_this_time, &bytes_that_were_written, nullptr ) )
+		if( !::WriteFile( this->file_handle, &src[bytes_written], bytes_to_write_this_time, &bytes_that_were_written, &overlapped ) )
 		{
 			// failed to write to file
 			return status::cant_write;
 		}
 
+		// a write which makes no progress would loop forever
+		if( bytes_that_were_written == 0 )
+			return status::cant_write;
+
 		// update number of bytes that were written
 		bytes_written += bytes_that_were_written;
 	}
@@ -364,12 +1025,176 @@ status _file_object::write(const u8* src, const u64 size)
 	return status::ok;
 }
 
+status _file_object::write_direct_tail(const u8* src, const u64 size)
+{
+	// unbuffered files can only be written in whole blocks, so pad the tail to a full block, and cut the file at close
+	std::vector<u8, aligned_allocator<u8, direct_io_alignment>> bounce( direct_io_alignment, 0 );
+	memcpy( bounce.data(), src, (size_t)size );
+	ctStatusCall( this->raw_write( bounce.data(), direct_io_alignment, this->file_position ) );
+	this->file_position += size;
+	this->direct_end_of_file = this->file_position;
+	this->direct_tail_written = true;
+	return status::ok;
+}
+
+void _file_object::drop_cached_pages(bool /*final_drop*/)
+{
+	// the windows cache manager unmaps pages of files opened with FILE_FLAG_SEQUENTIAL_SCAN after they are read
+}
+
+status _file_object::sync_data()
+{
+	if( !::FlushFileBuffers( this->file_handle ) )
+		return status::cant_write;
+	return status::ok;
+}
+
+void _file_object::preallocate(u64 size)
+{
+	// reserve the disk space, without changing the end of file
+	FILE_ALLOCATION_INFO allocation_info = {};
+	allocation_info.AllocationSize.QuadPart = (LONGLONG)size;
+	::SetFileInformationByHandle( this->file_handle, FileAllocationInfo, &allocation_info, sizeof( allocation_info ) );
+}
+
+static status _file_replace_durable( const std::string &from_path, const std::string &to_path )
+{
+	// MOVEFILE_WRITE_THROUGH does not return until the move has been flushed to disk
+	const auto wfrom = utf8string_to_wstringfullpath( from_path );
+	const auto wto = utf8string_to_wstringfullpath( to_path );
+	if( !::MoveFileExW( wfrom.c_str(), wto.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) )
+		return status::cant_write;
+	return status::ok;
+}
+
+status create_directory( const std::string &path )
+{
+	const auto wpath = utf8string_to_wstringfullpath( path );
+	if( !::CreateDirectoryW( wpath.c_str(), nullptr ) )
+	{
+		if( GetLastError() != ERROR_ALREADY_EXISTS )
+			return status::cant_write;
+	}
+	return status::ok;
+}
+
+status rename_file( const std::string &from_path, const std::string &to_path )
+{
+	const auto wfrom = utf8string_to_wstringfullpath( from_path );
+	const auto wto = utf8string_to_wstringfullpath( to_path );
+	if( !::MoveFileExW( wfrom.c_str(), wto.c_str(), MOVEFILE_REPLACE_EXISTING ) )
+		return status::cant_write;
+	return status::ok;
+}
+
+status remove_file( const std::string &path )
+{
+	const auto wpath = utf8string_to_wstringfullpath( path );
+	if( !::DeleteFileW( wpath.c_str() ) )
+	{
+		if( GetLastError() == ERROR_FILE_NOT_FOUND )
+			return status::not_found;
+		return status::cant_write;
+	}
+	return status::ok;
+}
+
+status get_file_info( const std::string &path, file_info &dest )
+{
+	const auto wpath = utf8string_to_wstringfullpath( path );
+	HANDLE hfile = ::CreateFileW( wpath.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr );
+	if( hfile == INVALID_HANDLE_VALUE )
+	{
+		const DWORD errorCode = GetLastError();
+		return ( errorCode == ERROR_FILE_NOT_FOUND || errorCode == ERROR_PATH_NOT_FOUND ) ? status::not_found : status::cant_access;
+	}
+
+	BY_HANDLE_FILE_INFORMATION info = {};
+	const BOOL res = ::GetFileInformationByHandle( hfile, &info );
+	::CloseHandle( hfile );
+	if( !res )
+		return status::cant_access;
+
+	dest.size = ( u64( info.nFileSizeHigh ) << 32 ) | u64( info.nFileSizeLow );
+	dest.mtime_ns = ( ( u64( info.ftLastWriteTime.dwHighDateTime ) << 32 ) | u64( info.ftLastWriteTime.dwLowDateTime ) ) * 100;
+	dest.inode = ( u64( info.nFileIndexHigh ) << 32 ) | u64( info.nFileIndexLow );
+	return status::ok;
+}
+
+u64 get_file_time_now()
+{
+	FILETIME now = {};
+	::GetSystemTimePreciseAsFileTime( &now );
+	return ( ( u64( now.dwHighDateTime ) << 32 ) | u64( now.dwLowDateTime ) ) * 100;
+}
+
+status mapped_file::open( const std::string &filepath )
+{
+	this->close();
+
+	const auto wpath = utf8string_to_wstringfullpath( filepath );
+	HANDLE hfile = ::CreateFileW( wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, nullptr );
+	if( hfile == INVALID_HANDLE_VALUE )
+		return status::cant_open;
+	this->file_handle = (void*)hfile;
+
+	LARGE_INTEGER dfilesize = {};
+	if( !::GetFileSizeEx( hfile, &dfilesize ) )
+	{
+		this->close();
+		return status::cant_read;
+	}
+	this->file_size = dfilesize.QuadPart;
+
+	// empty files can't be mapped, leave the data as nullptr
+	if( this->file_size == 0 )
+		return status::ok;
+
+	HANDLE hmapping = ::CreateFileMappingW( hfile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if( !hmapping )
+	{
+		this->close();
+		return status::cant_read;
+	}
+	this->mapping_handle = (void*)hmapping;
+
+	this->file_data = (const u8*)::MapViewOfFile( hmapping, FILE_MAP_READ, 0, 0, 0 );
+	if( !this->file_data )
+	{
+		this->close();
+		return status::cant_read;
+	}
+
+	return status::ok;
+}
+
+status mapped_file::close()
+{
+	if( this->file_data )
+		::UnmapViewOfFile( this->file_data );
+	if( this->mapping_handle )
+		::CloseHandle( (HANDLE)this->mapping_handle );
+	if( this->file_handle )
+		::CloseHandle( (HANDLE)this->file_handle );
+	this->file_data = nullptr;
+	this->mapping_handle = nullptr;
+	this->file_handle = nullptr;
+	this->file_size = 0;
+	return status::ok;
+}
+
 }
 //namespace ctle
 
 #elif defined(__GNUC__)
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <cstdio>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <time.h>
 
 namespace ctle
 {
@@ -394,85 +1219,320 @@ _file_object::_file_object()
 
 _file_object::~_file_object()
 {
-	this->close();
+	// a file which was not explicitly closed is abandoned, so an atomic replace must not install it
+	this->discard();
+}
+
+// the file descriptor is stored offset by one in the handle, so that fd 0 is not mistaken for a closed file
+static inline int _file_object_fd( void *file_handle )
+{
+	return (int)( (intptr_t)file_handle - 1 );
+}
+
+// open the file, and set the access hints. if direct i/o is not supported, mode is changed to streaming
+static int _file_object_open( const std::string &filepath, int flags, file_io_mode &mode )
+{
+	// the file is always opened without direct i/o, and direct i/o is enabled on the open file. (O_DIRECT in the open 
+	// call can create the file before it is rejected, and an O_EXCL retry would then fail on the stray file)
+	const int fd = ::open( filepath.c_str(), flags | O_CLOEXEC, 0666 );
+	if( fd < 0 )
+		return fd;
+
+	if( mode == file_io_mode::direct )
+	{
+#if defined(O_DIRECT)
+		const int fl = ::fcntl( fd, F_GETFL );
+		if( fl != -1 && ::fcntl( fd, F_SETFL, fl | O_DIRECT ) == 0 )
+			return fd;
+#elif defined(F_NOCACHE)
+		if( ::fcntl( fd, F_NOCACHE, 1 ) != -1 )
+			return fd;
+#endif
+		mode = file_io_mode::streaming;
+	}
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+	::posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+	return fd;
 }
 
-status _file_object::open_read(const std::string& filepath)
+status _file_object::open_read(const std::string& filepath, file_io_mode mode)
 {
 	if (this->is_open())
 		this->close();
 
-	// open the file at the end, so we can tell() the size of the file
-	this->file_handle = new std::ifstream(filepath.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
-	if( !this->file_handle || !((std::ifstream*)this->file_handle)->is_open() )
+	const int fd = _file_object_open( filepath, O_RDONLY, mode );
+	if( fd < 0 )
+		return status::cant_open;
+	this->file_handle = (void*)(intptr_t)( fd + 1 );
+	this->io_mode = mode;
+	this->write_access = false;
+	this->file_position = 0;
+	this->cache_drop_position = 0;
+
+	// get the size of the file
+	struct stat st = {};
+	if( ::fstat( fd, &st ) != 0 )
 	{
 		this->close();
-		return status::cant_open;
+		return status::corrupted;
 	}
+	this->file_size = (u64)st.st_size;
 
-	// get the size of the file, and move back to the beginning
-	this->file_size = ((std::ifstream*)this->file_handle)->tellg();
-	((std::ifstream*)this->file_handle)->seekg( 0, std::ios::beg );
+	return status::ok;
+}
+
+status _file_object::open_write_handle(const std::string& filepath, bool overwrite_existing, file_io_mode mode)
+{
+	// if we can't overwrite an existing file, the open fails if the file exists
+	const int fd = _file_object_open( filepath, O_WRONLY | O_CREAT | ( overwrite_existing ? O_TRUNC : O_EXCL ), mode );
+	if( fd < 0 )
+		return ( errno == EEXIST ) ? status::already_exists : status::cant_write;
+	this->file_handle = (void*)(intptr_t)( fd + 1 );
+	this->io_mode = mode;
+	this->write_access = true;
+	this->file_position = 0;
+	this->cache_drop_position = 0;
+	this->direct_tail_written = false;
 
 	return status::ok;
 }
 
-status _file_object::open_write(const std::string& filepath, bool overwrite_existing)
+void _file_object::close_handle()
 {
-	if (this->is_open())
-		this->close();
+	if (this->file_handle)
+	{
+		if( this->io_mode == file_io_mode::streaming )
+			this->drop_cached_pages( true );
 
-	// if we can't overwrite an existing file, fail if the file exists
-	if( !overwrite_existing && file_exists( filepath ) )
-		return status::already_exists;
+		::close( _file_object_fd( this->file_handle ) );
+		this->file_handle = nullptr;
+		this->file_size = 0;
+		this->file_position = 0;
+	}
+}
 
-	// create the file
-	this->file_handle = new std::ofstream( filepath.c_str(), std::ios::out | std::ios::binary );
-	if( !this->file_handle || !((std::ofstream*)this->file_handle)->is_open() )
+bool _file_object::is_open() const
+{
+	return this->file_handle != nullptr;
+}
+
+status _file_object::raw_read(u8* dest, const u64 size, const u64 offset, u64 &bytes_read)
+{
+	const int fd = _file_object_fd( this->file_handle );
+
+	bytes_read = 0;
+	while( bytes_read < size )
 	{
-		this->close();
-		return status::cant_write;
+		// cap each read at 1GB (which is aligned for direct i/o)
+		const size_t bytes_to_read_this_time = (size_t)std::min<u64>( size - bytes_read, 0x40000000ull );
+		const ssize_t res = ::pread( fd, &dest[bytes_read], bytes_to_read_this_time, (off_t)( offset + bytes_read ) );
+		if( res < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+			return status::cant_read;
+		}
+
+		// stop at end of file
+		bytes_read += (u64)res;
+		if( (size_t)res < bytes_to_read_this_time )
+			break;
 	}
 
 	return status::ok;
 }
 
-status _file_object::close()
+status _file_object::raw_write(const u8* src, const u64 size, const u64 offset)
 {
-	if (this->file_handle)
+	const int fd = _file_object_fd( this->file_handle );
+
+	u64 bytes_written = 0;
+	while( bytes_written < size )
 	{
-		delete ((std::ofstream*)this->file_handle);
-		this->file_handle = nullptr;
+		// cap each write at 1GB (which is aligned for direct i/o)
+		const size_t bytes_to_write_this_time = (size_t)std::min<u64>( size - bytes_written, 0x40000000ull );
+		const ssize_t res = ::pwrite( fd, &src[bytes_written], bytes_to_write_this_time, (off_t)( offset + bytes_written ) );
+		if( res < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+			return status::cant_write;
+		}
+		// a write which makes no progress would loop forever
+		if( res == 0 )
+			return status::cant_write;
+		bytes_written += (u64)res;
 	}
+
 	return status::ok;
 }
 
-bool _file_object::is_open() const
+status _file_object::write_direct_tail(const u8* src, const u64 size)
+{
+	// the tail can't be written with direct i/o, so switch the file to streaming mode for the rest of the file
+#if defined(O_DIRECT)
+	const int fd = _file_object_fd( this->file_handle );
+	const int flags = ::fcntl( fd, F_GETFL );
+	if( flags < 0 || ::fcntl( fd, F_SETFL, flags & ~O_DIRECT ) != 0 )
+		return status::cant_write;
+#endif
+	this->io_mode = file_io_mode::streaming;
+	this->cache_drop_position = this->file_position;
+
+	ctStatusCall( this->raw_write( src, size, this->file_position ) );
+	this->file_position += size;
+	return status::ok;
+}
+
+void _file_object::drop_cached_pages(bool final_drop)
+{
+	const u64 drop_size = this->file_position - this->cache_drop_position;
+	if( drop_size == 0 || ( !final_drop && drop_size < _file_object_cache_drop_interval ) )
+		return;
+
+#if defined(POSIX_FADV_DONTNEED)
+	// written pages must be on disk before they can be dropped
+	const int fd = _file_object_fd( this->file_handle );
+	if( this->write_access )
+		::fdatasync( fd );
+	::posix_fadvise( fd, (off_t)this->cache_drop_position, (off_t)drop_size, POSIX_FADV_DONTNEED );
+#endif
+	this->cache_drop_position = this->file_position;
+}
+
+status _file_object::sync_data()
+{
+#if defined(__APPLE__)
+	// fsync does not flush the drive cache on macOS
+	if( ::fcntl( _file_object_fd( this->file_handle ), F_FULLFSYNC ) != 0 )
+		return status::cant_write;
+#else
+	if( ::fdatasync( _file_object_fd( this->file_handle ) ) != 0 )
+		return status::cant_write;
+#endif
+	return status::ok;
+}
+
+void _file_object::preallocate(u64 size)
 {
-	return this->file_handle && ((std::ofstream*)this->file_handle)->is_open();
+#if defined(__linux__)
+	// reserve the disk space, without changing the file size. not all file systems support this, so errors are ignored
+	::fallocate( _file_object_fd( this->file_handle ), FALLOC_FL_KEEP_SIZE, 0, (off_t)size );
+#else
+	(void)size;
+#endif
 }
 
-status _file_object::read(u8* dest, const u64 size)
+static status _file_replace_durable( const std::string &from_path, const std::string &to_path )
 {
-	ctValidate(this->file_handle, status::not_ready) << "The file stream is not open" << ctValidateEnd;
+	if( ::rename( from_path.c_str(), to_path.c_str() ) != 0 )
+		return status::cant_write;
 
-	// read the data to the dest
-	((std::ifstream*)this->file_handle)->read((char*)dest, size);
-	if( ((std::ifstream*)this->file_handle)->fail() )
-		return status::cant_read;
+	// sync the directory, so the rename itself is on disk
+	const size_t separator = to_path.find_last_of( '/' );
+	const std::string directory = ( separator == std::string::npos ) ? std::string( "." ) : ( separator == 0 ) ? std::string( "/" ) : to_path.substr( 0, separator );
+	const int dir_fd = ::open( directory.c_str(), O_RDONLY | O_CLOEXEC );
+	if( dir_fd < 0 )
+		return status::cant_write;
+	const int res = ::fsync( dir_fd );
+	::close( dir_fd );
+	if( res != 0 )
+		return status::cant_write;
+	return status::ok;
+}
 
+status create_directory( const std::string &path )
+{
+	if( ::mkdir( path.c_str(), 0777 ) != 0 )
+	{
+		struct stat st = {};
+		if( errno != EEXIST || ::stat( path.c_str(), &st ) != 0 || !S_ISDIR( st.st_mode ) )
+			return status::cant_write;
+	}
 	return status::ok;
 }
 
-status _file_object::write(const u8* src, const u64 size)
+status rename_file( const std::string &from_path, const std::string &to_path )
 {
-	ctValidate(this->file_handle, status::not_ready) << "The file stream is not open" << ctValidateEnd;
+	if( ::rename( from_path.c_str(), to_path.c_str() ) != 0 )
+		return status::cant_write;
+	return status::ok;
+}
 
-	// read the data to the dest
-	((std::ofstream*)this->file_handle)->write((const char*)src, size);
-	if( ((std::ofstream*)this->file_handle)->fail() )
+status remove_file( const std::string &path )
+{
+	if( ::unlink( path.c_str() ) != 0 )
+		return ( errno == ENOENT ) ? status::not_found : status::cant_write;
+	return status::ok;
+}
+
+status get_file_info( const std::string &path, file_info &dest )
+{
+	struct stat st = {};
+	if( ::stat( path.c_str(), &st ) != 0 )
+		return ( errno == ENOENT || errno == ENOTDIR ) ? status::not_found : status::cant_access;
+
+	dest.size = (u64)st.st_size;
+#if defined(__APPLE__)
+	dest.mtime_ns = (u64)st.st_mtimespec.tv_sec * 1000000000ull + (u64)st.st_mtimespec.tv_nsec;
+#else
+	dest.mtime_ns = (u64)st.st_mtim.tv_sec * 1000000000ull + (u64)st.st_mtim.tv_nsec;
+#endif
+	dest.inode = (u64)st.st_ino;
+	return status::ok;
+}
+
+u64 get_file_time_now()
+{
+	struct timespec now = {};
+	::clock_gettime( CLOCK_REALTIME, &now );
+	return (u64)now.tv_sec * 1000000000ull + (u64)now.tv_nsec;
+}
+
+status mapped_file::open( const std::string &filepath )
+{
+	this->close();
+
+	// the file descriptor is stored offset by one in the handle, so that fd 0 is not mistaken for a closed file
+	const int fd = ::open( filepath.c_str(), O_RDONLY );
+	if( fd < 0 )
+		return status::cant_open;
+	this->file_handle = (void*)(intptr_t)( fd + 1 );
+
+	struct stat st = {};
+	if( ::fstat( fd, &st ) != 0 )
+	{
+		this->close();
 		return status::cant_read;
+	}
+	this->file_size = (u64)st.st_size;
+
+	// empty files can't be mapped, leave the data as nullptr
+	if( this->file_size == 0 )
+		return status::ok;
 
+	void *data = ::mmap( nullptr, (size_t)this->file_size, PROT_READ, MAP_SHARED, fd, 0 );
+	if( data == MAP_FAILED )
+	{
+		this->close();
+		return status::cant_read;
+	}
+	this->file_data = (const u8*)data;
+
+	return status::ok;
+}
+
+status mapped_file::close()
+{
+	if( this->file_data )
+		::munmap( (void*)this->file_data, (size_t)this->file_size );
+	if( this->file_handle )
+		::close( (int)( (intptr_t)this->file_handle - 1 ) );
+	this->file_data = nullptr;
+	this->file_handle = nullptr;
+	this->file_size = 0;
 	return status::ok;
 }
 
@@ -0,0 +1,361 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_FILE_HASH_CACHE_H_
+#define _CTLE_FILE_HASH_CACHE_H_
+
+/// @file file_hash_cache.h
+/// @brief A persistent cache of file content hashes, keyed by the file path, size, modification time and inode.
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+
+#include "fwd.h"
+#include "status.h"
+#include "status_return.h"
+#include "file_funcs.h"
+#include "hasher.h"
+#include "digest.h"
+#include "flat_id_map.h"
+#include "readers_writer_lock.h"
+#include "util.h"
+
+namespace ctle
+{
+
+/// @brief Hash the contents of a file, streaming the file through a hasher.
+/// @tparam _HashTy the hasher to use, e.g. hasher_sha256
+/// @return status::ok and the digest, or an error status if the file could not be read.
+template<class _HashTy> status_return<status, typename _HashTy::hash_type> hash_file( const std::string &path );
+
+/// @brief A cache of file content hashes, which is used to skip rehashing files which have not changed.
+/// @details A cached hash is used if the path, size, modification time and inode of the file all match the cached entry.
+/// hash_file_cached() only caches the hash of a file which was modified before the hash was taken by more than the timestamp 
+/// granularity (the "racy entry" rule of git), since a write in the same timestamp tick may not change the size or modification time.
+/// Lookups take a read lock on a readers_writer_lock, so concurrent lookups do not block each other. Updates are
+/// collected in a pending batch, and merged into the table under the write lock when the batch is full, or when
+/// flush() or save() is called. Only lookups which miss the table check the pending batch. The cache can be saved to a file, and loaded in a later run. Loading reads the mapped file once, and copies the records into the in-memory table, so the cost of load() is linear in the number of records.
+/// @tparam _HashTy the hasher used to hash the files, e.g. hasher_sha256
+template<class _HashTy /* = hasher_sha256 */>
+class file_hash_cache
+{
+public:
+	using hasher_type = _HashTy;
+	using hash_type = typename _HashTy::hash_type;
+
+	/// @brief The number of pending updates which are merged into the table at once.
+	static constexpr const size_t update_batch_size = 256;
+
+	/// @brief The default timestamp granularity, which covers the coarsest common file systems (FAT has 2 second timestamps).
+	static constexpr const u64 default_timestamp_granularity_ns = 2000000000ull;
+
+	file_hash_cache() = default;
+	~file_hash_cache() = default;
+
+	/// @brief Look up the cached hash of a file.
+	/// @param path the file path
+	/// @param info the current size, modification time and inode of the file
+	/// @param dest receives the cached hash
+	/// @return true if the file has a cached hash which matches the info
+	bool lookup( const std::string &path, const file_info &info, hash_type &dest ) const;
+
+	/// @brief Add or update the cached hash of a file. The update is batched, and merged into the table with the next batch.
+	void update( const std::string &path, const file_info &info, const hash_type &hash );
+
+	/// @brief Merge all pending updates into the table.
+	void flush();
+
+	/// @brief Get the hash of a file, using the cached hash if the file has not changed, else rehash the file and update the cache.
+	/// @details The hash is not cached if the file was modified while it was hashed, or if the modification time of the file is
+	/// not older than the time the hash was taken, minus the timestamp granularity. Such a file is hashed again on the next call.
+	/// @return status::ok and the hash, or an error status if the file could not be read.
+	status_return<status, hash_type> hash_file_cached( const std::string &path );
+
+	/// @brief Set the timestamp granularity of the file system, in nanoseconds. @see hash_file_cached()
+	void set_timestamp_granularity( u64 granularity_ns ) { this->timestamp_granularity_ns_m = granularity_ns; }
+
+	/// @brief Get the timestamp granularity of the file system, in nanoseconds.
+	u64 get_timestamp_granularity() const { return this->timestamp_granularity_ns_m; }
+
+	/// @brief Load the cache from a file, replacing the current entries. The records are copied into the in-memory table, the file is not kept mapped.
+	/// @return status::ok, status::cant_open if the file can't be opened, or status::corrupted if the file is not a valid cache file.
+	status load( const std::string &filepath );
+
+	/// @brief Flush and save the cache to a file. The file is written to a temporary file, and renamed into place.
+	status save( const std::string &filepath );
+
+	/// @brief Get the number of entries in the table (not including pending updates).
+	size_t size() const;
+
+	/// @brief Remove all entries.
+	void clear();
+
+private:
+	struct entry
+	{
+		u64 size;
+		u64 mtime_ns;
+		u64 inode;
+		hash_type hash;
+	};
+
+	// the record of an entry in a saved cache file
+	struct file_record
+	{
+		u64 path_hash;
+		entry data;
+	};
+
+	// the path hashes are already mixed, so they are used directly as hash values
+	struct path_hash_identity
+	{
+		size_t operator()( u64 path_hash ) const noexcept { return (size_t)path_hash; }
+	};
+
+	mutable readers_writer_lock table_lock_m;
+	flat_id_map<u64, entry, path_hash_identity> table_m;
+
+	mutable std::mutex pending_mutex_m;
+	std::vector<file_record> pending_m;
+
+	u64 timestamp_granularity_ns_m = default_timestamp_granularity_ns;
+
+	static u64 path_hash( const std::string &path ) noexcept;
+	void merge( std::vector<file_record> &records );
+};
+
+}
+//namespace ctle
+
+#include "log.h"
+#include "_macros.inl"
+
+namespace ctle
+{
+
+// the magic value of the file hash cache file ("CTLEHCCH")
+constexpr const u64 _file_hash_cache_magic = 0x48434348454c5443ull;
+constexpr const u32 _file_hash_cache_version = 1;
+
+struct _file_hash_cache_header
+{
+	u64 magic;
+	u32 version;
+	u32 record_size;
+	u64 record_count;
+};
+
+template<class _HashTy>
+inline status_return<status, typename _HashTy::hash_type> hash_file( const std::string &path )
+{
+	const size_t chunk_size = 1024 * 1024;
+
+	_file_object file;
+	ctStatusCall( file.open_read( path ) );
+
+	_HashTy hasher;
+	std::vector<u8> chunk( chunk_size );
+	u64 bytes_left = file.size();
+	while( bytes_left > 0 )
+	{
+		const size_t read_size = (size_t)std::min<u64>( bytes_left, chunk_size );
+		ctStatusCall( file.read( chunk.data(), read_size ) );
+		ctStatusCall( hasher.update( chunk.data(), read_size ) );
+		bytes_left -= read_size;
+	}
+
+	typename _HashTy::hash_type hash;
+	ctStatusReturnCall( hash, hasher.finish() );
+	return hash;
+}
+
+template<class _HashTy>
+inline u64 file_hash_cache<_HashTy>::path_hash( const std::string &path ) noexcept
+{
+	// FNV-1a, finalized with a full avalanche mix, so the hash is stable across runs and platforms
+	u64 h = 0xcbf29ce484222325ull;
+	for( const char c : path )
+	{
+		h = ( h ^ u64( u8( c ) ) ) * 0x100000001b3ull;
+	}
+	return hash_mix_64( h ^ u64( path.size() ) );
+}
+
+template<class _HashTy>
+inline bool file_hash_cache<_HashTy>::lookup( const std::string &path, const file_info &info, hash_type &dest ) const
+{
+	const u64 key = path_hash( path );
+
+	{
+		readers_writer_lock::read_guard guard( this->table_lock_m );
+		const entry *ent = this->table_m.find( key );
+		if( ent && ent->size == info.size && ent->mtime_ns == info.mtime_ns && ent->inode == info.inode )
+		{
+			dest = ent->hash;
+			return true;
+		}
+	}
+
+	// not in the table, check the pending updates (newest first)
+	const std::lock_guard<std::mutex> lock( this->pending_mutex_m );
+	for( size_t inx = this->pending_m.size(); inx > 0; --inx )
+	{
+		const file_record &rec = this->pending_m[inx - 1];
+		if( rec.path_hash == key )
+		{
+			if( rec.data.size == info.size && rec.data.mtime_ns == info.mtime_ns && rec.data.inode == info.inode )
+			{
+				dest = rec.data.hash;
+				return true;
+			}
+			return false;
+		}
+	}
+	return false;
+}
+
+template<class _HashTy>
+inline void file_hash_cache<_HashTy>::merge( std::vector<file_record> &records )
+{
+	{
+		readers_writer_lock::write_guard guard( this->table_lock_m );
+		for( const file_record &rec : records )
+		{
+			this->table_m.insert_or_assign( rec.path_hash, rec.data );
+		}
+	}
+	records.clear();
+}
+
+template<class _HashTy>
+inline void file_hash_cache<_HashTy>::update( const std::string &path, const file_info &info, const hash_type &hash )
+{
+	std::vector<file_record> batch;
+	{
+		const std::lock_guard<std::mutex> lock( this->pending_mutex_m );
+		this->pending_m.push_back( { path_hash( path ), { info.size, info.mtime_ns, info.inode, hash } } );
+		if( this->pending_m.size() < update_batch_size )
+			return;
+		batch.swap( this->pending_m );
+	}
+	this->merge( batch );
+}
+
+template<class _HashTy>
+inline void file_hash_cache<_HashTy>::flush()
+{
+	std::vector<file_record> batch;
+	{
+		const std::lock_guard<std::mutex> lock( this->pending_mutex_m );
+		batch.swap( this->pending_m );
+	}
+	if( !batch.empty() )
+		this->merge( batch );
+}
+
+template<class _HashTy>
+inline status_return<status, typename file_hash_cache<_HashTy>::hash_type> file_hash_cache<_HashTy>::hash_file_cached( const std::string &path )
+{
+	file_info info;
+	ctStatusCall( get_file_info( path, info ) );
+
+	hash_type hash;
+	if( this->lookup( path, info, hash ) )
+		return hash;
+
+	const u64 hash_time_ns = get_file_time_now();
+	ctStatusReturnCall( hash, hash_file<_HashTy>( path ) );
+
+	// only cache the hash if the file was not modified while it was hashed, and if the file is strictly older than the hash 
+	// by more than the timestamp granularity. else a later write in the same timestamp tick leaves a stale hash in the cache.
+	file_info info_after;
+	if( get_file_info( path, info_after )
+		&& info_after.size == info.size
+		&& info_after.mtime_ns == info.mtime_ns
+		&& info_after.inode == info.inode
+		&& info.mtime_ns < hash_time_ns
+		&& hash_time_ns - info.mtime_ns > this->timestamp_granularity_ns_m )
+	{
+		this->update( path, info, hash );
+	}
+	return hash;
+}
+
+template<class _HashTy>
+inline size_t file_hash_cache<_HashTy>::size() const
+{
+	readers_writer_lock::read_guard guard( this->table_lock_m );
+	return this->table_m.size();
+}
+
+template<class _HashTy>
+inline void file_hash_cache<_HashTy>::clear()
+{
+	{
+		const std::lock_guard<std::mutex> lock( this->pending_mutex_m );
+		this->pending_m.clear();
+	}
+	readers_writer_lock::write_guard guard( this->table_lock_m );
+	this->table_m.clear();
+}
+
+template<class _HashTy>
+inline status file_hash_cache<_HashTy>::load( const std::string &filepath )
+{
+	mapped_file file;
+	ctStatusCall( file.open( filepath ) );
+
+	_file_hash_cache_header header = {};
+	ctValidate( file.size() >= sizeof( header ), status::corrupted ) << "The file is too small to be a hash cache file: " << filepath << ctValidateEnd;
+	memcpy( &header, file.data(), sizeof( header ) );
+	ctValidate( header.magic == _file_hash_cache_magic && header.version == _file_hash_cache_version && header.record_size == sizeof( file_record ), status::corrupted ) << "The file is not a compatible hash cache file: " << filepath << ctValidateEnd;
+	ctValidate( header.record_count == ( file.size() - sizeof( header ) ) / sizeof( file_record ), status::corrupted ) << "The hash cache file has an invalid size: " << filepath << ctValidateEnd;
+
+	// copy the records into the table, so lookups and updates work the same on loaded and new entries
+	this->clear();
+	readers_writer_lock::write_guard guard( this->table_lock_m );
+	this->table_m.reserve( (size_t)header.record_count );
+	const u8 *src = file.data() + sizeof( header );
+	for( u64 inx = 0; inx < header.record_count; ++inx, src += sizeof( file_record ) )
+	{
+		file_record rec;
+		memcpy( &rec, src, sizeof( rec ) );
+		this->table_m.insert_or_assign( rec.path_hash, rec.data );
+	}
+	return status::ok;
+}
+
+template<class _HashTy>
+inline status file_hash_cache<_HashTy>::save( const std::string &filepath )
+{
+	this->flush();
+
+	std::vector<u8> data;
+	{
+		readers_writer_lock::read_guard guard( this->table_lock_m );
+		const _file_hash_cache_header header = { _file_hash_cache_magic, _file_hash_cache_version, u32( sizeof( file_record ) ), (u64)this->table_m.size() };
+		data.resize( sizeof( header ) + this->table_m.size() * sizeof( file_record ) );
+		memcpy( data.data(), &header, sizeof( header ) );
+		u8 *dest = data.data() + sizeof( header );
+		this->table_m.for_each( [&dest]( const u64 &key, const entry &value )
+			{
+				const file_record rec = { key, value };
+				memcpy( dest, &rec, sizeof( rec ) );
+				dest += sizeof( rec );
+			} );
+	}
+
+	// replace the file atomically, so a concurrent load never sees a partial file
+	ctStatusCall( write_file( filepath, data, file_write_mode::atomic_replace ) );
+	return status::ok;
+}
+
+}
+//namespace ctle
+
+#include "_undef_macros.inl"
+
+#endif//_CTLE_FILE_HASH_CACHE_H_
@@ -0,0 +1,476 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_FLAT_ID_MAP_H_
+#define _CTLE_FLAT_ID_MAP_H_
+
+/// @file flat_id_map.h
+/// @brief Contains the flat_id_map class template, an open-addressing hash map for uuid and digest keys.
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "fwd.h"
+#include "util.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define _CTLE_FLAT_ID_MAP_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ctle
+{
+
+/// @brief Internal helpers for the control bytes of flat_id_map. A group is 16 control bytes, and the
+/// helpers return a bit mask with one bit per control byte in the group.
+struct _flat_id_map_group
+{
+	static constexpr const size_t width = 16;
+
+	/// @brief Returns a mask of the control bytes in the group which are equal to value
+	static u32 match( const u8 *group, u8 value ) noexcept
+	{
+#ifdef _CTLE_FLAT_ID_MAP_SSE2
+		const __m128i ctrl = _mm_loadu_si128( (const __m128i *)group );
+		return (u32)_mm_movemask_epi8( _mm_cmpeq_epi8( ctrl, _mm_set1_epi8( (char)value ) ) );
+#else
+		u32 mask = 0;
+		for( size_t inx = 0; inx < width; ++inx )
+			mask |= u32( group[inx] == value ) << inx;
+		return mask;
+#endif
+	}
+
+	/// @brief Returns a mask of the control bytes in the group which are not full (empty or deleted, which have the high bit set)
+	static u32 match_not_full( const u8 *group ) noexcept
+	{
+#ifdef _CTLE_FLAT_ID_MAP_SSE2
+		return (u32)_mm_movemask_epi8( _mm_loadu_si128( (const __m128i *)group ) );
+#else
+		u32 mask = 0;
+		for( size_t inx = 0; inx < width; ++inx )
+			mask |= u32( group[inx] >> 7 ) << inx;
+		return mask;
+#endif
+	}
+
+	/// @brief Returns the index of the lowest set bit in a non-zero mask
+	static size_t lowest_bit( u32 mask ) noexcept
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward( &index, mask );
+		return (size_t)index;
+#else
+		return (size_t)__builtin_ctz( mask );
+#endif
+	}
+};
+
+/// @brief flat_id_map: an open-addressing hash map, designed for uniformly random keys such as uuid and digest<> values.
+/// @details The map stores all key/value pairs in a flat slot array, with a separate array of control bytes,
+/// one byte per slot, in groups of 16 (SwissTable style). The control bytes are probed a group at a time with SIMD
+/// compares (SSE2, with a scalar fallback), so a lookup typically touches one control group and one slot.
+/// The control byte of a full slot holds the top 7 bits of the hash value, and the group is selected by the low bits.
+/// By default, the key bits are used directly as the hash value (see identity_hash), which is correct for uniformly
+/// random keys, such as version 4 uuids and cryptographic digests. For structured keys, use e.g. std::hash<_Kty> as _Hash.
+/// Erased slots are marked empty when no probe sequence can pass the slot, so tombstones are only left in completely
+/// full groups, and the tombstones are dropped when the map is rehashed.
+/// @tparam _Kty The key type. Must be equality comparable.
+/// @tparam _Ty The mapped value type. Must be default constructible and move assignable.
+/// @tparam _Hash The hash functor, defaults to identity_hash<_Kty>.
+template<class _Kty, class _Ty, class _Hash /* = identity_hash<_Kty> */>
+class flat_id_map
+{
+public:
+	using key_type = _Kty;
+	using mapped_type = _Ty;
+	using value_type = std::pair<_Kty, _Ty>;
+	using hasher = _Hash;
+	using size_type = size_t;
+
+private:
+	using group = _flat_id_map_group;
+
+	static constexpr const u8 ctrl_empty = 0x80;
+	static constexpr const u8 ctrl_deleted = 0xfe;
+	static constexpr const size_t npos = ~size_t( 0 );
+
+	std::vector<u8> ctrl_m;
+	std::vector<value_type> slots_m;
+	size_t size_m = 0;
+	size_t deleted_m = 0;
+	size_t group_mask_m = 0;
+	hasher hasher_m;
+
+	static u8 hash_h2( size_t hval ) noexcept { return u8( u64( hval ) >> 57 ); }
+	size_t growth_limit() const noexcept { return ( this->slots_m.size() / 8 ) * 7; }
+	static size_t capacity_for( size_t count );
+
+	size_t find_index( const _Kty &key ) const;
+	size_t find_insert_index( size_t hval ) const;
+	void set_slot( size_t index, size_t hval, value_type &&value );
+	void rebuild( size_t new_capacity );
+	void grow_for_insert();
+
+public:
+	flat_id_map() = default;
+	flat_id_map( const flat_id_map &_other ) = default;
+	flat_id_map &operator=( const flat_id_map &_other ) = default;
+	flat_id_map( flat_id_map &&_other ) = default;
+	flat_id_map &operator=( flat_id_map &&_other ) = default;
+	~flat_id_map() = default;
+
+	/// @brief Returns the number of key/value pairs in the map.
+	size_type size() const noexcept { return this->size_m; }
+
+	/// @brief Returns true if the map is empty.
+	bool empty() const noexcept { return this->size_m == 0; }
+
+	/// @brief Returns the number of slots in the map. The map is rehashed when it is 7/8 full.
+	size_type capacity() const noexcept { return this->slots_m.size(); }
+
+	/// @brief Removes all key/value pairs, but keeps the allocated capacity.
+	void clear();
+
+	/// @brief Makes sure the map can hold at least count key/value pairs without rehashing.
+	void reserve( size_type count );
+
+	/// @brief Rebuilds the map with enough capacity to hold count key/value pairs (and at least the current size).
+	/// Drops all tombstones left by erased key/value pairs.
+	void rehash( size_type count );
+
+	/// @brief Checks if a key exists in the map.
+	bool contains( const _Kty &key ) const { return this->find_index( key ) != npos; }
+
+	/// @brief Finds the value mapped to a key.
+	/// @return A pointer to the value, or nullptr if the key does not exist. The pointer is invalidated by any insert or rehash.
+	_Ty *find( const _Kty &key );
+	/// @copydoc find(const _Kty&)
+	const _Ty *find( const _Kty &key ) const;
+
+	/// @brief Gets the value mapped to a key, if the key exists.
+	/// @return A pair containing the value and a boolean indicating if the key exists.
+	std::pair<_Ty, bool> get( const _Kty &key ) const;
+
+	/// @brief Returns the value mapped to a key.
+	/// @throws std::out_of_range if the key does not exist.
+	_Ty &at( const _Kty &key );
+	/// @copydoc at(const _Kty&)
+	const _Ty &at( const _Kty &key ) const;
+
+	/// @brief Returns the value mapped to a key. If the key does not exist, a default constructed value is inserted.
+	_Ty &operator[]( const _Kty &key );
+
+	/// @brief Inserts a key/value pair, if the key does not already exist in the map.
+	/// @return true if the pair was inserted, false if the key already existed (the existing value is not changed).
+	bool insert( const _Kty &key, const _Ty &value );
+	/// @copydoc insert(const _Kty&,const _Ty&)
+	bool insert( const _Kty &key, _Ty &&value );
+
+	/// @brief Inserts a key/value pair, or replaces the value if the key already exists in the map.
+	/// @return true if the pair was inserted, false if the value of an existing key was replaced.
+	bool insert_or_assign( const _Kty &key, const _Ty &value );
+
+	/// @brief Removes a key/value pair from the map.
+	/// @return Number of pairs removed (0 or 1).
+	size_type erase( const _Kty &key );
+
+	/// @brief Clears the map, and bulk builds it from an array of key/value pairs sorted by key.
+	/// @details The map is sized once, and since duplicate keys are adjacent in the sorted input, these are
+	/// skipped (the first pair is kept) without looking up any key in the map.
+	/// @note The input only needs to be grouped by key (all equal keys adjacent), a full sort is not needed.
+	void build_from_sorted( const value_type *items, size_type count );
+	/// @copydoc build_from_sorted(const value_type*,size_type)
+	void build_from_sorted( const std::vector<value_type> &items ) { this->build_from_sorted( items.data(), items.size() ); }
+
+	/// @brief Calls func( key, value ) for each key/value pair in the map, in slot order.
+	template<class _Func> void for_each( _Func func );
+	/// @copydoc for_each(_Func)
+	template<class _Func> void for_each( _Func func ) const;
+};
+
+template<class _Kty, class _Ty, class _Hash>
+inline size_t flat_id_map<_Kty, _Ty, _Hash>::capacity_for( size_t count )
+{
+	// smallest power of two number of groups which holds count values at max load 7/8
+	size_t capacity = group::width;
+	while( ( capacity / 8 ) * 7 < count )
+		capacity *= 2;
+	return capacity;
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline size_t flat_id_map<_Kty, _Ty, _Hash>::find_index( const _Kty &key ) const
+{
+	if( this->size_m == 0 )
+		return npos;
+
+	const size_t hval = this->hasher_m( key );
+	const u8 h2 = hash_h2( hval );
+	size_t group_index = hval & this->group_mask_m;
+	for( size_t probe = 1; ; ++probe )
+	{
+		const u8 *ctrl = &this->ctrl_m[group_index * group::width];
+
+		// check all slots in the group with a matching h2 value
+		u32 mask = group::match( ctrl, h2 );
+		while( mask )
+		{
+			const size_t index = group_index * group::width + group::lowest_bit( mask );
+			if( this->slots_m[index].first == key )
+				return index;
+			mask &= mask - 1;
+		}
+
+		// if the group has an empty slot, the key is not in the map
+		if( group::match( ctrl, ctrl_empty ) )
+			return npos;
+
+		// triangular probing visits all groups, since the group count is a power of two
+		group_index = ( group_index + probe ) & this->group_mask_m;
+	}
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline size_t flat_id_map<_Kty, _Ty, _Hash>::find_insert_index( size_t hval ) const
+{
+	size_t group_index = hval & this->group_mask_m;
+	for( size_t probe = 1; ; ++probe )
+	{
+		const u32 mask = group::match_not_full( &this->ctrl_m[group_index * group::width] );
+		if( mask )
+			return group_index * group::width + group::lowest_bit( mask );
+		group_index = ( group_index + probe ) & this->group_mask_m;
+	}
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline void flat_id_map<_Kty, _Ty, _Hash>::set_slot( size_t index, size_t hval, value_type &&value )
+{
+	if( this->ctrl_m[index] == ctrl_deleted )
+		--this->deleted_m;
+	this->ctrl_m[index] = hash_h2( hval );
+	this->slots_m[index] = std::move( value );
+	++this->size_m;
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline void flat_id_map<_Kty, _Ty, _Hash>::rebuild( size_t new_capacity )
+{
+	std::vector<u8> old_ctrl( new_capacity, ctrl_empty );
+	std::vector<value_type> old_slots( new_capacity );
+	std::swap( old_ctrl, this->ctrl_m );
+	std::swap( old_slots, this->slots_m );
+	this->size_m = 0;
+	this->deleted_m = 0;
+	this->group_mask_m = ( new_capacity / group::width ) - 1;
+
+	// re-insert all the full slots. keys are unique, so no lookup is needed
+	for( size_t inx = 0; inx < old_ctrl.size(); ++inx )
+	{
+		if( old_ctrl[inx] & 0x80 )
+			continue;
+		const size_t hval = this->hasher_m( old_slots[inx].first );
+		this->set_slot( this->find_insert_index( hval ), hval, std::move( old_slots[inx] ) );
+	}
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline void flat_id_map<_Kty, _Ty, _Hash>::grow_for_insert()
+{
+	// if the map is at most 25/32 full without the tombstones, drop them at the current capacity, else double the capacity
+	if( !this->slots_m.empty() && this->size_m * 32 <= this->slots_m.size() * 25 )
+		this->rebuild( this->slots_m.size() );
+	else
+		this->rebuild( this->slots_m.empty() ? group::width : this->slots_m.size() * 2 );
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline void flat_id_map<_Kty, _Ty, _Hash>::clear()
+{
+	for( size_t inx = 0; inx < this->ctrl_m.size(); ++inx )
+	{
+		if( !( this->ctrl_m[inx] & 0x80 ) )
+			this->slots_m[inx] = value_type();
+		this->ctrl_m[inx] = ctrl_empty;
+	}
+	this->size_m = 0;
+	this->deleted_m = 0;
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline void flat_id_map<_Kty, _Ty, _Hash>::reserve( size_type count )
+{
+	if( count > this->growth_limit() )
+		this->rehash( count );
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline void flat_id_map<_Kty, _Ty, _Hash>::rehash( size_type count )
+{
+	this->rebuild( capacity_for( ( count > this->size_m ) ? count : this->size_m ) );
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline _Ty *flat_id_map<_Kty, _Ty, _Hash>::find( const _Kty &key )
+{
+	const size_t index = this->find_index( key );
+	return ( index != npos ) ? &this->slots_m[index].second : nullptr;
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline const _Ty *flat_id_map<_Kty, _Ty, _Hash>::find( const _Kty &key ) const
+{
+	const size_t index = this->find_index( key );
+	return ( index != npos ) ? &this->slots_m[index].second : nullptr;
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline std::pair<_Ty, bool> flat_id_map<_Kty, _Ty, _Hash>::get( const _Kty &key ) const
+{
+	const size_t index = this->find_index( key );
+	if( index != npos )
+	{
+		return std::make_pair( this->slots_m[index].second, true );
+	}
+	return std::make_pair( _Ty(), false );
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline _Ty &flat_id_map<_Kty, _Ty, _Hash>::at( const _Kty &key )
+{
+	_Ty *value = this->find( key );
+	if( !value )
+		throw std::out_of_range( "flat_id_map: the key does not exist in the map" );
+	return *value;
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline const _Ty &flat_id_map<_Kty, _Ty, _Hash>::at( const _Kty &key ) const
+{
+	const _Ty *value = this->find( key );
+	if( !value )
+		throw std::out_of_range( "flat_id_map: the key does not exist in the map" );
+	return *value;
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline _Ty &flat_id_map<_Kty, _Ty, _Hash>::operator[]( const _Kty &key )
+{
+	size_t index = this->find_index( key );
+	if( index == npos )
+	{
+		if( this->size_m + this->deleted_m >= this->growth_limit() )
+			this->grow_for_insert();
+		const size_t hval = this->hasher_m( key );
+		index = this->find_insert_index( hval );
+		this->set_slot( index, hval, value_type( key, _Ty() ) );
+	}
+	return this->slots_m[index].second;
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline bool flat_id_map<_Kty, _Ty, _Hash>::insert( const _Kty &key, const _Ty &value )
+{
+	return this->insert( key, _Ty( value ) );
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline bool flat_id_map<_Kty, _Ty, _Hash>::insert( const _Kty &key, _Ty &&value )
+{
+	if( this->find_index( key ) != npos )
+		return false;
+
+	if( this->size_m + this->deleted_m >= this->growth_limit() )
+		this->grow_for_insert();
+	const size_t hval = this->hasher_m( key );
+	this->set_slot( this->find_insert_index( hval ), hval, value_type( key, std::move( value ) ) );
+	return true;
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline bool flat_id_map<_Kty, _Ty, _Hash>::insert_or_assign( const _Kty &key, const _Ty &value )
+{
+	_Ty *existing = this->find( key );
+	if( existing )
+	{
+		*existing = value;
+		return false;
+	}
+	return this->insert( key, value );
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline typename flat_id_map<_Kty, _Ty, _Hash>::size_type flat_id_map<_Kty, _Ty, _Hash>::erase( const _Kty &key )
+{
+	const size_t index = this->find_index( key );
+	if( index == npos )
+		return 0;
+
+	// lookups stop at the first group with an empty slot. if the group already has an empty slot, no probe
+	// sequence passes through this group, and the slot can be marked empty. else, leave a tombstone.
+	const size_t group_start = index - ( index % group::width );
+	if( group::match( &this->ctrl_m[group_start], ctrl_empty ) )
+	{
+		this->ctrl_m[index] = ctrl_empty;
+	}
+	else
+	{
+		this->ctrl_m[index] = ctrl_deleted;
+		++this->deleted_m;
+	}
+	this->slots_m[index] = value_type();
+	--this->size_m;
+	return 1;
+}
+
+template<class _Kty, class _Ty, class _Hash>
+inline void flat_id_map<_Kty, _Ty, _Hash>::build_from_sorted( const value_type *items, size_type count )
+{
+	this->clear();
+	this->reserve( count );
+
+	for( size_t inx = 0; inx < count; ++inx )
+	{
+		// skip duplicate keys, which are adjacent in the sorted input
+		if( inx > 0 && items[inx].first == items[inx - 1].first )
+			continue;
+		const size_t hval = this->hasher_m( items[inx].first );
+		this->set_slot( this->find_insert_index( hval ), hval, value_type( items[inx] ) );
+	}
+}
+
+template<class _Kty, class _Ty, class _Hash>
+template<class _Func>
+inline void flat_id_map<_Kty, _Ty, _Hash>::for_each( _Func func )
+{
+	for( size_t inx = 0; inx < this->ctrl_m.size(); ++inx )
+	{
+		if( !( this->ctrl_m[inx] & 0x80 ) )
+			func( (const _Kty &)this->slots_m[inx].first, this->slots_m[inx].second );
+	}
+}
+
+template<class _Kty, class _Ty, class _Hash>
+template<class _Func>
+inline void flat_id_map<_Kty, _Ty, _Hash>::for_each( _Func func ) const
+{
+	for( size_t inx = 0; inx < this->ctrl_m.size(); ++inx )
+	{
+		if( !( this->ctrl_m[inx] & 0x80 ) )
+			func( this->slots_m[inx].first, this->slots_m[inx].second );
+	}
+}
+
+}
+//namespace ctle
+
+#endif//_CTLE_FLAT_ID_MAP_H_
@@ -34,15 +34,19 @@ class status;
 
 // from data_source.h
 class file_data_source;
+class memory_data_source;
 
 // from data_destination.h
 class file_data_destination;
+class memory_data_destination;
+template<class _DataDestATy, class _DataDestBTy> class tee_data_destination;
 
 // from hasher.h
 class hasher_sha256;
 class hasher_xxh64;
 class hasher_xxh128;
 template <size_t _Size> class hasher_noop;
+template <class _HashATy, class _HashBTy> class hasher_pair;
 
 // from read_stream.h
 template<class _DataSourceTy, class _HashTy = hasher_noop<64>> class read_stream;
@@ -73,6 +77,54 @@ template <class _Ty, class _IdxTy = std::vector<i32>, class _VecTy = std::vector
 // from string_funcs.h
 template<class _Ty> struct string_span;
 
+// from util.h
+template<class _Ty> struct identity_hash;
+
+// from sorted_id_index.h
+template<class _IdTy, class _IdxTy = u32> class sorted_id_index;
+
+// from flat_id_map.h
+template<class _Kty, class _Ty, class _Hash = identity_hash<_Kty>> class flat_id_map;
+
+// from blob_store.h
+template<class _HashTy = hasher_sha256> class blob_store;
+
+// from file_hash_cache.h
+template<class _HashTy = hasher_sha256> class file_hash_cache;
+
+// from pack_file.h
+template<class _KeyTy, class _HashTy = hasher_xxh128> class pack_file_writer;
+template<class _KeyTy, class _HashTy = hasher_xxh128> class pack_file_reader;
+
+// from id_filter.h
+template<class _IdTy, class _Hash = identity_hash<_IdTy>> class blocked_bloom_filter;
+template<class _IdTy, class _Hash = identity_hash<_IdTy>> class cuckoo_filter;
+
+// from block_compression.h
+template<class _DataDestTy> class compressed_data_destination;
+template<class _DataSourceTy> class compressed_data_source;
+
+// from serialization.h
+template<class _Ty, class = void> struct is_bulk_serializable;
+
+// from value_equality.h
+template<class _Ty> struct bitwise_equality;
+template<class _Ty> class quantized_equality;
+
+// from idx_vector_builder.h
+template<class _Ty, class _IdxTy = std::vector<i32>, class _VecTy = std::vector<_Ty>, class _EqualityTy = bitwise_equality<_Ty>> class idx_vector_builder;
+
+// from vector_view.h
+template<class _Ty> class vector_view;
+template<class _Ty, class _IdxTy = i32> class idx_vector_view;
+template<class _Ty> class optional_vector_view;
+
+// from packed_index_vector.h
+class packed_index_vector;
+
+// from nullable_vector.h
+template<class _Ty, class _Alloc = std::allocator<_Ty>> class nullable_vector;
+
 
 }
 //namespace ctle
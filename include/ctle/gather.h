@@ -0,0 +1,340 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_GATHER_H_
+#define _CTLE_GATHER_H_
+
+/// @file gather.h
+/// @brief Contains the gather function, which copies values by index from a values array into a flat array, and the expand_to functions of idx_vectors.
+
+#include <cstring>
+#include <type_traits>
+#include <stdexcept>
+#include <algorithm>
+
+#include "fwd.h"
+#include "idx_vector.h"
+#include "packed_index_vector.h"
+#include "_cpu_features.h"
+#include "_parallel.h"
+
+#if defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_IX86) )
+#include <xmmintrin.h>
+#endif
+
+namespace ctle
+{
+
+/// @brief Gather values by index, so that dest[i] = values[indices[i]] for i in [0,count).
+/// @details For 4 and 8 byte trivially copyable values and u8, u16, i32 or u32 indices, the values are gathered using AVX-512 or AVX2
+/// gather instructions, selected at runtime from the capabilities of the cpu. Values of other sizes are copied one by one, and values
+/// larger than 8 bytes are prefetched ahead of the copy, so that the cache misses of random indices overlap.
+/// @param dest the destination array, which must hold count values, and must not overlap the values or the indices
+/// @param values the values array
+/// @param value_count the number of values in the values array. All indices must be less than value_count.
+/// @param indices the indices
+/// @param count the number of indices, and values to gather
+template<class _Ty, class _IdxTy> void gather( _Ty *dest, const _Ty *values, size_t value_count, const _IdxTy *indices, size_t count );
+
+/// @brief Expand the items [begin,end) of an idx_vector into a flat array of values, so that dest[i] = vec[begin + i].
+/// @details The values are gathered in bulk using gather(), instead of a dependent double load per item. The index vector must be 
+/// a std::vector or a packed_index_vector, and the indices in the range must be valid, see idx_vector::is_valid().
+/// @param dest the destination array, which must hold (end - begin) values
+/// @throws std::out_of_range if the range is not within the index vector
+template<class _Ty, class _IdxTy, class _VecTy> void expand_to( _Ty *dest, const idx_vector<_Ty, _IdxTy, _VecTy> &vec, size_t begin, size_t end );
+
+/// @brief Expand the items [begin,end) of an idx_vector into a flat array of values, on multiple threads. @see expand_to()
+/// @details The range is split into blocks, which are expanded in parallel. Small ranges are expanded on the calling thread.
+/// @param thread_count the number of threads to use, 0 uses the hardware concurrency
+template<class _Ty, class _IdxTy, class _VecTy> void expand_to_parallel( _Ty *dest, const idx_vector<_Ty, _IdxTy, _VecTy> &vec, size_t begin, size_t end, size_t thread_count = 0 );
+
+// Bulk gather of 4 or 8 byte values, using 1, 2 or 4 byte indices (which must all be less than 2^31), using
+// AVX-512 or AVX2 gathers. The instruction set is selected at runtime, from the capabilities of the cpu.
+void _gather_bulk( void *dest, const void *values, const void *indices, size_t count, size_t value_size, size_t index_size );
+
+// prefetch the cache line of an address into all cache levels
+inline void _prefetch( const void *ptr ) noexcept
+{
+#if defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_IX86) )
+	_mm_prefetch( (const char *)ptr, _MM_HINT_T0 );
+#elif defined(__GNUC__)
+	__builtin_prefetch( ptr );
+#else
+	(void)ptr;
+#endif
+}
+
+// the number of values which are prefetched ahead of the copy, enough to hide the memory latency
+static constexpr const size_t _gather_prefetch_distance = 16;
+
+// the smallest number of values which are gathered with the SIMD kernels
+static constexpr const size_t _gather_bulk_min_count = 32;
+
+// copy the values one by one, with no prefetch
+template<class _Ty, class _IdxTy> inline void _gather_scalar( _Ty *dest, const _Ty *values, const _IdxTy *indices, size_t count, std::false_type /*prefetch*/ )
+{
+	for( size_t inx = 0; inx < count; ++inx )
+		dest[inx] = values[indices[inx]];
+}
+
+// copy the values one by one, and prefetch the values ahead of the copy
+template<class _Ty, class _IdxTy> inline void _gather_scalar( _Ty *dest, const _Ty *values, const _IdxTy *indices, size_t count, std::true_type /*prefetch*/ )
+{
+	const size_t prefetch_end = ( count > _gather_prefetch_distance ) ? count - _gather_prefetch_distance : 0;
+	size_t inx = 0;
+	for( ; inx < prefetch_end; ++inx )
+	{
+		const _Ty *ahead = &values[indices[inx + _gather_prefetch_distance]];
+		_prefetch( ahead );
+		if( sizeof( _Ty ) > 64 )
+			_prefetch( (const u8 *)ahead + sizeof( _Ty ) - 1 );
+		dest[inx] = values[indices[inx]];
+	}
+	for( ; inx < count; ++inx )
+		dest[inx] = values[indices[inx]];
+}
+
+// values and indices which can be gathered by the SIMD kernels
+template<class _Ty, class _IdxTy> struct _is_bulk_gatherable : std::integral_constant<bool,
+	std::is_trivially_copyable<_Ty>::value && ( sizeof( _Ty ) == 4 || sizeof( _Ty ) == 8 )
+	&& std::is_integral<_IdxTy>::value && ( sizeof( _IdxTy ) == 1 || sizeof( _IdxTy ) == 2 || sizeof( _IdxTy ) == 4 )> {};
+
+template<class _Ty, class _IdxTy> inline void _gather( _Ty *dest, const _Ty *values, size_t value_count, const _IdxTy *indices, size_t count, std::true_type /*bulk gatherable*/ )
+{
+	// the kernels use signed 32 bit offsets
+	if( count >= _gather_bulk_min_count && value_count <= size_t( 0x7fffffff ) )
+		_gather_bulk( dest, values, indices, count, sizeof( _Ty ), sizeof( _IdxTy ) );
+	else
+		_gather_scalar( dest, values, indices, count, std::false_type() );
+}
+
+template<class _Ty, class _IdxTy> inline void _gather( _Ty *dest, const _Ty *values, size_t, const _IdxTy *indices, size_t count, std::false_type /*bulk gatherable*/ )
+{
+	_gather_scalar( dest, values, indices, count, std::integral_constant<bool, ( sizeof( _Ty ) > 8 )>() );
+}
+
+template<class _Ty, class _IdxTy>
+inline void gather( _Ty *dest, const _Ty *values, size_t value_count, const _IdxTy *indices, size_t count )
+{
+	_gather( dest, values, value_count, indices, count, _is_bulk_gatherable<_Ty, _IdxTy>() );
+}
+
+// the number of items expanded in each block by expand_to_parallel
+static constexpr const size_t _expand_block_size = 64 * 1024;
+
+// gather the values of the items [begin,end) of an index vector
+template<class _Ty, class _IdxTy> inline void _expand_index( _Ty *dest, const _Ty *values, size_t value_count, const _IdxTy &index, size_t begin, size_t end )
+{
+	gather( dest, values, value_count, index.data() + begin, end - begin );
+}
+
+template<class _Ty> struct _packed_index_gatherer
+{
+	_Ty *dest;
+	const _Ty *values;
+	size_t value_count;
+	size_t begin;
+	size_t end;
+
+	template<class _IdxTy> void operator()( const _IdxTy *indices, size_t ) const { gather( this->dest, this->values, this->value_count, indices + this->begin, this->end - this->begin ); }
+};
+
+template<class _Ty> inline void _expand_index( _Ty *dest, const _Ty *values, size_t value_count, const packed_index_vector &index, size_t begin, size_t end )
+{
+	index.visit( _packed_index_gatherer<_Ty>{ dest, values, value_count, begin, end } );
+}
+
+template<class _Ty, class _IdxTy, class _VecTy>
+inline void expand_to( _Ty *dest, const idx_vector<_Ty, _IdxTy, _VecTy> &vec, size_t begin, size_t end )
+{
+	if( begin > end || end > vec.size() )
+	{
+		throw std::out_of_range( "expand_to range is out of bounds" );
+	}
+	_expand_index( dest, vec.values().data(), vec.values().size(), vec.index(), begin, end );
+}
+
+template<class _Ty, class _IdxTy, class _VecTy>
+inline void expand_to_parallel( _Ty *dest, const idx_vector<_Ty, _IdxTy, _VecTy> &vec, size_t begin, size_t end, size_t thread_count )
+{
+	if( begin > end || end > vec.size() )
+	{
+		throw std::out_of_range( "expand_to_parallel range is out of bounds" );
+	}
+
+	const size_t block_count = ( end - begin + _expand_block_size - 1 ) / _expand_block_size;
+	thread_count = _resolve_thread_count( thread_count );
+	if( block_count <= 1 || thread_count == 1 )
+	{
+		_expand_index( dest, vec.values().data(), vec.values().size(), vec.index(), begin, end );
+		return;
+	}
+
+	_parallel_for( block_count, thread_count, [&]( size_t block )
+		{
+			const size_t block_begin = begin + block * _expand_block_size;
+			const size_t block_end = std::min<size_t>( block_begin + _expand_block_size, end );
+			_expand_index( dest + ( block_begin - begin ), vec.values().data(), vec.values().size(), vec.index(), block_begin, block_end );
+		} );
+}
+
+}
+//namespace ctle
+
+#ifdef CTLE_IMPLEMENTATION
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define _CTLE_GATHER_X86
+#include <immintrin.h>
+#endif
+
+// GCC and Clang need the target instruction set of functions which use intrinsics beyond the compiler flags, MSVC does not
+#if defined(__GNUC__)
+#define _CTLE_GATHER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define _CTLE_GATHER_TARGET(isa)
+#endif
+
+namespace ctle
+{
+
+// copy values of _Size bytes one by one
+template<size_t _Size, class _IdxTy> static inline void _gather_copy( u8 *dest, const u8 *values, const _IdxTy *indices, size_t count )
+{
+	for( size_t inx = 0; inx < count; ++inx )
+		memcpy( &dest[inx * _Size], &values[size_t( indices[inx] ) * _Size], _Size );
+}
+
+// gather values of value_size (4 or 8) bytes one by one, with index_size (1, 2 or 4) byte indices
+static void _gather_bulk_scalar( void *dest, const void *values, const void *indices, size_t count, size_t value_size, size_t index_size )
+{
+	u8 *d = (u8 *)dest;
+	const u8 *v = (const u8 *)values;
+	if( value_size == 4 )
+	{
+		switch( index_size )
+		{
+			case 1: _gather_copy<4>( d, v, (const u8 *)indices, count ); break;
+			case 2: _gather_copy<4>( d, v, (const u16 *)indices, count ); break;
+			default: _gather_copy<4>( d, v, (const u32 *)indices, count ); break;
+		}
+	}
+	else
+	{
+		switch( index_size )
+		{
+			case 1: _gather_copy<8>( d, v, (const u8 *)indices, count ); break;
+			case 2: _gather_copy<8>( d, v, (const u16 *)indices, count ); break;
+			default: _gather_copy<8>( d, v, (const u32 *)indices, count ); break;
+		}
+	}
+}
+
+#if defined(_CTLE_GATHER_X86)
+
+// load 8 indices of index_size bytes, zero extended to 32 bits
+_CTLE_GATHER_TARGET("avx2") static inline __m256i _gather_load_indices_avx2( const u8 *indices, size_t index_size )
+{
+	switch( index_size )
+	{
+		case 1: return _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i *)indices ) );
+		case 2: return _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i *)indices ) );
+		default: return _mm256_loadu_si256( (const __m256i *)indices );
+	}
+}
+
+_CTLE_GATHER_TARGET("avx2") static void _gather_bulk_avx2( void *dest, const void *values, const void *indices, size_t count, size_t value_size, size_t index_size )
+{
+	const u8 *idx = (const u8 *)indices;
+	size_t inx = 0;
+	if( value_size == 4 )
+	{
+		const int *base = (const int *)values;
+		u32 *d = (u32 *)dest;
+		for( ; inx + 8 <= count; inx += 8 )
+		{
+			const __m256i vindex = _gather_load_indices_avx2( &idx[inx * index_size], index_size );
+			_mm256_storeu_si256( (__m256i *)&d[inx], _mm256_i32gather_epi32( base, vindex, 4 ) );
+		}
+	}
+	else
+	{
+		const long long *base = (const long long *)values;
+		u64 *d = (u64 *)dest;
+		for( ; inx + 8 <= count; inx += 8 )
+		{
+			const __m256i vindex = _gather_load_indices_avx2( &idx[inx * index_size], index_size );
+			_mm256_storeu_si256( (__m256i *)&d[inx], _mm256_i32gather_epi64( base, _mm256_castsi256_si128( vindex ), 8 ) );
+			_mm256_storeu_si256( (__m256i *)&d[inx + 4], _mm256_i32gather_epi64( base, _mm256_extracti128_si256( vindex, 1 ), 8 ) );
+		}
+	}
+	_gather_bulk_scalar( (u8 *)dest + inx * value_size, values, &idx[inx * index_size], count - inx, value_size, index_size );
+}
+
+// load 16 indices of index_size bytes, zero extended to 32 bits
+_CTLE_GATHER_TARGET("avx512f") static inline __m512i _gather_load_indices_avx512( const u8 *indices, size_t index_size )
+{
+	switch( index_size )
+	{
+		case 1: return _mm512_cvtepu8_epi32( _mm_loadu_si128( (const __m128i *)indices ) );
+		case 2: return _mm512_cvtepu16_epi32( _mm256_loadu_si256( (const __m256i *)indices ) );
+		default: return _mm512_loadu_si512( (const void *)indices );
+	}
+}
+
+_CTLE_GATHER_TARGET("avx512f") static void _gather_bulk_avx512( void *dest, const void *values, const void *indices, size_t count, size_t value_size, size_t index_size )
+{
+	const u8 *idx = (const u8 *)indices;
+	size_t inx = 0;
+	if( value_size == 4 )
+	{
+		u32 *d = (u32 *)dest;
+		for( ; inx + 16 <= count; inx += 16 )
+		{
+			const __m512i vindex = _gather_load_indices_avx512( &idx[inx * index_size], index_size );
+			_mm512_storeu_si512( (void *)&d[inx], _mm512_i32gather_epi32( vindex, values, 4 ) );
+		}
+	}
+	else
+	{
+		u64 *d = (u64 *)dest;
+		for( ; inx + 16 <= count; inx += 16 )
+		{
+			const __m512i vindex = _gather_load_indices_avx512( &idx[inx * index_size], index_size );
+			_mm512_storeu_si512( (void *)&d[inx], _mm512_i32gather_epi64( _mm512_castsi512_si256( vindex ), values, 8 ) );
+			_mm512_storeu_si512( (void *)&d[inx + 8], _mm512_i32gather_epi64( _mm512_extracti64x4_epi64( vindex, 1 ), values, 8 ) );
+		}
+	}
+	_gather_bulk_scalar( (u8 *)dest + inx * value_size, values, &idx[inx * index_size], count - inx, value_size, index_size );
+}
+
+#endif
+
+typedef void ( *_gather_bulk_func )( void *dest, const void *values, const void *indices, size_t count, size_t value_size, size_t index_size );
+
+static _gather_bulk_func _gather_bulk_select()
+{
+#if defined(_CTLE_GATHER_X86)
+	if( _cpu_has_avx512f() )
+		return &_gather_bulk_avx512;
+	if( _cpu_has_avx2() )
+		return &_gather_bulk_avx2;
+#endif
+	return &_gather_bulk_scalar;
+}
+
+void _gather_bulk( void *dest, const void *values, const void *indices, size_t count, size_t value_size, size_t index_size )
+{
+	// the kernel is selected on first use
+	static const _gather_bulk_func kernel = _gather_bulk_select();
+	kernel( dest, values, indices, count, value_size, index_size );
+}
+
+}
+//namespace ctle
+
+#undef _CTLE_GATHER_TARGET
+
+#endif//CTLE_IMPLEMENTATION
+
+#endif//_CTLE_GATHER_H_
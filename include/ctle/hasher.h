@@ -17,6 +17,8 @@
 /// the library header before including hasher.h in the implementation source file. (see the example implementation in the 
 /// documentation for ctle.h for more information).
 
+#include <utility>
+
 #include "digest.h"
 #include "status.h"
 #include "status_return.h"
@@ -105,6 +107,44 @@ private:
 	void *context = nullptr;
 };
 
+/// @brief A hasher which feeds the same data to two hashers, so a single pass over a stream calculates both hashes, e.g. an XXH128 cache key and a SHA-256 manifest hash.
+/// @details The hash_type is a std::pair of the two digests. Pairs can be nested to calculate more than two hashes, e.g. hasher_pair<hasher_xxh128,hasher_pair<hasher_xxh64,hasher_sha256>>.
+/// @tparam _HashATy the first hasher
+/// @tparam _HashBTy the second hasher
+template <class _HashATy, class _HashBTy>
+class hasher_pair
+{
+public:
+	hasher_pair() {};
+	~hasher_pair() {};
+	using hash_type = std::pair<typename _HashATy::hash_type, typename _HashBTy::hash_type>;
+
+	/// @copydoc hasher_noop::update
+	status update(const uint8_t* data, size_t size)
+	{
+		const status result = this->hasher_a.update(data,size);
+		if( !result )
+			return result;
+		return this->hasher_b.update(data,size);
+	}
+
+	/// @copydoc hasher_noop::finish
+	status_return<status, hash_type> finish()
+	{
+		auto digest_a = this->hasher_a.finish();
+		if( !digest_a.status() )
+			return digest_a.status();
+		auto digest_b = this->hasher_b.finish();
+		if( !digest_b.status() )
+			return digest_b.status();
+		return hash_type( digest_a.value(), digest_b.value() );
+	}
+
+private:
+	_HashATy hasher_a;
+	_HashBTy hasher_b;
+};
+
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
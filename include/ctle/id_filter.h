@@ -0,0 +1,499 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_ID_FILTER_H_
+#define _CTLE_ID_FILTER_H_
+
+/// @file id_filter.h
+/// @brief Approximate membership filters (blocked bloom filter and cuckoo filter) for uuid and digest keys.
+/// @details The filters use the bits of the keys directly (through identity_hash), since uuid and digest values are already
+/// uniformly random, and can be written to and read from write_stream and read_stream.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "fwd.h"
+#include "util.h"
+#include "_cpu_features.h"
+#include "status.h"
+
+namespace ctle
+{
+
+// set, or test, the bit of a key in each of the eight 32 bit lanes of a 256 bit bloom filter block. 
+// The AVX2 or scalar kernel is selected at runtime, from the capabilities of the cpu.
+void _bloom_block_insert( u32 *block, u32 key ) noexcept;
+bool _bloom_block_contains( const u32 *block, u32 key ) noexcept;
+
+/// @brief A split block bloom filter for uuid and digest keys.
+/// @details The filter is an array of 256 bit blocks, each split into eight 32 bit lanes. A key selects one block, and sets
+/// one bit in each lane of the block, so a lookup touches a single cache line. The block is selected by the high 32 bits of the
+/// hash value, and the bit in each lane by multiplying the low 32 bits with a per-lane odd constant. If the cpu supports
+/// AVX2 (checked at runtime), all eight lanes are set or tested at once. The filter has no false negatives, and roughly 
+/// a 0.5% false positive rate at 12 bits per key, and 0.1% at 16 bits per key.
+/// @tparam _IdTy The key type, uuid or digest<_Size>.
+/// @tparam _Hash The hash functor, defaults to identity_hash<_IdTy>.
+template<class _IdTy, class _Hash /* = identity_hash<_IdTy> */>
+class blocked_bloom_filter
+{
+public:
+	using id_type = _IdTy;
+	using hasher = _Hash;
+
+	blocked_bloom_filter() = default;
+
+	/// @brief Create a filter sized for an expected number of keys.
+	/// @param expected_count the expected number of keys to insert
+	/// @param bits_per_key the number of filter bits per key, higher values give a lower false positive rate
+	explicit blocked_bloom_filter( size_t expected_count, size_t bits_per_key = 12 ) { this->reset( expected_count, bits_per_key ); }
+
+	/// @brief Clear and resize the filter for an expected number of keys. @see blocked_bloom_filter(size_t,size_t)
+	void reset( size_t expected_count, size_t bits_per_key = 12 );
+
+	/// @brief Clear all keys from the filter, keeps the size of the filter.
+	void clear();
+
+	/// @brief Insert a key into the filter.
+	void insert( const _IdTy &id );
+
+	/// @brief Check if a key may be in the filter.
+	/// @return false if the key is definitely not in the filter, true if the key is probably in the filter.
+	bool contains( const _IdTy &id ) const;
+
+	/// @brief Returns the number of 256 bit blocks in the filter.
+	size_t block_count() const noexcept { return this->words_m.size() / 8; }
+
+	/// @brief Returns the size of the filter data in bytes.
+	size_t size_in_bytes() const noexcept { return this->words_m.size() * sizeof( u32 ); }
+
+	/// @brief Write the filter to a write_stream.
+	template<class _StreamTy> status write_to_stream( _StreamTy &strm ) const;
+
+	/// @brief Read the filter from a read_stream, replacing the current filter.
+	template<class _StreamTy> status read_from_stream( _StreamTy &strm );
+
+private:
+	std::vector<u32> words_m;
+	hasher hasher_m;
+
+	size_t block_offset( u64 hval ) const noexcept;
+};
+
+/// @brief A cuckoo filter for uuid and digest keys, which supports deletion of keys.
+/// @details The filter stores 16 bit fingerprints in buckets of 4 slots. Each key has two candidate buckets, where the primary
+/// bucket is selected by the low bits of the hash value, and the fingerprint is the top 16 bits. The alternate bucket is the primary
+/// bucket xor a hash of the fingerprint, so keys can be moved between their buckets when the filter fills up. A lookup
+/// checks at most two buckets, and the false positive rate is roughly 0.01%. Keys can be erased, but only keys which have been inserted.
+/// @tparam _IdTy The key type, uuid or digest<_Size>.
+/// @tparam _Hash The hash functor, defaults to identity_hash<_IdTy>.
+template<class _IdTy, class _Hash /* = identity_hash<_IdTy> */>
+class cuckoo_filter
+{
+public:
+	using id_type = _IdTy;
+	using hasher = _Hash;
+
+	static constexpr const size_t bucket_size = 4;
+
+	cuckoo_filter() = default;
+
+	/// @brief Create a filter sized for an expected number of keys.
+	explicit cuckoo_filter( size_t expected_count ) { this->reset( expected_count ); }
+
+	/// @brief Clear and resize the filter for an expected number of keys.
+	void reset( size_t expected_count );
+
+	/// @brief Clear all keys from the filter, keeps the size of the filter.
+	void clear();
+
+	/// @brief Insert a key into the filter.
+	/// @return true if the key was inserted, false if the filter is too full to insert the key.
+	bool insert( const _IdTy &id );
+
+	/// @brief Check if a key may be in the filter.
+	/// @return false if the key is definitely not in the filter, true if the key is probably in the filter.
+	bool contains( const _IdTy &id ) const;
+
+	/// @brief Erase a key from the filter. Only erase keys which have been inserted, else other keys may be removed.
+	/// @return true if a fingerprint of the key was found and removed.
+	bool erase( const _IdTy &id );
+
+	/// @brief Returns the number of keys in the filter.
+	size_t size() const noexcept { return this->size_m; }
+
+	/// @brief Returns the number of buckets in the filter.
+	size_t bucket_count() const noexcept { return this->slots_m.size() / bucket_size; }
+
+	/// @brief Write the filter to a write_stream.
+	template<class _StreamTy> status write_to_stream( _StreamTy &strm ) const;
+
+	/// @brief Read the filter from a read_stream, replacing the current filter.
+	template<class _StreamTy> status read_from_stream( _StreamTy &strm );
+
+private:
+	static constexpr const size_t max_kicks = 500;
+
+	std::vector<u16> slots_m;
+	size_t size_m = 0;
+	size_t bucket_mask_m = 0;
+	u64 victim_rng_m = 0x9e3779b97f4a7c15ull;
+	hasher hasher_m;
+
+	static u16 fingerprint( u64 hval ) noexcept { const u16 fp = u16( hval >> 48 ); return fp ? fp : 1; }
+	size_t alt_bucket( size_t bucket, u16 fp ) const noexcept { return ( bucket ^ size_t( hash_mix_64( fp ) ) ) & this->bucket_mask_m; }
+	bool bucket_has( size_t bucket, u16 fp ) const noexcept;
+	bool bucket_add( size_t bucket, u16 fp ) noexcept;
+};
+
+}
+//namespace ctle
+
+#include "log.h"
+#include "_macros.inl"
+
+namespace ctle
+{
+
+// the number of bytes which are read at a time when a filter is read from a stream
+static constexpr const size_t _id_filter_read_step_size = 1024 * 1024;
+
+// read count values from a stream into a vector, growing the vector while reading, at most doubling the number of values 
+// read so far, so that a corrupted count fails when the stream ends, instead of allocating the whole count up front
+template<class _Ty, class _StreamTy> inline status _id_filter_read_values( _StreamTy &strm, std::vector<_Ty> &dest, size_t count )
+{
+	dest.clear();
+	while( dest.size() < count )
+	{
+		const size_t read_count = dest.size();
+		const size_t step = std::max( _id_filter_read_step_size / sizeof( _Ty ), read_count );
+		dest.resize( read_count + std::min( count - read_count, step ) );
+		ctStatusCall( strm.template read<_Ty>( &dest[read_count], dest.size() - read_count ) );
+	}
+	return status::ok;
+}
+
+template<class _IdTy, class _Hash>
+inline void blocked_bloom_filter<_IdTy, _Hash>::reset( size_t expected_count, size_t bits_per_key )
+{
+	const size_t bits = ( expected_count ? expected_count : 1 ) * ( bits_per_key ? bits_per_key : 1 );
+	const size_t blocks = ( bits + 255 ) / 256;
+	this->words_m.assign( blocks * 8, 0 );
+}
+
+template<class _IdTy, class _Hash>
+inline void blocked_bloom_filter<_IdTy, _Hash>::clear()
+{
+	this->words_m.assign( this->words_m.size(), 0 );
+}
+
+template<class _IdTy, class _Hash>
+inline size_t blocked_bloom_filter<_IdTy, _Hash>::block_offset( u64 hval ) const noexcept
+{
+	// map the high 32 bits onto the block range with a multiply-shift, instead of a modulo
+	return size_t( ( ( hval >> 32 ) * u64( this->block_count() ) ) >> 32 ) * 8;
+}
+
+template<class _IdTy, class _Hash>
+inline void blocked_bloom_filter<_IdTy, _Hash>::insert( const _IdTy &id )
+{
+	if( this->words_m.empty() )
+		this->reset( 1 );
+
+	const u64 hval = (u64)this->hasher_m( id );
+	_bloom_block_insert( &this->words_m[this->block_offset( hval )], u32( hval ) );
+}
+
+template<class _IdTy, class _Hash>
+inline bool blocked_bloom_filter<_IdTy, _Hash>::contains( const _IdTy &id ) const
+{
+	if( this->words_m.empty() )
+		return false;
+
+	const u64 hval = (u64)this->hasher_m( id );
+	return _bloom_block_contains( &this->words_m[this->block_offset( hval )], u32( hval ) );
+}
+
+template<class _IdTy, class _Hash>
+template<class _StreamTy>
+inline status blocked_bloom_filter<_IdTy, _Hash>::write_to_stream( _StreamTy &strm ) const
+{
+	ctStatusCall( strm.template write<u64>( (u64)this->words_m.size() ) );
+	ctStatusCall( strm.template write<u32>( this->words_m.data(), this->words_m.size() ) );
+	return status::ok;
+}
+
+template<class _IdTy, class _Hash>
+template<class _StreamTy>
+inline status blocked_bloom_filter<_IdTy, _Hash>::read_from_stream( _StreamTy &strm )
+{
+	u64 word_count = 0;
+	ctStatusCall( strm.template read<u64>( &word_count, 1 ) );
+	ctValidate( ( word_count % 8 ) == 0, status::corrupted ) << "The bloom filter word count must be a multiple of the block size" << ctValidateEnd;
+	ctValidate( word_count <= u64( this->words_m.max_size() ), status::corrupted ) << "The bloom filter word count " << word_count << " is not valid" << ctValidateEnd;
+
+	// read into a new vector, so the filter is unchanged if the read fails
+	std::vector<u32> words;
+	ctStatusCall( _id_filter_read_values( strm, words, (size_t)word_count ) );
+	this->words_m.swap( words );
+	return status::ok;
+}
+
+////////////////////////////////////////
+
+template<class _IdTy, class _Hash>
+inline void cuckoo_filter<_IdTy, _Hash>::reset( size_t expected_count )
+{
+	// size for a max load of ~95%, with a power of two number of buckets
+	size_t buckets = 1;
+	while( buckets * bucket_size * 19 < expected_count * 20 )
+		buckets *= 2;
+	this->slots_m.assign( buckets * bucket_size, 0 );
+	this->bucket_mask_m = buckets - 1;
+	this->size_m = 0;
+}
+
+template<class _IdTy, class _Hash>
+inline void cuckoo_filter<_IdTy, _Hash>::clear()
+{
+	this->slots_m.assign( this->slots_m.size(), 0 );
+	this->size_m = 0;
+}
+
+template<class _IdTy, class _Hash>
+inline bool cuckoo_filter<_IdTy, _Hash>::bucket_has( size_t bucket, u16 fp ) const noexcept
+{
+	const u16 *slots = &this->slots_m[bucket * bucket_size];
+	return ( slots[0] == fp ) | ( slots[1] == fp ) | ( slots[2] == fp ) | ( slots[3] == fp );
+}
+
+template<class _IdTy, class _Hash>
+inline bool cuckoo_filter<_IdTy, _Hash>::bucket_add( size_t bucket, u16 fp ) noexcept
+{
+	u16 *slots = &this->slots_m[bucket * bucket_size];
+	for( size_t inx = 0; inx < bucket_size; ++inx )
+	{
+		if( slots[inx] == 0 )
+		{
+			slots[inx] = fp;
+			return true;
+		}
+	}
+	return false;
+}
+
+template<class _IdTy, class _Hash>
+inline bool cuckoo_filter<_IdTy, _Hash>::insert( const _IdTy &id )
+{
+	if( this->slots_m.empty() )
+		this->reset( 1 );
+
+	const u64 hval = (u64)this->hasher_m( id );
+	u16 fp = fingerprint( hval );
+	const size_t b1 = size_t( hval ) & this->bucket_mask_m;
+	const size_t b2 = this->alt_bucket( b1, fp );
+	if( this->bucket_add( b1, fp ) || this->bucket_add( b2, fp ) )
+	{
+		++this->size_m;
+		return true;
+	}
+
+	// both buckets are full, kick out random fingerprints to their alternate buckets
+	std::vector<size_t> kicked;
+	size_t bucket = ( hval & ( u64( 1 ) << 63 ) ) ? b1 : b2;
+	for( size_t kick = 0; kick < max_kicks; ++kick )
+	{
+		this->victim_rng_m = hash_mix_64( this->victim_rng_m + 0x9e3779b97f4a7c15ull );
+		const size_t slot = bucket * bucket_size + size_t( this->victim_rng_m % bucket_size );
+		std::swap( fp, this->slots_m[slot] );
+		kicked.push_back( slot );
+
+		bucket = this->alt_bucket( bucket, fp );
+		if( this->bucket_add( bucket, fp ) )
+		{
+			++this->size_m;
+			return true;
+		}
+	}
+
+	// the filter is too full, undo the kicks so the filter is unchanged
+	for( size_t inx = kicked.size(); inx > 0; --inx )
+	{
+		std::swap( fp, this->slots_m[kicked[inx - 1]] );
+	}
+	return false;
+}
+
+template<class _IdTy, class _Hash>
+inline bool cuckoo_filter<_IdTy, _Hash>::contains( const _IdTy &id ) const
+{
+	if( this->slots_m.empty() )
+		return false;
+
+	const u64 hval = (u64)this->hasher_m( id );
+	const u16 fp = fingerprint( hval );
+	const size_t b1 = size_t( hval ) & this->bucket_mask_m;
+	return this->bucket_has( b1, fp ) || this->bucket_has( this->alt_bucket( b1, fp ), fp );
+}
+
+template<class _IdTy, class _Hash>
+inline bool cuckoo_filter<_IdTy, _Hash>::erase( const _IdTy &id )
+{
+	if( this->slots_m.empty() )
+		return false;
+
+	const u64 hval = (u64)this->hasher_m( id );
+	const u16 fp = fingerprint( hval );
+	const size_t b1 = size_t( hval ) & this->bucket_mask_m;
+	const size_t buckets[2] = { b1, this->alt_bucket( b1, fp ) };
+	for( size_t bucket : buckets )
+	{
+		u16 *slots = &this->slots_m[bucket * bucket_size];
+		for( size_t inx = 0; inx < bucket_size; ++inx )
+		{
+			if( slots[inx] == fp )
+			{
+				slots[inx] = 0;
+				--this->size_m;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+template<class _IdTy, class _Hash>
+template<class _StreamTy>
+inline status cuckoo_filter<_IdTy, _Hash>::write_to_stream( _StreamTy &strm ) const
+{
+	ctStatusCall( strm.template write<u64>( (u64)this->bucket_count() ) );
+	ctStatusCall( strm.template write<u64>( (u64)this->size_m ) );
+	ctStatusCall( strm.template write<u16>( this->slots_m.data(), this->slots_m.size() ) );
+	return status::ok;
+}
+
+template<class _IdTy, class _Hash>
+template<class _StreamTy>
+inline status cuckoo_filter<_IdTy, _Hash>::read_from_stream( _StreamTy &strm )
+{
+	u64 buckets = 0;
+	u64 size = 0;
+	ctStatusCall( strm.template read<u64>( &buckets, 1 ) );
+	ctStatusCall( strm.template read<u64>( &size, 1 ) );
+	ctValidate( buckets > 0 && ( buckets & ( buckets - 1 ) ) == 0, status::corrupted ) << "The cuckoo filter bucket count must be a power of two" << ctValidateEnd;
+	ctValidate( buckets <= u64( this->slots_m.max_size() / bucket_size ), status::corrupted ) << "The cuckoo filter bucket count " << buckets << " is not valid" << ctValidateEnd;
+	ctValidate( size <= buckets * bucket_size, status::corrupted ) << "The cuckoo filter key count is larger than the number of slots" << ctValidateEnd;
+
+	// read into a new vector, so the filter is unchanged if the read fails
+	std::vector<u16> slots;
+	ctStatusCall( _id_filter_read_values( strm, slots, (size_t)buckets * bucket_size ) );
+	this->slots_m.swap( slots );
+	this->bucket_mask_m = (size_t)buckets - 1;
+	this->size_m = (size_t)size;
+	return status::ok;
+}
+
+}
+// namespace ctle
+
+#include "_undef_macros.inl"
+
+#ifdef CTLE_IMPLEMENTATION
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define _CTLE_ID_FILTER_X86
+#include <immintrin.h>
+#endif
+
+// GCC and Clang need the target instruction set of functions which use intrinsics beyond the compiler flags, MSVC does not
+#if defined(__GNUC__)
+#define _CTLE_ID_FILTER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define _CTLE_ID_FILTER_TARGET(isa)
+#endif
+
+namespace ctle
+{
+
+// the bit selection salts of the split block bloom filter, one odd constant per lane
+alignas(32) static const u32 _blocked_bloom_filter_salt[8] = { 0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U };
+
+static void _bloom_block_insert_scalar( u32 *block, u32 key ) noexcept
+{
+	for( size_t lane = 0; lane < 8; ++lane )
+		block[lane] |= u32( 1 ) << ( ( key * _blocked_bloom_filter_salt[lane] ) >> 27 );
+}
+
+static bool _bloom_block_contains_scalar( const u32 *block, u32 key ) noexcept
+{
+	u32 missing = 0;
+	for( size_t lane = 0; lane < 8; ++lane )
+		missing |= ~block[lane] & ( u32( 1 ) << ( ( key * _blocked_bloom_filter_salt[lane] ) >> 27 ) );
+	return missing == 0;
+}
+
+#if defined(_CTLE_ID_FILTER_X86)
+
+// the bit of the key in each of the eight lanes
+_CTLE_ID_FILTER_TARGET("avx2") static inline __m256i _bloom_block_bits_avx2( u32 key ) noexcept
+{
+	const __m256i salt = _mm256_load_si256( (const __m256i *)_blocked_bloom_filter_salt );
+	return _mm256_sllv_epi32( _mm256_set1_epi32( 1 ), _mm256_srli_epi32( _mm256_mullo_epi32( _mm256_set1_epi32( (int)key ), salt ), 27 ) );
+}
+
+_CTLE_ID_FILTER_TARGET("avx2") static void _bloom_block_insert_avx2( u32 *block, u32 key ) noexcept
+{
+	_mm256_storeu_si256( (__m256i *)block, _mm256_or_si256( _mm256_loadu_si256( (const __m256i *)block ), _bloom_block_bits_avx2( key ) ) );
+}
+
+_CTLE_ID_FILTER_TARGET("avx2") static bool _bloom_block_contains_avx2( const u32 *block, u32 key ) noexcept
+{
+	return _mm256_testc_si256( _mm256_loadu_si256( (const __m256i *)block ), _bloom_block_bits_avx2( key ) ) != 0;
+}
+
+#endif
+
+typedef void ( *_bloom_block_insert_func )( u32 *block, u32 key );
+typedef bool ( *_bloom_block_contains_func )( const u32 *block, u32 key );
+
+static _bloom_block_insert_func _bloom_block_insert_select()
+{
+#if defined(_CTLE_ID_FILTER_X86)
+	if( _cpu_has_avx2() )
+		return &_bloom_block_insert_avx2;
+#endif
+	return &_bloom_block_insert_scalar;
+}
+
+static _bloom_block_contains_func _bloom_block_contains_select()
+{
+#if defined(_CTLE_ID_FILTER_X86)
+	if( _cpu_has_avx2() )
+		return &_bloom_block_contains_avx2;
+#endif
+	return &_bloom_block_contains_scalar;
+}
+
+void _bloom_block_insert( u32 *block, u32 key ) noexcept
+{
+	// the kernel is selected on first use
+	static const _bloom_block_insert_func kernel = _bloom_block_insert_select();
+	kernel( block, key );
+}
+
+bool _bloom_block_contains( const u32 *block, u32 key ) noexcept
+{
+	// the kernel is selected on first use
+	static const _bloom_block_contains_func kernel = _bloom_block_contains_select();
+	return kernel( block, key );
+}
+
+}
+//namespace ctle
+
+#undef _CTLE_ID_FILTER_TARGET
+
+#endif//CTLE_IMPLEMENTATION
+
+#endif//_CTLE_ID_FILTER_H_
@@ -14,6 +14,12 @@
 namespace ctle
 {
 
+// write an index into an index vector (the packed_index_vector overload is in packed_index_vector.h)
+template<class _IdxTy> inline void _write_index( _IdxTy &index, size_t pos, size_t value_index ) { index[pos] = typename _IdxTy::value_type( value_index ); }
+
+// repack an index vector into the narrowest index type, after the indices have been lowered (the packed_index_vector overload is in packed_index_vector.h)
+template<class _IdxTy> inline void _shrink_index_width( _IdxTy & ) {}
+
 /// @brief idx_vector: std::vector of values, with an std::vector as index into the values
 /// @details The idx_vector class template is a vector of values with an index vector into 
 /// the values.The index vector is used to index into the values vector, and all indices must 
@@ -119,6 +125,20 @@ public:
 		return true;
 	} 
 
+	/// @brief Remove the values which are not referenced by the index vector, and remap the indices.
+	/// @details Runs in linear time, and keeps the order of the remaining values. All indices must be valid, see is_valid().
+	void compact();
+
+	/// @brief Reorder the values in the order of their first use in the index vector, and remap the indices.
+	/// @details After the reorder, iterating the items reads the values vector mostly sequentially. Unreferenced values are
+	/// moved last, in their current order, call compact() to remove them. All indices must be valid, see is_valid().
+	void reorder_for_locality();
+
+private:
+	static constexpr const size_t npos = ~size_t( 0 );
+
+	// move the values to their new positions in the remap table (or drop the values which map to npos), and remap the indices
+	void remap_values( const std::vector<size_t> &_remap, size_t _value_count );
 };
 
 template <class _Ty, class _IdxTy, class _VecTy>
@@ -135,6 +155,65 @@ bool idx_vector<_Ty, _IdxTy, _VecTy>::operator!=( const idx_vector &_other ) con
 		|| ( this->index_m != _other.index_m );
 }
 
+template <class _Ty, class _IdxTy, class _VecTy>
+void idx_vector<_Ty, _IdxTy, _VecTy>::remap_values( const std::vector<size_t> &_remap, size_t _value_count )
+{
+	values_vector_type values;
+	values.resize( _value_count );
+	for( size_t inx = 0; inx < this->values_m.size(); ++inx )
+	{
+		if( _remap[inx] != npos )
+			values[_remap[inx]] = std::move( this->values_m[inx] );
+	}
+	this->values_m = std::move( values );
+
+	const size_t index_count = this->index_m.size();
+	for( size_t inx = 0; inx < index_count; ++inx )
+		_write_index( this->index_m, inx, _remap[size_t( this->index_m[inx] )] );
+	_shrink_index_width( this->index_m );
+}
+
+template <class _Ty, class _IdxTy, class _VecTy>
+void idx_vector<_Ty, _IdxTy, _VecTy>::compact()
+{
+	// mark the referenced values
+	std::vector<size_t> remap( this->values_m.size(), size_t( npos ) );
+	for( const size_t idx : this->index_m )
+		remap[idx] = 0;
+
+	// number the referenced values in order
+	size_t value_count = 0;
+	for( size_t &value_index : remap )
+	{
+		if( value_index != npos )
+			value_index = value_count++;
+	}
+	if( value_count == this->values_m.size() )
+		return;
+
+	this->remap_values( remap, value_count );
+}
+
+template <class _Ty, class _IdxTy, class _VecTy>
+void idx_vector<_Ty, _IdxTy, _VecTy>::reorder_for_locality()
+{
+	// number the values in the order of first use, followed by the unreferenced values
+	std::vector<size_t> remap( this->values_m.size(), size_t( npos ) );
+	size_t value_count = 0;
+	for( const size_t idx : this->index_m )
+	{
+		if( remap[idx] == npos )
+			remap[idx] = value_count++;
+	}
+	for( size_t &value_index : remap )
+	{
+		if( value_index == npos )
+			value_index = value_count++;
+	}
+
+	this->remap_values( remap, value_count );
+}
+
 }
 //namespace ctle
 
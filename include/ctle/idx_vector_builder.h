@@ -0,0 +1,386 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_IDX_VECTOR_BUILDER_H_
+#define _CTLE_IDX_VECTOR_BUILDER_H_
+
+/// @file idx_vector_builder.h
+/// @brief Contains the idx_vector_builder class template, which builds an idx_vector from a stream of values, deduplicating the values using a hash table.
+
+#include <vector>
+#include <limits>
+#include <type_traits>
+#include <algorithm>
+
+#include "fwd.h"
+#include "status.h"
+#include "idx_vector.h"
+#include "value_equality.h"
+#include "packed_index_vector.h"
+#include "_parallel.h"
+
+namespace ctle
+{
+
+// prepare an index vector for writes of indices below value_count from multiple threads.
+// a packed_index_vector is widened up front, so the concurrent writes never repack it.
+template<class _IdxTy> inline void _prepare_parallel_index_writes( _IdxTy &, size_t ) {}
+inline void _prepare_parallel_index_writes( packed_index_vector &index, size_t value_count ) { index.reserve_value_range( value_count ); }
+
+/// @brief idx_vector_builder: builds an idx_vector from a stream of values, deduplicating the values.
+/// @details Each inserted value is looked up in an open-addressing hash table of the unique values. If the value is new, it is
+/// added to the values vector, and its index is appended to the index vector, else the index of the existing value is appended.
+/// The values are stored in the order of their first insertion. For large inputs, insert_parallel() deduplicates the values in
+/// parallel shards, with the same result as inserting them one by one.
+/// @tparam _Ty The value type.
+/// @tparam _IdxTy The index vector type of the idx_vector.
+/// @tparam _VecTy The values vector type of the idx_vector.
+/// @tparam _EqualityTy The equality policy, with hash(value) and equal(a,b) methods, e.g. bitwise_equality or quantized_equality.
+template <
+	class _Ty,
+	class _IdxTy /* = std::vector<i32>*/,
+	class _VecTy /* = std::vector<_Ty>*/,
+	class _EqualityTy /* = bitwise_equality<_Ty>*/
+> class idx_vector_builder
+{
+public:
+	using value_type = _Ty;
+	using idx_vector_type = idx_vector<_Ty, _IdxTy, _VecTy>;
+	using index_value_type = typename _IdxTy::value_type;
+	using equality_type = _EqualityTy;
+
+	/// @brief The max number of unique values, limited by the index value type
+	static constexpr const size_t max_value_count = ( u64( std::numeric_limits<index_value_type>::max() ) < u64( 0xfffffffe ) ) ? size_t( std::numeric_limits<index_value_type>::max() ) : size_t( 0xfffffffe );
+
+	explicit idx_vector_builder( const equality_type &equality = equality_type() ) : equality_m( equality ) {}
+
+	/// @brief Reserve memory for a number of indices and unique values
+	void reserve( size_t index_count, size_t value_count );
+
+	/// @brief Insert a value, and append its index to the index vector
+	/// @return status::ok, or status::invalid if the value is new and there are already max_value_count unique values
+	status insert( const _Ty &value );
+
+	/// @brief Insert an array of values, one by one
+	/// @return status::ok, or status::invalid if there are more than max_value_count unique values
+	status insert( const _Ty *values, size_t count );
+
+	/// @brief Insert an array of values, deduplicating them in parallel.
+	/// @details The values are hashed, and split by hash into shards, which are deduplicated in parallel. The result is the same as
+	/// inserting the values one by one. Small arrays are inserted on the calling thread.
+	/// @param values the values
+	/// @param count the number of values
+	/// @param thread_count the number of threads to use, 0 uses the hardware concurrency
+	/// @return status::ok, or status::invalid if there are more than max_value_count unique values
+	status insert_parallel( const _Ty *values, size_t count, size_t thread_count = 0 );
+
+	/// @brief Get the number of inserted values (the size of the index vector)
+	size_t size() const noexcept { return this->vector_m.index().size(); }
+
+	/// @brief Get the number of unique values
+	size_t unique_count() const noexcept { return this->vector_m.values().size(); }
+
+	/// @brief Get the idx_vector which is being built
+	const idx_vector_type &vector() const noexcept { return this->vector_m; }
+
+	/// @brief Move out the built idx_vector, and clear the builder
+	idx_vector_type finish();
+
+	/// @brief Clear the builder
+	void clear();
+
+private:
+	static constexpr const size_t npos = ~size_t( 0 );
+
+	// inputs smaller than this are inserted on the calling thread by insert_parallel
+	static constexpr const size_t parallel_min_count = 16 * 1024;
+
+	idx_vector_type vector_m;
+	equality_type equality_m;
+
+	// open-addressing hash table of value index + 1, where 0 is an empty slot. the table is at most half full
+	std::vector<u32> slots_m;
+
+	// the hash of each unique value
+	std::vector<u64> hashes_m;
+
+	size_t find( const _Ty &value, u64 hash ) const noexcept;
+	void insert_slot( size_t value_index, u64 hash ) noexcept;
+	void reserve_slots( size_t value_count );
+};
+
+}
+//namespace ctle
+
+#include "log.h"
+#include "_macros.inl"
+
+namespace ctle
+{
+
+template<class _Ty, class _IdxTy, class _VecTy, class _EqualityTy>
+inline size_t idx_vector_builder<_Ty, _IdxTy, _VecTy, _EqualityTy>::find( const _Ty &value, u64 hash ) const noexcept
+{
+	if( this->slots_m.empty() )
+		return npos;
+
+	const size_t mask = this->slots_m.size() - 1;
+	for( size_t pos = size_t( hash ) & mask; this->slots_m[pos] != 0; pos = ( pos + 1 ) & mask )
+	{
+		const size_t value_index = this->slots_m[pos] - 1;
+		if( this->hashes_m[value_index] == hash && this->equality_m.equal( this->vector_m.values()[value_index], value ) )
+			return value_index;
+	}
+	return npos;
+}
+
+template<class _Ty, class _IdxTy, class _VecTy, class _EqualityTy>
+inline void idx_vector_builder<_Ty, _IdxTy, _VecTy, _EqualityTy>::insert_slot( size_t value_index, u64 hash ) noexcept
+{
+	const size_t mask = this->slots_m.size() - 1;
+	size_t pos = size_t( hash ) & mask;
+	while( this->slots_m[pos] != 0 )
+		pos = ( pos + 1 ) & mask;
+	this->slots_m[pos] = u32( value_index + 1 );
+}
+
+template<class _Ty, class _IdxTy, class _VecTy, class _EqualityTy>
+inline void idx_vector_builder<_Ty, _IdxTy, _VecTy, _EqualityTy>::reserve_slots( size_t value_count )
+{
+	// keep the table at most half full
+	size_t slot_count = 16;
+	while( slot_count < value_count * 2 )
+		slot_count *= 2;
+	if( slot_count <= this->slots_m.size() )
+		return;
+
+	// rehash using the stored hashes
+	this->slots_m.assign( slot_count, 0 );
+	for( size_t value_index = 0; value_index < this->hashes_m.size(); ++value_index )
+		this->insert_slot( value_index, this->hashes_m[value_index] );
+}
+
+template<class _Ty, class _IdxTy, class _VecTy, class _EqualityTy>
+inline void idx_vector_builder<_Ty, _IdxTy, _VecTy, _EqualityTy>::reserve( size_t index_count, size_t value_count )
+{
+	this->vector_m.index().reserve( index_count );
+	this->vector_m.values().reserve( value_count );
+	this->hashes_m.reserve( value_count );
+	this->reserve_slots( value_count );
+}
+
+template<class _Ty, class _IdxTy, class _VecTy, class _EqualityTy>
+inline status idx_vector_builder<_Ty, _IdxTy, _VecTy, _EqualityTy>::insert( const _Ty &value )
+{
+	const u64 hash = this->equality_m.hash( value );
+	size_t value_index = this->find( value, hash );
+	if( value_index == npos )
+	{
+		value_index = this->vector_m.values().size();
+		ctValidate( value_index < max_value_count, status::invalid ) << "The idx_vector can not hold more than " << max_value_count << " unique values" << ctValidateEnd;
+		this->vector_m.values().push_back( value );
+		this->hashes_m.push_back( hash );
+		this->reserve_slots( this->hashes_m.size() );
+		this->insert_slot( value_index, hash );
+	}
+	this->vector_m.index().push_back( index_value_type( value_index ) );
+	return status::ok;
+}
+
+template<class _Ty, class _IdxTy, class _VecTy, class _EqualityTy>
+inline status idx_vector_builder<_Ty, _IdxTy, _VecTy, _EqualityTy>::insert( const _Ty *values, size_t count )
+{
+	_IdxTy &index = this->vector_m.index();
+	if( index.size() + count > index.capacity() )
+		index.reserve( std::max( index.size() + count, index.capacity() * 2 ) );
+	for( size_t inx = 0; inx < count; ++inx )
+	{
+		ctStatusCall( this->insert( values[inx] ) );
+	}
+	return status::ok;
+}
+
+template<class _Ty, class _IdxTy, class _VecTy, class _EqualityTy>
+inline status idx_vector_builder<_Ty, _IdxTy, _VecTy, _EqualityTy>::insert_parallel( const _Ty *values, size_t count, size_t thread_count )
+{
+	thread_count = _resolve_thread_count( thread_count );
+	if( thread_count == 1 || count < parallel_min_count )
+		return this->insert( values, count );
+	ctValidate( count <= size_t( 0xfffffffe ), status::invalid_param ) << "Too many values in a single insert_parallel call" << ctValidateEnd;
+
+	// split the input into chunks, and the hash space into shards, a few per thread for load balancing
+	const size_t chunk_count = thread_count * 4;
+	const size_t chunk_size = ( count + chunk_count - 1 ) / chunk_count;
+	size_t shard_bits = 1;
+	while( ( size_t( 1 ) << shard_bits ) < thread_count * 4 )
+		++shard_bits;
+	const size_t shard_count = size_t( 1 ) << shard_bits;
+	auto chunk_range = [&]( size_t chunk, size_t &start, size_t &end )
+	{
+		start = std::min( chunk * chunk_size, count );
+		end = std::min( start + chunk_size, count );
+	};
+
+	// hash all values, and count the values of each shard in each chunk
+	std::vector<u64> hashes( count );
+	std::vector<size_t> shard_offsets( chunk_count * shard_count, 0 );
+	_parallel_for( chunk_count, thread_count, [&]( size_t chunk )
+		{
+			size_t start, end;
+			chunk_range( chunk, start, end );
+			size_t *shard_counts = &shard_offsets[chunk * shard_count];
+			for( size_t inx = start; inx < end; ++inx )
+			{
+				hashes[inx] = this->equality_m.hash( values[inx] );
+				++shard_counts[hashes[inx] >> ( 64 - shard_bits )];
+			}
+		} );
+
+	// lay out the value positions of each shard contiguously, in input order
+	std::vector<size_t> shard_starts( shard_count + 1, 0 );
+	size_t offset = 0;
+	for( size_t shard = 0; shard < shard_count; ++shard )
+	{
+		shard_starts[shard] = offset;
+		for( size_t chunk = 0; chunk < chunk_count; ++chunk )
+		{
+			const size_t shard_chunk_count = shard_offsets[chunk * shard_count + shard];
+			shard_offsets[chunk * shard_count + shard] = offset;
+			offset += shard_chunk_count;
+		}
+	}
+	shard_starts[shard_count] = offset;
+	std::vector<u32> positions( count );
+	_parallel_for( chunk_count, thread_count, [&]( size_t chunk )
+		{
+			size_t start, end;
+			chunk_range( chunk, start, end );
+			size_t *shard_positions = &shard_offsets[chunk * shard_count];
+			for( size_t inx = start; inx < end; ++inx )
+				positions[shard_positions[hashes[inx] >> ( 64 - shard_bits )]++] = u32( inx );
+		} );
+
+	// deduplicate each shard. for each value, store the index of an equal value which is already in the builder (flagged with
+	// existing_flag), or else the position of the first equal value in the input
+	const u64 existing_flag = u64( 1 ) << 63;
+	std::vector<u64> firsts( count );
+	_parallel_for( shard_count, thread_count, [&]( size_t shard )
+		{
+			const size_t shard_size = shard_starts[shard + 1] - shard_starts[shard];
+			size_t slot_count = 16;
+			while( slot_count < shard_size * 2 )
+				slot_count *= 2;
+			std::vector<u32> slots( slot_count, 0 );
+			const size_t mask = slot_count - 1;
+
+			for( size_t item = shard_starts[shard]; item < shard_starts[shard + 1]; ++item )
+			{
+				const size_t inx = positions[item];
+				const u64 hash = hashes[inx];
+				const size_t existing_index = this->find( values[inx], hash );
+				if( existing_index != npos )
+				{
+					firsts[inx] = u64( existing_index ) | existing_flag;
+					continue;
+				}
+
+				size_t pos = size_t( hash ) & mask;
+				for( ; slots[pos] != 0; pos = ( pos + 1 ) & mask )
+				{
+					const size_t first = slots[pos] - 1;
+					if( hashes[first] == hash && this->equality_m.equal( values[first], values[inx] ) )
+						break;
+				}
+				if( slots[pos] == 0 )
+					slots[pos] = u32( inx + 1 );
+				firsts[inx] = slots[pos] - 1;
+			}
+		} );
+
+	// count the new unique values of each chunk, and assign their value indices in input order
+	std::vector<size_t> chunk_bases( chunk_count + 1, 0 );
+	_parallel_for( chunk_count, thread_count, [&]( size_t chunk )
+		{
+			size_t start, end;
+			chunk_range( chunk, start, end );
+			size_t new_count = 0;
+			for( size_t inx = start; inx < end; ++inx )
+				new_count += ( firsts[inx] == inx ) ? 1 : 0;
+			chunk_bases[chunk + 1] = new_count;
+		} );
+	chunk_bases[0] = this->vector_m.values().size();
+	for( size_t chunk = 0; chunk < chunk_count; ++chunk )
+		chunk_bases[chunk + 1] += chunk_bases[chunk];
+	const size_t value_count = chunk_bases[chunk_count];
+	ctValidate( value_count <= max_value_count, status::invalid ) << "The idx_vector can not hold more than " << max_value_count << " unique values" << ctValidateEnd;
+
+	const size_t index_start = this->vector_m.index().size();
+	this->vector_m.values().resize( value_count );
+	_prepare_parallel_index_writes( this->vector_m.index(), value_count );
+	this->vector_m.index().resize( index_start + count );
+	this->hashes_m.resize( value_count );
+	std::vector<u32> value_indices( count );
+	_parallel_for( chunk_count, thread_count, [&]( size_t chunk )
+		{
+			size_t start, end;
+			chunk_range( chunk, start, end );
+			size_t value_index = chunk_bases[chunk];
+			for( size_t inx = start; inx < end; ++inx )
+			{
+				if( firsts[inx] == inx )
+				{
+					this->vector_m.values()[value_index] = values[inx];
+					this->hashes_m[value_index] = hashes[inx];
+					value_indices[inx] = u32( value_index );
+					++value_index;
+				}
+			}
+		} );
+
+	// all first positions have value indices, write the index
+	_parallel_for( chunk_count, thread_count, [&]( size_t chunk )
+		{
+			size_t start, end;
+			chunk_range( chunk, start, end );
+			for( size_t inx = start; inx < end; ++inx )
+			{
+				const u64 first = firsts[inx];
+				const size_t value_index = ( first & existing_flag ) ? size_t( first & ~existing_flag ) : size_t( value_indices[first] );
+				_write_index( this->vector_m.index(), index_start + inx, value_index );
+			}
+		} );
+
+	// add the new values to the hash table
+	const size_t old_value_count = chunk_bases[0];
+	const size_t old_slot_count = this->slots_m.size();
+	this->reserve_slots( value_count );
+	if( this->slots_m.size() == old_slot_count )
+	{
+		for( size_t value_index = old_value_count; value_index < value_count; ++value_index )
+			this->insert_slot( value_index, this->hashes_m[value_index] );
+	}
+	return status::ok;
+}
+
+template<class _Ty, class _IdxTy, class _VecTy, class _EqualityTy>
+inline typename idx_vector_builder<_Ty, _IdxTy, _VecTy, _EqualityTy>::idx_vector_type idx_vector_builder<_Ty, _IdxTy, _VecTy, _EqualityTy>::finish()
+{
+	idx_vector_type ret( std::move( this->vector_m ) );
+	this->clear();
+	return ret;
+}
+
+template<class _Ty, class _IdxTy, class _VecTy, class _EqualityTy>
+inline void idx_vector_builder<_Ty, _IdxTy, _VecTy, _EqualityTy>::clear()
+{
+	this->vector_m.clear();
+	this->slots_m.clear();
+	this->hashes_m.clear();
+}
+
+}
+//namespace ctle
+
+#include "_undef_macros.inl"
+
+#endif//_CTLE_IDX_VECTOR_BUILDER_H_
@@ -24,6 +24,7 @@
 #include "string_funcs.h"
 #include "status.h"
 #include "status_return.h"
+#include "endianness.h"
 
 namespace ctle
 {
@@ -599,6 +600,14 @@ public:
 #endif//GLM_VERSION
 };
 
+// Byte swapping n-tuples and mn-tuples swaps each of their values.
+template<class _Ty, size_t _Size> struct byte_swap_value_size<n_tup<_Ty,_Size>> : byte_swap_value_size<_Ty> {};
+template<class _Ty, size_t _InnerSize, size_t _OuterSize> struct byte_swap_value_size<mn_tup<_Ty,_InnerSize,_OuterSize>> : byte_swap_value_size<_Ty> {};
+
+// n-tuples and mn-tuples of bulk serializable values are serialized as raw contiguous blocks (see serialization.h).
+template<class _Ty, size_t _Size> struct is_bulk_serializable<n_tup<_Ty,_Size>> : is_bulk_serializable<_Ty> {};
+template<class _Ty, size_t _InnerSize, size_t _OuterSize> struct is_bulk_serializable<mn_tup<_Ty,_InnerSize,_OuterSize>> : is_bulk_serializable<_Ty> {};
+
 #ifdef CTLE_IMPLEMENTATION
 
 // Print types to strings.
@@ -0,0 +1,394 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_NULLABLE_VECTOR_H_
+#define _CTLE_NULLABLE_VECTOR_H_
+
+/// @file nullable_vector.h
+/// @brief Contains the nullable_vector class template, a vector where each element is optional, with the validity of the elements stored in a separate bitmap.
+
+#include <vector>
+#include <stdexcept>
+
+#include "fwd.h"
+#include "optional_value.h"
+#include "_cpu_features.h"
+
+#if defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_ARM64) )
+#include <intrin.h>
+#endif
+
+namespace ctle
+{
+
+// count the set bits of a 64 bit value
+inline size_t _popcount64( u64 value ) noexcept
+{
+	value = value - ( ( value >> 1 ) & 0x5555555555555555ull );
+	value = ( value & 0x3333333333333333ull ) + ( ( value >> 2 ) & 0x3333333333333333ull );
+	value = ( value + ( value >> 4 ) ) & 0x0f0f0f0f0f0f0f0full;
+	return size_t( ( value * 0x0101010101010101ull ) >> 56 );
+}
+
+// get the index of the lowest set bit of a non-zero 64 bit value
+inline size_t _count_trailing_zeros64( u64 value ) noexcept
+{
+#if defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_ARM64) )
+	unsigned long index;
+	_BitScanForward64( &index, value );
+	return size_t( index );
+#elif defined(__GNUC__)
+	return size_t( __builtin_ctzll( value ) );
+#else
+	size_t index = 0;
+	while( !( value & 1 ) )
+	{
+		value >>= 1;
+		++index;
+	}
+	return index;
+#endif
+}
+
+// Bulk count of the set bits in an array of 64 bit words, using AVX-512 VPOPCNTDQ or POPCNT. The instruction set is selected at runtime, from the capabilities of the cpu.
+size_t _popcount_bulk( const u64 *words, size_t word_count ) noexcept;
+
+// count the set bits in a bitmap. short bitmaps are counted inline, longer bitmaps use the bulk kernels
+inline size_t _bitmap_popcount( const u64 *words, size_t word_count ) noexcept
+{
+	if( word_count >= 16 )
+		return _popcount_bulk( words, word_count );
+	size_t count = 0;
+	for( size_t inx = 0; inx < word_count; ++inx )
+		count += _popcount64( words[inx] );
+	return count;
+}
+
+/// @brief nullable_vector: a vector of optional values, with a validity bitmap
+/// @details Each element is either valid (has a value) or null. The values are stored in a std::vector, and the validity
+/// in a separate bitmap, with one bit per element (the layout of Apache Arrow), so there is no per-element overhead
+/// as with a std::vector<optional_value<_Ty>>. The storage of null elements holds a value as well, which is not used.
+/// Counting the valid elements uses hardware popcount (AVX-512 or POPCNT, selected at runtime), and iterating the valid
+/// elements skips 64 elements per empty bitmap word.
+/// @tparam _Ty The value type.
+/// @tparam _Alloc The allocator of the values vector, defaults to std::allocator<_Ty>.
+template <
+	class _Ty,
+	class _Alloc /* = std::allocator<_Ty>*/
+> class nullable_vector
+{
+public:
+	using value_type = _Ty;
+	using allocator_type = _Alloc;
+	using values_vector_type = std::vector<_Ty, _Alloc>;
+	using reference = typename values_vector_type::reference;
+	using const_reference = typename values_vector_type::const_reference;
+	using size_type = typename values_vector_type::size_type;
+
+	nullable_vector() = default;
+
+	/// @brief Create a vector of _count null elements
+	explicit nullable_vector( size_type _count ) { this->resize( _count ); }
+
+	bool operator==( const nullable_vector &_other ) const;
+	bool operator!=( const nullable_vector &_other ) const { return !this->operator==( _other ); }
+
+	/// @brief Get the number of elements, valid and null
+	size_type size() const noexcept { return this->values_m.size(); }
+
+	/// @brief Check if the vector has no elements
+	bool empty() const noexcept { return this->values_m.empty(); }
+
+	/// @brief Remove all elements
+	void clear() noexcept { this->values_m.clear(); this->validity_m.clear(); }
+
+	/// @brief Reserve memory for _count elements
+	void reserve( size_type _count ) { this->values_m.reserve( _count ); this->validity_m.reserve( _word_count( _count ) ); }
+
+	/// @brief Resize the vector. New elements are null.
+	void resize( size_type _count );
+
+	/// @brief Append a valid element
+	void push_back( const _Ty &_value ) { this->values_m.push_back( _value ); this->push_back_validity( true ); }
+	/// @copydoc push_back(const _Ty &)
+	void push_back( _Ty &&_value ) { this->values_m.push_back( std::move( _value ) ); this->push_back_validity( true ); }
+
+	/// @brief Append a null element
+	void push_back_null() { this->values_m.emplace_back(); this->push_back_validity( false ); }
+
+	/// @brief Check if the element at a position is valid. The position is not bounds checked.
+	bool has_value( size_type _pos ) const noexcept { return ( this->validity_m[_pos >> 6] >> ( _pos & 63 ) ) & 1; }
+
+	/// @brief Get the storage of the element at a position, regardless of if it is valid. The position is not bounds checked.
+	reference operator[]( size_type _pos ) { return this->values_m[_pos]; }
+	/// @copydoc operator[](size_type)
+	const_reference operator[]( size_type _pos ) const { return this->values_m[_pos]; }
+
+	/// @brief Get the value of a valid element
+	/// @throws std::out_of_range if the position is out of bounds
+	/// @throws ctle::bad_optional_value_access if the element is null
+	reference value( size_type _pos ) { this->check_value( _pos ); return this->values_m[_pos]; }
+	/// @copydoc value(size_type)
+	const_reference value( size_type _pos ) const { this->check_value( _pos ); return this->values_m[_pos]; }
+
+	/// @brief Set the value of an element, and mark it as valid. The position is not bounds checked.
+	void set( size_type _pos, const _Ty &_value ) { this->values_m[_pos] = _value; this->validity_m[_pos >> 6] |= ( u64( 1 ) << ( _pos & 63 ) ); }
+
+	/// @brief Mark an element as null. The value in the storage is not changed. The position is not bounds checked.
+	void reset( size_type _pos ) noexcept { this->validity_m[_pos >> 6] &= ~( u64( 1 ) << ( _pos & 63 ) ); }
+
+	/// @brief Mark all elements in [_begin,_end) as valid, a whole bitmap word at a time
+	/// @throws std::out_of_range if the range is not within the vector
+	void set_valid_range( size_type _begin, size_type _end ) { this->fill_validity( _begin, _end, true ); }
+
+	/// @brief Mark all elements in [_begin,_end) as null, a whole bitmap word at a time
+	/// @throws std::out_of_range if the range is not within the vector
+	void reset_range( size_type _begin, size_type _end ) { this->fill_validity( _begin, _end, false ); }
+
+	/// @brief Get the number of valid elements
+	size_type valid_count() const noexcept { return _bitmap_popcount( this->validity_m.data(), this->validity_m.size() ); }
+
+	/// @brief Get the number of null elements
+	size_type null_count() const noexcept { return this->size() - this->valid_count(); }
+
+	/// @brief Get the position of the first valid element at or after _pos, or size() if there is none
+	size_type find_next_valid( size_type _pos ) const noexcept;
+
+	/// @brief Call func( size_type pos, const _Ty &value ) for each valid element, in order
+	template<class _Func> void for_each_valid( _Func &&func ) const;
+
+	/// @brief Get the values vector, including the storage of the null elements
+	const values_vector_type &values() const noexcept { return this->values_m; }
+
+	/// @brief Get the validity bitmap, where bit (pos % 64) of word (pos / 64) is set if the element at pos is valid. Bits past size() are 0.
+	const std::vector<u64> &validity() const noexcept { return this->validity_m; }
+
+	/// @brief Replace the contents with a values vector and a validity bitmap
+	/// @return false if the bitmap does not have (size + 63) / 64 words, or has bits set past the size, in which case the vector is not changed
+	bool assign( values_vector_type _values, std::vector<u64> _validity );
+
+private:
+	values_vector_type values_m;
+	std::vector<u64> validity_m;
+
+	static size_t _word_count( size_t count ) noexcept { return ( count + 63 ) / 64; }
+
+	void push_back_validity( bool _valid );
+	void fill_validity( size_type _begin, size_type _end, bool _valid );
+	void check_value( size_type _pos ) const;
+};
+
+template <class _Ty, class _Alloc>
+inline bool nullable_vector<_Ty, _Alloc>::operator==( const nullable_vector &_other ) const
+{
+	if( this->values_m.size() != _other.values_m.size() || this->validity_m != _other.validity_m )
+		return false;
+
+	// only the valid values are compared
+	for( size_t word = 0; word < this->validity_m.size(); ++word )
+	{
+		for( u64 bits = this->validity_m[word]; bits != 0; bits &= bits - 1 )
+		{
+			const size_t pos = word * 64 + _count_trailing_zeros64( bits );
+			if( !( this->values_m[pos] == _other.values_m[pos] ) )
+				return false;
+		}
+	}
+	return true;
+}
+
+template <class _Ty, class _Alloc>
+inline void nullable_vector<_Ty, _Alloc>::resize( size_type _count )
+{
+	const size_type old_count = this->values_m.size();
+	this->values_m.resize( _count );
+	this->validity_m.resize( _word_count( _count ), 0 );
+
+	// clear the bits past the new size, so that the bits of new elements are 0
+	if( _count < old_count && ( _count & 63 ) != 0 )
+		this->validity_m.back() &= ( u64( 1 ) << ( _count & 63 ) ) - 1;
+}
+
+template <class _Ty, class _Alloc>
+inline void nullable_vector<_Ty, _Alloc>::push_back_validity( bool _valid )
+{
+	const size_t pos = this->values_m.size() - 1;
+	if( ( pos & 63 ) == 0 )
+		this->validity_m.push_back( 0 );
+	if( _valid )
+		this->validity_m.back() |= ( u64( 1 ) << ( pos & 63 ) );
+}
+
+template <class _Ty, class _Alloc>
+inline void nullable_vector<_Ty, _Alloc>::fill_validity( size_type _begin, size_type _end, bool _valid )
+{
+	if( _begin > _end || _end > this->values_m.size() )
+	{
+		throw std::out_of_range( "nullable_vector range is out of bounds" );
+	}
+	if( _begin == _end )
+		return;
+
+	const size_t first_word = _begin >> 6;
+	const size_t last_word = ( _end - 1 ) >> 6;
+	const u64 first_mask = ~u64( 0 ) << ( _begin & 63 );
+	const u64 last_mask = ~u64( 0 ) >> ( 63 - ( ( _end - 1 ) & 63 ) );
+	for( size_t word = first_word; word <= last_word; ++word )
+	{
+		u64 mask = ~u64( 0 );
+		if( word == first_word )
+			mask &= first_mask;
+		if( word == last_word )
+			mask &= last_mask;
+		if( _valid )
+			this->validity_m[word] |= mask;
+		else
+			this->validity_m[word] &= ~mask;
+	}
+}
+
+template <class _Ty, class _Alloc>
+inline void nullable_vector<_Ty, _Alloc>::check_value( size_type _pos ) const
+{
+	if( _pos >= this->values_m.size() )
+	{
+		throw std::out_of_range( "nullable_vector position out of range" );
+	}
+	if( !this->has_value( _pos ) )
+	{
+		throw ctle::bad_optional_value_access( "nullable_vector element is null" );
+	}
+}
+
+template <class _Ty, class _Alloc>
+inline typename nullable_vector<_Ty, _Alloc>::size_type nullable_vector<_Ty, _Alloc>::find_next_valid( size_type _pos ) const noexcept
+{
+	if( _pos >= this->values_m.size() )
+		return this->values_m.size();
+
+	size_t word = _pos >> 6;
+	u64 bits = this->validity_m[word] & ( ~u64( 0 ) << ( _pos & 63 ) );
+	while( bits == 0 )
+	{
+		if( ++word >= this->validity_m.size() )
+			return this->values_m.size();
+		bits = this->validity_m[word];
+	}
+	return word * 64 + _count_trailing_zeros64( bits );
+}
+
+template <class _Ty, class _Alloc>
+template <class _Func>
+inline void nullable_vector<_Ty, _Alloc>::for_each_valid( _Func &&func ) const
+{
+	for( size_t word = 0; word < this->validity_m.size(); ++word )
+	{
+		for( u64 bits = this->validity_m[word]; bits != 0; bits &= bits - 1 )
+		{
+			const size_t pos = word * 64 + _count_trailing_zeros64( bits );
+			func( pos, this->values_m[pos] );
+		}
+	}
+}
+
+template <class _Ty, class _Alloc>
+inline bool nullable_vector<_Ty, _Alloc>::assign( values_vector_type _values, std::vector<u64> _validity )
+{
+	if( _validity.size() != _word_count( _values.size() ) )
+		return false;
+	if( ( _values.size() & 63 ) != 0 && ( _validity.back() >> ( _values.size() & 63 ) ) != 0 )
+		return false;
+	this->values_m = std::move( _values );
+	this->validity_m = std::move( _validity );
+	return true;
+}
+
+}
+//namespace ctle
+
+#ifdef CTLE_IMPLEMENTATION
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define _CTLE_NULLABLE_VECTOR_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <nmmintrin.h>
+#endif
+#endif
+
+// GCC and Clang need the target instruction set of functions which use intrinsics beyond the compiler flags, MSVC does not
+#if defined(__GNUC__)
+#define _CTLE_NULLABLE_VECTOR_TARGET(isa) __attribute__((target(isa)))
+#else
+#define _CTLE_NULLABLE_VECTOR_TARGET(isa)
+#endif
+
+namespace ctle
+{
+
+static size_t _popcount_bulk_scalar( const u64 *words, size_t word_count ) noexcept
+{
+	size_t count = 0;
+	for( size_t inx = 0; inx < word_count; ++inx )
+		count += _popcount64( words[inx] );
+	return count;
+}
+
+#if defined(_CTLE_NULLABLE_VECTOR_X86)
+
+_CTLE_NULLABLE_VECTOR_TARGET("popcnt") static size_t _popcount_bulk_popcnt( const u64 *words, size_t word_count ) noexcept
+{
+	// four independent sums, to hide the latency of the popcnt instruction
+	u64 counts[4] = {};
+	size_t inx = 0;
+	for( ; inx + 4 <= word_count; inx += 4 )
+	{
+		counts[0] += u64( _mm_popcnt_u64( words[inx] ) );
+		counts[1] += u64( _mm_popcnt_u64( words[inx + 1] ) );
+		counts[2] += u64( _mm_popcnt_u64( words[inx + 2] ) );
+		counts[3] += u64( _mm_popcnt_u64( words[inx + 3] ) );
+	}
+	for( ; inx < word_count; ++inx )
+		counts[0] += u64( _mm_popcnt_u64( words[inx] ) );
+	return size_t( counts[0] + counts[1] + counts[2] + counts[3] );
+}
+
+_CTLE_NULLABLE_VECTOR_TARGET("avx512f,avx512vpopcntdq") static size_t _popcount_bulk_avx512( const u64 *words, size_t word_count ) noexcept
+{
+	__m512i sum = _mm512_setzero_si512();
+	size_t inx = 0;
+	for( ; inx + 8 <= word_count; inx += 8 )
+		sum = _mm512_add_epi64( sum, _mm512_popcnt_epi64( _mm512_loadu_si512( (const void *)&words[inx] ) ) );
+	return size_t( _mm512_reduce_add_epi64( sum ) ) + _popcount_bulk_scalar( &words[inx], word_count - inx );
+}
+
+#endif
+
+typedef size_t ( *_popcount_bulk_func )( const u64 *words, size_t word_count );
+
+static _popcount_bulk_func _popcount_bulk_select()
+{
+#if defined(_CTLE_NULLABLE_VECTOR_X86)
+	if( _cpu_has_avx512vpopcntdq() )
+		return &_popcount_bulk_avx512;
+	if( _cpu_has_popcnt() )
+		return &_popcount_bulk_popcnt;
+#endif
+	return &_popcount_bulk_scalar;
+}
+
+size_t _popcount_bulk( const u64 *words, size_t word_count ) noexcept
+{
+	// the kernel is selected on first use
+	static const _popcount_bulk_func kernel = _popcount_bulk_select();
+	return kernel( words, word_count );
+}
+
+}
+//namespace ctle
+
+#undef _CTLE_NULLABLE_VECTOR_TARGET
+
+#endif//CTLE_IMPLEMENTATION
+
+#endif//_CTLE_NULLABLE_VECTOR_H_
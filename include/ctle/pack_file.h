@@ -0,0 +1,354 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_PACK_FILE_H_
+#define _CTLE_PACK_FILE_H_
+
+/// @file pack_file.h
+/// @brief Pack files, which store many blobs in one file, with a sorted index of the blobs at the end of the file.
+/// @details The pack file layout is: a header, the blobs (each aligned to pack_file_alignment bytes), the index of
+/// pack_file_entry records sorted by key, and a trailer which locates the index. The reader memory maps the pack, and
+/// looks up blobs with a binary search in the index, returning views directly into the mapped file.
+
+#include <string>
+#include <vector>
+
+#include "fwd.h"
+#include "status.h"
+#include "status_return.h"
+#include "status_error.h"
+#include "file_funcs.h"
+#include "data_destination.h"
+#include "write_stream.h"
+#include "flat_id_map.h"
+#include "sorted_id_index.h"
+
+namespace ctle
+{
+
+/// @brief The alignment of the blobs and the index in a pack file.
+constexpr const u64 pack_file_alignment = 16;
+
+/// @brief The magic value of the pack file header and trailer ("CTLEPACK")
+constexpr const u64 pack_file_magic = 0x4b434150454c5443ull;
+
+/// @brief The version of the pack file format.
+constexpr const u32 pack_file_version = 1;
+
+/// @brief An index entry of a pack file.
+template<class _KeyTy, class _HashValTy>
+struct pack_file_entry
+{
+	_KeyTy key;			// the key of the blob
+	u64 offset;			// the offset of the blob from the start of the file
+	u64 size;			// the size of the blob in bytes
+	_HashValTy hash;	// the hash of the blob contents
+};
+
+/// @brief A read-only view of a blob in a memory mapped pack file.
+struct pack_file_view
+{
+	const u8 *data = nullptr;
+	u64 size = 0;
+};
+
+/// @brief Writes blobs to a pack file.
+/// @details Blobs are appended to the file through a write_stream as they are added, and the sorted index and trailer are
+/// written by finish(). The file is not a valid pack file until finish() has been called.
+/// @tparam _KeyTy The key type of the blobs, uuid or digest<_Size>.
+/// @tparam _HashTy The hasher used for the per-blob hash, which the reader can use to verify the blobs.
+template<class _KeyTy, class _HashTy /* = hasher_xxh128 */>
+class pack_file_writer
+{
+public:
+	using key_type = _KeyTy;
+	using hasher_type = _HashTy;
+	using hash_type = typename _HashTy::hash_type;
+	using entry_type = pack_file_entry<_KeyTy, hash_type>;
+
+	/// @brief Create a pack file, and write the header.
+	/// @throws ctle::status_error if the file can't be created
+	explicit pack_file_writer( const std::string &filepath, bool overwrite_existing = true );
+
+	/// @brief Append a blob to the pack.
+	/// @return status::ok, status::already_exists if the key is already in the pack, or an error status if the write failed.
+	status add( const _KeyTy &key, const void *data, size_t size );
+	status add( const _KeyTy &key, const std::vector<u8> &data ) { return this->add( key, data.data(), data.size() ); } ///< @copydoc add(const _KeyTy&,const void*,size_t)
+
+	/// @brief Write the sorted index and the trailer, and end the stream.
+	status finish();
+
+	/// @brief Get the number of blobs added to the pack.
+	size_t size() const { return this->keys_m.size(); }
+
+private:
+	struct entry_data
+	{
+		u64 offset;
+		u64 size;
+		hash_type hash;
+	};
+
+	file_data_destination dest_m;
+	write_stream<file_data_destination> stream_m;
+	flat_id_map<_KeyTy, u64> added_m;
+	std::vector<_KeyTy> keys_m;
+	std::vector<entry_data> entries_m;
+	bool finished_m = false;
+
+	status write_padding();
+};
+
+/// @brief Reads blobs from a memory mapped pack file.
+/// @details Opening a pack maps the file once, and all lookups are binary searches in the mapped index, which
+/// return views into the mapped file without copying. The views are valid until the reader is closed.
+/// @tparam _KeyTy The key type of the blobs, uuid or digest<_Size>.
+/// @tparam _HashTy The hasher used for the per-blob hash, must be the same as the one used to write the pack.
+template<class _KeyTy, class _HashTy /* = hasher_xxh128 */>
+class pack_file_reader
+{
+public:
+	using key_type = _KeyTy;
+	using hasher_type = _HashTy;
+	using hash_type = typename _HashTy::hash_type;
+	using entry_type = pack_file_entry<_KeyTy, hash_type>;
+
+	/// @brief Map a pack file and validate the header, trailer and index.
+	/// @return status::ok, status::cant_open if the file can't be opened, or status::corrupted if the file is not a valid pack file.
+	status open( const std::string &filepath );
+
+	/// @brief Unmap the pack file.
+	status close();
+
+	/// @brief Find the index entry of a key, or nullptr if the key is not in the pack.
+	const entry_type *find( const _KeyTy &key ) const;
+
+	/// @brief Check if a key is in the pack.
+	bool contains( const _KeyTy &key ) const { return this->find( key ) != nullptr; }
+
+	/// @brief Get a view of a blob.
+	/// @param key the key of the blob
+	/// @param verify if true, the blob is rehashed and compared to the hash in the index
+	/// @return status::ok and the view, status::not_found if the key is not in the pack, or status::corrupted if the verification failed.
+	status_return<status, pack_file_view> get( const _KeyTy &key, bool verify = false ) const;
+
+	/// @brief Rehash all blobs in the pack, and compare with the hashes in the index.
+	/// @return status::ok, or status::corrupted if any blob does not match its hash.
+	status verify_all() const;
+
+	/// @brief Get the number of blobs in the pack.
+	size_t size() const { return this->entry_count_m; }
+
+	/// @brief Get the index entries, sorted by key.
+	const entry_type *entries() const { return this->entries_m; }
+
+private:
+	mapped_file file_m;
+	const entry_type *entries_m = nullptr;
+	size_t entry_count_m = 0;
+
+	status verify_entry( const entry_type &entry ) const;
+};
+
+}
+//namespace ctle
+
+#include "log.h"
+#include "_macros.inl"
+
+namespace ctle
+{
+
+// the header and trailer of a pack file
+struct _pack_file_header
+{
+	u64 magic;
+	u32 version;
+	u32 entry_size;
+};
+
+struct _pack_file_trailer
+{
+	u64 index_offset;
+	u64 entry_count;
+	u32 version;
+	u32 entry_size;
+	u64 magic;
+};
+
+template<class _KeyTy, class _HashTy>
+inline pack_file_writer<_KeyTy, _HashTy>::pack_file_writer( const std::string &filepath, bool overwrite_existing )
+	: dest_m( filepath, overwrite_existing )
+	, stream_m( dest_m )
+{
+	const _pack_file_header header = { pack_file_magic, pack_file_version, u32( sizeof( entry_type ) ) };
+	ctStatusCallThrow( this->stream_m.write( header ) );
+}
+
+template<class _KeyTy, class _HashTy>
+inline status pack_file_writer<_KeyTy, _HashTy>::write_padding()
+{
+	static const u8 zeros[pack_file_alignment] = {};
+	const u64 padding = ( pack_file_alignment - ( this->stream_m.get_position() % pack_file_alignment ) ) % pack_file_alignment;
+	ctStatusCall( this->stream_m.write_bytes( zeros, (size_t)padding ) );
+	return status::ok;
+}
+
+template<class _KeyTy, class _HashTy>
+inline status pack_file_writer<_KeyTy, _HashTy>::add( const _KeyTy &key, const void *data, size_t size )
+{
+	ctValidate( !this->finished_m, status::not_ready ) << "The pack has already been finished" << ctValidateEnd;
+	ctValidate( data || size == 0, status::invalid_param ) << "data can only be nullptr if size is 0" << ctValidateEnd;
+	ctValidate( !this->added_m.contains( key ), status::already_exists ) << "The key is already in the pack" << ctValidateEnd;
+
+	entry_data entry = {};
+	hasher_type hasher;
+	ctStatusCall( hasher.update( (const u8 *)data, size ) );
+	ctStatusReturnCall( entry.hash, hasher.finish() );
+
+	ctStatusCall( this->write_padding() );
+	entry.offset = this->stream_m.get_position();
+	entry.size = size;
+	ctStatusCall( this->stream_m.write_bytes( (const u8 *)data, size ) );
+
+	this->added_m.insert( key, entry.offset );
+	this->keys_m.push_back( key );
+	this->entries_m.push_back( entry );
+	return status::ok;
+}
+
+template<class _KeyTy, class _HashTy>
+inline status pack_file_writer<_KeyTy, _HashTy>::finish()
+{
+	ctValidate( !this->finished_m, status::not_ready ) << "The pack has already been finished" << ctValidateEnd;
+	this->finished_m = true;
+
+	// sort the entries by key, and write the index
+	radix_sort( this->keys_m, this->entries_m );
+
+	ctStatusCall( this->write_padding() );
+	const u64 index_offset = this->stream_m.get_position();
+	for( size_t inx = 0; inx < this->keys_m.size(); ++inx )
+	{
+		const entry_type entry = { this->keys_m[inx], this->entries_m[inx].offset, this->entries_m[inx].size, this->entries_m[inx].hash };
+		ctStatusCall( this->stream_m.write( entry ) );
+	}
+
+	const _pack_file_trailer trailer = { index_offset, (u64)this->keys_m.size(), pack_file_version, u32( sizeof( entry_type ) ), pack_file_magic };
+	ctStatusCall( this->stream_m.write( trailer ) );
+	ctStatusCall( this->stream_m.end() );
+	return status::ok;
+}
+
+template<class _KeyTy, class _HashTy>
+inline status pack_file_reader<_KeyTy, _HashTy>::open( const std::string &filepath )
+{
+	this->close();
+	ctStatusCall( this->file_m.open( filepath ) );
+
+	const u8 *data = this->file_m.data();
+	const u64 file_size = this->file_m.size();
+	ctValidate( file_size >= sizeof( _pack_file_header ) + sizeof( _pack_file_trailer ), status::corrupted ) << "The file is too small to be a pack file: " << filepath << ctValidateEnd;
+
+	_pack_file_header header = {};
+	_pack_file_trailer trailer = {};
+	memcpy( &header, data, sizeof( header ) );
+	memcpy( &trailer, data + file_size - sizeof( trailer ), sizeof( trailer ) );
+	ctValidate( header.magic == pack_file_magic && trailer.magic == pack_file_magic, status::corrupted ) << "The file is not a pack file: " << filepath << ctValidateEnd;
+	ctValidate( header.version == pack_file_version && trailer.version == pack_file_version, status::corrupted ) << "Unsupported pack file version: " << filepath << ctValidateEnd;
+	ctValidate( header.entry_size == sizeof( entry_type ) && trailer.entry_size == sizeof( entry_type ), status::corrupted ) << "The pack file key or hash type does not match the reader: " << filepath << ctValidateEnd;
+
+	const u64 index_end = file_size - sizeof( trailer );
+	ctValidate( trailer.index_offset % pack_file_alignment == 0
+		&& trailer.index_offset <= index_end
+		&& trailer.entry_count == ( index_end - trailer.index_offset ) / sizeof( entry_type ), status::corrupted ) << "The pack file index is invalid: " << filepath << ctValidateEnd;
+
+	this->entries_m = (const entry_type *)( data + trailer.index_offset );
+	this->entry_count_m = (size_t)trailer.entry_count;
+
+	for( size_t inx = 0; inx < this->entry_count_m; ++inx )
+	{
+		const entry_type &entry = this->entries_m[inx];
+		ctValidate( entry.offset <= trailer.index_offset && entry.size <= trailer.index_offset - entry.offset, status::corrupted ) << "A pack file entry is out of bounds: " << filepath << ctValidateEnd;
+		ctValidate( inx == 0 || this->entries_m[inx - 1].key < entry.key, status::corrupted ) << "The pack file index is not sorted: " << filepath << ctValidateEnd;
+	}
+
+	return status::ok;
+}
+
+template<class _KeyTy, class _HashTy>
+inline status pack_file_reader<_KeyTy, _HashTy>::close()
+{
+	this->entries_m = nullptr;
+	this->entry_count_m = 0;
+	return this->file_m.close();
+}
+
+template<class _KeyTy, class _HashTy>
+inline const typename pack_file_reader<_KeyTy, _HashTy>::entry_type *pack_file_reader<_KeyTy, _HashTy>::find( const _KeyTy &key ) const
+{
+	// binary search in the sorted index
+	const entry_type *first = this->entries_m;
+	size_t count = this->entry_count_m;
+	while( count > 0 )
+	{
+		const size_t half = count / 2;
+		if( first[half].key < key )
+		{
+			first += half + 1;
+			count -= half + 1;
+		}
+		else
+		{
+			count = half;
+		}
+	}
+	if( first != this->entries_m + this->entry_count_m && first->key == key )
+		return first;
+	return nullptr;
+}
+
+template<class _KeyTy, class _HashTy>
+inline status pack_file_reader<_KeyTy, _HashTy>::verify_entry( const entry_type &entry ) const
+{
+	hash_type hash;
+	hasher_type hasher;
+	ctStatusCall( hasher.update( this->file_m.data() + entry.offset, (size_t)entry.size ) );
+	ctStatusReturnCall( hash, hasher.finish() );
+	ctValidate( hash == entry.hash, status::corrupted ) << "The pack file blob does not match its hash" << ctValidateEnd;
+	return status::ok;
+}
+
+template<class _KeyTy, class _HashTy>
+inline status_return<status, pack_file_view> pack_file_reader<_KeyTy, _HashTy>::get( const _KeyTy &key, bool verify ) const
+{
+	const entry_type *entry = this->find( key );
+	if( !entry )
+		return status::not_found;
+	if( verify )
+	{
+		ctStatusCall( this->verify_entry( *entry ) );
+	}
+
+	pack_file_view view;
+	view.data = this->file_m.data() + entry->offset;
+	view.size = entry->size;
+	return view;
+}
+
+template<class _KeyTy, class _HashTy>
+inline status pack_file_reader<_KeyTy, _HashTy>::verify_all() const
+{
+	for( size_t inx = 0; inx < this->entry_count_m; ++inx )
+	{
+		ctStatusCall( this->verify_entry( this->entries_m[inx] ) );
+	}
+	return status::ok;
+}
+
+}
+//namespace ctle
+
+#include "_undef_macros.inl"
+
+#endif//_CTLE_PACK_FILE_H_
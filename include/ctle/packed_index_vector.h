@@ -0,0 +1,318 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_PACKED_INDEX_VECTOR_H_
+#define _CTLE_PACKED_INDEX_VECTOR_H_
+
+/// @file packed_index_vector.h
+/// @brief Contains the packed_index_vector class, an index vector which stores the indices in the narrowest of u8, u16 or u32 which fits them.
+
+#include <vector>
+#include <iterator>
+#include <stdexcept>
+#include <initializer_list>
+#include <algorithm>
+
+#include "fwd.h"
+
+namespace ctle
+{
+
+/// @brief packed_index_vector: a vector of u32 indices, stored as u8, u16 or u32 values.
+/// @details The storage width is the narrowest which fits all indices, and is widened (the indices repacked) when a larger index is stored.
+/// Use as the index vector type of an idx_vector (e.g. idx_vector<_Ty, packed_index_vector>), where indices into less than 256 or 65536 values
+/// use a quarter or half the memory of a std::vector<i32>. Reading a single index branches on the width, which is well predicted since
+/// the width rarely changes. For bulk work, visit() calls a functor with the typed index array, so the loop is compiled once per width without branches.
+class packed_index_vector
+{
+public:
+	using value_type = u32;
+	using size_type = size_t;
+
+	/// @brief Random access iterator over the indices (as u32 values)
+	class const_iterator
+	{
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = u32;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const u32 *;
+		using reference = u32;
+
+		const_iterator() = default;
+		const_iterator( const packed_index_vector *_vec, size_t _pos ) noexcept : vec( _vec ), pos( _pos ) {}
+
+		u32 operator*() const noexcept { return ( *this->vec )[this->pos]; }
+		u32 operator[]( difference_type offset ) const noexcept { return ( *this->vec )[size_t( difference_type( this->pos ) + offset )]; }
+		const_iterator &operator++() noexcept { ++this->pos; return *this; }
+		const_iterator operator++( int ) noexcept { const_iterator ret = *this; ++this->pos; return ret; }
+		const_iterator &operator--() noexcept { --this->pos; return *this; }
+		const_iterator operator--( int ) noexcept { const_iterator ret = *this; --this->pos; return ret; }
+		const_iterator &operator+=( difference_type offset ) noexcept { this->pos = size_t( difference_type( this->pos ) + offset ); return *this; }
+		const_iterator &operator-=( difference_type offset ) noexcept { this->pos = size_t( difference_type( this->pos ) - offset ); return *this; }
+		const_iterator operator+( difference_type offset ) const noexcept { return const_iterator( this->vec, size_t( difference_type( this->pos ) + offset ) ); }
+		const_iterator operator-( difference_type offset ) const noexcept { return const_iterator( this->vec, size_t( difference_type( this->pos ) - offset ) ); }
+		difference_type operator-( const const_iterator &other ) const noexcept { return difference_type( this->pos ) - difference_type( other.pos ); }
+		bool operator==( const const_iterator &other ) const noexcept { return this->pos == other.pos; }
+		bool operator!=( const const_iterator &other ) const noexcept { return this->pos != other.pos; }
+		bool operator<( const const_iterator &other ) const noexcept { return this->pos < other.pos; }
+		bool operator>( const const_iterator &other ) const noexcept { return this->pos > other.pos; }
+		bool operator<=( const const_iterator &other ) const noexcept { return this->pos <= other.pos; }
+		bool operator>=( const const_iterator &other ) const noexcept { return this->pos >= other.pos; }
+
+	private:
+		const packed_index_vector *vec = nullptr;
+		size_t pos = 0;
+	};
+
+	packed_index_vector() = default;
+	packed_index_vector( std::initializer_list<u32> _indices ) { this->assign( _indices.begin(), _indices.size() ); }
+
+	bool operator==( const packed_index_vector &_other ) const noexcept;
+	bool operator!=( const packed_index_vector &_other ) const noexcept { return !this->operator==( _other ); }
+
+	/// @brief Get the index at a position. The position is not bounds checked.
+	u32 operator[]( size_type _pos ) const noexcept
+	{
+		switch( this->width_m )
+		{
+			case 1: return this->indices8_m[_pos];
+			case 2: return this->indices16_m[_pos];
+			default: return this->indices32_m[_pos];
+		}
+	}
+
+	/// @brief Get the index at a position.
+	/// @throws std::out_of_range if the position is out of bounds
+	u32 at( size_type _pos ) const
+	{
+		if( _pos >= this->size() )
+		{
+			throw std::out_of_range( "packed_index_vector position out of range" );
+		}
+		return this->operator[]( _pos );
+	}
+
+	/// @brief Set the index at a position, widening the storage if needed. The position is not bounds checked.
+	void set( size_type _pos, u32 _index );
+
+	/// @brief Append an index, widening the storage if needed.
+	void push_back( u32 _index );
+
+	/// @brief Replace the indices with an array of indices. The width is selected from the largest index.
+	template<class _Ty> void assign( const _Ty *_indices, size_type _count );
+
+	/// @brief Resize the vector. New indices are 0.
+	void resize( size_type _count );
+
+	/// @brief Reserve memory for a number of indices, at the current width
+	void reserve( size_type _count );
+
+	/// @brief Widen the storage up front, so that indices into value_count values never repack the storage.
+	void reserve_value_range( size_t _value_count ) { this->widen( _value_count > 0 ? u32( std::min<size_t>( _value_count - 1, 0xffffffff ) ) : 0 ); }
+
+	/// @brief Repack the indices into the narrowest width which fits the largest index.
+	void shrink_width();
+
+	/// @brief Get the number of indices
+	size_type size() const noexcept
+	{
+		switch( this->width_m )
+		{
+			case 1: return this->indices8_m.size();
+			case 2: return this->indices16_m.size();
+			default: return this->indices32_m.size();
+		}
+	}
+
+	/// @brief Get the number of indices which fit in the allocated memory, at the current width
+	size_type capacity() const noexcept
+	{
+		switch( this->width_m )
+		{
+			case 1: return this->indices8_m.capacity();
+			case 2: return this->indices16_m.capacity();
+			default: return this->indices32_m.capacity();
+		}
+	}
+
+	/// @brief Check if the vector is empty
+	bool empty() const noexcept { return this->size() == 0; }
+
+	/// @brief Remove all indices, and reset the width to u8
+	void clear() noexcept;
+
+	/// @brief Get the storage width of each index in bytes, 1, 2 or 4
+	size_t width() const noexcept { return this->width_m; }
+
+	/// @brief Call func( const _IdxTy *indices, size_t count ) with the typed index array, where _IdxTy is u8, u16 or u32 depending on the width.
+	/// @return The return value of func
+	template<class _Func> auto visit( _Func &&func ) const -> decltype( func( (const u32 *)nullptr, size_t( 0 ) ) )
+	{
+		switch( this->width_m )
+		{
+			case 1: return func( this->indices8_m.data(), this->indices8_m.size() );
+			case 2: return func( this->indices16_m.data(), this->indices16_m.size() );
+			default: return func( this->indices32_m.data(), this->indices32_m.size() );
+		}
+	}
+
+	const_iterator begin() const noexcept { return const_iterator( this, 0 ); }
+	const_iterator end() const noexcept { return const_iterator( this, this->size() ); }
+
+private:
+	size_t width_m = 1;
+	std::vector<u8> indices8_m;
+	std::vector<u16> indices16_m;
+	std::vector<u32> indices32_m;
+
+	static size_t width_of( u32 _index ) noexcept { return ( _index <= 0xff ) ? 1 : ( ( _index <= 0xffff ) ? 2 : 4 ); }
+	void widen( u32 _index );
+	void repack( size_t _width );
+};
+
+inline bool packed_index_vector::operator==( const packed_index_vector &_other ) const noexcept
+{
+	if( this->size() != _other.size() )
+		return false;
+	if( this->width_m == _other.width_m )
+	{
+		return ( this->indices8_m == _other.indices8_m )
+			&& ( this->indices16_m == _other.indices16_m )
+			&& ( this->indices32_m == _other.indices32_m );
+	}
+	return std::equal( this->begin(), this->end(), _other.begin() );
+}
+
+// copy the indices from one typed array to another, and release the source
+template<class _SrcTy, class _DestTy> inline void _repack_indices( std::vector<_SrcTy> &src, std::vector<_DestTy> &dest )
+{
+	dest.assign( src.begin(), src.end() );
+	std::vector<_SrcTy>().swap( src );
+}
+
+// copy an array of indices into a typed array
+template<class _IdxTy, class _SrcTy> inline void _assign_indices( std::vector<_IdxTy> &dest, const _SrcTy *src, size_t count )
+{
+	dest.resize( count );
+	for( size_t inx = 0; inx < count; ++inx )
+		dest[inx] = _IdxTy( src[inx] );
+}
+
+// get the largest index in a typed array
+template<class _IdxTy> inline u32 _max_index( const std::vector<_IdxTy> &indices )
+{
+	return indices.empty() ? 0 : u32( *std::max_element( indices.begin(), indices.end() ) );
+}
+
+inline void packed_index_vector::repack( size_t _width )
+{
+	if( _width == this->width_m )
+		return;
+
+	switch( this->width_m * 8 + _width )
+	{
+		case 1 * 8 + 2: _repack_indices( this->indices8_m, this->indices16_m ); break;
+		case 1 * 8 + 4: _repack_indices( this->indices8_m, this->indices32_m ); break;
+		case 2 * 8 + 1: _repack_indices( this->indices16_m, this->indices8_m ); break;
+		case 2 * 8 + 4: _repack_indices( this->indices16_m, this->indices32_m ); break;
+		case 4 * 8 + 1: _repack_indices( this->indices32_m, this->indices8_m ); break;
+		default: _repack_indices( this->indices32_m, this->indices16_m ); break;
+	}
+	this->width_m = _width;
+}
+
+inline void packed_index_vector::widen( u32 _index )
+{
+	const size_t width = width_of( _index );
+	if( width > this->width_m )
+		this->repack( width );
+}
+
+inline void packed_index_vector::set( size_type _pos, u32 _index )
+{
+	this->widen( _index );
+	switch( this->width_m )
+	{
+		case 1: this->indices8_m[_pos] = u8( _index ); break;
+		case 2: this->indices16_m[_pos] = u16( _index ); break;
+		default: this->indices32_m[_pos] = _index; break;
+	}
+}
+
+inline void packed_index_vector::push_back( u32 _index )
+{
+	this->widen( _index );
+	switch( this->width_m )
+	{
+		case 1: this->indices8_m.push_back( u8( _index ) ); break;
+		case 2: this->indices16_m.push_back( u16( _index ) ); break;
+		default: this->indices32_m.push_back( _index ); break;
+	}
+}
+
+template<class _Ty>
+inline void packed_index_vector::assign( const _Ty *_indices, size_type _count )
+{
+	u32 max_index = 0;
+	for( size_type inx = 0; inx < _count; ++inx )
+		max_index = std::max( max_index, u32( _indices[inx] ) );
+
+	this->clear();
+	this->width_m = width_of( max_index );
+	switch( this->width_m )
+	{
+		case 1: _assign_indices( this->indices8_m, _indices, _count ); break;
+		case 2: _assign_indices( this->indices16_m, _indices, _count ); break;
+		default: _assign_indices( this->indices32_m, _indices, _count ); break;
+	}
+}
+
+inline void packed_index_vector::resize( size_type _count )
+{
+	switch( this->width_m )
+	{
+		case 1: this->indices8_m.resize( _count ); break;
+		case 2: this->indices16_m.resize( _count ); break;
+		default: this->indices32_m.resize( _count ); break;
+	}
+}
+
+inline void packed_index_vector::reserve( size_type _count )
+{
+	switch( this->width_m )
+	{
+		case 1: this->indices8_m.reserve( _count ); break;
+		case 2: this->indices16_m.reserve( _count ); break;
+		default: this->indices32_m.reserve( _count ); break;
+	}
+}
+
+inline void packed_index_vector::shrink_width()
+{
+	u32 max_index;
+	switch( this->width_m )
+	{
+		case 1: max_index = _max_index( this->indices8_m ); break;
+		case 2: max_index = _max_index( this->indices16_m ); break;
+		default: max_index = _max_index( this->indices32_m ); break;
+	}
+	this->repack( width_of( max_index ) );
+}
+
+inline void packed_index_vector::clear() noexcept
+{
+	this->indices8_m.clear();
+	this->indices16_m.clear();
+	this->indices32_m.clear();
+	this->width_m = 1;
+}
+
+// index vector helpers of idx_vector (see idx_vector.h), which are found by argument dependent lookup
+inline void _write_index( packed_index_vector &index, size_t pos, size_t value_index ) { index.set( pos, u32( value_index ) ); }
+inline void _shrink_index_width( packed_index_vector &index ) { index.shrink_width(); }
+
+}
+//namespace ctle
+
+#endif//_CTLE_PACKED_INDEX_VECTOR_H_
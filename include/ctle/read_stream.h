@@ -8,31 +8,50 @@
 /// @brief A read-only input stream for streaming data sequentially, using a memory buffer, while also calculating a hash on the input stream.
 
 #include <vector>
+#include <type_traits>
+#include <algorithm>
 
 #include "fwd.h"
 #include "status_error.h"
 #include "status_return.h"
 #include "hasher.h"
 #include "file_funcs.h"
+#include "util.h"
+#include "varint.h"
+#include "endianness.h"
 
 namespace ctle
 {
+
+// memory data sources define a static is_memory_data_source member, and are read in place by read_stream
+template<class _Ty, class = void> struct _is_memory_data_source : std::false_type {};
+template<class _Ty> struct _is_memory_data_source<_Ty, typename std::enable_if<_Ty::is_memory_data_source>::type> : std::true_type {};
+
 /// @brief A read-only input stream with optional hashing
 /// @details A read-only input stream which is designed for streaming data sequentially, using a 
-/// memory buffer, while also calculating a hash on the input stream.
+/// memory buffer, while also calculating a hash on the input stream. If the data source is a memory source (e.g. memory_data_source),
+/// the stream reads directly from the source memory, and no intermediate buffer is used.
+/// The stream can be set up to read a declared byte order, in which case arithmetic values (see byte_swap_value_size) which are read 
+/// using read() are byte swapped as they are copied from the stream buffer, if the byte order differs from the host.
 template<class _DataSourceTy, class _HashTy /* = hasher_noop<64> */>
 class read_stream
 {
 	const size_t buffer_size = 2 * 1024 * 1024;
 
 public:
-	read_stream( _DataSourceTy &_data_source );
+	/// @brief Set up the stream, and fill the read buffer
+	/// @param _data_source the data source
+	/// @param _order the byte order of the values in the stream
+	read_stream( _DataSourceTy &_data_source, byte_order _order = host_byte_order );
 	~read_stream();
 
 	using data_source_type = _DataSourceTy;
 	using hasher_type = _HashTy;
 	using hash_type = typename _HashTy::hash_type;
 
+	/// @brief Get the byte order of the values read by read()
+	byte_order get_byte_order() const { return this->order; }
+
 	/// @brief Get the current position/number of bytes read from the stream (not including any pre-read data in the read buffer)
 	u64 get_position() const { return this->current_position; };
 	
@@ -49,31 +68,77 @@ public:
 	/// @note Make sure the type is correctly packed, since any alignment byte will also be read from the stream
 	template<class _DataTy> status read(_DataTy* dest, size_t count = 1);
 
-	/// @brief Read a raw byte stream into a memory area
+	/// @brief Read a raw byte stream into a memory area. The bytes are never byte swapped.
 	/// @param dest the destination memory area
 	/// @param count the number of bytes to read
 	/// @note dest must be a valid memory area of at least count bytes
 	status read_bytes(u8* dest, size_t count);
 
+	/// @brief Get a pointer to the next count bytes of the source memory, and move past them, without copying the data.
+	/// @details Only available for memory sources (e.g. memory_data_source), where the pointer stays valid as long as the source memory does.
+	/// @param count the number of bytes
+	/// @return status::ok and the pointer, or status::cant_read if the stream ends before count bytes
+	status_return<status, const u8*> read_in_place( size_t count );
+
+	/// @brief Read an unsigned LEB128 varint, written by write_stream::write_varint()
+	/// @return status::ok, status::cant_read if the stream ended, or status::corrupted if the varint is not valid
+	status read_varint( u64 &value );
+
+	/// @brief Read a zigzag encoded signed varint, written by write_stream::write_signed_varint()
+	/// @return status::ok, status::cant_read if the stream ended, or status::corrupted if the varint is not valid
+	status read_signed_varint( i64 &value );
+
+	/// @brief Read a stream-vbyte encoded array of u32 values, written by write_stream::write_varint_array(). The destination is resized to the value count.
+	/// @return status::ok, status::cant_read if the stream ended, or status::corrupted if the array is not valid
+	status read_varint_array( std::vector<u32> &dest ) { return this->read_stream_vbyte( dest, false ); }
+
+	/// @brief Read a delta coded stream-vbyte encoded array of u32 values, written by write_stream::write_delta_varint_array(). The destination is resized to the value count.
+	/// @return status::ok, status::cant_read if the stream ended, or status::corrupted if the array is not valid
+	status read_delta_varint_array( std::vector<u32> &dest ) { return this->read_stream_vbyte( dest, true ); }
+
 	/// @brief Returns true if the stream has ended (eos/eof)
 	bool has_ended() const;
 
+	/// @brief Move the read position of the stream.
+	/// @details If the position is within the data in the read buffer, only the buffer position is moved. Else the data source
+	/// is repositioned (which requires a seek(u64) method on the data source), and the buffer is refilled. Since the hash is 
+	/// calculated on the data as it is read from the source, repositioning the source invalidates the hash digest.
+	/// @param position the new position in the stream
+	/// @return status::ok, or an error status if the source could not be repositioned, or the position is beyond the end of the stream
+	status seek(u64 position);
+
+	/// @brief Skip forward in the stream, without copying the data. @see seek()
+	/// @param count the number of bytes to skip
+	status skip(u64 count) { return this->seek( this->current_position + count ); }
+
 	/// @brief Get the hash digest from the stream. 
-	/// @note The hash value will be calculated when the stream has ended, any call before then will return an empty hash digest
-	status_return<status,hash_type> get_digest() const { return hash_digest; };
+	/// @note The hash value will be calculated when the stream has ended, any call before then will return an empty hash digest. 
+	/// If the source has been repositioned by seek(), status::invalid is returned.
+	status_return<status,hash_type> get_digest() const { if( !this->hash_valid ) { return status::invalid; } return hash_digest; };
 
 private:
 	u64 current_position = 0;
+	size_t buffer_start = 0;
 	size_t buffer_position = 0;
 	size_t buffer_end = 0;
-	std::vector<u8> buffer;
+	const u8 *buffer_data = nullptr;
+	bool source_ended = false;
+	bool memory_mode = false;
+	bool hash_valid = true;
+	std::vector<u8, aligned_allocator<u8, direct_io_alignment>> buffer;
 
 	data_source_type &data_source;
 	hasher_type hasher;
 	hash_type hash_digest;
+	const byte_order order;
 
+	void open( std::false_type is_memory_source );
+	void open( std::true_type is_memory_source );
 	void read_from_buffer( u8* const dest, const size_t count );
+	status read_bytes_swapped( u8 *dest, size_t count, size_t value_size );
 	status fill_buffer();
+	status read_span( size_t count, std::vector<u8> &scratch, const u8 *&data );
+	status read_stream_vbyte( std::vector<u32> &dest, bool delta );
 };
 
 }
@@ -84,14 +149,40 @@ private:
 namespace ctle
 {
 
+// the number of bytes which are read at a time when the size of the read data comes from the stream itself
+static constexpr const size_t _read_stream_step_size = 1024 * 1024;
+
 template<class _DataSourceTy, class _HashTy>
-inline read_stream<_DataSourceTy,_HashTy>::read_stream( _DataSourceTy &_data_source ) 
+inline read_stream<_DataSourceTy,_HashTy>::read_stream( _DataSourceTy &_data_source, byte_order _order ) 
 	: data_source(_data_source)
+	, order(_order)
+{
+	this->open( std::integral_constant<bool, _is_memory_data_source<_DataSourceTy>::value>() );
+}
+
+template<class _DataSourceTy, class _HashTy>
+inline void read_stream<_DataSourceTy,_HashTy>::open( std::false_type )
 {
 	this->buffer.resize(buffer_size);
 	ctStatusCallThrow( this->fill_buffer() );
 }
 
+template<class _DataSourceTy, class _HashTy>
+inline void read_stream<_DataSourceTy,_HashTy>::open( std::true_type )
+{
+	// use the rest of the source memory as the buffer, and hash all of it up front
+	const u64 source_position = this->data_source.position();
+	this->buffer_data = this->data_source.data() + source_position;
+	this->buffer_end = (size_t)( this->data_source.size() - source_position );
+	this->source_ended = true;
+	this->memory_mode = true;
+	ctStatusCallThrow( this->data_source.seek( this->data_source.size() ) );
+	ctStatusCallThrow( this->hasher.update( this->buffer_data, this->buffer_end ) );
+	const auto digest = this->hasher.finish();
+	ctStatusCallThrow( digest.status() );
+	this->hash_digest = digest.value();
+}
+
 template<class _DataSourceTy, class _HashTy>
 inline read_stream<_DataSourceTy,_HashTy>::~read_stream()
 {
@@ -112,10 +203,49 @@ inline status read_stream<_DataSourceTy,_HashTy>::read(_DataTy* dest, size_t cou
 {
 	static_assert( std::is_trivially_copyable<_DataTy>(), "_DataTy data type must be trivially copyable" );
 
+	const size_t value_size = byte_swap_value_size<_DataTy>::value;
+	if( value_size != 0 && this->order != host_byte_order )
+	{
+		ctStatusCall( this->read_bytes_swapped( (u8*)dest, sizeof(_DataTy)*count, value_size ) );
+		return status::ok;
+	}
+
 	ctStatusCall( this->read_bytes( (u8*)dest, sizeof(_DataTy)*count) );
 	return status::ok;
 }
 
+template<class _DataSourceTy, class _HashTy>
+inline status read_stream<_DataSourceTy,_HashTy>::read_bytes_swapped( u8 *dest, size_t count, size_t value_size )
+{
+	// swap the values while copying them from the buffer
+	size_t read_count = 0;
+	while( read_count < count )
+	{
+		const size_t values_left = ( count - read_count ) / value_size;
+		const size_t values_in_buffer = std::min( values_left, ( this->buffer_end - this->buffer_position ) / value_size );
+		if( values_in_buffer > 0 )
+		{
+			const size_t to_copy = values_in_buffer * value_size;
+			_byte_swap_copy( &dest[read_count], &this->buffer_data[this->buffer_position], values_in_buffer, value_size );
+			this->buffer_position += to_copy;
+			this->current_position += to_copy;
+			read_count += to_copy;
+		}
+		else
+		{
+			// the value straddles the end of the buffer (or the buffer is empty), read it with read_bytes, which refills the buffer
+			ctStatusCall( this->read_bytes( &dest[read_count], value_size ) );
+			_byte_swap_copy( &dest[read_count], &dest[read_count], 1, value_size );
+			read_count += value_size;
+		}
+	}
+
+	// keep the buffer filled, as read_bytes does
+	if( this->buffer_position >= this->buffer_end )
+		ctStatusCall( this->fill_buffer() );
+	return status::ok;
+}
+
 template<class _DataSourceTy, class _HashTy>
 inline status read_stream<_DataSourceTy,_HashTy>::read_bytes(u8* const dest, const size_t count)
 {
@@ -149,35 +279,176 @@ inline status read_stream<_DataSourceTy,_HashTy>::read_bytes(u8* const dest, con
 	return status::ok;
 }
 
+template<class _DataSourceTy, class _HashTy>
+inline status_return<status, const u8*> read_stream<_DataSourceTy,_HashTy>::read_in_place( size_t count )
+{
+	static_assert( _is_memory_data_source<_DataSourceTy>::value, "read_in_place is only available for memory data sources" );
+
+	// all of the source memory is in the buffer
+	ctValidate( this->buffer_end - this->buffer_position >= count, status::cant_read ) << "The stream ended before reading the desired data count" << ctValidateEnd;
+	const u8 *data = &this->buffer_data[this->buffer_position];
+	this->buffer_position += count;
+	this->current_position += count;
+	return data;
+}
+
+template<class _DataSourceTy, class _HashTy>
+inline status read_stream<_DataSourceTy,_HashTy>::read_varint( u64 &value )
+{
+	// decode directly from the buffer if a whole varint is guaranteed to be in it
+	size_t count = 0;
+	if( this->buffer_end - this->buffer_position >= varint_max_size )
+	{
+		count = varint_decode( &this->buffer_data[this->buffer_position], varint_max_size, value );
+		ctValidate( count > 0, status::corrupted ) << "The varint is longer than " << varint_max_size << " bytes, or does not fit in 64 bits" << ctValidateEnd;
+		this->buffer_position += count;
+		this->current_position += count;
+		return status::ok;
+	}
+
+	// near the end of the buffer, read byte by byte
+	u8 encoded[varint_max_size];
+	do
+	{
+		ctValidate( count < varint_max_size, status::corrupted ) << "The varint is longer than " << varint_max_size << " bytes" << ctValidateEnd;
+		ctStatusCall( this->read_bytes( &encoded[count], 1 ) );
+		++count;
+	} 
+	while( encoded[count - 1] >= 0x80 );
+	ctValidate( varint_decode( encoded, count, value ) == count, status::corrupted ) << "The varint does not fit in 64 bits" << ctValidateEnd;
+	return status::ok;
+}
+
+template<class _DataSourceTy, class _HashTy>
+inline status read_stream<_DataSourceTy,_HashTy>::read_signed_varint( i64 &value )
+{
+	u64 encoded = 0;
+	ctStatusCall( this->read_varint( encoded ) );
+	value = zigzag_decode( encoded );
+	return status::ok;
+}
+
+template<class _DataSourceTy, class _HashTy>
+inline status read_stream<_DataSourceTy,_HashTy>::read_span( size_t count, std::vector<u8> &scratch, const u8 *&data )
+{
+	// if all of the data is in the buffer, use it in place. the pointer is valid until the buffer is refilled
+	if( this->buffer_end - this->buffer_position >= count )
+	{
+		data = &this->buffer_data[this->buffer_position];
+		this->buffer_position += count;
+		this->current_position += count;
+		return status::ok;
+	}
+
+	scratch.resize( count );
+	ctStatusCall( this->read_bytes( scratch.data(), count ) );
+	data = scratch.data();
+	return status::ok;
+}
+
+template<class _DataSourceTy, class _HashTy>
+inline status read_stream<_DataSourceTy,_HashTy>::read_stream_vbyte( std::vector<u32> &dest, bool delta )
+{
+	u64 count = 0;
+	ctStatusCall( this->read_varint( count ) );
+	ctValidate( count <= u64( dest.max_size() ), status::corrupted ) << "The array count " << count << " is not valid" << ctValidateEnd;
+	if( count == 0 )
+	{
+		dest.clear();
+		return status::ok;
+	}
+
+	// the control bytes are copied, since reading the data bytes may refill the buffer. they are read in steps, at most doubling the 
+	// bytes read so far, so a corrupted count fails when the stream ends, instead of allocating the whole count up front. 
+	// the data size, and the values, are then bounded by the control bytes which were actually read.
+	const size_t control_size = stream_vbyte_control_size( (size_t)count );
+	std::vector<u8> control;
+	while( control.size() < control_size )
+	{
+		const size_t read_count = control.size();
+		control.resize( read_count + std::min( control_size - read_count, std::max( _read_stream_step_size, read_count ) ) );
+		ctStatusCall( this->read_bytes( &control[read_count], control.size() - read_count ) );
+	}
+
+	// the data bytes are decoded in place if they are in the buffer
+	const size_t data_size = stream_vbyte_data_size( control.data(), (size_t)count );
+	std::vector<u8> scratch;
+	const u8 *data = nullptr;
+	ctStatusCall( this->read_span( data_size, scratch, data ) );
+
+	dest.resize( (size_t)count );
+	_stream_vbyte_decode( control.data(), data, data_size, dest.data(), dest.size(), delta );
+	return status::ok;
+}
+
 template<class _DataSourceTy, class _HashTy>
 inline bool read_stream<_DataSourceTy,_HashTy>::has_ended() const
 {
-	// the definition of the end of the stream is that the buffer is not totally filled, since 
+	// the definition of the end of the stream is that the source could not fill the buffer, since 
 	// no more bytes can be read, and that the buffer_position has come to the end of the partially filled buffer
-	if(this->buffer_end == this->buffer_size)
+	if(!this->source_ended)
 		return false;
 	return this->buffer_position >= this->buffer_end;
 }
 
+template<class _DataSourceTy, class _HashTy>
+inline status read_stream<_DataSourceTy,_HashTy>::seek( u64 position )
+{
+	// if the position is within the data in the buffer, just move the buffer position
+	const u64 buffer_start_position = this->current_position - ( this->buffer_position - this->buffer_start );
+	const u64 buffer_end_position = this->current_position + ( this->buffer_end - this->buffer_position );
+	if( position >= buffer_start_position && position <= buffer_end_position )
+	{
+		this->buffer_position = this->buffer_start + (size_t)( position - buffer_start_position );
+		this->current_position = position;
+		return status::ok;
+	}
+
+	// a memory source is all in the buffer
+	ctValidate( !this->memory_mode, status::invalid_param ) << "The position is beyond the end of the stream" << ctValidateEnd;
+
+	// reposition the source at an aligned position, refill the buffer, and skip up to the position in the buffer
+	const u64 source_position = position - ( position % direct_io_alignment );
+	ctStatusCall( this->data_source.seek( source_position ) );
+	this->hash_valid = false;
+	this->source_ended = false;
+	this->buffer_start = 0;
+	this->buffer_position = 0;
+	this->buffer_end = 0;
+	this->current_position = source_position;
+	ctStatusCall( this->fill_buffer() );
+	ctValidate( position - source_position <= this->buffer_end, status::invalid_param ) << "The position is beyond the end of the stream" << ctValidateEnd;
+	this->buffer_position = (size_t)( position - source_position );
+	this->current_position = position;
+	return status::ok;
+}
+
 template<class _DataSourceTy, class _HashTy>
 inline void read_stream<_DataSourceTy,_HashTy>::read_from_buffer( u8* const dest, const size_t count )
 {
-	u8* const src = this->buffer.data();
-	memcpy(dest, &src[this->buffer_position], count);
+	memcpy(dest, &this->buffer_data[this->buffer_position], count);
 	this->buffer_position += count;
 }
 
 template<class _DataSourceTy, class _HashTy>
 inline status read_stream<_DataSourceTy,_HashTy>::fill_buffer()
 {
+	// nothing more to read if the source has ended
+	if( this->source_ended )
+		return status::ok;
+
 	u8* const buffer_data = this->buffer.data();
+	this->buffer_data = buffer_data;
 	const size_t buffer_count = buffer_end - buffer_position;
 
-	// move whatever is left in the buffer to the beginning
+	// move whatever is left in the buffer to the beginning, but place it so it ends at an aligned offset,
+	// so that the fill is aligned and a whole multiple of direct_io_alignment (for sources which use direct i/o)
+	const size_t leftover_start = ( direct_io_alignment - ( buffer_count % direct_io_alignment ) ) % direct_io_alignment;
 	if (buffer_count > 0)
-		memcpy( (void*)buffer_data, (void*)&buffer_data[buffer_position], buffer_count);
-	buffer_position = 0;
-	buffer_end = buffer_count;
+		memmove( (void*)&buffer_data[leftover_start], (void*)&buffer_data[buffer_position], buffer_count);
+	buffer_start = leftover_start;
+	buffer_position = leftover_start;
+	buffer_end = leftover_start + buffer_count;
 
 	// fill up with new data. 
 	const size_t fill_start = buffer_end;
@@ -185,13 +456,15 @@ inline status read_stream<_DataSourceTy,_HashTy>::fill_buffer()
 	size_t read_count = 0;
 	ctStatusReturnCall(read_count, this->data_source.read(&buffer_data[fill_start], fill_count));
 	buffer_end += read_count;
+	this->source_ended = ( read_count < fill_count );
 
-	// update hash digest
-	this->hasher.update(&buffer_data[fill_start], read_count);
-
-	// if at the end of the stream, get the final hash value
-	if (read_count < fill_count)
-		ctStatusReturnCall( this->hash_digest , this->hasher.finish() );
+	// update hash digest, and if at the end of the stream, get the final hash value
+	if( this->hash_valid )
+	{
+		this->hasher.update(&buffer_data[fill_start], read_count);
+		if (this->source_ended)
+			ctStatusReturnCall( this->hash_digest , this->hasher.finish() );
+	}
 	
 	return status::ok;
 }
@@ -0,0 +1,583 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_SERIALIZATION_H_
+#define _CTLE_SERIALIZATION_H_
+
+/// @file serialization.h
+/// @brief Binary serialization of values and ctle containers to and from write_stream/read_stream.
+
+#include <vector>
+#include <string>
+#include <type_traits>
+#include <algorithm>
+
+#include "fwd.h"
+#include "status.h"
+#include "uuid.h"
+#include "digest.h"
+#include "idx_vector.h"
+#include "optional_value.h"
+#include "optional_vector.h"
+#include "optional_idx_vector.h"
+#include "packed_index_vector.h"
+#include "nullable_vector.h"
+#include "bimap.h"
+#include "vector_view.h"
+#include "endianness.h"
+
+namespace ctle
+{
+
+/// @brief The current version of the serialization format, written by write_serialization_header()
+constexpr const u32 serialization_format_version = 1;
+
+/// @brief Trait which is true for types which are serialized as raw bytes, so arrays of them are written and read as a single contiguous block.
+/// @details The trait is true for arithmetic and enum types, uuid and digest. ntup.h specializes the trait for n_tup and mn_tup,
+/// which are bulk serializable if their value type is. Specialize the trait as std::true_type for other trivially copyable and
+/// tightly packed types, any padding bytes will be written to the stream.
+template<class _Ty, class /* = void */> struct is_bulk_serializable : std::integral_constant<bool, std::is_arithmetic<_Ty>::value || std::is_enum<_Ty>::value> {};
+template<> struct is_bulk_serializable<uuid> : std::true_type {};
+template<size_t _Size> struct is_bulk_serializable<digest<_Size>> : std::true_type {};
+
+/// @brief Write the serialization header (a magic value and the format version) to a stream. Write it once, before the serialized values.
+template<class _WriteStreamTy> status write_serialization_header( _WriteStreamTy &strm );
+
+/// @brief Read and validate the serialization header from a stream.
+/// @return status::ok, or status::invalid if the stream is not serialized data, or is written by a newer version of the format.
+template<class _ReadStreamTy> status read_serialization_header( _ReadStreamTy &strm );
+
+/// @brief Write a value of a bulk serializable type (see is_bulk_serializable) as raw bytes.
+template<class _WriteStreamTy, class _Ty> typename std::enable_if<is_bulk_serializable<_Ty>::value, status>::type serialize( _WriteStreamTy &strm, const _Ty &value );
+/// @brief Read a value of a bulk serializable type.
+template<class _ReadStreamTy, class _Ty> typename std::enable_if<is_bulk_serializable<_Ty>::value, status>::type deserialize( _ReadStreamTy &strm, _Ty &value );
+
+/// @brief Write a string, as its length and the characters.
+template<class _WriteStreamTy> status serialize( _WriteStreamTy &strm, const std::string &value );
+/// @brief Read a string.
+template<class _ReadStreamTy> status deserialize( _ReadStreamTy &strm, std::string &value );
+
+/// @brief Write a vector, as its length, followed by the values. Values of bulk serializable types are written as a single contiguous block, other values are serialized one by one.
+template<class _WriteStreamTy, class _Ty, class _Alloc> status serialize( _WriteStreamTy &strm, const std::vector<_Ty, _Alloc> &value );
+/// @brief Read a vector.
+template<class _ReadStreamTy, class _Ty, class _Alloc> status deserialize( _ReadStreamTy &strm, std::vector<_Ty, _Alloc> &value );
+
+/// @brief Write a bool vector, as its length, followed by one byte per value.
+template<class _WriteStreamTy, class _Alloc> status serialize( _WriteStreamTy &strm, const std::vector<bool, _Alloc> &value );
+/// @brief Read a bool vector.
+template<class _ReadStreamTy, class _Alloc> status deserialize( _ReadStreamTy &strm, std::vector<bool, _Alloc> &value );
+
+/// @brief Write an idx_vector, as the values vector followed by the index vector.
+template<class _WriteStreamTy, class _Ty, class _IdxTy, class _VecTy> status serialize( _WriteStreamTy &strm, const idx_vector<_Ty, _IdxTy, _VecTy> &value );
+/// @brief Read an idx_vector. Returns status::corrupted if any index is out of bounds of the values.
+template<class _ReadStreamTy, class _Ty, class _IdxTy, class _VecTy> status deserialize( _ReadStreamTy &strm, idx_vector<_Ty, _IdxTy, _VecTy> &value );
+
+/// @brief Write a packed_index_vector, as a byte with the index width, followed by the indices as a vector of u8, u16 or u32.
+template<class _WriteStreamTy> status serialize( _WriteStreamTy &strm, const packed_index_vector &value );
+/// @brief Read a packed_index_vector. Returns status::corrupted if the index width is not valid.
+template<class _ReadStreamTy> status deserialize( _ReadStreamTy &strm, packed_index_vector &value );
+
+/// @brief Write an optional_value, as a flag, followed by the value if it is set.
+template<class _WriteStreamTy, class _Ty> status serialize( _WriteStreamTy &strm, const optional_value<_Ty> &value );
+/// @brief Read an optional_value.
+template<class _ReadStreamTy, class _Ty> status deserialize( _ReadStreamTy &strm, optional_value<_Ty> &value );
+
+/// @brief Write an optional_vector, as a flag, followed by the vector if it is set.
+template<class _WriteStreamTy, class _Ty, class _Alloc> status serialize( _WriteStreamTy &strm, const optional_vector<_Ty, _Alloc> &value );
+/// @brief Read an optional_vector.
+template<class _ReadStreamTy, class _Ty, class _Alloc> status deserialize( _ReadStreamTy &strm, optional_vector<_Ty, _Alloc> &value );
+
+/// @brief Write a nullable_vector, as the values vector (including the storage of null elements), followed by the validity bitmap as a vector of u64.
+template<class _WriteStreamTy, class _Ty, class _Alloc> status serialize( _WriteStreamTy &strm, const nullable_vector<_Ty, _Alloc> &value );
+/// @brief Read a nullable_vector. Returns status::corrupted if the size of the validity bitmap does not match the values, or has bits set past the size.
+template<class _ReadStreamTy, class _Ty, class _Alloc> status deserialize( _ReadStreamTy &strm, nullable_vector<_Ty, _Alloc> &value );
+
+/// @brief Write an optional_idx_vector, as a flag, followed by the idx_vector if it is set.
+template<class _WriteStreamTy, class _Ty, class _IdxTy, class _VecTy> status serialize( _WriteStreamTy &strm, const optional_idx_vector<_Ty, _IdxTy, _VecTy> &value );
+/// @brief Read an optional_idx_vector.
+template<class _ReadStreamTy, class _Ty, class _IdxTy, class _VecTy> status deserialize( _ReadStreamTy &strm, optional_idx_vector<_Ty, _IdxTy, _VecTy> &value );
+
+/// @brief Write a bimap, as a vector of the keys followed by a vector of the values they map to.
+template<class _WriteStreamTy, class _Kty, class _Vty> status serialize( _WriteStreamTy &strm, const bimap<_Kty, _Vty> &value );
+/// @brief Read a bimap. Returns status::corrupted if a key or value is not unique.
+template<class _ReadStreamTy, class _Kty, class _Vty> status deserialize( _ReadStreamTy &strm, bimap<_Kty, _Vty> &value );
+
+/// @brief Set up a view of a vector of bulk serializable values which is serialized in the stream, without copying the values.
+/// @details The stream must read from a memory source (e.g. a memory_data_source over a mapped_file), and the view points directly into the source memory.
+/// @return status::ok, status::invalid_param if the stream byte order is not the host byte order, or if the values are not aligned in memory, or an error status if the stream fails.
+template<class _ReadStreamTy, class _Ty> status deserialize_view( _ReadStreamTy &strm, vector_view<_Ty> &value );
+
+/// @brief Set up a view of a serialized idx_vector, without copying the values or index. @see deserialize_view(_ReadStreamTy &, vector_view<_Ty> &)
+/// @note The indices are not validated, use idx_vector_view::is_valid() for untrusted data.
+template<class _ReadStreamTy, class _Ty, class _IdxTy> status deserialize_view( _ReadStreamTy &strm, idx_vector_view<_Ty, _IdxTy> &value );
+
+/// @brief Set up a view of a serialized optional_vector, without copying the values. @see deserialize_view(_ReadStreamTy &, vector_view<_Ty> &)
+template<class _ReadStreamTy, class _Ty> status deserialize_view( _ReadStreamTy &strm, optional_vector_view<_Ty> &value );
+
+}
+//namespace ctle
+
+#include "log.h"
+#include "_macros.inl"
+
+namespace ctle
+{
+
+// the magic value of the serialization header ("CTSR")
+constexpr const u32 _serialization_magic = 0x52535443;
+
+// when reading arrays, the destination is grown in steps of at most this many bytes past the data which has
+// actually been read, so a corrupted length never allocates much more memory than the stream contains
+constexpr const size_t _serialization_read_step_size = 16 * 1024 * 1024;
+
+// the max alignment of blocks of bulk serializable values
+constexpr const size_t _serialization_max_alignment = 16;
+
+template<class _WriteStreamTy>
+inline status write_serialization_header( _WriteStreamTy &strm )
+{
+	ctStatusCall( strm.write( _serialization_magic ) );
+	ctStatusCall( strm.write( serialization_format_version ) );
+	return status::ok;
+}
+
+template<class _ReadStreamTy>
+inline status read_serialization_header( _ReadStreamTy &strm )
+{
+	u32 magic = 0;
+	u32 version = 0;
+	ctStatusCall( strm.read( &magic ) );
+	ctStatusCall( strm.read( &version ) );
+	ctValidate( magic == _serialization_magic, status::invalid ) << "The stream does not contain serialized data" << ctValidateEnd;
+	ctValidate( version <= serialization_format_version, status::invalid ) << "The serialized data is version " << version << ", which is newer than the supported version " << serialization_format_version << ctValidateEnd;
+	return status::ok;
+}
+
+template<class _ReadStreamTy>
+inline status _deserialize_count( _ReadStreamTy &strm, size_t &count )
+{
+	u64 value = 0;
+	ctStatusCall( strm.read_varint( value ) );
+	ctValidate( value <= u64( SIZE_MAX ), status::corrupted ) << "The serialized count " << value << " is too large" << ctValidateEnd;
+	count = size_t( value );
+	return status::ok;
+}
+
+// get the next size to grow an array to while reading it, at most doubling the number of values read so far
+inline size_t _deserialize_step( size_t read_count, size_t count, size_t value_size )
+{
+	const size_t step = std::max( std::max( _serialization_read_step_size / value_size, read_count ), size_t( 1 ) );
+	return read_count + std::min( count - read_count, step );
+}
+
+template<class _WriteStreamTy, class _Ty>
+inline typename std::enable_if<is_bulk_serializable<_Ty>::value, status>::type serialize( _WriteStreamTy &strm, const _Ty &value )
+{
+	ctStatusCall( strm.write( value ) );
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty>
+inline typename std::enable_if<is_bulk_serializable<_Ty>::value, status>::type deserialize( _ReadStreamTy &strm, _Ty &value )
+{
+	ctStatusCall( strm.read( &value ) );
+	return status::ok;
+}
+
+template<class _WriteStreamTy>
+inline status serialize( _WriteStreamTy &strm, const std::string &value )
+{
+	ctStatusCall( strm.write_varint( u64( value.size() ) ) );
+	ctStatusCall( strm.write_bytes( (const u8 *)value.data(), value.size() ) );
+	return status::ok;
+}
+
+template<class _ReadStreamTy>
+inline status deserialize( _ReadStreamTy &strm, std::string &value )
+{
+	size_t count = 0;
+	ctStatusCall( _deserialize_count( strm, count ) );
+	value.clear();
+	while( value.size() < count )
+	{
+		const size_t read_count = value.size();
+		value.resize( _deserialize_step( read_count, count, 1 ) );
+		ctStatusCall( strm.read_bytes( (u8 *)&value[read_count], value.size() - read_count ) );
+	}
+	return status::ok;
+}
+
+// the number of padding bytes which aligns the stream position to the alignment of _Ty
+template<class _Ty> inline size_t _serialization_padding( u64 position )
+{
+	static_assert( alignof( _Ty ) <= _serialization_max_alignment, "The alignment of _Ty is larger than the max supported alignment" );
+	return size_t( ( alignof( _Ty ) - ( position % alignof( _Ty ) ) ) % alignof( _Ty ) );
+}
+
+template<class _Ty, class _WriteStreamTy>
+inline status _serialize_align( _WriteStreamTy &strm )
+{
+	static const u8 padding[_serialization_max_alignment] = {};
+	const size_t padding_size = _serialization_padding<_Ty>( strm.get_position() );
+	if( padding_size > 0 )
+	{
+		ctStatusCall( strm.write_bytes( padding, padding_size ) );
+	}
+	return status::ok;
+}
+
+template<class _Ty, class _ReadStreamTy>
+inline status _deserialize_align( _ReadStreamTy &strm )
+{
+	u8 padding[_serialization_max_alignment];
+	const size_t padding_size = _serialization_padding<_Ty>( strm.get_position() );
+	if( padding_size > 0 )
+	{
+		ctStatusCall( strm.read_bytes( padding, padding_size ) );
+	}
+	return status::ok;
+}
+
+// bulk serializable values are written as a single block, aligned to the alignment of the value type
+template<class _WriteStreamTy, class _Ty, class _Alloc>
+inline typename std::enable_if<is_bulk_serializable<_Ty>::value, status>::type _serialize_values( _WriteStreamTy &strm, const std::vector<_Ty, _Alloc> &value )
+{
+	if( value.empty() )
+		return status::ok;
+	ctStatusCall( _serialize_align<_Ty>( strm ) );
+	ctStatusCall( strm.write( value.data(), value.size() ) );
+	return status::ok;
+}
+
+template<class _WriteStreamTy, class _Ty, class _Alloc>
+inline typename std::enable_if<!is_bulk_serializable<_Ty>::value, status>::type _serialize_values( _WriteStreamTy &strm, const std::vector<_Ty, _Alloc> &value )
+{
+	for( const _Ty &item : value )
+	{
+		ctStatusCall( serialize( strm, item ) );
+	}
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty, class _Alloc>
+inline typename std::enable_if<is_bulk_serializable<_Ty>::value, status>::type _deserialize_values( _ReadStreamTy &strm, std::vector<_Ty, _Alloc> &value, size_t count )
+{
+	if( count == 0 )
+		return status::ok;
+	ctStatusCall( _deserialize_align<_Ty>( strm ) );
+	while( value.size() < count )
+	{
+		const size_t read_count = value.size();
+		value.resize( _deserialize_step( read_count, count, sizeof( _Ty ) ) );
+		ctStatusCall( strm.read( &value[read_count], value.size() - read_count ) );
+	}
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty, class _Alloc>
+inline typename std::enable_if<!is_bulk_serializable<_Ty>::value, status>::type _deserialize_values( _ReadStreamTy &strm, std::vector<_Ty, _Alloc> &value, size_t count )
+{
+	while( value.size() < count )
+	{
+		const size_t read_count = value.size();
+		value.resize( _deserialize_step( read_count, count, sizeof( _Ty ) ) );
+		for( size_t inx = read_count; inx < value.size(); ++inx )
+		{
+			ctStatusCall( deserialize( strm, value[inx] ) );
+		}
+	}
+	return status::ok;
+}
+
+template<class _WriteStreamTy, class _Ty, class _Alloc>
+inline status serialize( _WriteStreamTy &strm, const std::vector<_Ty, _Alloc> &value )
+{
+	ctStatusCall( strm.write_varint( u64( value.size() ) ) );
+	ctStatusCall( _serialize_values( strm, value ) );
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty, class _Alloc>
+inline status deserialize( _ReadStreamTy &strm, std::vector<_Ty, _Alloc> &value )
+{
+	size_t count = 0;
+	ctStatusCall( _deserialize_count( strm, count ) );
+	value.clear();
+	ctStatusCall( _deserialize_values( strm, value, count ) );
+	return status::ok;
+}
+
+template<class _WriteStreamTy, class _Alloc>
+inline status serialize( _WriteStreamTy &strm, const std::vector<bool, _Alloc> &value )
+{
+	ctStatusCall( strm.write_varint( u64( value.size() ) ) );
+	std::vector<u8> bytes( value.begin(), value.end() );
+	ctStatusCall( strm.write_bytes( bytes.data(), bytes.size() ) );
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Alloc>
+inline status deserialize( _ReadStreamTy &strm, std::vector<bool, _Alloc> &value )
+{
+	size_t count = 0;
+	ctStatusCall( _deserialize_count( strm, count ) );
+	std::vector<u8> bytes;
+	ctStatusCall( _deserialize_values( strm, bytes, count ) );
+	value.assign( bytes.begin(), bytes.end() );
+	return status::ok;
+}
+
+template<class _WriteStreamTy, class _Ty, class _IdxTy, class _VecTy>
+inline status serialize( _WriteStreamTy &strm, const idx_vector<_Ty, _IdxTy, _VecTy> &value )
+{
+	ctStatusCall( serialize( strm, value.values() ) );
+	ctStatusCall( serialize( strm, value.index() ) );
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty, class _IdxTy, class _VecTy>
+inline status deserialize( _ReadStreamTy &strm, idx_vector<_Ty, _IdxTy, _VecTy> &value )
+{
+	ctStatusCall( deserialize( strm, value.values() ) );
+	ctStatusCall( deserialize( strm, value.index() ) );
+	ctValidate( value.is_valid(), status::corrupted ) << "The serialized idx_vector has indices which are out of bounds" << ctValidateEnd;
+	return status::ok;
+}
+
+// writes the typed index array of a packed_index_vector, in the same format as a std::vector of the index type
+template<class _WriteStreamTy> struct _packed_index_serializer
+{
+	_WriteStreamTy &strm;
+
+	template<class _IdxTy> status operator()( const _IdxTy *indices, size_t count ) const
+	{
+		ctStatusCall( this->strm.write_varint( u64( count ) ) );
+		if( count == 0 )
+			return status::ok;
+		ctStatusCall( _serialize_align<_IdxTy>( this->strm ) );
+		ctStatusCall( this->strm.write( indices, count ) );
+		return status::ok;
+	}
+};
+
+template<class _ReadStreamTy, class _IdxTy>
+inline status _deserialize_packed_indices( _ReadStreamTy &strm, packed_index_vector &value )
+{
+	std::vector<_IdxTy> indices;
+	ctStatusCall( deserialize( strm, indices ) );
+	value.assign( indices.data(), indices.size() );
+	return status::ok;
+}
+
+template<class _WriteStreamTy>
+inline status serialize( _WriteStreamTy &strm, const packed_index_vector &value )
+{
+	ctStatusCall( strm.write( u8( value.width() ) ) );
+	ctStatusCall( value.visit( _packed_index_serializer<_WriteStreamTy>{ strm } ) );
+	return status::ok;
+}
+
+template<class _ReadStreamTy>
+inline status deserialize( _ReadStreamTy &strm, packed_index_vector &value )
+{
+	u8 width = 0;
+	ctStatusCall( strm.read( &width ) );
+	switch( width )
+	{
+		case 1: ctStatusCall( ( _deserialize_packed_indices<_ReadStreamTy, u8>( strm, value ) ) ); break;
+		case 2: ctStatusCall( ( _deserialize_packed_indices<_ReadStreamTy, u16>( strm, value ) ) ); break;
+		case 4: ctStatusCall( ( _deserialize_packed_indices<_ReadStreamTy, u32>( strm, value ) ) ); break;
+		default: ctValidate( false, status::corrupted ) << "The serialized packed_index_vector has an invalid index width " << u32( width ) << ctValidateEnd;
+	}
+	return status::ok;
+}
+
+template<class _WriteStreamTy, class _Ty>
+inline status serialize( _WriteStreamTy &strm, const optional_value<_Ty> &value )
+{
+	ctStatusCall( strm.write( u8( value.has_value() ) ) );
+	if( value.has_value() )
+	{
+		ctStatusCall( serialize( strm, value.value() ) );
+	}
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty>
+inline status deserialize( _ReadStreamTy &strm, optional_value<_Ty> &value )
+{
+	u8 has_value = 0;
+	ctStatusCall( strm.read( &has_value ) );
+	ctValidate( has_value <= 1, status::corrupted ) << "Invalid optional_value flag" << ctValidateEnd;
+	value.reset();
+	if( has_value )
+	{
+		value.set();
+		ctStatusCall( deserialize( strm, value.value() ) );
+	}
+	return status::ok;
+}
+
+template<class _WriteStreamTy, class _Ty, class _Alloc>
+inline status serialize( _WriteStreamTy &strm, const optional_vector<_Ty, _Alloc> &value )
+{
+	ctStatusCall( strm.write( u8( value.has_value() ) ) );
+	if( value.has_value() )
+	{
+		ctStatusCall( serialize( strm, value.vector() ) );
+	}
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty, class _Alloc>
+inline status deserialize( _ReadStreamTy &strm, optional_vector<_Ty, _Alloc> &value )
+{
+	u8 has_value = 0;
+	ctStatusCall( strm.read( &has_value ) );
+	ctValidate( has_value <= 1, status::corrupted ) << "Invalid optional_vector flag" << ctValidateEnd;
+	value.reset();
+	if( has_value )
+	{
+		value.set();
+		ctStatusCall( deserialize( strm, value.vector() ) );
+	}
+	return status::ok;
+}
+
+template<class _WriteStreamTy, class _Ty, class _Alloc>
+inline status serialize( _WriteStreamTy &strm, const nullable_vector<_Ty, _Alloc> &value )
+{
+	ctStatusCall( serialize( strm, value.values() ) );
+	ctStatusCall( serialize( strm, value.validity() ) );
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty, class _Alloc>
+inline status deserialize( _ReadStreamTy &strm, nullable_vector<_Ty, _Alloc> &value )
+{
+	std::vector<_Ty, _Alloc> values;
+	std::vector<u64> validity;
+	ctStatusCall( deserialize( strm, values ) );
+	ctStatusCall( deserialize( strm, validity ) );
+	ctValidate( value.assign( std::move( values ), std::move( validity ) ), status::corrupted ) << "The serialized nullable_vector has a validity bitmap which does not match the values" << ctValidateEnd;
+	return status::ok;
+}
+
+template<class _WriteStreamTy, class _Ty, class _IdxTy, class _VecTy>
+inline status serialize( _WriteStreamTy &strm, const optional_idx_vector<_Ty, _IdxTy, _VecTy> &value )
+{
+	ctStatusCall( strm.write( u8( value.has_value() ) ) );
+	if( value.has_value() )
+	{
+		ctStatusCall( serialize( strm, value.vector() ) );
+	}
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty, class _IdxTy, class _VecTy>
+inline status deserialize( _ReadStreamTy &strm, optional_idx_vector<_Ty, _IdxTy, _VecTy> &value )
+{
+	u8 has_value = 0;
+	ctStatusCall( strm.read( &has_value ) );
+	ctValidate( has_value <= 1, status::corrupted ) << "Invalid optional_idx_vector flag" << ctValidateEnd;
+	value.reset();
+	if( has_value )
+	{
+		value.set();
+		ctStatusCall( deserialize( strm, value.vector() ) );
+	}
+	return status::ok;
+}
+
+template<class _WriteStreamTy, class _Kty, class _Vty>
+inline status serialize( _WriteStreamTy &strm, const bimap<_Kty, _Vty> &value )
+{
+	// gather the keys and values into separate arrays, so bulk serializable keys and values are written as contiguous blocks
+	std::vector<_Kty> keys;
+	std::vector<_Vty> values;
+	keys.reserve( value.size() );
+	values.reserve( value.size() );
+	for( const auto &item : value )
+	{
+		keys.emplace_back( item.first );
+		values.emplace_back( item.second );
+	}
+	ctStatusCall( serialize( strm, keys ) );
+	ctStatusCall( serialize( strm, values ) );
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Kty, class _Vty>
+inline status deserialize( _ReadStreamTy &strm, bimap<_Kty, _Vty> &value )
+{
+	std::vector<_Kty> keys;
+	std::vector<_Vty> values;
+	ctStatusCall( deserialize( strm, keys ) );
+	ctStatusCall( deserialize( strm, values ) );
+	ctValidate( keys.size() == values.size(), status::corrupted ) << "The serialized bimap has " << keys.size() << " keys but " << values.size() << " values" << ctValidateEnd;
+
+	value.clear();
+	for( size_t inx = 0; inx < keys.size(); ++inx )
+	{
+		value.insert( keys[inx], values[inx] );
+	}
+	ctValidate( value.size() == keys.size(), status::corrupted ) << "The serialized bimap has keys or values which are not unique" << ctValidateEnd;
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty>
+inline status deserialize_view( _ReadStreamTy &strm, vector_view<_Ty> &value )
+{
+	static_assert( is_bulk_serializable<_Ty>::value, "Only vectors of bulk serializable values can be viewed" );
+	ctValidate( byte_swap_value_size<_Ty>::value == 0 || strm.get_byte_order() == host_byte_order, status::invalid_param ) << "The values can only be viewed if the stream is in the host byte order" << ctValidateEnd;
+
+	size_t count = 0;
+	ctStatusCall( _deserialize_count( strm, count ) );
+	if( count == 0 )
+	{
+		value = {};
+		return status::ok;
+	}
+	ctStatusCall( _deserialize_align<_Ty>( strm ) );
+	ctValidate( count <= SIZE_MAX / sizeof( _Ty ), status::corrupted ) << "The serialized count " << count << " is too large" << ctValidateEnd;
+
+	const u8 *data = nullptr;
+	ctStatusReturnCall( data, strm.read_in_place( count * sizeof( _Ty ) ) );
+	ctValidate( ( uintptr_t( data ) % alignof( _Ty ) ) == 0, status::invalid_param ) << "The values are not aligned in memory, the source memory must be aligned to at least " << alignof( _Ty ) << " bytes" << ctValidateEnd;
+	value = vector_view<_Ty>( reinterpret_cast<const _Ty *>( data ), count );
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty, class _IdxTy>
+inline status deserialize_view( _ReadStreamTy &strm, idx_vector_view<_Ty, _IdxTy> &value )
+{
+	vector_view<_Ty> values;
+	vector_view<_IdxTy> index;
+	ctStatusCall( deserialize_view( strm, values ) );
+	ctStatusCall( deserialize_view( strm, index ) );
+	value = idx_vector_view<_Ty, _IdxTy>( values, index );
+	return status::ok;
+}
+
+template<class _ReadStreamTy, class _Ty>
+inline status deserialize_view( _ReadStreamTy &strm, optional_vector_view<_Ty> &value )
+{
+	u8 has_value = 0;
+	ctStatusCall( strm.read( &has_value ) );
+	ctValidate( has_value <= 1, status::corrupted ) << "Invalid optional_vector flag" << ctValidateEnd;
+	value.reset();
+	if( has_value )
+	{
+		vector_view<_Ty> values;
+		ctStatusCall( deserialize_view( strm, values ) );
+		value.set( values );
+	}
+	return status::ok;
+}
+
+}
+//namespace ctle
+
+#include "_undef_macros.inl"
+
+#endif//_CTLE_SERIALIZATION_H_
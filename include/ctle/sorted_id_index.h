@@ -0,0 +1,389 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_SORTED_ID_INDEX_H_
+#define _CTLE_SORTED_ID_INDEX_H_
+
+/// @file sorted_id_index.h
+/// @brief Radix sort of uuid and digest arrays, and the sorted_id_index class template, a sorted array index with fast lookups.
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <limits>
+
+#include "fwd.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ctle
+{
+
+/// @brief Sort an array of uuid or digest values, using a stable MSD radix sort on the big-endian bytes.
+/// @details The sort order is the same as operator< of the id types. The ids are scattered by one byte at a time,
+/// most significant byte first, and buckets which are small are finished with an insertion sort. Random ids are
+/// typically fully sorted after 3-4 byte passes. The sort is stable, so ids which are equal keep their relative order.
+/// @tparam _IdTy The id type, uuid or digest<_Size>. Must have a data[] member with the big-endian bytes of the id.
+/// @param ids The ids to sort
+/// @param count The number of ids
+template<class _IdTy> void radix_sort( _IdTy *ids, size_t count );
+
+/// @brief Sort an array of uuid or digest values, and permute a payload array alongside the ids.
+/// @copydetails radix_sort(_IdTy*,size_t)
+/// @param ids The ids to sort
+/// @param payload The payload values, one per id. Each payload value stays with its id.
+/// @param count The number of ids (and payload values)
+template<class _IdTy, class _PayloadTy> void radix_sort( _IdTy *ids, _PayloadTy *payload, size_t count );
+
+/// @brief Sort a vector of uuid or digest values. @see radix_sort(_IdTy*,size_t)
+template<class _IdTy> void radix_sort( std::vector<_IdTy> &ids ) { radix_sort( ids.data(), ids.size() ); }
+
+/// @brief Sort a vector of uuid or digest values, and permute a payload vector alongside. @see radix_sort(_IdTy*,_PayloadTy*,size_t)
+/// @throws std::invalid_argument if the vectors are of different sizes
+template<class _IdTy, class _PayloadTy> void radix_sort( std::vector<_IdTy> &ids, std::vector<_PayloadTy> &payload )
+{
+	if( ids.size() != payload.size() )
+		throw std::invalid_argument( "radix_sort: the ids and payload vectors must be the same size" );
+	radix_sort( ids.data(), payload.data(), ids.size() );
+}
+
+/// @brief sorted_id_index: a sorted set of uuid or digest values, with fast lookups of the position of an id in sorted order.
+/// @details The ids are radix sorted and stored in an Eytzinger (breadth-first binary tree) layout, which is searched
+/// branch-free, with the tree nodes a few levels down prefetched. This keeps the top levels of the tree in the same cache lines
+/// for all searches. The batch find() interleaves multiple searches, so the memory latency of the searches overlap.
+/// @tparam _IdTy The id type, uuid or digest<_Size>.
+/// @tparam _IdxTy The type of the sorted positions, defaults to u32, which limits the index to 2^32-1 ids.
+template<class _IdTy, class _IdxTy /* = u32 */>
+class sorted_id_index
+{
+public:
+	using id_type = _IdTy;
+	using index_type = _IdxTy;
+
+	/// @brief Returned by find() when the id is not found.
+	static constexpr const _IdxTy npos = std::numeric_limits<_IdxTy>::max();
+
+private:
+	// the ids and sorted positions, in eytzinger order, 1-based (index 0 is unused)
+	std::vector<_IdTy> tree_m;
+	std::vector<_IdxTy> position_m;
+	size_t size_m = 0;
+	size_t levels_m = 0;
+
+	size_t build_tree( const std::vector<_IdTy> &sorted, size_t sorted_index, size_t tree_index );
+	size_t lower_bound_node( size_t k ) const;
+
+public:
+	sorted_id_index() = default;
+
+	/// @brief Build the index from a list of ids. The ids are sorted, and duplicates are removed.
+	/// @throws std::length_error if there are too many ids to index using _IdxTy
+	explicit sorted_id_index( std::vector<_IdTy> ids ) { this->build( std::move( ids ) ); }
+
+	/// @brief Build the index from a list of ids. The ids are sorted, and duplicates are removed.
+	/// @throws std::length_error if there are too many ids to index using _IdxTy
+	void build( std::vector<_IdTy> ids );
+
+	/// @brief Build the index from a list of ids which are already sorted and unique.
+	/// @throws std::length_error if there are too many ids to index using _IdxTy
+	void build_from_sorted( const std::vector<_IdTy> &sorted_ids );
+
+	/// @brief Returns the number of (unique) ids in the index.
+	size_t size() const noexcept { return this->size_m; }
+
+	/// @brief Returns true if the index is empty.
+	bool empty() const noexcept { return this->size_m == 0; }
+
+	/// @brief Removes all ids from the index.
+	void clear();
+
+	/// @brief Find the position of an id in the sorted order of the index.
+	/// @return The position of the id in sorted order, or npos if the id is not in the index.
+	_IdxTy find( const _IdTy &id ) const;
+
+	/// @brief Find the positions of a batch of ids. The searches are interleaved, so the memory latency of the searches overlap.
+	/// @param ids The ids to look up
+	/// @param count The number of ids
+	/// @param positions The output positions, one per id, npos for ids which are not in the index
+	void find( const _IdTy *ids, size_t count, _IdxTy *positions ) const;
+
+	/// @brief Find the positions of a batch of ids. @see find(const _IdTy*,size_t,_IdxTy*)
+	std::vector<_IdxTy> find( const std::vector<_IdTy> &ids ) const;
+
+	/// @brief Returns true if the id is in the index.
+	bool contains( const _IdTy &id ) const { return this->find( id ) != npos; }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// prefetch a memory address into the cache, no-op on unsupported compilers
+inline void _sorted_id_index_prefetch( const void *address ) noexcept
+{
+#if defined(_MSC_VER)
+	_mm_prefetch( (const char *)address, _MM_HINT_T0 );
+#elif defined(__GNUC__)
+	__builtin_prefetch( address );
+#else
+	(void)address;
+#endif
+}
+
+// stand-in payload type used when sorting ids without a payload
+struct _radix_sort_no_payload {};
+
+template<class _PayloadTy> inline void _radix_sort_move_payload( _PayloadTy *dest, _PayloadTy *src ) { *dest = std::move( *src ); }
+inline void _radix_sort_move_payload( _radix_sort_no_payload *, _radix_sort_no_payload * ) {}
+
+template<class _IdTy, class _PayloadTy>
+inline void _radix_sort_insertion( _IdTy *ids, _PayloadTy *payload, size_t count )
+{
+	for( size_t inx = 1; inx < count; ++inx )
+	{
+		if( !( ids[inx] < ids[inx - 1] ) )
+			continue;
+
+		_IdTy id = ids[inx];
+		_PayloadTy pl;
+		_radix_sort_move_payload( &pl, &payload[inx] );
+
+		size_t pos = inx;
+		do
+		{
+			ids[pos] = ids[pos - 1];
+			_radix_sort_move_payload( &payload[pos], &payload[pos - 1] );
+			--pos;
+		} while( pos > 0 && id < ids[pos - 1] );
+
+		ids[pos] = id;
+		_radix_sort_move_payload( &payload[pos], &pl );
+	}
+}
+
+// sorts the range in src on the bytes from byte_index and on, using the same range in other as scratch memory.
+// if src_is_final is false, the result is written to other, else the result is left in src.
+template<class _IdTy, class _PayloadTy>
+inline void _radix_sort_msd( _IdTy *src, _PayloadTy *src_payload, _IdTy *other, _PayloadTy *other_payload, size_t count, size_t byte_index, bool src_is_final )
+{
+	constexpr const size_t insertion_sort_limit = 64;
+	constexpr const size_t id_size = sizeof( _IdTy::data );
+
+	// skip all leading bytes which are the same for all ids in the range
+	size_t counts[256];
+	while( count > insertion_sort_limit && byte_index < id_size )
+	{
+		memset( counts, 0, sizeof( counts ) );
+		for( size_t inx = 0; inx < count; ++inx )
+			++counts[src[inx].data[byte_index]];
+		if( counts[src[0].data[byte_index]] != count )
+			break;
+		++byte_index;
+	}
+
+	// if the range is small, or all bytes are used, sort (if needed) and move the data to the final destination
+	if( count <= insertion_sort_limit || byte_index >= id_size )
+	{
+		if( byte_index < id_size )
+			_radix_sort_insertion( src, src_payload, count );
+		if( !src_is_final )
+		{
+			for( size_t inx = 0; inx < count; ++inx )
+			{
+				other[inx] = src[inx];
+				_radix_sort_move_payload( &other_payload[inx], &src_payload[inx] );
+			}
+		}
+		return;
+	}
+
+	// scatter the ids into the buckets in other
+	size_t offsets[256];
+	size_t offset = 0;
+	for( size_t bucket = 0; bucket < 256; ++bucket )
+	{
+		offsets[bucket] = offset;
+		offset += counts[bucket];
+	}
+	for( size_t inx = 0; inx < count; ++inx )
+	{
+		const size_t dest = offsets[src[inx].data[byte_index]]++;
+		other[dest] = src[inx];
+		_radix_sort_move_payload( &other_payload[dest], &src_payload[inx] );
+	}
+
+	// sort each bucket on the next byte, with the roles of the buffers swapped
+	offset = 0;
+	for( size_t bucket = 0; bucket < 256; ++bucket )
+	{
+		if( counts[bucket] > 0 )
+			_radix_sort_msd( &other[offset], &other_payload[offset], &src[offset], &src_payload[offset], counts[bucket], byte_index + 1, !src_is_final );
+		offset += counts[bucket];
+	}
+}
+
+template<class _IdTy>
+inline void radix_sort( _IdTy *ids, size_t count )
+{
+	static_assert( sizeof( _IdTy ) == sizeof( _IdTy::data ), "The id type must be a plain array of big-endian bytes" );
+	if( count < 2 )
+		return;
+
+	// the no-payload arrays are 1 byte per id, and moving the values is a no-op
+	std::vector<_IdTy> scratch( count );
+	std::vector<_radix_sort_no_payload> no_payload( count );
+	std::vector<_radix_sort_no_payload> scratch_no_payload( count );
+	_radix_sort_msd( ids, no_payload.data(), scratch.data(), scratch_no_payload.data(), count, 0, true );
+}
+
+template<class _IdTy, class _PayloadTy>
+inline void radix_sort( _IdTy *ids, _PayloadTy *payload, size_t count )
+{
+	static_assert( sizeof( _IdTy ) == sizeof( _IdTy::data ), "The id type must be a plain array of big-endian bytes" );
+	if( count < 2 )
+		return;
+
+	std::vector<_IdTy> scratch( count );
+	std::vector<_PayloadTy> scratch_payload( count );
+	_radix_sort_msd( ids, payload, scratch.data(), scratch_payload.data(), count, 0, true );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<class _IdTy, class _IdxTy>
+inline size_t sorted_id_index<_IdTy, _IdxTy>::build_tree( const std::vector<_IdTy> &sorted, size_t sorted_index, size_t tree_index )
+{
+	// in-order traversal of the implicit tree, assigns the sorted ids in order
+	if( tree_index <= this->size_m )
+	{
+		sorted_index = this->build_tree( sorted, sorted_index, 2 * tree_index );
+		this->tree_m[tree_index] = sorted[sorted_index];
+		this->position_m[tree_index] = (_IdxTy)sorted_index;
+		++sorted_index;
+		sorted_index = this->build_tree( sorted, sorted_index, 2 * tree_index + 1 );
+	}
+	return sorted_index;
+}
+
+template<class _IdTy, class _IdxTy>
+inline void sorted_id_index<_IdTy, _IdxTy>::build( std::vector<_IdTy> ids )
+{
+	radix_sort( ids );
+
+	// remove duplicates
+	size_t unique_count = 0;
+	for( size_t inx = 0; inx < ids.size(); ++inx )
+	{
+		if( unique_count == 0 || ids[unique_count - 1] != ids[inx] )
+			ids[unique_count++] = ids[inx];
+	}
+	ids.resize( unique_count );
+
+	this->build_from_sorted( ids );
+}
+
+template<class _IdTy, class _IdxTy>
+inline void sorted_id_index<_IdTy, _IdxTy>::build_from_sorted( const std::vector<_IdTy> &sorted_ids )
+{
+	if( sorted_ids.size() >= (size_t)npos )
+		throw std::length_error( "sorted_id_index: too many ids for the index type" );
+
+	this->size_m = sorted_ids.size();
+	this->tree_m.resize( this->size_m + 1 );
+	this->position_m.resize( this->size_m + 1 );
+	this->build_tree( sorted_ids, 0, 1 );
+
+	// number of levels in the tree
+	this->levels_m = 0;
+	for( size_t n = this->size_m; n > 0; n >>= 1 )
+		++this->levels_m;
+}
+
+template<class _IdTy, class _IdxTy>
+inline void sorted_id_index<_IdTy, _IdxTy>::clear()
+{
+	this->tree_m.clear();
+	this->position_m.clear();
+	this->size_m = 0;
+	this->levels_m = 0;
+}
+
+template<class _IdTy, class _IdxTy>
+inline size_t sorted_id_index<_IdTy, _IdxTy>::lower_bound_node( size_t k ) const
+{
+	// k has descended past a leaf. the path is encoded in the bits of k, where a 1 means the search went right.
+	// strip the trailing right turns and the last left turn, to get the node of the lower bound (0 if none)
+	++k;
+	while( ( k & 1 ) == 0 )
+		k >>= 1;
+	return k >> 1;
+}
+
+template<class _IdTy, class _IdxTy>
+inline _IdxTy sorted_id_index<_IdTy, _IdxTy>::find( const _IdTy &id ) const
+{
+	constexpr const size_t prefetch_stride = ( sizeof( _IdTy ) < 64 ) ? ( 64 / sizeof( _IdTy ) ) : 1;
+	const _IdTy *tree = this->tree_m.data();
+	const size_t n = this->size_m;
+
+	size_t k = 1;
+	while( k <= n )
+	{
+		// prefetch the nodes a few levels down, which are in the same cache line
+		if( k * prefetch_stride <= n )
+			_sorted_id_index_prefetch( tree + k * prefetch_stride );
+		k = 2 * k + size_t( tree[k] < id );
+	}
+
+	k = this->lower_bound_node( k );
+	if( k != 0 && tree[k] == id )
+		return this->position_m[k];
+	return npos;
+}
+
+template<class _IdTy, class _IdxTy>
+inline void sorted_id_index<_IdTy, _IdxTy>::find( const _IdTy *ids, size_t count, _IdxTy *positions ) const
+{
+	constexpr const size_t batch_size = 16;
+	const _IdTy *tree = this->tree_m.data();
+	const size_t n = this->size_m;
+
+	size_t k[batch_size];
+	for( size_t start = 0; start < count; start += batch_size )
+	{
+		const size_t batch_count = ( count - start < batch_size ) ? ( count - start ) : batch_size;
+
+		// descend all searches in the batch one level at a time, so the loads are issued in parallel
+		for( size_t inx = 0; inx < batch_count; ++inx )
+			k[inx] = 1;
+		for( size_t level = 0; level < this->levels_m; ++level )
+		{
+			for( size_t inx = 0; inx < batch_count; ++inx )
+			{
+				if( k[inx] <= n )
+					k[inx] = 2 * k[inx] + size_t( tree[k[inx]] < ids[start + inx] );
+			}
+		}
+
+		for( size_t inx = 0; inx < batch_count; ++inx )
+		{
+			const size_t node = this->lower_bound_node( k[inx] );
+			positions[start + inx] = ( node != 0 && tree[node] == ids[start + inx] ) ? this->position_m[node] : npos;
+		}
+	}
+}
+
+template<class _IdTy, class _IdxTy>
+inline std::vector<_IdxTy> sorted_id_index<_IdTy, _IdxTy>::find( const std::vector<_IdTy> &ids ) const
+{
+	std::vector<_IdxTy> positions( ids.size() );
+	this->find( ids.data(), ids.size(), positions.data() );
+	return positions;
+}
+
+}
+//namespace ctle
+
+#endif//_CTLE_SORTED_ID_INDEX_H_
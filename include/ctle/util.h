@@ -4,11 +4,48 @@
 #ifndef _CTLE_UTIL_H_
 #define _CTLE_UTIL_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <type_traits>
+#include <cstdlib>
+#include <new>
 
 namespace ctle
 {
 
+/// @brief Mix the bits of a 64 bit value into a well-distributed 64 bit hash value.
+/// @details Uses the murmur3 64 bit finalizer (fmix64), which is a bijection, so distinct values never collide.
+inline uint64_t hash_mix_64( uint64_t value ) noexcept
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ull;
+	value ^= value >> 33;
+	return value;
+}
+
+/// @brief Calculate a well-distributed hash value of an array of 64 bit words.
+/// @details Each word is mixed into the running hash value, so all bits of all words affect all bits of the result.
+/// @param words pointer to the words to hash
+/// @param count the number of words, must be at least 1
+inline uint64_t hash_mix_64( const uint64_t *words, size_t count ) noexcept
+{
+	uint64_t hval = words[0];
+	for( size_t inx = 1; inx < count; ++inx )
+	{
+		hval = hash_mix_64( hval ) ^ words[inx];
+	}
+	return hash_mix_64( hval );
+}
+
+/// @brief Identity hash functor, which uses the bits of an already uniformly random value directly as hash value.
+/// @details Specializations are implemented for uuid (in uuid.h) and digest (in digest.h). Use as the hash functor 
+/// of a hash table, e.g. std::unordered_map<uuid,_Ty,identity_hash<uuid>> when all keys are truly random (such as version 4 uuids, 
+/// or cryptographic digests), and the cost of the default std::hash mixing should be avoided.
+/// @note Do not use for structured or time-based values, since these will cluster badly in the hash table.
+template<class _Ty> struct identity_hash;
+
 /// @brief assign a value to a variable if the variable is trivially default constructible
 /// @details identity_assign_if_trivially_default_constructible is a conditional template function which:
 ///  - Initializes trivially constructable types by using the = {} assignment. 
@@ -17,6 +54,40 @@ namespace ctle
 template<typename _Ty, typename std::enable_if<std::is_trivially_default_constructible<_Ty>{},bool>::type = true> void identity_assign_if_trivially_default_constructible( _Ty &val ) { val = {}; }
 template<typename _Ty, typename std::enable_if<!std::is_trivially_default_constructible<_Ty>{},bool>::type = true> void identity_assign_if_trivially_default_constructible( _Ty & ) { /*noop*/ }
 
+/// @brief Allocator which aligns all allocations to _Align bytes, e.g. for buffers which are used with direct (unbuffered) file i/o.
+/// @details The allocation is over-allocated, and the original pointer is stored just before the aligned pointer.
+/// @tparam _Align the alignment in bytes, which must be a power of two, and at least the size of a pointer
+template<class _Ty, size_t _Align> class aligned_allocator
+{
+	static_assert( ( _Align & ( _Align - 1 ) ) == 0 && _Align >= sizeof( void * ), "_Align must be a power of two, and at least the size of a pointer" );
+
+public:
+	using value_type = _Ty;
+	template<class _Other> struct rebind { using other = aligned_allocator<_Other, _Align>; };
+
+	aligned_allocator() noexcept = default;
+	template<class _Other> aligned_allocator( const aligned_allocator<_Other, _Align> & ) noexcept {}
+
+	_Ty *allocate( size_t count )
+	{
+		void *raw = std::malloc( count * sizeof( _Ty ) + _Align + sizeof( void * ) );
+		if( !raw )
+			throw std::bad_alloc();
+		const uintptr_t aligned = ( (uintptr_t)raw + sizeof( void * ) + _Align - 1 ) & ~( uintptr_t )( _Align - 1 );
+		( (void **)aligned )[-1] = raw;
+		return (_Ty *)aligned;
+	}
+
+	void deallocate( _Ty *ptr, size_t ) noexcept
+	{
+		if( ptr )
+			std::free( ( (void **)ptr )[-1] );
+	}
+
+	template<class _Other> bool operator==( const aligned_allocator<_Other, _Align> & ) const noexcept { return true; }
+	template<class _Other> bool operator!=( const aligned_allocator<_Other, _Align> & ) const noexcept { return false; }
+};
+
 /// @brief nil object with a static allocation
 /// @details nil_object is a static class with an allocated object, which can be 
 /// used to point to or reference an invalid object, when nullptr is not applicable or allowed.
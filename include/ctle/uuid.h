@@ -11,6 +11,9 @@
 #include <functional>
 #include <iosfwd>
 
+#include "endianness.h"
+#include "util.h"
+
 namespace ctle
 {
 /// @brief uuid implements a portable, variant 1, version 4 (RNG generated) of uuid implementation.
@@ -38,26 +41,13 @@ struct uuid
 
 inline bool uuid::operator<( const ctle::uuid &right ) const noexcept
 {
-	const uint8_t *u1 = this->data;
-	const uint8_t *u2 = right.data;
-
-	// uuid is stored big-endian, so MSB is first byte, LSB is last byte
-	size_t n = 16;
-	do
-	{
-		if( *u1 != *u2 )	// not equal, early exit, check if more or less than
-		{
-			if( *u1 < *u2 )
-				return true;	// less than
-			else
-				return false;	// more than
-		}
-		++u1;
-		++u2;
-		--n;
-	} while( n>0 );
-
-	return false; // equal, so not less
+	// uuid is stored big-endian, so MSB is first byte, LSB is last byte. 
+	// load the two words as big-endian values, and compare them without branching
+	const uint64_t l0 = from_bigendian<uint64_t>( &this->data[0] );
+	const uint64_t r0 = from_bigendian<uint64_t>( &right.data[0] );
+	const uint64_t l1 = from_bigendian<uint64_t>( &this->data[8] );
+	const uint64_t r1 = from_bigendian<uint64_t>( &right.data[8] );
+	return ( l0 < r0 ) | ( ( l0 == r0 ) & ( l1 < r1 ) );
 };
 
 inline bool uuid::operator==( const ctle::uuid &right ) const noexcept
@@ -72,6 +62,17 @@ inline bool uuid::operator!=( const ctle::uuid &right ) const noexcept
 		|| ( this->_data_q[1] != right._data_q[1] );
 };
 
+/// @brief Identity hash of a uuid, which xors the two words of the uuid. Only use for version 4 (random) uuids.
+template <>
+struct identity_hash<uuid>
+{
+	std::size_t operator()( const uuid &val ) const noexcept
+	{
+		static_assert( sizeof( std::size_t ) == sizeof( std::uint64_t ), "The hashing code only works for 64bit size_t" );
+		return val._data_q[0] ^ val._data_q[1];
+	}
+};
+
 }
 //namespace ctle
 
@@ -85,7 +86,7 @@ struct hash<ctle::uuid>
 	{
 		static_assert( sizeof( std::size_t ) == sizeof( std::uint64_t ), "The hashing code only works for 64bit size_t" );
 		static_assert( sizeof( ctle::uuid ) == 16, "The uuid must be 16 bytes in size" );
-		return val._data_q[0] ^ val._data_q[1];
+		return ctle::hash_mix_64( val._data_q, 2 );
 	}
 };
 
@@ -0,0 +1,212 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_VALUE_EQUALITY_H_
+#define _CTLE_VALUE_EQUALITY_H_
+
+/// @file value_equality.h
+/// @brief Contains the bitwise_equality and quantized_equality policies, which hash and compare values when deduplicating them, and the merge function of idx_vectors.
+
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "fwd.h"
+#include "status.h"
+#include "status_error.h"
+#include "util.h"
+#include "idx_vector.h"
+
+namespace ctle
+{
+
+// the scalar component type of the values which are quantized by quantized_equality
+template<class _Ty> struct _quantized_component { using type = _Ty; };
+template<class _Ty, size_t _Size> struct _quantized_component<n_tup<_Ty, _Size>> { using type = _Ty; };
+template<class _Ty, size_t _InnerSize, size_t _OuterSize> struct _quantized_component<mn_tup<_Ty, _InnerSize, _OuterSize>> { using type = _Ty; };
+
+/// @brief Equality policy of idx_vector_builder and merge(), where values are equal if all their bytes are equal.
+/// @details The values must be trivially copyable and must not have padding bytes. Note that for floating point values, 0.0 and -0.0 are
+/// different values, and NaN values are equal to NaN values with the same bits.
+template<class _Ty> struct bitwise_equality
+{
+	static_assert( std::is_trivially_copyable<_Ty>::value, "bitwise_equality requires a trivially copyable type" );
+
+	u64 hash( const _Ty &value ) const noexcept;
+	bool equal( const _Ty &a, const _Ty &b ) const noexcept { return memcmp( &a, &b, sizeof( _Ty ) ) == 0; }
+};
+
+/// @brief Equality policy of idx_vector_builder and merge(), where floating point values are equal if they quantize to the same multiple of epsilon.
+/// @details The policy works on arithmetic values, and n_tup and mn_tup of arithmetic values, where each component is quantized
+/// separately. Values are equal if all of their components round to the same multiple of epsilon, which merges values which are
+/// within epsilon/2 of the same grid point (but two values closer than epsilon can still round to different grid points).
+/// Integer components are not quantized, and all NaN values are equal.
+template<class _Ty> class quantized_equality
+{
+public:
+	using component_type = typename _quantized_component<_Ty>::type;
+	static constexpr const size_t component_count = sizeof( _Ty ) / sizeof( component_type );
+
+	/// @brief Set up the policy
+	/// @param epsilon the quantization step, must be larger than 0
+	/// @throws ctle::status_error if epsilon is not larger than 0
+	explicit quantized_equality( double epsilon );
+
+	/// @brief Get the quantization step
+	double epsilon() const noexcept { return this->epsilon_m; }
+
+	u64 hash( const _Ty &value ) const noexcept;
+	bool equal( const _Ty &a, const _Ty &b ) const noexcept;
+
+private:
+	double epsilon_m;
+	double inv_epsilon_m;
+
+	void quantize( const _Ty &value, i64 *keys ) const noexcept;
+};
+
+template<class _Ty> inline i64 _quantize_component( _Ty value, double inv_epsilon, std::true_type /*is_floating_point*/ ) noexcept
+{
+	if( std::isnan( value ) )
+		return std::numeric_limits<i64>::min();
+	const double scaled = std::floor( double( value ) * inv_epsilon + 0.5 );
+	if( scaled >= 9.2e18 )
+		return std::numeric_limits<i64>::max();
+	if( scaled <= -9.2e18 )
+		return std::numeric_limits<i64>::min() + 1;
+	return i64( scaled );
+}
+
+template<class _Ty> inline i64 _quantize_component( _Ty value, double, std::false_type /*is_floating_point*/ ) noexcept
+{
+	return i64( value );
+}
+
+template<class _Ty>
+inline u64 bitwise_equality<_Ty>::hash( const _Ty &value ) const noexcept
+{
+	u64 words[( sizeof( _Ty ) + 7 ) / 8] = {};
+	memcpy( words, &value, sizeof( _Ty ) );
+	return hash_mix_64( words, ( sizeof( _Ty ) + 7 ) / 8 );
+}
+
+template<class _Ty>
+inline quantized_equality<_Ty>::quantized_equality( double epsilon )
+	: epsilon_m( epsilon )
+	, inv_epsilon_m( 1.0 / epsilon )
+{
+	static_assert( std::is_arithmetic<component_type>::value && sizeof( _Ty ) % sizeof( component_type ) == 0, "quantized_equality requires an arithmetic type, or a n_tup or mn_tup of an arithmetic type" );
+	if( !( epsilon > 0 ) )
+		throw ctle::status_error( status::invalid_param, "The quantization epsilon must be larger than 0" );
+}
+
+template<class _Ty>
+inline void quantized_equality<_Ty>::quantize( const _Ty &value, i64 *keys ) const noexcept
+{
+	component_type components[component_count];
+	memcpy( components, &value, sizeof( _Ty ) );
+	for( size_t inx = 0; inx < component_count; ++inx )
+		keys[inx] = _quantize_component( components[inx], this->inv_epsilon_m, std::is_floating_point<component_type>() );
+}
+
+template<class _Ty>
+inline u64 quantized_equality<_Ty>::hash( const _Ty &value ) const noexcept
+{
+	i64 keys[component_count];
+	this->quantize( value, keys );
+	return hash_mix_64( (const u64 *)keys, component_count );
+}
+
+template<class _Ty>
+inline bool quantized_equality<_Ty>::equal( const _Ty &a, const _Ty &b ) const noexcept
+{
+	i64 keys_a[component_count];
+	i64 keys_b[component_count];
+	this->quantize( a, keys_a );
+	this->quantize( b, keys_b );
+	return memcmp( keys_a, keys_b, sizeof( keys_a ) ) == 0;
+}
+
+/// @brief Append the items of another idx_vector to an idx_vector, sharing values which are equal to values already in the vector.
+/// @details The values of dest and its indices are not changed. The values of the other vector which are referenced by its
+/// index are looked up in a hash table of the values, and values which are not found are appended in the order of their first use.
+/// Unreferenced values of the other vector are not added. All indices of the other vector must be valid, see idx_vector::is_valid().
+/// @param dest The vector to append to
+/// @param other The vector to append, which may be dest
+/// @param equality The equality policy, with hash(value) and equal(a,b) methods, e.g. bitwise_equality or quantized_equality
+template<class _Ty, class _IdxTy, class _VecTy, class _EqualityTy = bitwise_equality<_Ty>>
+inline void merge( idx_vector<_Ty, _IdxTy, _VecTy> &dest, const idx_vector<_Ty, _IdxTy, _VecTy> &other, const _EqualityTy &equality = _EqualityTy() )
+{
+	if( &other == &dest )
+	{
+		const idx_vector<_Ty, _IdxTy, _VecTy> copy( other );
+		merge( dest, copy, equality );
+		return;
+	}
+
+	auto &values = dest.values();
+	auto &index = dest.index();
+	const auto &other_values = other.values();
+	const auto &other_index = other.index();
+	const size_t npos = ~size_t( 0 );
+
+	// open-addressing hash table of value index + 1, where 0 is an empty slot. the table is at most half full
+	size_t slot_count = 16;
+	while( slot_count < ( values.size() + other_values.size() ) * 2 )
+		slot_count *= 2;
+	const size_t mask = slot_count - 1;
+	std::vector<u32> slots( slot_count, 0 );
+	std::vector<u64> hashes;
+	hashes.reserve( values.size() + other_values.size() );
+	auto insert_slot = [&]( size_t value_index, u64 hash )
+	{
+		size_t pos = size_t( hash ) & mask;
+		while( slots[pos] != 0 )
+			pos = ( pos + 1 ) & mask;
+		slots[pos] = u32( value_index + 1 );
+	};
+	auto find = [&]( const _Ty &value, u64 hash ) -> size_t
+	{
+		for( size_t pos = size_t( hash ) & mask; slots[pos] != 0; pos = ( pos + 1 ) & mask )
+		{
+			const size_t value_index = slots[pos] - 1;
+			if( hashes[value_index] == hash && equality.equal( values[value_index], value ) )
+				return value_index;
+		}
+		return npos;
+	};
+
+	for( size_t value_index = 0; value_index < values.size(); ++value_index )
+	{
+		hashes.push_back( equality.hash( values[value_index] ) );
+		insert_slot( value_index, hashes.back() );
+	}
+
+	// append the indices of the other vector, and look up (or add) each referenced value on first use
+	std::vector<size_t> remap( other_values.size(), npos );
+	index.reserve( index.size() + other_index.size() );
+	for( const size_t idx : other_index )
+	{
+		if( remap[idx] == npos )
+		{
+			const _Ty &value = other_values[idx];
+			const u64 hash = equality.hash( value );
+			remap[idx] = find( value, hash );
+			if( remap[idx] == npos )
+			{
+				remap[idx] = values.size();
+				values.push_back( value );
+				hashes.push_back( hash );
+				insert_slot( remap[idx], hash );
+			}
+		}
+		index.push_back( typename _IdxTy::value_type( remap[idx] ) );
+	}
+}
+
+}
+//namespace ctle
+
+#endif//_CTLE_VALUE_EQUALITY_H_
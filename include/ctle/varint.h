@@ -0,0 +1,321 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_VARINT_H_
+#define _CTLE_VARINT_H_
+
+/// @file varint.h
+/// @brief Variable length integer encodings: LEB128 varints, zigzag encoding of signed values, and stream-vbyte encoding of u32 arrays, with optional delta coding.
+
+#include <cstring>
+
+#include "fwd.h"
+#include "status.h"
+#include "status_return.h"
+#include "endianness.h"
+#include "_cpu_features.h"
+
+namespace ctle
+{
+
+/// @brief The max number of bytes of a LEB128 encoded u64 value
+constexpr const size_t varint_max_size = 10;
+
+/// @brief Map a signed value to an unsigned value, so that values close to zero (positive or negative) get small unsigned values
+inline u64 zigzag_encode( i64 value ) { return ( u64( value ) << 1 ) ^ u64( value >> 63 ); }
+
+/// @brief Map a zigzag encoded value back to the signed value
+inline i64 zigzag_decode( u64 value ) { return i64( value >> 1 ) ^ -i64( value & 1 ); }
+
+/// @brief Encode a value as a LEB128 varint, 7 bits per byte, with the high bit set on all bytes but the last.
+/// @param value the value to encode
+/// @param dest the destination, which must have room for at least varint_max_size bytes
+/// @return the number of bytes written, 1 to varint_max_size
+inline size_t varint_encode( u64 value, u8 *dest )
+{
+	size_t count = 0;
+	while( value >= 0x80 )
+	{
+		dest[count++] = u8( value | 0x80 );
+		value >>= 7;
+	}
+	dest[count++] = u8( value );
+	return count;
+}
+
+/// @brief Decode a LEB128 varint.
+/// @param src the source data
+/// @param src_size the number of bytes available in the source
+/// @param value receives the decoded value
+/// @return the number of bytes read, or 0 if the varint is truncated, longer than varint_max_size bytes, or does not fit in 64 bits
+inline size_t varint_decode( const u8 *src, size_t src_size, u64 &value )
+{
+	// fast path, single byte values
+	if( src_size > 0 && src[0] < 0x80 )
+	{
+		value = src[0];
+		return 1;
+	}
+
+	u64 result = 0;
+	const size_t max_count = ( src_size < varint_max_size ) ? src_size : varint_max_size;
+	for( size_t inx = 0; inx < max_count; ++inx )
+	{
+		const u8 byte = src[inx];
+		// the last byte only holds bit 63, any higher bits would be silently dropped
+		if( inx == varint_max_size - 1 && byte > 0x01 )
+			return 0;
+		result |= u64( byte & 0x7f ) << ( 7 * inx );
+		if( byte < 0x80 )
+		{
+			value = result;
+			return inx + 1;
+		}
+	}
+	return 0;
+}
+
+/// @brief Get the number of control bytes of a stream-vbyte encoded array of count values
+inline size_t stream_vbyte_control_size( size_t count ) { return ( count + 3 ) / 4; }
+
+/// @brief Get the max size of a stream-vbyte encoded array of count values, to use as the destination size of stream_vbyte_encode()
+inline size_t stream_vbyte_bound( size_t count ) { return stream_vbyte_control_size( count ) + count * 4; }
+
+/// @brief Get the size of the data bytes of a stream-vbyte encoded array, from the control bytes.
+/// @param control the control bytes, stream_vbyte_control_size(count) bytes
+/// @param count the number of values in the array
+size_t stream_vbyte_data_size( const u8 *control, size_t count );
+
+/// @brief Encode an array of u32 values using stream-vbyte.
+/// @details Each value is stored in 1 to 4 little-endian bytes. The byte lengths of four values are packed into a control byte, and all
+/// control bytes are stored first, followed by the data bytes. Since the lengths of four values are known from a single control byte,
+/// the decoder can decode four values at once, with a single SIMD shuffle (if the cpu supports SSSE3, which is checked at runtime).
+/// If delta is set, the differences between consecutive values are encoded (starting from 0), which makes sorted/monotone sequences encode into small values.
+/// @param src the source values
+/// @param count the number of values
+/// @param dest the destination, which must have room for at least stream_vbyte_bound(count) bytes
+/// @param delta if true, the values are delta coded
+/// @return the number of bytes written
+size_t stream_vbyte_encode( const u32 *src, size_t count, u8 *dest, bool delta = false );
+
+/// @brief Decode an array of u32 values encoded with stream_vbyte_encode().
+/// @param src the encoded data
+/// @param src_size the number of bytes available in the source
+/// @param dest the destination of the values, which must have room for count values
+/// @param count the number of values to decode
+/// @param delta if true, the values are delta coded
+/// @return status::ok and the number of bytes read, or status::corrupted if the source is too small for the encoded data
+status_return<status, size_t> stream_vbyte_decode( const u8 *src, size_t src_size, u32 *dest, size_t count, bool delta = false );
+
+// decode stream-vbyte values from separate control and data areas. the data area must be exactly stream_vbyte_data_size(control, count) bytes.
+// The SSSE3 or scalar kernel is selected at runtime, from the capabilities of the cpu.
+void _stream_vbyte_decode( const u8 *control, const u8 *data, size_t data_size, u32 *dest, size_t count, bool delta );
+
+}
+//namespace ctle
+
+#ifdef CTLE_IMPLEMENTATION
+
+#include "log.h"
+#include "_macros.inl"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define _CTLE_VARINT_X86
+#include <immintrin.h>
+#endif
+
+// GCC and Clang need the target instruction set of functions which use intrinsics beyond the compiler flags, MSVC does not
+#if defined(__GNUC__)
+#define _CTLE_VARINT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define _CTLE_VARINT_TARGET(isa)
+#endif
+
+namespace ctle
+{
+
+// lookup tables of the stream-vbyte control bytes
+struct _stream_vbyte_tables
+{
+	// the number of data bytes of the four values of a control byte
+	u8 length[256];
+
+	// the SSSE3 shuffle masks which expand the data bytes of the four values of a control byte into four u32
+	u8 shuffle[256][16];
+
+	_stream_vbyte_tables()
+	{
+		for( size_t control = 0; control < 256; ++control )
+		{
+			size_t offset = 0;
+			for( size_t value = 0; value < 4; ++value )
+			{
+				const size_t value_length = ( ( control >> ( 2 * value ) ) & 3 ) + 1;
+				for( size_t byte = 0; byte < 4; ++byte )
+					this->shuffle[control][value * 4 + byte] = ( byte < value_length ) ? u8( offset + byte ) : u8( 0xff );
+				offset += value_length;
+			}
+			this->length[control] = u8( offset );
+		}
+	}
+};
+
+static const _stream_vbyte_tables &_stream_vbyte_get_tables()
+{
+	static const _stream_vbyte_tables tables;
+	return tables;
+}
+
+size_t stream_vbyte_data_size( const u8 *control, size_t count )
+{
+	const _stream_vbyte_tables &tables = _stream_vbyte_get_tables();
+	const size_t full_controls = count / 4;
+	size_t size = 0;
+	for( size_t inx = 0; inx < full_controls; ++inx )
+		size += tables.length[control[inx]];
+
+	// the last control byte may be partial
+	for( size_t value = 0; value < ( count % 4 ); ++value )
+		size += ( ( control[full_controls] >> ( 2 * value ) ) & 3 ) + 1;
+	return size;
+}
+
+size_t stream_vbyte_encode( const u32 *src, size_t count, u8 *dest, bool delta )
+{
+	u8 *control = dest;
+	u8 *data = dest + stream_vbyte_control_size( count );
+	u32 previous = 0;
+
+	for( size_t inx = 0; inx < count; inx += 4 )
+	{
+		const size_t values = ( count - inx < 4 ) ? ( count - inx ) : 4;
+		u8 control_byte = 0;
+		for( size_t value = 0; value < values; ++value )
+		{
+			u32 v = src[inx + value];
+			if( delta )
+			{
+				const u32 current = v;
+				v -= previous;
+				previous = current;
+			}
+			const u32 code = u32( v > 0xff ) + u32( v > 0xffff ) + u32( v > 0xffffff );
+			control_byte |= u8( code << ( 2 * value ) );
+
+			// always copy 4 bytes, since the destination is at least stream_vbyte_bound(count) bytes, this never overruns
+			const u8 bytes[4] = { u8( v ), u8( v >> 8 ), u8( v >> 16 ), u8( v >> 24 ) };
+			memcpy( data, bytes, 4 );
+			data += code + 1;
+		}
+		*control++ = control_byte;
+	}
+
+	return size_t( data - dest );
+}
+
+status_return<status, size_t> stream_vbyte_decode( const u8 *src, size_t src_size, u32 *dest, size_t count, bool delta )
+{
+	const size_t control_size = stream_vbyte_control_size( count );
+	ctValidate( src_size >= control_size, status::corrupted ) << "The stream-vbyte data is truncated" << ctValidateEnd;
+	const size_t data_size = stream_vbyte_data_size( src, count );
+	ctValidate( src_size - control_size >= data_size, status::corrupted ) << "The stream-vbyte data is truncated" << ctValidateEnd;
+
+	_stream_vbyte_decode( src, src + control_size, data_size, dest, count, delta );
+	return control_size + data_size;
+}
+
+// decode the values from inx to count one by one. previous is the last decoded value, if delta coded. 
+// on little-endian hosts, load 4 bytes and mask while it is safe to over-read
+static void _stream_vbyte_decode_scalar( const u8 *control, const u8 *data, const u8 *data_end, u32 *dest, size_t inx, size_t count, bool delta, u32 previous )
+{
+	static const u32 length_mask[4] = { 0xff, 0xffff, 0xffffff, 0xffffffff };
+	for( ; inx < count; ++inx )
+	{
+		const size_t length = ( ( control[inx / 4] >> ( 2 * ( inx % 4 ) ) ) & 3 ) + 1;
+		u32 v = 0;
+		if( host_is_little_endian && data_end - data >= 4 )
+		{
+			memcpy( &v, data, 4 );
+			v &= length_mask[length - 1];
+		}
+		else
+		{
+			for( size_t byte = 0; byte < length; ++byte )
+				v |= u32( data[byte] ) << ( 8 * byte );
+		}
+		data += length;
+		if( delta )
+		{
+			v += previous;
+			previous = v;
+		}
+		dest[inx] = v;
+	}
+}
+
+static void _stream_vbyte_decode_generic( const u8 *control, const u8 *data, size_t data_size, u32 *dest, size_t count, bool delta )
+{
+	_stream_vbyte_decode_scalar( control, data, data + data_size, dest, 0, count, delta, 0 );
+}
+
+#if defined(_CTLE_VARINT_X86)
+
+_CTLE_VARINT_TARGET("ssse3") static void _stream_vbyte_decode_ssse3( const u8 *control, const u8 *data, size_t data_size, u32 *dest, size_t count, bool delta )
+{
+	const _stream_vbyte_tables &tables = _stream_vbyte_get_tables();
+	const u8 *data_end = data + data_size;
+	size_t inx = 0;
+
+	// decode four values per control byte, while it is safe to load 16 data bytes
+	__m128i prefix = _mm_setzero_si128();
+	while( count - inx >= 4 && data_end - data >= 16 )
+	{
+		const u8 control_byte = control[inx / 4];
+		const __m128i shuffle = _mm_loadu_si128( (const __m128i *)tables.shuffle[control_byte] );
+		__m128i values = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)data ), shuffle );
+		if( delta )
+		{
+			// prefix sum of the four deltas, added to the last value of the previous group
+			values = _mm_add_epi32( values, _mm_slli_si128( values, 4 ) );
+			values = _mm_add_epi32( values, _mm_slli_si128( values, 8 ) );
+			values = _mm_add_epi32( values, prefix );
+			prefix = _mm_shuffle_epi32( values, 0xff );
+		}
+		_mm_storeu_si128( (__m128i *)&dest[inx], values );
+		data += tables.length[control_byte];
+		inx += 4;
+	}
+
+	_stream_vbyte_decode_scalar( control, data, data_end, dest, inx, count, delta, ( delta && inx > 0 ) ? dest[inx - 1] : 0 );
+}
+
+#endif
+
+typedef void ( *_stream_vbyte_decode_func )( const u8 *control, const u8 *data, size_t data_size, u32 *dest, size_t count, bool delta );
+
+static _stream_vbyte_decode_func _stream_vbyte_decode_select()
+{
+#if defined(_CTLE_VARINT_X86)
+	if( _cpu_has_ssse3() )
+		return &_stream_vbyte_decode_ssse3;
+#endif
+	return &_stream_vbyte_decode_generic;
+}
+
+void _stream_vbyte_decode( const u8 *control, const u8 *data, size_t data_size, u32 *dest, size_t count, bool delta )
+{
+	// the kernel is selected on first use
+	static const _stream_vbyte_decode_func kernel = _stream_vbyte_decode_select();
+	kernel( control, data, data_size, dest, count, delta );
+}
+
+}
+//namespace ctle
+
+#include "_undef_macros.inl"
+
+#undef _CTLE_VARINT_TARGET
+
+#endif//CTLE_IMPLEMENTATION
+
+#endif//_CTLE_VARINT_H_
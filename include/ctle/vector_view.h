@@ -0,0 +1,164 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+#pragma once
+#ifndef _CTLE_VECTOR_VIEW_H_
+#define _CTLE_VECTOR_VIEW_H_
+
+/// @file vector_view.h
+/// @brief Contains the vector_view, idx_vector_view and optional_vector_view class templates, read-only views of arrays in memory owned by someone else, e.g. a memory mapped file.
+
+#include <stdexcept>
+
+#include "fwd.h"
+#include "optional_value.h"
+
+namespace ctle
+{
+
+/// @brief vector_view: A read-only view of a contiguous array of values, in memory which is owned by someone else.
+/// @details The view never allocates or copies the values, and the memory must be kept alive while the view is used.
+/// @tparam _Ty The value type.
+template<class _Ty> class vector_view
+{
+public:
+	using value_type = _Ty;
+	using size_type = size_t;
+	using const_pointer = const _Ty *;
+	using const_reference = const _Ty &;
+	using const_iterator = const _Ty *;
+
+private:
+	const _Ty *data_m = nullptr;
+	size_type size_m = 0;
+
+public:
+	vector_view() = default;
+	vector_view( const _Ty *_data, size_type _size ) noexcept : data_m( _data ), size_m( _size ) {}
+
+	/// @brief Get a reference to the value at the given index. The index is not bounds checked.
+	const_reference operator[]( size_type _idx ) const { return this->data_m[_idx]; }
+
+	/// @brief Get a reference to the value at the given index.
+	/// @throws std::out_of_range if the index is out of bounds
+	const_reference at( size_type _idx ) const
+	{
+		if( _idx >= this->size_m )
+		{
+			throw std::out_of_range( "vector_view index out of range" );
+		}
+		return this->data_m[_idx];
+	}
+
+	/// @brief Get the number of values
+	size_type size() const noexcept { return this->size_m; }
+
+	/// @brief Check if the view is empty
+	bool empty() const noexcept { return this->size_m == 0; }
+
+	/// @brief Get a pointer to the values
+	const_pointer data() const noexcept { return this->data_m; }
+
+	const_iterator begin() const noexcept { return this->data_m; }
+	const_iterator end() const noexcept { return this->data_m + this->size_m; }
+};
+
+/// @brief idx_vector_view: A read-only view of an idx_vector, with the values and index in memory which is owned by someone else.
+/// @details The view has the same read surface as idx_vector, but never allocates or copies the values or index.
+/// @tparam _Ty The value type.
+/// @tparam _IdxTy The index value type, defaults to i32, the index value type of the default idx_vector.
+template<class _Ty, class _IdxTy /* = i32 */> class idx_vector_view
+{
+public:
+	using value_type = _Ty;
+	using values_vector_type = vector_view<_Ty>;
+	using index_vector_type = vector_view<_IdxTy>;
+	using size_type = size_t;
+	using const_reference = const _Ty &;
+
+private:
+	values_vector_type values_m;
+	index_vector_type index_m;
+
+public:
+	idx_vector_view() = default;
+	idx_vector_view( const values_vector_type &_values, const index_vector_type &_index ) noexcept : values_m( _values ), index_m( _index ) {}
+
+	/// @brief Get a reference to the value which the index at the given position points to.
+	/// @note Neither the position, nor the index at the position, is bounds checked. Use is_valid() to validate the index of untrusted data.
+	const_reference operator[]( size_type _idx ) const
+	{
+		return this->values_m[size_type( this->index_m[_idx] )];
+	}
+
+	/// @brief Get the size of the index vector
+	size_type size() const noexcept { return this->index_m.size(); }
+
+	/// @brief Get the index vector
+	const index_vector_type &index() const noexcept { return this->index_m; }
+
+	/// @brief Get the values vector
+	const values_vector_type &values() const noexcept { return this->values_m; }
+
+	/// @brief Validate the index vector, checking that all indices are within the bounds of the values vector
+	/// @return true if the index vector is valid, false otherwise
+	bool is_valid() const
+	{
+		const size_type values_size = this->values_m.size();
+		for( const _IdxTy idx : this->index_m )
+		{
+			// negative indices convert to large values, which are out of bounds
+			if( size_type( idx ) >= values_size )
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+/// @brief optional_vector_view: A read-only view of an optional_vector, with the values in memory which is owned by someone else.
+/// @tparam _Ty The value type.
+template<class _Ty> class optional_vector_view
+{
+public:
+	using value_type = _Ty;
+	using size_type = size_t;
+	using const_reference = const _Ty &;
+
+private:
+	vector_view<_Ty> vector_m;
+	bool has_value_m = false;
+
+public:
+	optional_vector_view() = default;
+	explicit optional_vector_view( const vector_view<_Ty> &_vector ) noexcept : vector_m( _vector ), has_value_m( true ) {}
+
+	/// @brief Reset the view, has_value() will return false.
+	void reset() noexcept { this->has_value_m = false; this->vector_m = {}; }
+
+	/// @brief Set the view, has_value() will return true.
+	void set( const vector_view<_Ty> &_vector ) noexcept { this->has_value_m = true; this->vector_m = _vector; }
+
+	/// @brief Check if the optional_vector_view has a value.
+	bool has_value() const noexcept { return this->has_value_m; }
+
+	/// @brief Get the view of the values.
+	/// @throws ctle::bad_optional_value_access if the optional_vector_view has no value.
+	const vector_view<_Ty> &vector() const { if( !this->has_value_m ) { throw ctle::bad_optional_value_access( "optional_vector_view has no value" ); } return this->vector_m; }
+
+	/// @brief Get the view of the values.
+	/// @throws ctle::bad_optional_value_access if the optional_vector_view has no value.
+	const vector_view<_Ty> &values() const { return vector(); }
+
+	/// @brief Get a reference to the value at the given index. The index is not bounds checked.
+	/// @throws ctle::bad_optional_value_access if the optional_vector_view has no value.
+	const_reference operator[]( size_type _idx ) const { return this->vector()[_idx]; }
+
+	/// @brief Get the number of values, or 0 if the optional_vector_view has no value.
+	size_type size() const noexcept { return this->vector_m.size(); }
+};
+
+}
+//namespace ctle
+
+#endif//_CTLE_VECTOR_VIEW_H_
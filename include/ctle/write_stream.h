@@ -5,30 +5,48 @@
 #define _CTLE_WRITE_STREAM_H_
 
 #include <vector>
+#include <type_traits>
+#include <algorithm>
 
 #include "fwd.h"
 #include "status.h"
 #include "status_return.h"
 #include "hasher.h"
 #include "file_funcs.h"
+#include "util.h"
+#include "varint.h"
+#include "endianness.h"
 
 namespace ctle
 {
+
+// memory data destinations define a static is_memory_data_destination member, and are written to directly by write_stream
+template<class _Ty, class = void> struct _is_memory_data_destination : std::false_type {};
+template<class _Ty> struct _is_memory_data_destination<_Ty, typename std::enable_if<_Ty::is_memory_data_destination>::type> : std::true_type {};
+
 // base class for a write_stream, a read-only input stream which is designed for 
 // streaming data sequentially, using a memory buffer, while also calculating a hash on the input stream.
+// If the destination is a memory destination (e.g. memory_data_destination), the data is written directly to the 
+// destination, and no intermediate buffer is used.
+// The stream can be set up to write a declared byte order, in which case arithmetic values (see byte_swap_value_size) 
+// which are written using write() are byte swapped as they are copied into the stream buffer, if the byte order differs from the host.
 template<class _DataDestTy, class _HashTy /* = hasher_noop<64> */>
 class write_stream
 {
 	const size_t buffer_size = 2 * 1024 * 1024;
+	static constexpr const bool memory_mode = _is_memory_data_destination<_DataDestTy>::value;
 
 public:
-	write_stream( _DataDestTy &_data_dest );
+	write_stream( _DataDestTy &_data_dest, byte_order _order = host_byte_order );
 	~write_stream();
 
 	using data_destination_type = _DataDestTy;
 	using hasher_type = _HashTy;
 	using hash_type = typename _HashTy::hash_type;
 
+	// Get the byte order of the values written by write()
+	byte_order get_byte_order() const { return this->order; }
+
 	// Get the current position/number of bytes written to the stream (not the actual bytes written to the destination, which may be less because of cacheing)
 	u64 get_position() const { return this->current_position; };
 	
@@ -42,9 +60,21 @@ public:
 	// Caveat! Make sure the type is correctly packed, since any alignment byte will also be written to the stream
 	template<class _DataTy> status write(const _DataTy* src, size_t count = 1);
 
-	// Write raw bytes to the stream 
+	// Write raw bytes to the stream. The bytes are never byte swapped.
 	status write_bytes( const u8* src, size_t count);
 
+	// Write an unsigned value as a LEB128 varint, 1 to 10 bytes depending on the magnitude of the value
+	status write_varint( u64 value );
+
+	// Write a signed value as a zigzag encoded LEB128 varint, so small negative values are also short
+	status write_signed_varint( i64 value ) { return this->write_varint( zigzag_encode( value ) ); }
+
+	// Write an array of u32 values, using stream-vbyte encoding. The value count is written first, as a varint
+	status write_varint_array( const u32* src, size_t count ) { return this->write_stream_vbyte( src, count, false ); }
+
+	// Write an array of u32 values, delta coded and then stream-vbyte encoded. Use for sorted/monotone sequences, e.g. offsets
+	status write_delta_varint_array( const u32* src, size_t count ) { return this->write_stream_vbyte( src, count, true ); }
+
 	// Ends the stream, flushes the destination, and calculates the final hash. 
 	status end();
 
@@ -55,15 +85,18 @@ public:
 private:
 	u64 current_position = 0;
 	size_t buffer_position = 0;
-	std::vector<u8> buffer;
+	std::vector<u8, aligned_allocator<u8, direct_io_alignment>> buffer;
 
 	data_destination_type &data_dest;
 	hasher_type hasher;
 	hash_type hash_digest;
+	const byte_order order;
 
 	void write_to_buffer( const u8 *src, size_t count );
+	status write_bytes_swapped( const u8 *src, size_t count, size_t value_size );
 	status write_to_destination( const u8 *src, size_t count );
 	status flush_buffer();
+	status write_stream_vbyte( const u32 *src, size_t count, bool delta );
 };
 
 }
@@ -75,10 +108,12 @@ namespace ctle
 {
 
 template<class _DataDestTy, class _HashTy>
-inline write_stream<_DataDestTy,_HashTy>::write_stream( _DataDestTy &_data_dest ) 
+inline write_stream<_DataDestTy,_HashTy>::write_stream( _DataDestTy &_data_dest, byte_order _order ) 
 	: data_dest(_data_dest)
+	, order(_order)
 {
-	this->buffer.resize(buffer_size);
+	if( !memory_mode )
+		this->buffer.resize(buffer_size);
 }
 
 template<class _DataDestTy, class _HashTy>
@@ -100,31 +135,95 @@ inline status write_stream<_DataDestTy,_HashTy>::write( const _DataTy* src, size
 {
 	static_assert( std::is_trivially_copyable<_DataTy>(), "_DataTy data type must be trivially copyable" );
 
+	const size_t value_size = byte_swap_value_size<_DataTy>::value;
+	if( value_size != 0 && this->order != host_byte_order )
+	{
+		ctStatusCall( this->write_bytes_swapped( (const u8*)src, sizeof(_DataTy)*count, value_size ) );
+		return status::ok;
+	}
+
 	ctStatusCall( this->write_bytes( (const u8*)src, sizeof(_DataTy)*count) );
 	return status::ok;
 }
 
 template<class _DataDestTy, class _HashTy>
-inline status write_stream<_DataDestTy,_HashTy>::write_bytes(const u8* src, size_t count)
+inline status write_stream<_DataDestTy,_HashTy>::write_bytes_swapped( const u8 *src, size_t count, size_t value_size )
 {
-	// if the write fits in the buffer, use the buffer
-	if( (buffer_size - this->buffer_position) > count )
+	// memory destinations have no buffer, swap through a small local buffer
+	if( memory_mode )
 	{
-		this->write_to_buffer( src, count );
+		u8 swapped[4096];
+		size_t written_count = 0;
+		while( written_count < count )
+		{
+			const size_t to_write = std::min( count - written_count, sizeof(swapped) );
+			_byte_swap_copy( swapped, &src[written_count], to_write / value_size, value_size );
+			ctStatusCall( this->write_bytes( swapped, to_write ) );
+			written_count += to_write;
+		}
+		return status::ok;
 	}
-	else
+
+	// swap the values while copying them into the buffer
+	size_t written_count = 0;
+	while( written_count < count )
 	{
-		// the data does not fit in the buffer. flush the current buffer to the destination
-		ctStatusCall(this->flush_buffer());
+		const size_t values_left = ( count - written_count ) / value_size;
+		const size_t values_in_buffer = std::min( values_left, ( buffer_size - this->buffer_position ) / value_size );
+		if( values_in_buffer > 0 )
+		{
+			const size_t to_copy = values_in_buffer * value_size;
+			_byte_swap_copy( &this->buffer[this->buffer_position], &src[written_count], values_in_buffer, value_size );
+			this->buffer_position += to_copy;
+			this->current_position += to_copy;
+			written_count += to_copy;
+			if( this->buffer_position == buffer_size )
+				ctStatusCall(this->flush_buffer());
+		}
+		else
+		{
+			// the value straddles the end of the buffer, swap it separately
+			u8 swapped[8];
+			_byte_swap_copy( swapped, &src[written_count], 1, value_size );
+			ctStatusCall( this->write_bytes( swapped, value_size ) );
+			written_count += value_size;
+		}
+	}
+	return status::ok;
+}
 
-		// write to buffer if it now fits, else skip the buffer and write to the destination directly
-		if( (buffer_size - this->buffer_position) > count )
+template<class _DataDestTy, class _HashTy>
+inline status write_stream<_DataDestTy,_HashTy>::write_bytes(const u8* src, size_t count)
+{
+	// memory destinations are written directly
+	if( memory_mode )
+	{
+		ctStatusCall(this->write_to_destination( src, count ));
+		this->current_position += count;
+		return status::ok;
+	}
+
+	// the destination is only written in whole multiples of the buffer size (except for the final flush), 
+	// so destinations which use direct i/o only get aligned writes
+	size_t written_count = 0;
+	while( written_count < count )
+	{
+		const size_t bytes_left = count - written_count;
+		if( this->buffer_position == 0 && bytes_left >= buffer_size )
 		{
-			this->write_to_buffer( src, count );
+			// the buffer is empty, write all whole buffer sizes directly to the destination
+			const size_t direct_count = bytes_left - ( bytes_left % buffer_size );
+			ctStatusCall(this->write_to_destination( &src[written_count], direct_count ));
+			written_count += direct_count;
 		}
 		else
 		{
-			ctStatusCall(this->write_to_destination(src,count));
+			// fill up the buffer, and flush it when full
+			const size_t to_copy = std::min( bytes_left, buffer_size - this->buffer_position );
+			this->write_to_buffer( &src[written_count], to_copy );
+			written_count += to_copy;
+			if( this->buffer_position == buffer_size )
+				ctStatusCall(this->flush_buffer());
 		}
 	}
 
@@ -132,6 +231,39 @@ inline status write_stream<_DataDestTy,_HashTy>::write_bytes(const u8* src, size
 	return status::ok;
 }
 
+template<class _DataDestTy, class _HashTy>
+inline status write_stream<_DataDestTy,_HashTy>::write_varint( u64 value )
+{
+	// encode directly into the buffer if there is room
+	if( !memory_mode && buffer_size - this->buffer_position >= varint_max_size )
+	{
+		const size_t count = varint_encode( value, &this->buffer[this->buffer_position] );
+		this->buffer_position += count;
+		this->current_position += count;
+		if( this->buffer_position == buffer_size )
+			ctStatusCall(this->flush_buffer());
+		return status::ok;
+	}
+
+	u8 encoded[varint_max_size];
+	const size_t count = varint_encode( value, encoded );
+	ctStatusCall( this->write_bytes( encoded, count ) );
+	return status::ok;
+}
+
+template<class _DataDestTy, class _HashTy>
+inline status write_stream<_DataDestTy,_HashTy>::write_stream_vbyte( const u32 *src, size_t count, bool delta )
+{
+	ctStatusCall( this->write_varint( (u64)count ) );
+	if( count == 0 )
+		return status::ok;
+
+	std::vector<u8> encoded( stream_vbyte_bound( count ) );
+	const size_t encoded_size = stream_vbyte_encode( src, count, encoded.data(), delta );
+	ctStatusCall( this->write_bytes( encoded.data(), encoded_size ) );
+	return status::ok;
+}
+
 template<class _DataDestTy, class _HashTy>
 inline status write_stream<_DataDestTy,_HashTy>::end()
 {
@@ -0,0 +1,142 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/blob_store.h>
+#include <ctle/data_source.h>
+#include <ctle/read_stream.h>
+
+#include "unit_tests.h"
+
+#include <thread>
+
+using namespace ctle;
+
+TEST( blob_store, basic_test )
+{
+	blob_store<hasher_xxh128> store( "./blob_store_test" );
+
+	// add a blob, and make sure it is stored under its digest
+	const std::vector<u8> data = random_vector<u8>( 100000 );
+	auto res = store.put( data );
+	ASSERT_EQ( res.status(), status::ok );
+	const digest<128> id = res.value();
+
+	hasher_xxh128 hasher;
+	ASSERT_EQ( hasher.update( data.data(), data.size() ), status::ok );
+	EXPECT_EQ( id, hasher.finish().value() );
+	EXPECT_TRUE( file_exists( store.blob_path( id ) ) );
+	EXPECT_TRUE( store.contains( id ) );
+	EXPECT_EQ( store.blob_size( id ).value(), data.size() );
+
+	// adding the same blob again is deduplicated
+	const size_t indexed_count = store.indexed_count();
+	auto res2 = store.put( data );
+	ASSERT_EQ( res2.status(), status::ok );
+	EXPECT_EQ( res2.value(), id );
+	EXPECT_EQ( store.indexed_count(), indexed_count );
+
+	// read back by copy, by mapping, and by streaming
+	std::vector<u8> copy;
+	ASSERT_EQ( store.get( id, copy ), status::ok );
+	EXPECT_EQ( copy, data );
+
+	mapped_file mapped;
+	ASSERT_EQ( store.map( id, mapped ), status::ok );
+	ASSERT_EQ( mapped.size(), data.size() );
+	EXPECT_EQ( memcmp( mapped.data(), data.data(), data.size() ), 0 );
+	mapped.close();
+
+	if( true )
+	{
+		file_data_source ds( store.blob_path( id ) );
+		read_stream<file_data_source, hasher_xxh128> rs( ds );
+		std::vector<u8> streamed( data.size() );
+		ASSERT_EQ( rs.read_bytes( streamed.data(), streamed.size() ), status::ok );
+		EXPECT_EQ( streamed, data );
+		EXPECT_EQ( rs.get_digest().value(), id );
+	}
+
+	EXPECT_EQ( store.verify( id ), status::ok );
+
+	// unknown blobs
+	digest<128> missing_id = id;
+	missing_id._data_q[0] ^= 1;
+	EXPECT_FALSE( store.contains( missing_id ) );
+	EXPECT_EQ( store.get( missing_id, copy ), status::not_found );
+	EXPECT_EQ( store.map( missing_id, mapped ), status::not_found );
+
+	// a second store on the same directory finds the blob on disk
+	blob_store<hasher_xxh128> store2( "./blob_store_test" );
+	EXPECT_TRUE( store2.contains( id ) );
+	EXPECT_EQ( store2.blob_size( id ).value(), data.size() );
+
+	// empty blobs are valid
+	auto empty_res = store.put( nullptr, 0 );
+	ASSERT_EQ( empty_res.status(), status::ok );
+	EXPECT_EQ( store.get( empty_res.value(), copy ), status::ok );
+	EXPECT_TRUE( copy.empty() );
+	EXPECT_EQ( store.verify( empty_res.value() ), status::ok );
+}
+
+TEST( blob_store, put_from_source )
+{
+	blob_store<hasher_xxh128> store( "./blob_store_test" );
+
+	const std::vector<u8> data = random_vector<u8>( 3 * 1024 * 1024 + 17 );
+	ASSERT_EQ( write_file( "./blob_store_test_source.dat", data, true ), status::ok );
+
+	file_data_source ds( "./blob_store_test_source.dat" );
+	auto res = store.put_from( ds );
+	ASSERT_EQ( res.status(), status::ok );
+	EXPECT_EQ( res.value(), store.put( data ).value() );
+	EXPECT_EQ( store.blob_size( res.value() ).value(), data.size() );
+	EXPECT_EQ( store.verify( res.value() ), status::ok );
+
+	// a modified blob file is detected
+	const std::vector<u8> other = random_vector<u8>( 100 );
+	const digest<128> id = store.put( random_vector<u8>( 100 ) ).value();
+	ASSERT_EQ( write_file( store.blob_path( id ), other, true ), status::ok );
+	EXPECT_EQ( store.verify( id ), status::corrupted );
+	EXPECT_EQ( remove_file( store.blob_path( id ) ), status::ok );
+}
+
+TEST( blob_store, concurrent_writers )
+{
+	blob_store<hasher_xxh128> store( "./blob_store_test" );
+
+	// all threads write the same set of blobs
+	const size_t blob_count = 32;
+	std::vector<std::vector<u8>> blobs( blob_count );
+	for( size_t inx = 0; inx < blob_count; ++inx )
+	{
+		blobs[inx] = random_vector<u8>( 1000 + inx );
+	}
+
+	std::vector<std::vector<digest<128>>> ids( 4 );
+	std::vector<std::thread> threads;
+	for( size_t t = 0; t < ids.size(); ++t )
+	{
+		threads.emplace_back( [&, t]()
+			{
+				for( size_t inx = 0; inx < blob_count; ++inx )
+				{
+					ids[t].push_back( store.put( blobs[inx] ).value() );
+				}
+			} );
+	}
+	for( auto &thread : threads )
+	{
+		thread.join();
+	}
+
+	for( size_t inx = 0; inx < blob_count; ++inx )
+	{
+		for( size_t t = 1; t < ids.size(); ++t )
+		{
+			EXPECT_EQ( ids[t][inx], ids[0][inx] );
+		}
+		std::vector<u8> copy;
+		ASSERT_EQ( store.get( ids[0][inx], copy ), status::ok );
+		EXPECT_EQ( copy, blobs[inx] );
+	}
+}
@@ -0,0 +1,150 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/block_compression.h>
+#include <ctle/data_source.h>
+#include <ctle/data_destination.h>
+#include <ctle/read_stream.h>
+#include <ctle/write_stream.h>
+
+#include "unit_tests.h"
+
+using namespace ctle;
+
+// generate data which compresses, with repeated runs and structured values mixed with random bytes
+static std::vector<u8> compressible_data( size_t size )
+{
+	std::vector<u8> data( size );
+	size_t inx = 0;
+	while( inx < size )
+	{
+		const size_t run = std::min<size_t>( 1 + random_value<size_t>() % 300, size - inx );
+		const int kind = random_value<int>() & 3;
+		for( size_t r = 0; r < run; ++r )
+		{
+			if( kind == 0 )
+				data[inx + r] = random_value<u8>();
+			else if( kind == 1 || inx < 1000 )
+				data[inx + r] = u8( r & 7 );
+			else
+				data[inx + r] = data[inx + r - 1000];
+		}
+		inx += run;
+	}
+	return data;
+}
+
+TEST( block_compression, codec )
+{
+	const size_t sizes[] = { 0, 1, 12, 13, 100, 4096, 65536 + 17, 1000000 };
+	for( const size_t size : sizes )
+	{
+		const std::vector<u8> data = compressible_data( size );
+		std::vector<u8> compressed( lz_compress_bound( size ) );
+		const size_t compressed_size = lz_compress( data.data(), data.size(), compressed.data(), compressed.size() );
+		ASSERT_GT( compressed_size, 0 );
+		if( size >= 4096 )
+		{
+			EXPECT_LT( compressed_size, size );
+		}
+
+		std::vector<u8> decompressed( size );
+		EXPECT_EQ( lz_decompress( compressed.data(), compressed_size, decompressed.data(), decompressed.size() ), status::ok );
+		EXPECT_TRUE( decompressed == data );
+
+		// a wrong size, or truncated data, is detected
+		if( size > 0 )
+		{
+			EXPECT_EQ( lz_decompress( compressed.data(), compressed_size, decompressed.data(), decompressed.size() - 1 ), status::corrupted );
+			EXPECT_EQ( lz_decompress( compressed.data(), compressed_size - 1, decompressed.data(), decompressed.size() ), status::corrupted );
+		}
+	}
+
+	// random data does not compress, and does not fit in a smaller buffer, but fits in the bound
+	const std::vector<u8> random_data = random_vector<u8>( 100000 );
+	std::vector<u8> compressed( lz_compress_bound( random_data.size() ) );
+	EXPECT_EQ( lz_compress( random_data.data(), random_data.size(), compressed.data(), random_data.size() - 1 ), 0 );
+	EXPECT_GT( lz_compress( random_data.data(), random_data.size(), compressed.data(), compressed.size() ), 0 );
+
+	// corrupt data never writes out of bounds, and is either detected, or decompresses to some data
+	const std::vector<u8> data = compressible_data( 10000 );
+	const size_t compressed_size = lz_compress( data.data(), data.size(), compressed.data(), compressed.size() );
+	std::vector<u8> decompressed( data.size() );
+	for( size_t inx = 0; inx < 1000; ++inx )
+	{
+		std::vector<u8> corrupted( compressed.begin(), compressed.begin() + compressed_size );
+		corrupted[random_value<size_t>() % compressed_size] ^= u8( 1 + random_value<u8>() % 255 );
+		lz_decompress( corrupted.data(), corrupted.size(), decompressed.data(), decompressed.size() );
+	}
+}
+
+TEST( block_compression, compressed_stream )
+{
+	const size_t thread_counts[] = { 1, 4 };
+	for( const size_t thread_count : thread_counts )
+	{
+		const std::vector<u8> data = compressible_data( 3000000 );
+
+		// write through a write_stream, into a compressed memory destination, using small blocks
+		memory_data_destination dd;
+		if( true )
+		{
+			compressed_data_destination<memory_data_destination> cd( dd, 64 * 1024, thread_count );
+			write_stream<compressed_data_destination<memory_data_destination>> ws( cd );
+			ASSERT_EQ( ws.write( data.data(), 1 ), status::ok );
+			ASSERT_EQ( ws.write( data.data() + 1, data.size() - 1 ), status::ok );
+			ASSERT_EQ( ws.end(), status::ok );
+			ASSERT_EQ( cd.end(), status::ok );
+			EXPECT_EQ( cd.raw_size(), data.size() );
+			EXPECT_EQ( cd.compressed_size(), dd.size() );
+			EXPECT_LT( dd.size(), data.size() );
+		}
+
+		// read back through a read_stream
+		const std::vector<u8> frame = dd.to_vector();
+		if( true )
+		{
+			memory_data_source ms( frame.data(), frame.size() );
+			compressed_data_source<memory_data_source> cs( ms, thread_count );
+			read_stream<compressed_data_source<memory_data_source>> rs( cs );
+			std::vector<u8> data2( data.size() );
+			ASSERT_EQ( rs.read( data2.data(), data2.size() ), status::ok );
+			EXPECT_TRUE( rs.has_ended() );
+			EXPECT_TRUE( data == data2 );
+		}
+
+		// a corrupted frame is detected by the checksums
+		std::vector<u8> corrupted = frame;
+		corrupted[corrupted.size() / 2] ^= 0x10;
+		memory_data_source ms( corrupted.data(), corrupted.size() );
+		compressed_data_source<memory_data_source> cs( ms, thread_count );
+		std::vector<u8> data2( data.size() );
+		u64 read_bytes = 0;
+		status result = status::ok;
+		while( result && read_bytes < data2.size() )
+		{
+			auto read_result = cs.read( data2.data() + read_bytes, 100000 );
+			result = read_result.status();
+			read_bytes += read_result.value();
+		}
+		EXPECT_EQ( result, status::corrupted );
+	}
+}
+
+TEST( block_compression, empty_frame )
+{
+	memory_data_destination dd;
+	if( true )
+	{
+		compressed_data_destination<memory_data_destination> cd( dd );
+		EXPECT_EQ( cd.end(), status::ok );
+	}
+
+	const std::vector<u8> frame = dd.to_vector();
+	memory_data_source ms( frame.data(), frame.size() );
+	compressed_data_source<memory_data_source> cs( ms );
+	u8 value = 0;
+	auto result = cs.read( &value, 1 );
+	EXPECT_EQ( result.status(), status::ok );
+	EXPECT_EQ( result.value(), 0 );
+}
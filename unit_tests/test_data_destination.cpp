@@ -9,6 +9,7 @@
 #include <thread>
 
 #include <ctle/data_destination.h>
+#include <ctle/write_stream.h>
 
 using namespace ctle;
 
@@ -42,3 +43,108 @@ TEST( data_destination, file_test )
 
 	EXPECT_TRUE( read_buffer == file_data );
 }
+
+TEST( data_destination, memory_test )
+{
+	constexpr const size_t data_size = 100000;
+	auto data = random_vector<u8>(data_size);
+
+	// write using random block sizes, with a small chunk size, so the data spans many chunks
+	memory_data_destination dd( 4096 );
+	size_t written_bytes = 0;
+	while( written_bytes < data_size )
+	{
+		const u64 write_size = std::min<u64>( random_value<u64>() % 10000, data_size - written_bytes );
+		auto result = dd.write( &data[written_bytes], write_size );
+		ASSERT_EQ( result.status(), status::ok );
+		EXPECT_EQ( result.value(), write_size );
+		written_bytes += write_size;
+	}
+	EXPECT_EQ( dd.write( nullptr, 0 ).value(), 0 );
+	EXPECT_EQ( dd.size(), data_size );
+
+	// the chunks cover the data in order
+	const auto chunks = dd.chunks();
+	EXPECT_GT( chunks.size(), 1 );
+	size_t offset = 0;
+	for( const auto &chunk : chunks )
+	{
+		EXPECT_EQ( memcmp( chunk.data, &data[offset], (size_t)chunk.size ), 0 );
+		offset += chunk.size;
+	}
+	EXPECT_EQ( offset, data_size );
+	EXPECT_TRUE( dd.to_vector() == data );
+
+	dd.clear();
+	EXPECT_EQ( dd.size(), 0 );
+	EXPECT_TRUE( dd.chunks().empty() );
+}
+
+// a destination which fails after a number of bytes
+class failing_data_destination
+{
+public:
+	u64 bytes_left = 0;
+	status_return<status, u64> write( const u8 * /*src_buffer*/, u64 write_count )
+	{
+		if( write_count > this->bytes_left )
+			return status::cant_write;
+		this->bytes_left -= write_count;
+		return write_count;
+	}
+};
+
+TEST( data_destination, tee_test )
+{
+	const char *data_destination_file = "data_destination_tee_test.dat";
+	constexpr const size_t data_size = 5000000;
+	auto data = random_vector<u8>(data_size);
+
+	// expected digests, calculated separately
+	hasher_xxh128 xxh;
+	hasher_sha256 sha;
+	xxh.update( data.data(), data.size() );
+	sha.update( data.data(), data.size() );
+	const auto expected_xxh = xxh.finish().value();
+	const auto expected_sha = sha.finish().value();
+
+	for( bool parallel : { false, true } )
+	{
+		// write the data once, to both a file and memory, and calculate both digests in the same pass
+		memory_data_destination md;
+		if( true )
+		{
+			file_data_destination fd( data_destination_file );
+			tee_data_destination<file_data_destination, memory_data_destination> td( fd, md, parallel );
+			write_stream<tee_data_destination<file_data_destination, memory_data_destination>, hasher_pair<hasher_xxh128, hasher_sha256>> ws( td );
+			size_t written_bytes = 0;
+			while( written_bytes < data_size )
+			{
+				const size_t write_size = std::min<size_t>( random_value<u32>() % 300000, data_size - written_bytes );
+				ASSERT_EQ( ws.write_bytes( &data[written_bytes], write_size ), status::ok );
+				written_bytes += write_size;
+			}
+			ASSERT_EQ( ws.end(), status::ok );
+			EXPECT_TRUE( ws.get_digest().value().first == expected_xxh );
+			EXPECT_TRUE( ws.get_digest().value().second == expected_sha );
+		}
+
+		std::vector<u8> file_data;
+		ASSERT_EQ( read_file( data_destination_file, file_data ), status::ok );
+		EXPECT_TRUE( file_data == data );
+		EXPECT_TRUE( md.to_vector() == data );
+
+		// a failing destination fails the write, on either side of the tee
+		memory_data_destination md2;
+		failing_data_destination fail;
+		fail.bytes_left = 1000;
+		tee_data_destination<memory_data_destination, failing_data_destination> td_b( md2, fail, parallel );
+		EXPECT_EQ( td_b.write( data.data(), 1000 ).status(), status::ok );
+		EXPECT_NE( td_b.write( data.data(), 1000 ).status(), status::ok );
+
+		fail.bytes_left = 1000;
+		tee_data_destination<failing_data_destination, memory_data_destination> td_a( fail, md2, parallel );
+		EXPECT_EQ( td_a.write( data.data(), 1000 ).status(), status::ok );
+		EXPECT_NE( td_a.write( data.data(), 1000 ).status(), status::ok );
+	}
+}
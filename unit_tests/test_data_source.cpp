@@ -37,3 +37,31 @@ TEST( data_source, file_test )
 
 	EXPECT_TRUE( read_buffer == file_data );
 }
+
+TEST( data_source, memory_test )
+{
+	constexpr const size_t data_size = 100000;
+	auto data = random_vector<u8>(data_size);
+
+	// read using a random number of block sizes and calls, and compare results
+	std::vector<u8> read_buffer(data_size);
+	memory_data_source ds( data.data(), data.size() );
+	size_t read_bytes = 0;
+	while( read_bytes < data_size )
+	{
+		u64 read_chunk_size = random_value<u64>() % 1000;
+		auto result = ds.read( &read_buffer.data()[read_bytes], read_chunk_size );
+		ASSERT_EQ( result.status(), status::ok );
+		EXPECT_TRUE( result.value() <= read_chunk_size );
+		read_bytes += result.value();
+	}
+	EXPECT_TRUE( ds.read( nullptr, 0 ).value() == 0 );
+	EXPECT_TRUE( ds.read( read_buffer.data(), 10 ).value() == 0 );
+	EXPECT_TRUE( read_buffer == data );
+
+	// seek back and reread
+	EXPECT_EQ( ds.seek( 10 ), status::ok );
+	EXPECT_EQ( ds.read( read_buffer.data(), 1 ).value(), 1 );
+	EXPECT_EQ( read_buffer[0], data[10] );
+	EXPECT_EQ( ds.seek( data_size + 1 ), status::invalid_param );
+}
@@ -13,6 +13,7 @@
 #include <ctle/write_stream.h>
 #include <ctle/data_destination.h>
 #include <ctle/ntup.h>
+#include <ctle/endianness.h>
 
 using namespace ctle;
 
@@ -72,3 +73,340 @@ TEST( data_stream, basic_test )
 	}
 
 }
+
+TEST( data_stream, file_io_modes )
+{
+	const file_io_mode modes[] = { file_io_mode::buffered, file_io_mode::streaming, file_io_mode::direct };
+	for( const file_io_mode mode : modes )
+	{
+		// more than one stream buffer, with a size which is not aligned
+		std::vector<u32> values( ( 3 * 1024 * 1024 + 17 ) / sizeof( u32 ) );
+		for( auto &val : values )
+			val = random_value<u32>();
+
+		digest<128> digest1;
+		if( true )
+		{
+			file_data_destination dd( "./data_stream_file_io_modes.dat", true, mode );
+			write_stream<file_data_destination, hasher_xxh128> ws( dd );
+			ASSERT_EQ( ws.write( values.data(), 3 ), status::ok );
+			ASSERT_EQ( ws.write( values.data() + 3, values.size() - 3 ), status::ok );
+			ASSERT_EQ( ws.end(), status::ok );
+			digest1 = ws.get_digest().value();
+		}
+
+		digest<128> digest2;
+		std::vector<u32> values2( values.size() );
+		if( true )
+		{
+			file_data_source ds( "./data_stream_file_io_modes.dat", mode );
+			read_stream<file_data_source, hasher_xxh128> rs( ds );
+			ASSERT_EQ( rs.read( values2.data(), 1 ), status::ok );
+			ASSERT_EQ( rs.read( values2.data() + 1, values2.size() - 1 ), status::ok );
+			EXPECT_TRUE( rs.has_ended() );
+			digest2 = rs.get_digest().value();
+		}
+
+		EXPECT_TRUE( values == values2 );
+		EXPECT_EQ( digest1, digest2 );
+	}
+}
+
+TEST( data_stream, atomic_replace )
+{
+	std::vector<u64> values( 100000 );
+	for( auto &val : values )
+		val = random_value<u64>();
+
+	if( true )
+	{
+		file_data_destination dd( "./data_stream_atomic_replace.dat", file_write_mode::atomic_replace, values.size() * sizeof( u64 ) );
+		write_stream<file_data_destination, hasher_noop<64>> ws( dd );
+		ASSERT_EQ( ws.write( values.data(), values.size() ), status::ok );
+		ASSERT_EQ( ws.end(), status::ok );
+		EXPECT_EQ( dd.close(), status::ok );
+	}
+
+	std::vector<u64> values2( values.size() );
+	if( true )
+	{
+		file_data_source ds( "./data_stream_atomic_replace.dat" );
+		read_stream<file_data_source, hasher_noop<64>> rs( ds );
+		ASSERT_EQ( rs.read( values2.data(), values2.size() ), status::ok );
+		EXPECT_TRUE( rs.has_ended() );
+	}
+	EXPECT_TRUE( values == values2 );
+
+	// a destination which is dropped half-written, or discarded, leaves the old file untouched
+	for( const bool explicit_discard : { false, true } )
+	{
+		if( true )
+		{
+			file_data_destination dd( "./data_stream_atomic_replace.dat", file_write_mode::atomic_replace );
+			write_stream<file_data_destination, hasher_noop<64>> ws( dd );
+			ASSERT_EQ( ws.write( values2.data(), values2.size() / 2 ), status::ok );
+			ASSERT_EQ( ws.end(), status::ok );
+			if( explicit_discard )
+				dd.discard();
+		}
+
+		std::vector<u8> data;
+		ASSERT_EQ( read_file( "./data_stream_atomic_replace.dat", data ), status::ok );
+		ASSERT_EQ( data.size(), values.size() * sizeof( u64 ) );
+		EXPECT_EQ( memcmp( data.data(), values.data(), data.size() ), 0 );
+	}
+	EXPECT_EQ( remove_file( "./data_stream_atomic_replace.dat" ), status::ok );
+}
+
+TEST( data_stream, seek_and_skip )
+{
+	// values which are their own index, spanning a few stream buffers
+	std::vector<u32> values( 2 * 1024 * 1024 );
+	for( size_t inx = 0; inx < values.size(); ++inx )
+		values[inx] = (u32)inx;
+	EXPECT_EQ( write_file( "./data_stream_seek.dat", values, true ), status::ok );
+
+	file_data_source ds( "./data_stream_seek.dat" );
+	read_stream<file_data_source, hasher_xxh128> rs( ds );
+
+	// skip and seek within the buffer
+	EXPECT_EQ( rs.read<u32>(), 0 );
+	EXPECT_EQ( rs.skip( 9 * sizeof( u32 ) ), status::ok );
+	EXPECT_EQ( rs.read<u32>(), 10 );
+	EXPECT_EQ( rs.seek( 3 * sizeof( u32 ) ), status::ok );
+	EXPECT_EQ( rs.get_position(), 3 * sizeof( u32 ) );
+	EXPECT_EQ( rs.read<u32>(), 3 );
+	EXPECT_EQ( rs.get_digest().status(), status::ok );
+
+	// seek beyond the buffer, forward and back, at unaligned positions
+	const size_t indices[] = { 1500001, 7, 2000000, 1048576, values.size() - 1 };
+	for( const size_t index : indices )
+	{
+		EXPECT_EQ( rs.seek( index * sizeof( u32 ) ), status::ok );
+		EXPECT_EQ( rs.read<u32>(), (u32)index );
+		EXPECT_EQ( rs.get_position(), ( index + 1 ) * sizeof( u32 ) );
+	}
+	EXPECT_TRUE( rs.has_ended() );
+
+	// the source has been repositioned, so the digest is not valid
+	EXPECT_EQ( rs.get_digest().status(), status::invalid );
+
+	// seek to the end is ok, but not beyond
+	EXPECT_EQ( rs.seek( values.size() * sizeof( u32 ) ), status::ok );
+	EXPECT_TRUE( rs.has_ended() );
+	EXPECT_NE( rs.seek( values.size() * sizeof( u32 ) + 5000 ), status::ok );
+}
+
+TEST( data_stream, memory_test )
+{
+	std::vector<u32> values( 1000000 );
+	for( auto &val : values )
+		val = random_value<u32>();
+
+	// write to memory, in pieces
+	memory_data_destination dd;
+	digest<128> digest1;
+	if( true )
+	{
+		write_stream<memory_data_destination, hasher_xxh128> ws( dd );
+		ASSERT_EQ( ws.write( values.data(), 1 ), status::ok );
+		ASSERT_EQ( ws.write( values.data() + 1, values.size() - 1 ), status::ok );
+		EXPECT_EQ( ws.get_position(), values.size() * sizeof( u32 ) );
+		ASSERT_EQ( ws.end(), status::ok );
+		digest1 = ws.get_digest().value();
+	}
+	EXPECT_EQ( dd.size(), values.size() * sizeof( u32 ) );
+
+	// read back in place from memory
+	const std::vector<u8> data = dd.to_vector();
+	memory_data_source ds( data.data(), data.size() );
+	read_stream<memory_data_source, hasher_xxh128> rs( ds );
+	std::vector<u32> values2( values.size() );
+	ASSERT_EQ( rs.read( values2.data(), 10 ), status::ok );
+	ASSERT_EQ( rs.read( values2.data() + 10, values2.size() - 10 ), status::ok );
+	EXPECT_TRUE( rs.has_ended() );
+	u32 extra_value = 0;
+	EXPECT_EQ( rs.read( &extra_value ), status::cant_read );
+	EXPECT_TRUE( values == values2 );
+	EXPECT_EQ( rs.get_digest().value(), digest1 );
+
+	// seek in the memory stream
+	EXPECT_EQ( rs.seek( 500 * sizeof( u32 ) ), status::ok );
+	EXPECT_EQ( rs.read<u32>(), values[500] );
+	EXPECT_NE( rs.seek( data.size() + 1 ), status::ok );
+	EXPECT_EQ( rs.get_digest().value(), digest1 );
+}
+
+TEST( data_stream, varint_test )
+{
+	// values which span a few stream buffers, with varints straddling the buffer boundaries
+	const size_t value_count = 1000000;
+	std::vector<u64> values( value_count );
+	std::vector<i64> signed_values( value_count );
+	for( size_t inx = 0; inx < value_count; ++inx )
+	{
+		values[inx] = random_value<u64>() >> ( random_value<u32>() % 64 );
+		signed_values[inx] = random_value<i64>() >> ( random_value<u32>() % 64 );
+	}
+	std::vector<u32> indices( 300000 );
+	for( auto &index : indices )
+		index = random_value<u32>() % 5000;
+	std::vector<u32> offsets( 300000 );
+	u32 offset = 0;
+	for( auto &value : offsets )
+	{
+		offset += random_value<u32>() % 100;
+		value = offset;
+	}
+
+	memory_data_destination md;
+	if( true )
+	{
+		file_data_destination fd( "./data_stream_varint.dat" );
+		write_stream<file_data_destination> ws( fd );
+		for( size_t inx = 0; inx < value_count; ++inx )
+		{
+			ASSERT_EQ( ws.write_varint( values[inx] ), status::ok );
+			ASSERT_EQ( ws.write_signed_varint( signed_values[inx] ), status::ok );
+		}
+		ASSERT_EQ( ws.write_varint_array( indices.data(), indices.size() ), status::ok );
+		ASSERT_EQ( ws.write_delta_varint_array( offsets.data(), offsets.size() ), status::ok );
+		ASSERT_EQ( ws.write_varint_array( nullptr, 0 ), status::ok );
+		ASSERT_EQ( ws.write_varint( 12345 ), status::ok );
+		ASSERT_EQ( ws.end(), status::ok );
+
+		// the sorted offsets are about a byte each
+		EXPECT_LT( ws.get_position(), value_count * 20 + indices.size() * 2 + offsets.size() * 2 );
+
+		write_stream<memory_data_destination> mws( md );
+		ASSERT_EQ( mws.write_varint( 300 ), status::ok );
+		ASSERT_EQ( mws.write_delta_varint_array( offsets.data(), offsets.size() ), status::ok );
+		ASSERT_EQ( mws.end(), status::ok );
+	}
+
+	// read back from file, through the stream buffer
+	file_data_source ds( "./data_stream_varint.dat" );
+	read_stream<file_data_source> rs( ds );
+	for( size_t inx = 0; inx < value_count; ++inx )
+	{
+		u64 value = 0;
+		i64 signed_value = 0;
+		ASSERT_EQ( rs.read_varint( value ), status::ok );
+		ASSERT_EQ( rs.read_signed_varint( signed_value ), status::ok );
+		ASSERT_EQ( value, values[inx] );
+		ASSERT_EQ( signed_value, signed_values[inx] );
+	}
+	std::vector<u32> read_values;
+	ASSERT_EQ( rs.read_varint_array( read_values ), status::ok );
+	EXPECT_TRUE( read_values == indices );
+	ASSERT_EQ( rs.read_delta_varint_array( read_values ), status::ok );
+	EXPECT_TRUE( read_values == offsets );
+	ASSERT_EQ( rs.read_varint_array( read_values ), status::ok );
+	EXPECT_TRUE( read_values.empty() );
+	u64 last_value = 0;
+	ASSERT_EQ( rs.read_varint( last_value ), status::ok );
+	EXPECT_EQ( last_value, 12345 );
+	EXPECT_TRUE( rs.has_ended() );
+	EXPECT_EQ( rs.read_varint( last_value ), status::cant_read );
+
+	// read back in place from memory
+	const std::vector<u8> data = md.to_vector();
+	memory_data_source ms( data.data(), data.size() );
+	read_stream<memory_data_source> mrs( ms );
+	ASSERT_EQ( mrs.read_varint( last_value ), status::ok );
+	EXPECT_EQ( last_value, 300 );
+	ASSERT_EQ( mrs.read_delta_varint_array( read_values ), status::ok );
+	EXPECT_TRUE( read_values == offsets );
+	EXPECT_TRUE( mrs.has_ended() );
+
+	// a corrupted array count fails when the stream ends, without allocating the whole count
+	u8 corrupted[varint_max_size + 4] = {};
+	const size_t count_size = varint_encode( u64( 1 ) << 60, corrupted );
+	memory_data_source cs( corrupted, count_size + 4 );
+	read_stream<memory_data_source> crs( cs );
+	EXPECT_EQ( crs.read_varint_array( read_values ), status::cant_read );
+}
+
+TEST( data_stream, byte_order_test )
+{
+	// arrays which span the stream buffers, written after a single byte, so the values are not aligned in the buffer
+	const size_t value_count = 700000;
+	std::vector<u16> values16 = random_vector<u16>( value_count );
+	std::vector<u32> values32 = random_vector<u32>( value_count );
+	std::vector<u64> values64 = random_vector<u64>( value_count );
+	std::vector<double> doubles( value_count );
+	for( size_t inx = 0; inx < value_count; ++inx )
+		doubles[inx] = double( random_value<i32>() ) * 0.25;
+
+	memory_data_destination md;
+	if( true )
+	{
+		file_data_destination fd( "./data_stream_byte_order.dat" );
+		write_stream<file_data_destination> ws( fd, byte_order::big_endian );
+		write_stream<memory_data_destination> mws( md, byte_order::big_endian );
+		EXPECT_EQ( ws.get_byte_order(), byte_order::big_endian );
+		ASSERT_EQ( ws.write<u8>( 0x42 ), status::ok );
+		ASSERT_EQ( ws.write( values16.data(), value_count ), status::ok );
+		ASSERT_EQ( ws.write( values32.data(), value_count ), status::ok );
+		ASSERT_EQ( ws.write( values64.data(), value_count ), status::ok );
+		ASSERT_EQ( ws.write( doubles.data(), value_count ), status::ok );
+		ASSERT_EQ( ws.write<u32>( 0x12345678 ), status::ok );
+		ASSERT_EQ( ws.end(), status::ok );
+
+		ASSERT_EQ( mws.write( values32.data(), value_count ), status::ok );
+		ASSERT_EQ( mws.end(), status::ok );
+	}
+
+	// the file has big-endian values
+	std::vector<u8> data;
+	ASSERT_EQ( read_file( "./data_stream_byte_order.dat", data ), status::ok );
+	ASSERT_EQ( data.size(), 1 + value_count * ( 2 + 4 + 8 + 8 ) + 4 );
+	EXPECT_EQ( data[0], 0x42 );
+	for( size_t inx = 0; inx < value_count; inx += 997 )
+	{
+		EXPECT_EQ( from_bigendian<u16>( &data[1 + inx * 2] ), values16[inx] );
+		EXPECT_EQ( from_bigendian<u32>( &data[1 + value_count * 2 + inx * 4] ), values32[inx] );
+		EXPECT_EQ( from_bigendian<u64>( &data[1 + value_count * 6 + inx * 8] ), values64[inx] );
+	}
+	EXPECT_EQ( from_bigendian<u32>( &data[data.size() - 4] ), 0x12345678u );
+	const std::vector<u8> memory_data = md.to_vector();
+	ASSERT_EQ( memory_data.size(), value_count * 4 );
+	EXPECT_EQ( memcmp( memory_data.data(), &data[1 + value_count * 2], memory_data.size() ), 0 );
+
+	// read back, in pieces of random sizes
+	file_data_source ds( "./data_stream_byte_order.dat" );
+	read_stream<file_data_source> rs( ds, byte_order::big_endian );
+	EXPECT_EQ( rs.read<u8>(), 0x42 );
+	std::vector<u16> read16( value_count );
+	std::vector<u32> read32( value_count );
+	std::vector<u64> read64( value_count );
+	std::vector<double> read_doubles( value_count );
+	ASSERT_EQ( rs.read( read16.data(), 3 ), status::ok );
+	ASSERT_EQ( rs.read( read16.data() + 3, value_count - 3 ), status::ok );
+	ASSERT_EQ( rs.read( read32.data(), value_count ), status::ok );
+	for( size_t inx = 0; inx < value_count; )
+	{
+		const size_t count = std::min<size_t>( random_value<u32>() % 100000, value_count - inx );
+		ASSERT_EQ( rs.read( &read64[inx], count ), status::ok );
+		inx += count;
+	}
+	ASSERT_EQ( rs.read( read_doubles.data(), value_count ), status::ok );
+	EXPECT_EQ( rs.read<u32>(), 0x12345678u );
+	EXPECT_TRUE( rs.has_ended() );
+	EXPECT_TRUE( read16 == values16 );
+	EXPECT_TRUE( read32 == values32 );
+	EXPECT_TRUE( read64 == values64 );
+	EXPECT_TRUE( read_doubles == doubles );
+
+	// read the memory copy in place
+	memory_data_source ms( memory_data.data(), memory_data.size() );
+	read_stream<memory_data_source> mrs( ms, byte_order::big_endian );
+	ASSERT_EQ( mrs.read( read32.data(), value_count ), status::ok );
+	EXPECT_TRUE( read32 == values32 );
+	EXPECT_TRUE( mrs.has_ended() );
+
+	// host byte order streams are not swapped
+	memory_data_source hs( memory_data.data(), memory_data.size() );
+	read_stream<memory_data_source> hrs( hs, host_byte_order );
+	EXPECT_EQ( hrs.read<u32>(), host_is_little_endian ? byte_swap( values32[0] ) : values32[0] );
+}
@@ -179,3 +179,61 @@ TEST( hash, all_sizes )
 	test_hash_of_size<256>();
 	test_hash_of_size<512>();
 }
+
+template<size_t _Size>
+static void test_hash_ordering_of_size()
+{
+	using hash = ctle::digest<_Size>;
+
+	// compare against a byte-wise compare, since the digest is stored big-endian.
+	// copy a random number of leading bytes, so that the values share a prefix
+	for( size_t inx = 0; inx < 1000; ++inx )
+	{
+		hash a = random_hash<_Size>();
+		hash b = random_hash<_Size>();
+		const size_t prefix = rand() % ((_Size / 8) + 1);
+		memcpy( b.data, a.data, prefix );
+
+		const int cmp = memcmp( a.data, b.data, _Size / 8 );
+		EXPECT_EQ( a < b, cmp < 0 );
+		EXPECT_EQ( b < a, cmp > 0 );
+		EXPECT_FALSE( a < a );
+	}
+}
+
+TEST( hash, ordering )
+{
+	test_hash_ordering_of_size<64>();
+	test_hash_ordering_of_size<128>();
+	test_hash_ordering_of_size<256>();
+	test_hash_ordering_of_size<512>();
+}
+
+TEST( hash, identity_hash )
+{
+	using hash = ctle::digest<256>;
+
+	std::unordered_map<hash, u64, identity_hash<hash>> idmap;
+	std::vector<hash> ids;
+	for( u64 inx = 0; inx < 1000; ++inx )
+	{
+		ids.push_back( random_hash<256>() );
+		idmap[ids.back()] = inx;
+	}
+	EXPECT_EQ( idmap.size(), 1000 );
+	for( u64 inx = 0; inx < 1000; ++inx )
+	{
+		EXPECT_EQ( idmap[ids[inx]], inx );
+	}
+
+	// digests with equal words should not collide in the default hash
+	std::unordered_map<size_t, hash> hashes;
+	for( u64 inx = 0; inx < 1000; ++inx )
+	{
+		hash val;
+		for( size_t w = 0; w < 4; ++w )
+			val._data_q[w] = inx;
+		hashes[std::hash<hash>{}( val )] = val;
+	}
+	EXPECT_EQ( hashes.size(), 1000 );
+}
@@ -2,6 +2,7 @@
 // Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
 
 #include <ctle/endianness.h>
+#include <ctle/ntup.h>
 
 #include "unit_tests.h"
 
@@ -40,4 +41,74 @@ TEST( endianness, basic_test )
 	uint64_t sb64 = 0x123456789abcdef0;
 	swap_byte_order( &sb64 );
 	EXPECT_EQ( sb64, (uint64_t)0xf0debc9a78563412 );
-}
\ No newline at end of file
+
+	EXPECT_EQ( byte_swap( (uint16_t)0x1234 ), (uint16_t)0x3412 );
+	EXPECT_EQ( byte_swap( (uint32_t)0x12345678 ), (uint32_t)0x78563412 );
+	EXPECT_EQ( byte_swap( (uint64_t)0x123456789abcdef0 ), (uint64_t)0xf0debc9a78563412 );
+}
+
+template<class _Ty, class _ValTy> void test_swap_byte_order_arrays()
+{
+	// random sizes and misaligned offsets, so both the SIMD kernels and the scalar tails are used
+	for( size_t pass = 0; pass < 200; ++pass )
+	{
+		const size_t count = ( pass < 100 ) ? pass : ( random_value<size_t>() % 5000 );
+		const size_t offset = random_value<size_t>() % 8;
+		std::vector<u8> src_bytes( offset + count * sizeof( _Ty ) );
+		for( auto &b : src_bytes )
+			b = random_value<u8>();
+		std::vector<u8> dest_bytes( src_bytes.size() + 8 );
+
+		const _Ty *src = (const _Ty *)&src_bytes[offset];
+		_Ty *dest = (_Ty *)&dest_bytes[8 - offset];
+		swap_byte_order( dest, src, count );
+
+		// compare with swapping each value separately
+		const size_t value_count = count * sizeof( _Ty ) / sizeof( _ValTy );
+		for( size_t inx = 0; inx < value_count; ++inx )
+		{
+			_ValTy expected;
+			_ValTy swapped;
+			memcpy( &expected, &src_bytes[offset + inx * sizeof( _ValTy )], sizeof( _ValTy ) );
+			memcpy( &swapped, &dest_bytes[8 - offset + inx * sizeof( _ValTy )], sizeof( _ValTy ) );
+			ASSERT_EQ( byte_swap( expected ), swapped );
+		}
+
+		// swapping back in place restores the source
+		swap_byte_order( dest, count );
+		if( count > 0 )
+		{
+			EXPECT_EQ( memcmp( dest, src, count * sizeof( _Ty ) ), 0 );
+		}
+	}
+}
+
+TEST( endianness, swap_byte_order_arrays )
+{
+	test_swap_byte_order_arrays<u16, u16>();
+	test_swap_byte_order_arrays<i16, u16>();
+	test_swap_byte_order_arrays<u32, u32>();
+	test_swap_byte_order_arrays<float, u32>();
+	test_swap_byte_order_arrays<u64, u64>();
+	test_swap_byte_order_arrays<double, u64>();
+	test_swap_byte_order_arrays<n_tup<float, 3>, u32>();
+	test_swap_byte_order_arrays<n_tup<double, 4>, u64>();
+	test_swap_byte_order_arrays<mn_tup<u16, 3, 3>, u16>();
+
+	// single values
+	float f = 1.5f;
+	swap_byte_order( &f );
+	swap_byte_order( &f );
+	EXPECT_EQ( f, 1.5f );
+	n_tup<float, 3> v( 1.f, 2.f, 3.f );
+	swap_byte_order( &v );
+	EXPECT_NE( v.x, 1.f );
+	swap_byte_order( &v );
+	EXPECT_TRUE( ( v == n_tup<float, 3>( 1.f, 2.f, 3.f ) ) );
+
+	// only arithmetic values are swapped
+	EXPECT_EQ( byte_swap_value_size<u8>::value, 0 );
+	EXPECT_EQ( byte_swap_value_size<double>::value, 8 );
+	EXPECT_EQ( ( byte_swap_value_size<n_tup<float, 3>>::value ), 4 );
+	EXPECT_EQ( ( byte_swap_value_size<n_tup<u8, 4>>::value ), 0 );
+}
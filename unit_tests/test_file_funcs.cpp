@@ -7,6 +7,10 @@
 
 #include "unit_tests.h"
 
+#include <thread>
+#include <atomic>
+#include <cstring>
+
 using namespace ctle;
 
 static void testReadWriteAccess()
@@ -45,3 +49,267 @@ TEST( file_funcs, basic_test )
 {
 	testReadWriteAccess();
 }
+
+TEST( file_funcs, file_info )
+{
+	const std::string filename = to_hex_string( uuid::generate() );
+	const std::vector<uint8_t> cont = random_vector<uint8_t>( 12345 );
+	ASSERT_EQ( write_file( filename, cont ), status::ok );
+
+	file_info info;
+	ASSERT_EQ( get_file_info( filename, info ), status::ok );
+	EXPECT_EQ( info.size, cont.size() );
+	EXPECT_NE( info.mtime_ns, 0u );
+
+	// the info follows the file when it is renamed
+	const std::string filename2 = filename + ".renamed";
+	ASSERT_EQ( rename_file( filename, filename2 ), status::ok );
+	file_info info2;
+	ASSERT_EQ( get_file_info( filename2, info2 ), status::ok );
+	EXPECT_EQ( info2.size, info.size );
+	EXPECT_EQ( info2.inode, info.inode );
+	EXPECT_EQ( get_file_info( filename, info2 ), status::not_found );
+
+	// map the file
+	mapped_file mapped;
+	ASSERT_EQ( mapped.open( filename2 ), status::ok );
+	ASSERT_EQ( mapped.size(), cont.size() );
+	EXPECT_EQ( memcmp( mapped.data(), cont.data(), cont.size() ), 0 );
+	ASSERT_EQ( mapped.close(), status::ok );
+
+	EXPECT_EQ( remove_file( filename2 ), status::ok );
+	EXPECT_EQ( remove_file( filename2 ), status::not_found );
+	EXPECT_EQ( mapped.open( filename2 ), status::cant_open );
+}
+
+TEST( file_funcs, read_files )
+{
+	const size_t file_count = 200;
+
+	std::vector<std::string> paths( file_count );
+	std::vector<std::vector<uint8_t>> contents( file_count );
+	for( size_t inx = 0; inx < file_count; ++inx )
+	{
+		paths[inx] = to_hex_string( uuid::generate() );
+		contents[inx] = random_vector<uint8_t>( random_value<uint16_t>() % 10000 );
+		ASSERT_EQ( write_file( paths[inx], contents[inx] ), status::ok );
+	}
+
+	// one missing file in the list
+	paths.push_back( to_hex_string( uuid::generate() ) );
+
+	std::vector<std::vector<uint8_t>> dest;
+	std::vector<status> results = read_files_into( paths, dest );
+	ASSERT_EQ( results.size(), paths.size() );
+	ASSERT_EQ( dest.size(), paths.size() );
+	for( size_t inx = 0; inx < file_count; ++inx )
+	{
+		EXPECT_EQ( results[inx], status::ok );
+		EXPECT_TRUE( dest[inx] == contents[inx] );
+	}
+	EXPECT_EQ( results[file_count], status::cant_open );
+	EXPECT_TRUE( dest[file_count].empty() );
+
+	// the callback version, using a single thread
+	std::vector<size_t> sizes( paths.size(), 0 );
+	results = read_files( paths, [&sizes]( size_t index, status result, std::vector<uint8_t> &data )
+		{
+			if( result )
+				sizes[index] = data.size();
+		}, 1 );
+	for( size_t inx = 0; inx < file_count; ++inx )
+	{
+		EXPECT_EQ( results[inx], status::ok );
+		EXPECT_EQ( sizes[inx], contents[inx].size() );
+	}
+	EXPECT_EQ( results[file_count], status::cant_open );
+
+	for( size_t inx = 0; inx < file_count; ++inx )
+	{
+		EXPECT_EQ( remove_file( paths[inx] ), status::ok );
+	}
+}
+
+TEST( file_funcs, file_io_modes )
+{
+	const file_io_mode modes[] = { file_io_mode::buffered, file_io_mode::streaming, file_io_mode::direct };
+	for( const file_io_mode mode : modes )
+	{
+		// a size which is not a multiple of the direct i/o alignment
+		std::vector<uint8_t> cont( 3 * direct_io_alignment + 17 );
+		for( auto &val : cont )
+			val = random_value<uint8_t>();
+
+		const std::string filename = to_hex_string( uuid::generate() );
+
+		// write in unaligned pieces, the last write has an unaligned size
+		if( true )
+		{
+			_file_object file;
+			ASSERT_EQ( file.open_write( filename, false, mode ), status::ok );
+			EXPECT_EQ( file.write( cont.data(), 1 ), status::ok );
+			EXPECT_EQ( file.write( cont.data() + 1, 2 * direct_io_alignment - 1 ), status::ok );
+			EXPECT_EQ( file.write( cont.data() + 2 * direct_io_alignment, cont.size() - 2 * direct_io_alignment ), status::ok );
+			EXPECT_EQ( file.position(), cont.size() );
+			EXPECT_EQ( file.close(), status::ok );
+		}
+
+		// read back with unaligned offsets and sizes
+		if( true )
+		{
+			_file_object file;
+			ASSERT_EQ( file.open_read( filename, mode ), status::ok );
+			EXPECT_EQ( file.size(), cont.size() );
+			std::vector<uint8_t> dest( cont.size() );
+			EXPECT_EQ( file.read( dest.data(), 5 ), status::ok );
+			EXPECT_EQ( file.read( dest.data() + 5, direct_io_alignment ), status::ok );
+			EXPECT_EQ( file.read( dest.data() + 5 + direct_io_alignment, cont.size() - 5 - direct_io_alignment ), status::ok );
+			EXPECT_EQ( file.read( dest.data(), 1 ), status::cant_read );
+			EXPECT_TRUE( cont == dest );
+		}
+
+		// the size of the file is exact, and the plain read functions can read it
+		std::vector<uint8_t> dest;
+		EXPECT_EQ( read_file( filename, dest ), status::ok );
+		EXPECT_TRUE( cont == dest );
+		EXPECT_EQ( remove_file( filename ), status::ok );
+	}
+}
+
+TEST( file_funcs, atomic_replace )
+{
+	const std::string filename = to_hex_string( uuid::generate() );
+	const std::vector<uint8_t> old_cont( 1000, 0x11 );
+	std::vector<uint8_t> new_cont( 100000 );
+	for( auto &val : new_cont )
+		val = random_value<uint8_t>();
+
+	// create fails on existing files, atomic replace does not
+	EXPECT_EQ( write_file( filename, old_cont, file_write_mode::create ), status::ok );
+	EXPECT_EQ( write_file( filename, old_cont, file_write_mode::create ), status::already_exists );
+	EXPECT_EQ( write_file( filename, new_cont, file_write_mode::atomic_replace ), status::ok );
+	std::vector<uint8_t> dest;
+	EXPECT_EQ( read_file( filename, dest ), status::ok );
+	EXPECT_TRUE( dest == new_cont );
+
+	// the old file is visible until the new file is closed
+	if( true )
+	{
+		_file_object file;
+		ASSERT_EQ( file.open_write( filename, file_write_mode::atomic_replace, old_cont.size() ), status::ok );
+		EXPECT_EQ( file.write( old_cont.data(), old_cont.size() ), status::ok );
+		EXPECT_EQ( read_file( filename, dest ), status::ok );
+		EXPECT_TRUE( dest == new_cont );
+		EXPECT_EQ( file.close(), status::ok );
+		EXPECT_EQ( read_file( filename, dest ), status::ok );
+		EXPECT_TRUE( dest == old_cont );
+	}
+
+	// a discarded file does not replace the old file
+	if( true )
+	{
+		_file_object file;
+		ASSERT_EQ( file.open_write( filename, file_write_mode::atomic_replace ), status::ok );
+		EXPECT_EQ( file.write( new_cont.data(), new_cont.size() ), status::ok );
+		file.discard();
+		EXPECT_EQ( read_file( filename, dest ), status::ok );
+		EXPECT_TRUE( dest == old_cont );
+	}
+
+	// close_and_rename replaces another path, and leaves the path the file was opened with untouched
+	const std::string renamed_filename = filename + ".renamed";
+	if( true )
+	{
+		_file_object file;
+		EXPECT_EQ( file.close_and_rename( renamed_filename ), status::not_ready );
+		ASSERT_EQ( file.open_write( filename, file_write_mode::atomic_replace ), status::ok );
+		EXPECT_EQ( file.write( new_cont.data(), new_cont.size() ), status::ok );
+		EXPECT_EQ( file.close_and_rename( renamed_filename ), status::ok );
+		EXPECT_FALSE( file.is_open() );
+		EXPECT_EQ( read_file( renamed_filename, dest ), status::ok );
+		EXPECT_TRUE( dest == new_cont );
+		EXPECT_EQ( read_file( filename, dest ), status::ok );
+		EXPECT_TRUE( dest == old_cont );
+	}
+
+	EXPECT_EQ( remove_file( renamed_filename ), status::ok );
+	EXPECT_EQ( remove_file( filename ), status::ok );
+}
+
+TEST( file_funcs, positional_read_write )
+{
+	const file_io_mode modes[] = { file_io_mode::buffered, file_io_mode::direct };
+	for( const file_io_mode mode : modes )
+	{
+		std::vector<uint8_t> cont( 64 * direct_io_alignment );
+		for( auto &val : cont )
+			val = random_value<uint8_t>();
+		const std::string filename = to_hex_string( uuid::generate() );
+
+		// write the blocks in reverse order
+		if( true )
+		{
+			_file_object file;
+			ASSERT_EQ( file.open_write( filename, false, mode ), status::ok );
+			for( size_t block = 64; block > 0; --block )
+			{
+				const size_t offset = ( block - 1 ) * direct_io_alignment;
+				EXPECT_EQ( file.write_at( offset, cont.data() + offset, direct_io_alignment ), status::ok );
+			}
+			EXPECT_EQ( file.position(), 0 );
+			if( file.get_io_mode() == file_io_mode::direct )
+			{
+				EXPECT_EQ( file.write_at( 1, cont.data(), direct_io_alignment ), status::invalid_param );
+			}
+			EXPECT_EQ( file.close(), status::ok );
+		}
+
+		// read random unaligned ranges concurrently
+		_file_object file;
+		ASSERT_EQ( file.open_read( filename, mode ), status::ok );
+		const size_t max_read_size = 10000;
+		std::vector<std::pair<size_t, size_t>> ranges( 200 );
+		for( auto &range : ranges )
+		{
+			range.first = random_value<size_t>() % ( cont.size() - max_read_size );
+			range.second = 1 + random_value<size_t>() % max_read_size;
+		}
+		std::vector<std::thread> threads;
+		std::atomic<size_t> failures( 0 );
+		for( size_t thread_inx = 0; thread_inx < 4; ++thread_inx )
+		{
+			threads.emplace_back( [&, thread_inx]()
+				{
+					std::vector<uint8_t> dest( max_read_size );
+					for( size_t inx = thread_inx; inx < ranges.size(); inx += 4 )
+					{
+						const size_t offset = ranges[inx].first;
+						const size_t size = ranges[inx].second;
+						if( file.read_at( offset, dest.data(), size ) != status::ok || memcmp( dest.data(), cont.data() + offset, size ) != 0 )
+							++failures;
+					}
+				} );
+		}
+		for( auto &thread : threads )
+			thread.join();
+		EXPECT_EQ( failures.load(), 0 );
+
+		// read_at does not move the position, and reads past the end fail
+		uint8_t value = 0;
+		EXPECT_EQ( file.read_at( cont.size() - 1, &value, 1 ), status::ok );
+		EXPECT_EQ( value, cont.back() );
+		EXPECT_EQ( file.read_at( cont.size(), &value, 1 ), status::cant_read );
+		EXPECT_EQ( file.position(), 0 );
+
+		// seek and continue reading sequentially
+		EXPECT_EQ( file.seek( 1000 ), status::ok );
+		std::vector<uint8_t> dest( 5000 );
+		EXPECT_EQ( file.read( dest.data(), dest.size() ), status::ok );
+		EXPECT_EQ( memcmp( dest.data(), cont.data() + 1000, dest.size() ), 0 );
+		EXPECT_EQ( file.position(), 6000 );
+		EXPECT_EQ( file.seek( cont.size() + 1 ), status::invalid_param );
+		file.close();
+
+		EXPECT_EQ( remove_file( filename ), status::ok );
+	}
+}
@@ -0,0 +1,131 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/file_hash_cache.h>
+#include <ctle/uuid.h>
+#include <ctle/string_funcs.h>
+
+#include "unit_tests.h"
+
+using namespace ctle;
+
+TEST( file_hash_cache, basic_test )
+{
+	const size_t file_count = 300;
+
+	// write some files
+	std::vector<std::string> paths( file_count );
+	std::vector<std::vector<u8>> contents( file_count );
+	for( size_t inx = 0; inx < file_count; ++inx )
+	{
+		paths[inx] = "./file_hash_cache_test_" + to_hex_string( uuid::generate() ) + ".dat";
+		contents[inx] = random_vector<u8>( 1000 + inx );
+		ASSERT_EQ( write_file( paths[inx], contents[inx] ), status::ok );
+	}
+
+	// the cached hash matches a direct hash of the file. the files were just written, so the 
+	// timestamp granularity is cleared for the test to cache their hashes
+	file_hash_cache<hasher_xxh128> cache;
+	cache.set_timestamp_granularity( 0 );
+	std::vector<digest<128>> hashes( file_count );
+	for( size_t inx = 0; inx < file_count; ++inx )
+	{
+		auto res = cache.hash_file_cached( paths[inx] );
+		ASSERT_EQ( res.status(), status::ok );
+		hashes[inx] = res.value();
+
+		hasher_xxh128 hasher;
+		ASSERT_EQ( hasher.update( contents[inx].data(), contents[inx].size() ), status::ok );
+		EXPECT_EQ( hashes[inx], hasher.finish().value() );
+		EXPECT_EQ( hash_file<hasher_xxh128>( paths[inx] ).value(), hashes[inx] );
+	}
+
+	// all files are found, both in the merged table and in the pending batch
+	EXPECT_EQ( cache.size(), file_count - ( file_count % file_hash_cache<hasher_xxh128>::update_batch_size ) );
+	for( size_t inx = 0; inx < file_count; ++inx )
+	{
+		file_info info;
+		ASSERT_EQ( get_file_info( paths[inx], info ), status::ok );
+		digest<128> cached;
+		EXPECT_TRUE( cache.lookup( paths[inx], info, cached ) );
+		EXPECT_EQ( cached, hashes[inx] );
+
+		// a different size is a miss
+		info.size += 1;
+		EXPECT_FALSE( cache.lookup( paths[inx], info, cached ) );
+	}
+
+	// save and load the cache
+	ASSERT_EQ( cache.save( "./file_hash_cache_test.cache" ), status::ok );
+	EXPECT_EQ( cache.size(), file_count );
+	file_hash_cache<hasher_xxh128> cache2;
+	ASSERT_EQ( cache2.load( "./file_hash_cache_test.cache" ), status::ok );
+	EXPECT_EQ( cache2.size(), file_count );
+	for( size_t inx = 0; inx < file_count; ++inx )
+	{
+		file_info info;
+		ASSERT_EQ( get_file_info( paths[inx], info ), status::ok );
+		digest<128> cached;
+		EXPECT_TRUE( cache2.lookup( paths[inx], info, cached ) );
+		EXPECT_EQ( cached, hashes[inx] );
+	}
+
+	// a cache with a different hash type can't be loaded
+	file_hash_cache<hasher_sha256> cache3;
+	EXPECT_EQ( cache3.load( "./file_hash_cache_test.cache" ), status::corrupted );
+
+	// a modified file is rehashed
+	const std::vector<u8> new_contents = random_vector<u8>( 5000 );
+	ASSERT_EQ( write_file( paths[0], new_contents, true ), status::ok );
+	auto res = cache2.hash_file_cached( paths[0] );
+	ASSERT_EQ( res.status(), status::ok );
+	EXPECT_EQ( res.value(), hash_file<hasher_xxh128>( paths[0] ).value() );
+	EXPECT_NE( res.value(), hashes[0] );
+
+	for( const auto &path : paths )
+	{
+		EXPECT_EQ( remove_file( path ), status::ok );
+	}
+	EXPECT_EQ( cache2.hash_file_cached( paths[1] ).status(), status::not_found );
+}
+
+TEST( file_hash_cache, racy_entry_test )
+{
+	const std::string path = "./file_hash_cache_racy_test_" + to_hex_string( uuid::generate() ) + ".dat";
+	const std::vector<u8> contents_a = random_vector<u8>( 4096 );
+	std::vector<u8> contents_b = contents_a;
+	contents_b[0] ^= 0xff;
+
+	file_hash_cache<hasher_xxh128> cache;
+	EXPECT_EQ( cache.get_timestamp_granularity(), file_hash_cache<hasher_xxh128>::default_timestamp_granularity_ns );
+
+	// a file which was modified within the timestamp granularity of the hash is hashed, but not cached
+	ASSERT_EQ( write_file( path, contents_a ), status::ok );
+	auto res_a = cache.hash_file_cached( path );
+	ASSERT_EQ( res_a.status(), status::ok );
+	EXPECT_EQ( res_a.value(), hash_file<hasher_xxh128>( path ).value() );
+	file_info info_a;
+	ASSERT_EQ( get_file_info( path, info_a ), status::ok );
+	digest<128> cached;
+	EXPECT_FALSE( cache.lookup( path, info_a, cached ) );
+
+	// rewrite the file with the same size inside the same tick, the new content is hashed
+	ASSERT_EQ( write_file( path, contents_b, true ), status::ok );
+	file_info info_b;
+	ASSERT_EQ( get_file_info( path, info_b ), status::ok );
+	EXPECT_EQ( info_b.size, info_a.size );
+	auto res_b = cache.hash_file_cached( path );
+	ASSERT_EQ( res_b.status(), status::ok );
+	EXPECT_EQ( res_b.value(), hash_file<hasher_xxh128>( path ).value() );
+	EXPECT_NE( res_b.value(), res_a.value() );
+
+	// with the granularity cleared, the file is older than the hash, and is cached
+	cache.set_timestamp_granularity( 0 );
+	auto res_c = cache.hash_file_cached( path );
+	ASSERT_EQ( res_c.status(), status::ok );
+	cache.flush();
+	EXPECT_TRUE( cache.lookup( path, info_b, cached ) );
+	EXPECT_EQ( cached, res_b.value() );
+
+	EXPECT_EQ( remove_file( path ), status::ok );
+}
@@ -0,0 +1,170 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/flat_id_map.h>
+#include <ctle/uuid.h>
+#include <ctle/digest.h>
+
+#include "unit_tests.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+using namespace ctle;
+
+template<size_t _Size>
+static digest<_Size> random_digest()
+{
+	digest<_Size> val;
+	for( size_t inx=0; inx<_Size/64; ++inx )
+	{
+		val._data_q[inx] = random_value<uint64_t>();
+	}
+	return val;
+}
+
+template<class _Kty, class _KeyGen>
+static void test_flat_id_map_with_keys( _KeyGen keygen )
+{
+	const size_t key_count = 10000;
+
+	flat_id_map<_Kty, u64> map;
+	std::unordered_map<_Kty, u64> ref;
+	std::vector<_Kty> keys( key_count );
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		keys[inx] = keygen();
+		EXPECT_TRUE( map.insert( keys[inx], inx ) );
+		ref[keys[inx]] = inx;
+	}
+	EXPECT_EQ( map.size(), key_count );
+	EXPECT_FALSE( map.insert( keys[0], 1234 ) );
+	EXPECT_EQ( map.at( keys[0] ), 0 );
+
+	// find all keys
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		EXPECT_TRUE( map.contains( keys[inx] ) );
+		ASSERT_NE( map.find( keys[inx] ), nullptr );
+		EXPECT_EQ( *map.find( keys[inx] ), inx );
+		EXPECT_EQ( map.get( keys[inx] ).first, inx );
+	}
+	EXPECT_FALSE( map.contains( keygen() ) );
+	EXPECT_FALSE( map.get( keygen() ).second );
+	EXPECT_THROW( map.at( keygen() ), std::out_of_range );
+
+	// erase every other key
+	for( size_t inx = 0; inx < key_count; inx += 2 )
+	{
+		EXPECT_EQ( map.erase( keys[inx] ), 1 );
+		EXPECT_EQ( map.erase( keys[inx] ), 0 );
+		ref.erase( keys[inx] );
+	}
+	EXPECT_EQ( map.size(), ref.size() );
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		EXPECT_EQ( map.contains( keys[inx] ), ( inx & 1 ) != 0 );
+	}
+
+	// compare all values against the reference
+	size_t visited = 0;
+	map.for_each( [&]( const _Kty &key, u64 &value ) 
+	{
+		EXPECT_EQ( ref[key], value );
+		++visited;
+	} );
+	EXPECT_EQ( visited, ref.size() );
+
+	// operator[] and insert_or_assign
+	map[keys[0]] = 42;
+	EXPECT_EQ( map.at( keys[0] ), 42 );
+	EXPECT_FALSE( map.insert_or_assign( keys[0], 43 ) );
+	EXPECT_EQ( map.at( keys[0] ), 43 );
+
+	map.clear();
+	EXPECT_TRUE( map.empty() );
+	EXPECT_FALSE( map.contains( keys[1] ) );
+}
+
+TEST( flat_id_map, basic_test )
+{
+	test_flat_id_map_with_keys<uuid>( []() { return uuid::generate(); } );
+	test_flat_id_map_with_keys<digest<128>>( []() { return random_digest<128>(); } );
+	test_flat_id_map_with_keys<digest<256>>( []() { return random_digest<256>(); } );
+}
+
+TEST( flat_id_map, erase_churn )
+{
+	// repeatedly insert and erase keys, the capacity should not grow from tombstones
+	flat_id_map<uuid, u32> map;
+	map.reserve( 1000 );
+	const size_t capacity = map.capacity();
+
+	std::vector<uuid> live;
+	for( size_t inx = 0; inx < 1000; ++inx )
+	{
+		live.push_back( uuid::generate() );
+		map.insert( live.back(), (u32)inx );
+	}
+	for( size_t iter = 0; iter < 100000; ++iter )
+	{
+		const size_t pos = rand() % live.size();
+		EXPECT_EQ( map.erase( live[pos] ), 1 );
+		live[pos] = uuid::generate();
+		EXPECT_TRUE( map.insert( live[pos], (u32)iter ) );
+	}
+	EXPECT_EQ( map.size(), 1000 );
+	EXPECT_EQ( map.capacity(), capacity );
+	for( const auto &id : live )
+	{
+		EXPECT_TRUE( map.contains( id ) );
+	}
+
+	// rehash to a larger size, all keys should still be found
+	map.rehash( 10000 );
+	EXPECT_GE( map.capacity(), 10000 );
+	for( const auto &id : live )
+	{
+		EXPECT_TRUE( map.contains( id ) );
+	}
+}
+
+TEST( flat_id_map, build_from_sorted )
+{
+	std::vector<std::pair<digest<256>, u32>> items;
+	for( u32 inx = 0; inx < 5000; ++inx )
+	{
+		items.emplace_back( random_digest<256>(), inx );
+	}
+
+	// add some duplicates
+	for( u32 inx = 0; inx < 100; ++inx )
+	{
+		items.emplace_back( items[inx].first, inx + 10000 );
+	}
+	std::stable_sort( items.begin(), items.end(), []( const std::pair<digest<256>, u32> &a, const std::pair<digest<256>, u32> &b ) { return a.first < b.first; } );
+
+	flat_id_map<digest<256>, u32> map;
+	map.build_from_sorted( items );
+	EXPECT_EQ( map.size(), 5000 );
+	for( const auto &item : items )
+	{
+		ASSERT_TRUE( map.contains( item.first ) );
+		EXPECT_LT( map.at( item.first ), 5000 );
+	}
+}
+
+TEST( flat_id_map, std_hash )
+{
+	// sequential keys are not random, so use std::hash
+	flat_id_map<u64, u64, std::hash<u64>> map;
+	for( u64 inx = 0; inx < 1000; ++inx )
+	{
+		map[inx] = inx * 2;
+	}
+	EXPECT_EQ( map.size(), 1000 );
+	for( u64 inx = 0; inx < 1000; ++inx )
+	{
+		EXPECT_EQ( map.at( inx ), inx * 2 );
+	}
+}
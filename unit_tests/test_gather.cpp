@@ -0,0 +1,98 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/gather.h>
+
+#include "unit_tests.h"
+
+#include <ctle/ntup.h>
+
+using namespace ctle;
+
+template<class _Ty, class _IdxTy> static void test_gather( size_t value_count, size_t count )
+{
+	const std::vector<_Ty> values = random_vector<_Ty>( value_count );
+	std::vector<_IdxTy> indices( count );
+	for( auto &index : indices )
+		index = _IdxTy( random_value<u32>() % value_count );
+
+	// gather all, and also unaligned sub ranges which end in the scalar tail
+	std::vector<_Ty> dest( count );
+	gather( dest.data(), values.data(), values.size(), indices.data(), count );
+	for( size_t inx = 0; inx < count; ++inx )
+	{
+		ASSERT_TRUE( dest[inx] == values[indices[inx]] );
+	}
+	for( const size_t start : { 1, 3, 7 } )
+	{
+		if( start >= count )
+			continue;
+		std::vector<_Ty> part( count - start );
+		gather( part.data(), values.data(), values.size(), indices.data() + start, count - start );
+		for( size_t inx = 0; inx < part.size(); ++inx )
+		{
+			ASSERT_TRUE( part[inx] == values[indices[start + inx]] );
+		}
+	}
+}
+
+TEST( gather, value_and_index_types )
+{
+	for( const size_t count : { 0, 5, 31, 32, 33, 1000, 4099 } )
+	{
+		// bulk gathers
+		test_gather<u32, u8>( 200, count );
+		test_gather<u32, u16>( 3000, count );
+		test_gather<u32, i32>( 100000, count );
+		test_gather<f32, u32>( 100000, count );
+		test_gather<u64, u8>( 256, count );
+		test_gather<f64, u16>( 65536, count );
+		test_gather<i64, i32>( 70000, count );
+		test_gather<u64, u32>( 70000, count );
+
+		// scalar, and prefetched
+		test_gather<u16, u32>( 1000, count );
+		test_gather<u32, u64>( 1000, count );
+		test_gather<n_tup<f32, 3>, u32>( 5000, count );
+		test_gather<mn_tup<f64, 4, 4>, u16>( 5000, count );
+	}
+}
+
+TEST( gather, expand_to )
+{
+	idx_vector<f32> vec;
+	vec.values() = random_vector<f32>( 1000 );
+	for( size_t i = 0; i < 300000; ++i )
+		vec.index().push_back( i32( random_value<u32>() % 1000 ) );
+
+	std::vector<f32> flat( vec.size() );
+	expand_to( flat.data(), vec, 0, vec.size() );
+	for( size_t i = 0; i < vec.size(); ++i )
+	{
+		ASSERT_EQ( flat[i], vec[i] );
+	}
+
+	for( const size_t thread_count : { 1, 3, 8 } )
+	{
+		std::vector<f32> part( vec.size() - 17 );
+		expand_to_parallel( part.data(), vec, 7, vec.size() - 10, thread_count );
+		for( size_t i = 0; i < part.size(); ++i )
+		{
+			ASSERT_EQ( part[i], vec[i + 7] );
+		}
+	}
+	EXPECT_THROW( expand_to( flat.data(), vec, 10, 5 ), std::out_of_range );
+	EXPECT_THROW( expand_to_parallel( flat.data(), vec, 0, vec.size() + 1 ), std::out_of_range );
+
+	// a packed index, and values which are not gathered in bulk
+	idx_vector<n_tup<f64, 3>, packed_index_vector> pvec;
+	pvec.values() = random_vector<n_tup<f64, 3>>( 300 );
+	for( size_t i = 0; i < 200000; ++i )
+		pvec.index().push_back( random_value<u32>() % 300 );
+	std::vector<n_tup<f64, 3>> pflat( pvec.size() );
+	expand_to_parallel( pflat.data(), pvec, 0, pvec.size(), 4 );
+	for( size_t i = 0; i < pvec.size(); ++i )
+	{
+		ASSERT_TRUE( pflat[i] == pvec[i] );
+	}
+}
@@ -90,3 +90,22 @@ TEST( hasher, test_determenism )
 	test_hash_determenism<hasher_xxh64>( random_data.data(), random_data.size(), block_size1, block_size2 );
 	test_hash_determenism<hasher_xxh128>( random_data.data(), random_data.size(), block_size1, block_size2 );
 }
+
+TEST( hasher, hasher_pair )
+{
+	// a hasher pair calculates the same digests as the separate hashers
+	hasher_pair<hasher_xxh128, hasher_sha256> digests;
+	EXPECT_EQ( digests.update( hashing_testdata, sizeof(hashing_testdata) ), status::ok );
+	auto return_value = digests.finish();
+	ASSERT_EQ( return_value.status(), status::ok );
+	EXPECT_TRUE( return_value.value().first == from_string<digest<128>>("828D13C68D1BAC3AA5AA63C0925F9C1E") );
+	EXPECT_TRUE( return_value.value().second == from_string<digest<256>>("0A2591AAF3340AD92FAECBC5908E74D04B51EE5D2DEEE78F089F1607570E2E91") );
+
+	// nested pairs
+	hasher_pair<hasher_xxh64, hasher_pair<hasher_xxh128, hasher_noop<64>>> nested;
+	EXPECT_EQ( nested.update( hashing_testdata, sizeof(hashing_testdata) ), status::ok );
+	auto nested_value = nested.finish().value();
+	EXPECT_TRUE( nested_value.first == from_string<digest<64>>("625A8B25C833FD36") );
+	EXPECT_TRUE( nested_value.second.first == from_string<digest<128>>("828D13C68D1BAC3AA5AA63C0925F9C1E") );
+	EXPECT_TRUE( nested_value.second.second == digest<64>() );
+}
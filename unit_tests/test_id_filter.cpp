@@ -0,0 +1,205 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/id_filter.h>
+#include <ctle/uuid.h>
+#include <ctle/digest.h>
+#include <ctle/read_stream.h>
+#include <ctle/data_source.h>
+#include <ctle/write_stream.h>
+#include <ctle/data_destination.h>
+
+#include "unit_tests.h"
+
+using namespace ctle;
+
+static digest<256> random_digest256()
+{
+	digest<256> val;
+	for( size_t inx=0; inx<4; ++inx )
+	{
+		val._data_q[inx] = random_value<uint64_t>();
+	}
+	return val;
+}
+
+TEST( id_filter, blocked_bloom_filter )
+{
+	const size_t key_count = 100000;
+
+	std::vector<uuid> keys( key_count );
+	blocked_bloom_filter<uuid> filter( key_count );
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		keys[inx] = uuid::generate();
+		filter.insert( keys[inx] );
+	}
+
+	// no false negatives
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		EXPECT_TRUE( filter.contains( keys[inx] ) );
+	}
+
+	// false positive rate should be well below 2% at 12 bits per key
+	size_t false_positives = 0;
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		if( filter.contains( uuid::generate() ) )
+			++false_positives;
+	}
+	EXPECT_LT( false_positives, key_count / 50 );
+
+	filter.clear();
+	EXPECT_FALSE( filter.contains( keys[0] ) );
+
+	// an empty filter contains nothing
+	blocked_bloom_filter<digest<256>> empty_filter;
+	EXPECT_FALSE( empty_filter.contains( random_digest256() ) );
+}
+
+TEST( id_filter, cuckoo_filter )
+{
+	const size_t key_count = 100000;
+
+	std::vector<digest<256>> keys( key_count );
+	cuckoo_filter<digest<256>> filter( key_count );
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		keys[inx] = random_digest256();
+		EXPECT_TRUE( filter.insert( keys[inx] ) );
+	}
+	EXPECT_EQ( filter.size(), key_count );
+
+	// no false negatives
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		EXPECT_TRUE( filter.contains( keys[inx] ) );
+	}
+
+	// false positive rate should be well below 0.1%
+	size_t false_positives = 0;
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		if( filter.contains( random_digest256() ) )
+			++false_positives;
+	}
+	EXPECT_LT( false_positives, key_count / 1000 );
+
+	// erase half the keys, the rest must remain
+	for( size_t inx = 0; inx < key_count; inx += 2 )
+	{
+		EXPECT_TRUE( filter.erase( keys[inx] ) );
+	}
+	EXPECT_EQ( filter.size(), key_count / 2 );
+	for( size_t inx = 1; inx < key_count; inx += 2 )
+	{
+		EXPECT_TRUE( filter.contains( keys[inx] ) );
+	}
+
+	// overfill a small filter, failed inserts must not drop any keys
+	cuckoo_filter<uuid> small_filter( 64 );
+	std::vector<uuid> inserted;
+	for( size_t inx = 0; inx < 1000; ++inx )
+	{
+		const uuid id = uuid::generate();
+		if( small_filter.insert( id ) )
+			inserted.push_back( id );
+	}
+	EXPECT_EQ( small_filter.size(), inserted.size() );
+	EXPECT_LE( inserted.size(), small_filter.bucket_count() * cuckoo_filter<uuid>::bucket_size );
+	for( const uuid &id : inserted )
+	{
+		EXPECT_TRUE( small_filter.contains( id ) );
+	}
+}
+
+TEST( id_filter, serialization )
+{
+	const size_t key_count = 1000;
+
+	std::vector<uuid> keys( key_count );
+	blocked_bloom_filter<uuid> bloom( key_count, 16 );
+	cuckoo_filter<uuid> cuckoo( key_count );
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		keys[inx] = uuid::generate();
+		bloom.insert( keys[inx] );
+		EXPECT_TRUE( cuckoo.insert( keys[inx] ) );
+	}
+
+	if( true )
+	{
+		file_data_destination dd( "./id_filter_test.dat" );
+		write_stream<file_data_destination, hasher_xxh128> ws( dd );
+		ASSERT_EQ( bloom.write_to_stream( ws ), status::ok );
+		ASSERT_EQ( cuckoo.write_to_stream( ws ), status::ok );
+		ASSERT_EQ( ws.end(), status::ok );
+	}
+
+	blocked_bloom_filter<uuid> bloom2;
+	cuckoo_filter<uuid> cuckoo2;
+	if( true )
+	{
+		file_data_source ds( "./id_filter_test.dat" );
+		read_stream<file_data_source, hasher_xxh128> rs( ds );
+		ASSERT_EQ( bloom2.read_from_stream( rs ), status::ok );
+		ASSERT_EQ( cuckoo2.read_from_stream( rs ), status::ok );
+		EXPECT_TRUE( rs.has_ended() );
+	}
+
+	EXPECT_EQ( bloom2.block_count(), bloom.block_count() );
+	EXPECT_EQ( cuckoo2.size(), cuckoo.size() );
+	EXPECT_EQ( cuckoo2.bucket_count(), cuckoo.bucket_count() );
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		EXPECT_TRUE( bloom2.contains( keys[inx] ) );
+		EXPECT_TRUE( cuckoo2.contains( keys[inx] ) );
+	}
+	for( size_t inx = 0; inx < key_count; ++inx )
+	{
+		const uuid id = uuid::generate();
+		EXPECT_EQ( bloom2.contains( id ), bloom.contains( id ) );
+		EXPECT_EQ( cuckoo2.contains( id ), cuckoo.contains( id ) );
+	}
+}
+
+TEST( id_filter, corrupted_stream )
+{
+	// headers with huge counts must fail, without allocating the whole count, and leave the filters unchanged
+	const u64 bloom_header[] = { u64( 8 ) << 40 };
+	const u64 cuckoo_headers[][2] = { { u64( 1 ) << 40, 0 }, { u64( 1 ) << 62, 1 }, { 3, 0 }, { 4, 17 } };
+
+	blocked_bloom_filter<uuid> bloom( 100 );
+	cuckoo_filter<uuid> cuckoo( 100 );
+	const uuid id = uuid::generate();
+	bloom.insert( id );
+	EXPECT_TRUE( cuckoo.insert( id ) );
+	const size_t block_count = bloom.block_count();
+	const size_t bucket_count = cuckoo.bucket_count();
+
+	if( true )
+	{
+		memory_data_source ds( bloom_header, sizeof( bloom_header ) );
+		read_stream<memory_data_source> rs( ds );
+		EXPECT_NE( bloom.read_from_stream( rs ), status::ok );
+	}
+	for( const auto &header : cuckoo_headers )
+	{
+		memory_data_source ds( header, sizeof( header ) );
+		read_stream<memory_data_source> rs( ds );
+		EXPECT_NE( cuckoo.read_from_stream( rs ), status::ok );
+	}
+	if( true )
+	{
+		memory_data_source ds( cuckoo_headers[1], sizeof( cuckoo_headers[1] ) );
+		read_stream<memory_data_source> rs( ds );
+		EXPECT_EQ( cuckoo.read_from_stream( rs ), status::corrupted );
+	}
+
+	EXPECT_EQ( bloom.block_count(), block_count );
+	EXPECT_TRUE( bloom.contains( id ) );
+	EXPECT_EQ( cuckoo.bucket_count(), bucket_count );
+	EXPECT_EQ( cuckoo.size(), 1 );
+	EXPECT_TRUE( cuckoo.contains( id ) );
+}
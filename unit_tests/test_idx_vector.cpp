@@ -2,9 +2,13 @@
 // Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
 
 #include <ctle/idx_vector.h>
+#include <ctle/value_equality.h>
+#include <ctle/packed_index_vector.h>
 
 #include "unit_tests.h"
 
+#include <ctle/ntup.h>
+
 using namespace ctle;
 
 TEST(idx_vector, basic_test)
@@ -72,3 +76,67 @@ TEST(idx_vector, basic_test)
 	EXPECT_TRUE(!(vec != vec2));
 }
 
+
+TEST(idx_vector, compact_merge_reorder)
+{
+	// values 1 and 3 are unreferenced
+	idx_vector<u64> vec;
+	vec.values() = { 10, 11, 12, 13, 14 };
+	vec.index() = { 4, 2, 4, 0, 2 };
+	const std::vector<u64> items = { 14, 12, 14, 10, 12 };
+
+	idx_vector<u64> compacted = vec;
+	compacted.compact();
+	EXPECT_EQ(compacted.values(), std::vector<u64>({ 10, 12, 14 }));
+	EXPECT_EQ(compacted.index(), std::vector<i32>({ 2, 1, 2, 0, 1 }));
+	compacted.compact();
+	EXPECT_EQ(compacted.values().size(), 3);
+
+	// reorder by first use, the unreferenced values are last
+	idx_vector<u64> reordered = vec;
+	reordered.reorder_for_locality();
+	EXPECT_EQ(reordered.values(), std::vector<u64>({ 14, 12, 10, 11, 13 }));
+	EXPECT_EQ(reordered.index(), std::vector<i32>({ 0, 1, 0, 2, 1 }));
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		EXPECT_EQ(reordered[i], items[i]);
+	}
+
+	// merge shares the equal values, and only adds the referenced values of the other vector
+	idx_vector<u64> other;
+	other.values() = { 12, 99, 20, 10 };
+	other.index() = { 2, 0, 3, 2 };
+	idx_vector<u64> merged = vec;
+	merge(merged, other);
+	EXPECT_EQ(merged.values(), std::vector<u64>({ 10, 11, 12, 13, 14, 20 }));
+	EXPECT_EQ(merged.index(), std::vector<i32>({ 4, 2, 4, 0, 2, 5, 2, 0, 5 }));
+	EXPECT_TRUE(merged.is_valid());
+
+	merge(merged, merged);
+	EXPECT_EQ(merged.values().size(), 6);
+	EXPECT_EQ(merged.size(), 18);
+	for (size_t i = 0; i < 9; ++i)
+	{
+		EXPECT_EQ(merged[i + 9], merged[i]);
+	}
+
+	// larger random vectors, also with a packed index, which shrinks when values are removed
+	idx_vector<u32, packed_index_vector> pvec;
+	pvec.values() = random_vector<u32>(1000);
+	for (size_t i = 0; i < 5000; ++i)
+		pvec.index().push_back(u32(random_value<u32>() % 200) * 5);
+	EXPECT_EQ(pvec.index().width(), 2);
+	idx_vector<u32, packed_index_vector> pvec2 = pvec;
+	pvec2.compact();
+	EXPECT_LE(pvec2.values().size(), 200);
+	EXPECT_EQ(pvec2.index().width(), 1);
+	pvec2.reorder_for_locality();
+	merge(pvec2, pvec);
+	ASSERT_EQ(pvec2.size(), pvec.size() * 2);
+	EXPECT_LE(pvec2.values().size(), 200);
+	for (size_t i = 0; i < pvec.size(); ++i)
+	{
+		EXPECT_EQ(pvec2[i], pvec[i]);
+		EXPECT_EQ(pvec2[i + pvec.size()], pvec[i]);
+	}
+}
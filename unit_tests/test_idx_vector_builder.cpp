@@ -0,0 +1,152 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/idx_vector_builder.h>
+
+#include "unit_tests.h"
+
+#include <ctle/ntup.h>
+
+using namespace ctle;
+
+// check that the idx_vector reproduces the values, and that all its values are unique
+template<class _Ty, class _EqualityTy> static void check_built_vector( const idx_vector<_Ty> &ivec, const std::vector<_Ty> &values, const _EqualityTy &equality )
+{
+	ASSERT_EQ( ivec.size(), values.size() );
+	EXPECT_TRUE( ivec.is_valid() );
+	for( size_t inx = 0; inx < values.size(); ++inx )
+	{
+		EXPECT_TRUE( equality.equal( ivec[inx], values[inx] ) );
+	}
+	for( size_t a = 0; a < ivec.values().size() && a < 200; ++a )
+	{
+		for( size_t b = a + 1; b < ivec.values().size(); ++b )
+		{
+			EXPECT_FALSE( equality.equal( ivec.values()[a], ivec.values()[b] ) );
+		}
+	}
+}
+
+TEST( idx_vector_builder, basic_test )
+{
+	idx_vector_builder<u32> builder;
+	const std::vector<u32> values = { 5, 3, 5, 5, 9, 3, 0 };
+	for( const u32 value : values )
+	{
+		EXPECT_EQ( builder.insert( value ), status::ok );
+	}
+	EXPECT_EQ( builder.size(), 7 );
+	EXPECT_EQ( builder.unique_count(), 4 );
+	EXPECT_EQ( builder.vector().values(), std::vector<u32>( { 5, 3, 9, 0 } ) );
+	EXPECT_EQ( builder.vector().index(), std::vector<i32>( { 0, 1, 0, 0, 2, 1, 3 } ) );
+
+	// bulk insert continues with the same values
+	EXPECT_EQ( builder.insert( values.data(), values.size() ), status::ok );
+	EXPECT_EQ( builder.unique_count(), 4 );
+
+	idx_vector<u32> ivec = builder.finish();
+	EXPECT_EQ( ivec.size(), 14 );
+	EXPECT_EQ( builder.size(), 0 );
+	EXPECT_EQ( builder.unique_count(), 0 );
+
+	// many unique values, to grow the table
+	std::vector<u64> many = random_vector<u64>( 20000 );
+	for( size_t inx = 0; inx < 5000; ++inx )
+		many.push_back( many[random_value<u32>() % many.size()] );
+	idx_vector_builder<u64, std::vector<u32>> builder64;
+	builder64.reserve( many.size(), 100 );
+	EXPECT_EQ( builder64.insert( many.data(), many.size() ), status::ok );
+	ASSERT_EQ( builder64.size(), many.size() );
+	for( size_t inx = 0; inx < many.size(); ++inx )
+	{
+		EXPECT_EQ( builder64.vector()[inx], many[inx] );
+	}
+	EXPECT_LE( builder64.unique_count(), 20000 );
+
+	// the index type limits the number of unique values
+	idx_vector_builder<u16, std::vector<u8>> small_builder;
+	EXPECT_EQ( ( idx_vector_builder<u16, std::vector<u8>>::max_value_count ), 255 );
+	for( u16 value = 0; value < 255; ++value )
+	{
+		EXPECT_EQ( small_builder.insert( value ), status::ok );
+	}
+	EXPECT_EQ( small_builder.insert( u16( 0 ) ), status::ok );
+	EXPECT_EQ( small_builder.insert( u16( 255 ) ), status::invalid );
+}
+
+TEST( idx_vector_builder, equality_policies )
+{
+	// bit-exact equality differentiates 0.0 and -0.0
+	idx_vector_builder<n_tup<f32, 3>> exact_builder;
+	EXPECT_EQ( exact_builder.insert( n_tup<f32, 3>( 0.f, 1.f, 2.f ) ), status::ok );
+	EXPECT_EQ( exact_builder.insert( n_tup<f32, 3>( -0.f, 1.f, 2.f ) ), status::ok );
+	EXPECT_EQ( exact_builder.insert( n_tup<f32, 3>( 0.f, 1.f, 2.f ) ), status::ok );
+	EXPECT_EQ( exact_builder.unique_count(), 2 );
+
+	// quantized equality merges values within the same quantization step
+	using quantized_builder = idx_vector_builder<n_tup<f32, 3>, std::vector<i32>, std::vector<n_tup<f32, 3>>, quantized_equality<n_tup<f32, 3>>>;
+	quantized_builder qbuilder( quantized_equality<n_tup<f32, 3>>( 0.01 ) );
+	EXPECT_EQ( qbuilder.insert( n_tup<f32, 3>( 0.f, 1.f, 2.f ) ), status::ok );
+	EXPECT_EQ( qbuilder.insert( n_tup<f32, 3>( -0.f, 1.001f, 1.999f ) ), status::ok );
+	EXPECT_EQ( qbuilder.insert( n_tup<f32, 3>( 0.f, 1.02f, 2.f ) ), status::ok );
+	EXPECT_EQ( qbuilder.unique_count(), 2 );
+	EXPECT_EQ( qbuilder.vector().index(), std::vector<i32>( { 0, 0, 1 } ) );
+
+	// NaN values are equal
+	quantized_equality<f64> qeq( 0.5 );
+	EXPECT_TRUE( qeq.equal( std::nan( "" ), -std::nan( "" ) ) );
+	EXPECT_FALSE( qeq.equal( std::nan( "" ), 0.0 ) );
+	EXPECT_TRUE( qeq.equal( 1e300, 1e301 ) );
+	EXPECT_EQ( qeq.hash( 0.1 ), qeq.hash( -0.1 ) );
+
+	// integer components are not quantized
+	quantized_equality<mn_tup<i32, 2, 2>> ieq( 10.0 );
+	mn_tup<i32, 2, 2> a, b;
+	EXPECT_TRUE( ieq.equal( a, b ) );
+	b[1][0] = 1;
+	EXPECT_FALSE( ieq.equal( a, b ) );
+
+	EXPECT_THROW( quantized_equality<f32>( 0.0 ), status_error );
+}
+
+TEST( idx_vector_builder, parallel_build )
+{
+	// mesh-like vertices, with many duplicates
+	const std::vector<n_tup<f32, 3>> unique_values = random_vector<n_tup<f32, 3>>( 30000 );
+	std::vector<n_tup<f32, 3>> values( 200000 );
+	for( auto &value : values )
+		value = unique_values[random_value<u32>() % unique_values.size()];
+
+	for( const size_t thread_count : { 1, 2, 3, 8 } )
+	{
+		// the parallel build must give the same result as the serial build, also when continuing a build
+		idx_vector_builder<n_tup<f32, 3>> serial_builder;
+		EXPECT_EQ( serial_builder.insert( values.data(), 1000 ), status::ok );
+		EXPECT_EQ( serial_builder.insert( values.data(), values.size() ), status::ok );
+
+		idx_vector_builder<n_tup<f32, 3>> parallel_builder;
+		EXPECT_EQ( parallel_builder.insert( values.data(), 1000 ), status::ok );
+		EXPECT_EQ( parallel_builder.insert_parallel( values.data(), values.size(), thread_count ), status::ok );
+		EXPECT_TRUE( parallel_builder.vector() == serial_builder.vector() );
+
+		// and the table must be updated, so later inserts are deduplicated
+		EXPECT_EQ( serial_builder.insert( values.data(), 50000 ), status::ok );
+		EXPECT_EQ( parallel_builder.insert_parallel( values.data(), 50000, thread_count ), status::ok );
+		EXPECT_TRUE( parallel_builder.vector() == serial_builder.vector() );
+
+		const idx_vector<n_tup<f32, 3>> ivec = parallel_builder.finish();
+		std::vector<n_tup<f32, 3>> all_values( values.begin(), values.begin() + 1000 );
+		all_values.insert( all_values.end(), values.begin(), values.end() );
+		all_values.insert( all_values.end(), values.begin(), values.begin() + 50000 );
+		check_built_vector( ivec, all_values, bitwise_equality<n_tup<f32, 3>>() );
+	}
+
+	// quantized parallel build
+	using quantized_builder = idx_vector_builder<n_tup<f32, 3>, std::vector<i32>, std::vector<n_tup<f32, 3>>, quantized_equality<n_tup<f32, 3>>>;
+	const quantized_equality<n_tup<f32, 3>> qeq( 1e-3 );
+	quantized_builder serial_builder( qeq );
+	quantized_builder parallel_builder( qeq );
+	EXPECT_EQ( serial_builder.insert( values.data(), values.size() ), status::ok );
+	EXPECT_EQ( parallel_builder.insert_parallel( values.data(), values.size(), 4 ), status::ok );
+	EXPECT_TRUE( parallel_builder.vector() == serial_builder.vector() );
+}
@@ -0,0 +1,195 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/nullable_vector.h>
+
+#include "unit_tests.h"
+
+#include <ctle/serialization.h>
+#include <ctle/read_stream.h>
+#include <ctle/data_source.h>
+#include <ctle/write_stream.h>
+#include <ctle/data_destination.h>
+
+using namespace ctle;
+
+// check the nullable_vector against a reference validity vector
+template<class _Ty> static void check_validity( const nullable_vector<_Ty> &nvec, const std::vector<bool> &reference )
+{
+	ASSERT_EQ( nvec.size(), reference.size() );
+	size_t valid_count = 0;
+	for( size_t inx = 0; inx < reference.size(); ++inx )
+	{
+		ASSERT_EQ( nvec.has_value( inx ), reference[inx] );
+		valid_count += reference[inx] ? 1 : 0;
+	}
+	EXPECT_EQ( nvec.valid_count(), valid_count );
+	EXPECT_EQ( nvec.null_count(), reference.size() - valid_count );
+
+	// iterating the valid elements, and finding them one by one, must match the reference
+	std::vector<size_t> valid_positions;
+	nvec.for_each_valid( [&]( size_t pos, const _Ty &value )
+		{
+			EXPECT_TRUE( value == nvec[pos] );
+			valid_positions.push_back( pos );
+		} );
+	ASSERT_EQ( valid_positions.size(), valid_count );
+	size_t pos = nvec.find_next_valid( 0 );
+	for( const size_t valid_pos : valid_positions )
+	{
+		ASSERT_EQ( pos, valid_pos );
+		pos = nvec.find_next_valid( pos + 1 );
+	}
+	EXPECT_EQ( pos, nvec.size() );
+}
+
+TEST( nullable_vector, basic_test )
+{
+	nullable_vector<u32> nvec;
+	EXPECT_TRUE( nvec.empty() );
+	EXPECT_EQ( nvec.valid_count(), 0 );
+	EXPECT_EQ( nvec.find_next_valid( 0 ), 0 );
+
+	nvec.push_back( 5 );
+	nvec.push_back_null();
+	nvec.push_back( 7 );
+	EXPECT_EQ( nvec.size(), 3 );
+	EXPECT_TRUE( nvec.has_value( 0 ) );
+	EXPECT_FALSE( nvec.has_value( 1 ) );
+	EXPECT_EQ( nvec.value( 2 ), 7 );
+	EXPECT_THROW( nvec.value( 1 ), bad_optional_value_access );
+	EXPECT_THROW( nvec.value( 3 ), std::out_of_range );
+	nvec.set( 1, 6 );
+	EXPECT_EQ( nvec.value( 1 ), 6 );
+	nvec.reset( 0 );
+	EXPECT_FALSE( nvec.has_value( 0 ) );
+	check_validity( nvec, { false, true, true } );
+
+	// only the valid values are compared
+	nullable_vector<u32> nvec2( 3 );
+	nvec2.set( 1, 6 );
+	nvec2.set( 2, 7 );
+	EXPECT_TRUE( nvec == nvec2 );
+	nvec2.set( 0, 1 );
+	EXPECT_TRUE( nvec != nvec2 );
+
+	// shrinking clears the bits past the size, so growing again adds null elements
+	nullable_vector<std::string> svec;
+	std::vector<bool> reference;
+	for( size_t inx = 0; inx < 200; ++inx )
+	{
+		svec.push_back( std::to_string( inx ) );
+		reference.push_back( true );
+	}
+	svec.resize( 70 );
+	svec.resize( 130 );
+	reference.resize( 70 );
+	reference.resize( 130, false );
+	check_validity( svec, reference );
+	EXPECT_EQ( svec.value( 69 ), "69" );
+
+	EXPECT_THROW( svec.set_valid_range( 10, 131 ), std::out_of_range );
+	EXPECT_THROW( svec.reset_range( 10, 9 ), std::out_of_range );
+	svec.clear();
+	EXPECT_TRUE( svec.empty() );
+	EXPECT_TRUE( svec.validity().empty() );
+}
+
+TEST( nullable_vector, bulk_ranges_and_counts )
+{
+	// large enough to count with the bulk kernels
+	nullable_vector<f64> nvec( 5000 );
+	std::vector<bool> reference( 5000, false );
+	check_validity( nvec, reference );
+
+	for( size_t iter = 0; iter < 50; ++iter )
+	{
+		size_t begin = random_value<u32>() % 5001;
+		size_t end = random_value<u32>() % 5001;
+		if( begin > end )
+			std::swap( begin, end );
+		const bool valid = ( iter % 3 ) != 0;
+		if( valid )
+			nvec.set_valid_range( begin, end );
+		else
+			nvec.reset_range( begin, end );
+		for( size_t inx = begin; inx < end; ++inx )
+			reference[inx] = valid;
+
+		const size_t pos = random_value<u32>() % 5000;
+		nvec.set( pos, 1.5 );
+		reference[pos] = true;
+		check_validity( nvec, reference );
+	}
+
+	// ranges within one word, and on word bounds
+	nullable_vector<u8> small( 128 );
+	small.set_valid_range( 3, 9 );
+	small.set_valid_range( 64, 128 );
+	small.reset_range( 64, 64 );
+	EXPECT_EQ( small.valid_count(), 70 );
+	EXPECT_EQ( small.validity()[0], u64( 0x1f8 ) );
+	EXPECT_EQ( small.validity()[1], ~u64( 0 ) );
+	EXPECT_EQ( small.find_next_valid( 9 ), 64 );
+}
+
+TEST( nullable_vector, serialization )
+{
+	nullable_vector<u64> nvec;
+	for( size_t inx = 0; inx < 1000; ++inx )
+	{
+		if( random_value<u32>() % 4 == 0 )
+			nvec.push_back_null();
+		else
+			nvec.push_back( random_value<u64>() );
+	}
+	nullable_vector<std::string> svec;
+	svec.push_back( "a" );
+	svec.push_back_null();
+	svec.push_back( "c" );
+	const nullable_vector<u64> empty_vec;
+
+	for( const byte_order order : { byte_order::little_endian, byte_order::big_endian } )
+	{
+		memory_data_destination dd;
+		if( true )
+		{
+			write_stream<memory_data_destination> ws( dd, order );
+			ASSERT_EQ( write_serialization_header( ws ), status::ok );
+			ASSERT_EQ( serialize( ws, nvec ), status::ok );
+			ASSERT_EQ( serialize( ws, svec ), status::ok );
+			ASSERT_EQ( serialize( ws, empty_vec ), status::ok );
+			ASSERT_EQ( ws.end(), status::ok );
+		}
+
+		const std::vector<u8> data = dd.to_vector();
+		memory_data_source ds( data.data(), data.size() );
+		read_stream<memory_data_source> rs( ds, order );
+		ASSERT_EQ( read_serialization_header( rs ), status::ok );
+		nullable_vector<u64> read_nvec;
+		nullable_vector<std::string> read_svec;
+		nullable_vector<u64> read_empty_vec;
+		ASSERT_EQ( deserialize( rs, read_nvec ), status::ok );
+		ASSERT_EQ( deserialize( rs, read_svec ), status::ok );
+		ASSERT_EQ( deserialize( rs, read_empty_vec ), status::ok );
+		EXPECT_TRUE( read_nvec == nvec );
+		EXPECT_TRUE( read_svec == svec );
+		EXPECT_TRUE( read_empty_vec.empty() );
+		EXPECT_TRUE( rs.has_ended() );
+	}
+
+	// a bitmap with bits past the size is corrupted
+	memory_data_destination dd;
+	if( true )
+	{
+		write_stream<memory_data_destination> ws( dd );
+		ASSERT_EQ( serialize( ws, std::vector<u8>( 3 ) ), status::ok );
+		ASSERT_EQ( serialize( ws, std::vector<u64>( { 0x8 } ) ), status::ok );
+		ASSERT_EQ( ws.end(), status::ok );
+	}
+	const std::vector<u8> data = dd.to_vector();
+	memory_data_source ds( data.data(), data.size() );
+	read_stream<memory_data_source> rs( ds );
+	nullable_vector<u8> bad_vec;
+	EXPECT_EQ( deserialize( rs, bad_vec ), status::corrupted );
+}
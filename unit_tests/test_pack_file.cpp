@@ -0,0 +1,97 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/pack_file.h>
+#include <ctle/uuid.h>
+
+#include "unit_tests.h"
+
+#include <map>
+
+using namespace ctle;
+
+TEST( pack_file, basic_test )
+{
+	const size_t blob_count = 1000;
+
+	// write blobs of random sizes, including empty blobs
+	std::map<uuid, std::vector<u8>> blobs;
+	if( true )
+	{
+		pack_file_writer<uuid> writer( "./pack_file_test.pack" );
+		for( size_t inx = 0; inx < blob_count; ++inx )
+		{
+			const uuid key = uuid::generate();
+			blobs[key] = random_vector<u8>( inx % 7 == 0 ? 0 : size_t( random_value<u16>() % 4096 ) );
+			ASSERT_EQ( writer.add( key, blobs[key] ), status::ok );
+		}
+		EXPECT_EQ( writer.add( blobs.begin()->first, blobs.begin()->second ), status::already_exists );
+		EXPECT_EQ( writer.size(), blob_count );
+		ASSERT_EQ( writer.finish(), status::ok );
+		EXPECT_EQ( writer.finish(), status::not_ready );
+	}
+
+	pack_file_reader<uuid> reader;
+	ASSERT_EQ( reader.open( "./pack_file_test.pack" ), status::ok );
+	EXPECT_EQ( reader.size(), blob_count );
+
+	// the index is sorted
+	auto it = blobs.begin();
+	for( size_t inx = 0; inx < reader.size(); ++inx, ++it )
+	{
+		EXPECT_EQ( reader.entries()[inx].key, it->first );
+		EXPECT_EQ( reader.entries()[inx].offset % pack_file_alignment, 0u );
+	}
+
+	// look up all blobs, with and without verification
+	for( const auto &blob : blobs )
+	{
+		auto res = reader.get( blob.first, ( blob.second.size() & 1 ) != 0 );
+		ASSERT_EQ( res.status(), status::ok );
+		ASSERT_EQ( res.value().size, blob.second.size() );
+		if( !blob.second.empty() )
+		{
+			EXPECT_EQ( memcmp( res.value().data, blob.second.data(), blob.second.size() ), 0 );
+		}
+	}
+	EXPECT_EQ( reader.verify_all(), status::ok );
+
+	EXPECT_FALSE( reader.contains( uuid::generate() ) );
+	EXPECT_EQ( reader.get( uuid::generate() ).status(), status::not_found );
+	ASSERT_EQ( reader.close(), status::ok );
+
+	// reading with the wrong key type is detected
+	pack_file_reader<digest<256>> wrong_reader;
+	EXPECT_EQ( wrong_reader.open( "./pack_file_test.pack" ), status::corrupted );
+
+	// an unfinished pack is not valid
+	if( true )
+	{
+		pack_file_writer<uuid> writer( "./pack_file_test_unfinished.pack" );
+		ASSERT_EQ( writer.add( uuid::generate(), random_vector<u8>( 100 ) ), status::ok );
+	}
+	EXPECT_EQ( reader.open( "./pack_file_test_unfinished.pack" ), status::corrupted );
+}
+
+TEST( pack_file, corrupted_blob )
+{
+	const uuid key = uuid::generate();
+	if( true )
+	{
+		pack_file_writer<uuid, hasher_sha256> writer( "./pack_file_test_corrupted.pack" );
+		ASSERT_EQ( writer.add( key, random_vector<u8>( 1000 ) ), status::ok );
+		ASSERT_EQ( writer.finish(), status::ok );
+	}
+
+	// flip a byte in the blob
+	std::vector<u8> data;
+	ASSERT_EQ( read_file( "./pack_file_test_corrupted.pack", data ), status::ok );
+	data[100] ^= 0xff;
+	ASSERT_EQ( write_file( "./pack_file_test_corrupted.pack", data, true ), status::ok );
+
+	pack_file_reader<uuid, hasher_sha256> reader;
+	ASSERT_EQ( reader.open( "./pack_file_test_corrupted.pack" ), status::ok );
+	EXPECT_EQ( reader.get( key ).status(), status::ok );
+	EXPECT_EQ( reader.get( key, true ).status(), status::corrupted );
+	EXPECT_EQ( reader.verify_all(), status::corrupted );
+}
@@ -0,0 +1,152 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/packed_index_vector.h>
+
+#include <numeric>
+
+#include "unit_tests.h"
+
+#include <ctle/idx_vector.h>
+#include <ctle/idx_vector_builder.h>
+#include <ctle/serialization.h>
+#include <ctle/ntup.h>
+#include <ctle/read_stream.h>
+#include <ctle/data_source.h>
+#include <ctle/write_stream.h>
+#include <ctle/data_destination.h>
+
+using namespace ctle;
+
+namespace
+{
+// sums the indices, using the typed index array
+struct sum_indices
+{
+	template<class _IdxTy> u64 operator()( const _IdxTy *indices, size_t count ) const
+	{
+		u64 sum = 0;
+		for( size_t inx = 0; inx < count; ++inx )
+			sum += indices[inx];
+		return sum;
+	}
+};
+}
+
+TEST( packed_index_vector, basic_test )
+{
+	packed_index_vector pvec;
+	EXPECT_TRUE( pvec.empty() );
+	EXPECT_EQ( pvec.width(), 1 );
+
+	// the width grows with the largest index, and the indices are kept
+	std::vector<u32> indices;
+	for( const u32 index : { 0u, 255u, 3u, 256u, 65535u, 7u, 65536u, 0xffffffffu, 12u } )
+	{
+		pvec.push_back( index );
+		indices.push_back( index );
+		EXPECT_TRUE( std::equal( pvec.begin(), pvec.end(), indices.begin(), indices.end() ) );
+	}
+	EXPECT_EQ( pvec.width(), 4 );
+	EXPECT_EQ( pvec.size(), indices.size() );
+	EXPECT_EQ( pvec.at( 3 ), 256 );
+	EXPECT_THROW( pvec.at( indices.size() ), std::out_of_range );
+	EXPECT_EQ( pvec.visit( sum_indices() ), std::accumulate( indices.begin(), indices.end(), u64( 0 ) ) );
+
+	// shrinking repacks to the narrowest width
+	pvec.set( 4, 1 );
+	pvec.set( 6, 2 );
+	pvec.set( 7, 3 );
+	pvec.shrink_width();
+	EXPECT_EQ( pvec.width(), 2 );
+	EXPECT_EQ( pvec[3], 256 );
+	pvec.set( 3, 0 );
+	pvec.shrink_width();
+	EXPECT_EQ( pvec.width(), 1 );
+	EXPECT_TRUE( pvec == packed_index_vector( { 0, 255, 3, 0, 1, 7, 2, 3, 12 } ) );
+
+	// set widens the storage
+	pvec.set( 0, 1000 );
+	EXPECT_EQ( pvec.width(), 2 );
+	EXPECT_EQ( pvec[0], 1000 );
+	EXPECT_EQ( pvec[1], 255 );
+
+	// equality does not depend on the width
+	packed_index_vector wide = { 1, 2, 3 };
+	wide.reserve_value_range( 100000 );
+	EXPECT_EQ( wide.width(), 4 );
+	EXPECT_TRUE( wide == packed_index_vector( { 1, 2, 3 } ) );
+	EXPECT_TRUE( wide != packed_index_vector( { 1, 2, 4 } ) );
+	EXPECT_TRUE( wide != packed_index_vector( { 1, 2 } ) );
+	wide.reserve_value_range( 10 );
+	EXPECT_EQ( wide.width(), 4 );
+
+	// assign picks the width from the largest index
+	const std::vector<i32> index = { 5, 70000, 2 };
+	pvec.assign( index.data(), index.size() );
+	EXPECT_EQ( pvec.width(), 4 );
+	EXPECT_TRUE( std::equal( pvec.begin(), pvec.end(), index.begin(), index.end() ) );
+	pvec.resize( 5 );
+	EXPECT_EQ( pvec[4], 0 );
+
+	pvec.clear();
+	EXPECT_TRUE( pvec.empty() );
+	EXPECT_EQ( pvec.width(), 1 );
+}
+
+TEST( packed_index_vector, idx_vector_index )
+{
+	// a mesh-like idx_vector with a packed index matches one with a std::vector<i32> index
+	for( const size_t value_count : { 100, 5000, 70000 } )
+	{
+		const std::vector<n_tup<f32, 3>> unique_values = random_vector<n_tup<f32, 3>>( value_count );
+		std::vector<n_tup<f32, 3>> values( 100000 );
+		for( size_t inx = 0; inx < values.size(); ++inx )
+			values[inx] = unique_values[( inx < value_count ) ? inx : random_value<u32>() % value_count];
+
+		idx_vector_builder<n_tup<f32, 3>> builder;
+		idx_vector_builder<n_tup<f32, 3>, packed_index_vector> packed_builder;
+		idx_vector_builder<n_tup<f32, 3>, packed_index_vector> parallel_packed_builder;
+		EXPECT_EQ( builder.insert( values.data(), values.size() ), status::ok );
+		EXPECT_EQ( packed_builder.insert( values.data(), values.size() ), status::ok );
+		EXPECT_EQ( parallel_packed_builder.insert_parallel( values.data(), values.size(), 4 ), status::ok );
+
+		const idx_vector<n_tup<f32, 3>> ivec = builder.finish();
+		const idx_vector<n_tup<f32, 3>, packed_index_vector> packed_ivec = packed_builder.finish();
+		EXPECT_TRUE( packed_ivec == parallel_packed_builder.vector() );
+		EXPECT_TRUE( packed_ivec.is_valid() );
+		EXPECT_EQ( packed_ivec.values(), ivec.values() );
+		EXPECT_TRUE( std::equal( packed_ivec.index().begin(), packed_ivec.index().end(), ivec.index().begin(), ivec.index().end() ) );
+		EXPECT_EQ( packed_ivec.index().width(), ( value_count <= 256 ) ? 1 : ( ( value_count <= 65536 ) ? 2 : 4 ) );
+		for( size_t inx = 0; inx < values.size(); inx += 31 )
+		{
+			EXPECT_EQ( packed_ivec[inx], values[inx] );
+		}
+
+		// serialize and read back
+		memory_data_destination dd;
+		if( true )
+		{
+			write_stream<memory_data_destination> ws( dd );
+			ASSERT_EQ( write_serialization_header( ws ), status::ok );
+			ASSERT_EQ( serialize( ws, packed_ivec ), status::ok );
+			ASSERT_EQ( ws.end(), status::ok );
+		}
+		const std::vector<u8> data = dd.to_vector();
+		memory_data_source ds( data.data(), data.size() );
+		read_stream<memory_data_source> rs( ds );
+		ASSERT_EQ( read_serialization_header( rs ), status::ok );
+		idx_vector<n_tup<f32, 3>, packed_index_vector> read_ivec;
+		ASSERT_EQ( deserialize( rs, read_ivec ), status::ok );
+		EXPECT_TRUE( read_ivec == packed_ivec );
+		EXPECT_EQ( read_ivec.index().width(), packed_ivec.index().width() );
+		EXPECT_TRUE( rs.has_ended() );
+	}
+
+	// an invalid width is corrupted data
+	const std::vector<u8> bad_data = { 3, 0 };
+	memory_data_source ds( bad_data.data(), bad_data.size() );
+	read_stream<memory_data_source> rs( ds );
+	packed_index_vector pvec;
+	EXPECT_EQ( deserialize( rs, pvec ), status::corrupted );
+}
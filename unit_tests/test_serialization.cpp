@@ -0,0 +1,214 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/serialization.h>
+
+#include "unit_tests.h"
+
+#include <ctle/ntup.h>
+#include <ctle/read_stream.h>
+#include <ctle/data_source.h>
+#include <ctle/write_stream.h>
+#include <ctle/data_destination.h>
+
+using namespace ctle;
+
+namespace
+{
+enum class test_enum : u16
+{
+	first = 1,
+	second = 1000,
+};
+}
+
+static_assert( is_bulk_serializable<u32>::value, "u32 must be bulk serializable" );
+static_assert( is_bulk_serializable<test_enum>::value, "enums must be bulk serializable" );
+static_assert( is_bulk_serializable<uuid>::value, "uuid must be bulk serializable" );
+static_assert( is_bulk_serializable<digest<256>>::value, "digest must be bulk serializable" );
+static_assert( is_bulk_serializable<n_tup<float, 3>>::value, "n_tup must be bulk serializable" );
+static_assert( is_bulk_serializable<mn_tup<i16, 4, 4>>::value, "mn_tup must be bulk serializable" );
+static_assert( !is_bulk_serializable<std::string>::value, "strings are not bulk serializable" );
+static_assert( !is_bulk_serializable<std::vector<u32>>::value, "vectors are not bulk serializable" );
+
+template<class _Ty> static void serialize_round_trip( const _Ty &value, byte_order order = host_byte_order )
+{
+	memory_data_destination dd;
+	if( true )
+	{
+		write_stream<memory_data_destination> ws( dd, order );
+		ASSERT_EQ( write_serialization_header( ws ), status::ok );
+		ASSERT_EQ( serialize( ws, value ), status::ok );
+		ASSERT_EQ( ws.end(), status::ok );
+	}
+
+	const std::vector<u8> data = dd.to_vector();
+	memory_data_source ds( data.data(), data.size() );
+	read_stream<memory_data_source> rs( ds, order );
+	ASSERT_EQ( read_serialization_header( rs ), status::ok );
+	_Ty read_value;
+	ASSERT_EQ( deserialize( rs, read_value ), status::ok );
+	EXPECT_TRUE( read_value == value );
+	EXPECT_TRUE( rs.has_ended() );
+}
+
+TEST( serialization, values_and_vectors )
+{
+	for( const byte_order order : { byte_order::little_endian, byte_order::big_endian } )
+	{
+		serialize_round_trip( random_value<u64>(), order );
+		serialize_round_trip( test_enum::second, order );
+		serialize_round_trip( uuid::generate(), order );
+		serialize_round_trip( std::string( "serialized string" ), order );
+		serialize_round_trip( std::string(), order );
+		serialize_round_trip( random_vector<f64>( 1000 ), order );
+		serialize_round_trip( random_vector<n_tup<float, 3>>( 1000 ), order );
+		serialize_round_trip( random_vector<mn_tup<i16, 2, 3>>( 100 ), order );
+		serialize_round_trip( std::vector<u32>(), order );
+		serialize_round_trip( std::vector<bool>( { true, false, false, true, true } ), order );
+		serialize_round_trip( std::vector<std::string>( { "a", "", "longer string" } ), order );
+		serialize_round_trip( std::vector<std::vector<u16>>( { random_vector<u16>(), {}, random_vector<u16>() } ), order );
+
+		std::vector<digest<128>> digests( 17 );
+		for( auto &dig : digests )
+		{
+			for( auto &byte : dig.data )
+				byte = random_value<u8>();
+		}
+		serialize_round_trip( digests, order );
+	}
+}
+
+TEST( serialization, containers )
+{
+	idx_vector<n_tup<f32, 2>> ivec;
+	ivec.values() = random_vector<n_tup<f32, 2>>( 50 );
+	for( size_t inx = 0; inx < 200; ++inx )
+		ivec.index().push_back( i32( random_value<u32>() % 50 ) );
+	serialize_round_trip( ivec );
+	serialize_round_trip( idx_vector<std::string>() );
+
+	optional_value<u32> oval;
+	serialize_round_trip( oval );
+	oval.set( 12345 );
+	serialize_round_trip( oval );
+	serialize_round_trip( optional_value<std::string>( "optional" ) );
+
+	optional_vector<u8> ovec;
+	serialize_round_trip( ovec );
+	ovec.set();
+	serialize_round_trip( ovec );
+	ovec.set( random_vector<u8>( 300 ) );
+	serialize_round_trip( ovec );
+
+	optional_idx_vector<i64> oivec;
+	serialize_round_trip( oivec );
+	oivec.set();
+	oivec.values() = random_vector<i64>( 10 );
+	oivec.index() = { 0, 9, 3, 3, 0 };
+	serialize_round_trip( oivec );
+
+	bimap<u32, std::string> bmap;
+	serialize_round_trip( bmap );
+	for( u32 inx = 0; inx < 100; ++inx )
+		bmap.insert( inx * 7, "value " + std::to_string( inx ) );
+	serialize_round_trip( bmap );
+
+	bimap<uuid, digest<256>> bmap2;
+	for( size_t inx = 0; inx < 10; ++inx )
+	{
+		digest<256> dig;
+		for( auto &byte : dig.data )
+			byte = random_value<u8>();
+		bmap2.insert( uuid::generate(), dig );
+	}
+	serialize_round_trip( bmap2 );
+}
+
+TEST( serialization, large_bulk_array )
+{
+	// more than one stream buffer, through a file
+	const std::vector<n_tup<u32, 4>> values = random_vector<n_tup<u32, 4>>( 300000 );
+	if( true )
+	{
+		file_data_destination dd( "./serialization_large_bulk_array.dat" );
+		write_stream<file_data_destination> ws( dd );
+		ASSERT_EQ( write_serialization_header( ws ), status::ok );
+		ASSERT_EQ( serialize( ws, values ), status::ok );
+		ASSERT_EQ( ws.end(), status::ok );
+	}
+
+	file_data_source ds( "./serialization_large_bulk_array.dat" );
+	read_stream<file_data_source> rs( ds );
+	ASSERT_EQ( read_serialization_header( rs ), status::ok );
+	std::vector<n_tup<u32, 4>> read_values;
+	ASSERT_EQ( deserialize( rs, read_values ), status::ok );
+	EXPECT_TRUE( read_values == values );
+	EXPECT_TRUE( rs.has_ended() );
+}
+
+TEST( serialization, invalid_data )
+{
+	// not a serialization header
+	if( true )
+	{
+		const u32 data[2] = { 0x12345678, serialization_format_version };
+		memory_data_source ds( data, sizeof( data ) );
+		read_stream<memory_data_source> rs( ds );
+		EXPECT_EQ( read_serialization_header( rs ), status::invalid );
+	}
+
+	// a newer format version
+	if( true )
+	{
+		memory_data_destination dd;
+		if( true )
+		{
+			write_stream<memory_data_destination> ws( dd );
+			ASSERT_EQ( write_serialization_header( ws ), status::ok );
+			ASSERT_EQ( ws.end(), status::ok );
+		}
+		std::vector<u8> data = dd.to_vector();
+		data[4] += 1;
+		memory_data_source ds( data.data(), data.size() );
+		read_stream<memory_data_source> rs( ds );
+		EXPECT_EQ( read_serialization_header( rs ), status::invalid );
+	}
+
+	// a huge corrupted count fails when the stream ends, without allocating the whole count
+	if( true )
+	{
+		memory_data_destination dd;
+		if( true )
+		{
+			write_stream<memory_data_destination> ws( dd );
+			ASSERT_EQ( ws.write_varint( 0x0fffffffffffull ), status::ok );
+			const std::vector<u64> values = random_vector<u64>( 100 );
+			ASSERT_EQ( ws.write( values.data(), values.size() ), status::ok );
+			ASSERT_EQ( ws.end(), status::ok );
+		}
+		const std::vector<u8> data = dd.to_vector();
+		memory_data_source ds( data.data(), data.size() );
+		read_stream<memory_data_source> rs( ds );
+		std::vector<u64> read_values;
+		EXPECT_NE( deserialize( rs, read_values ), status::ok );
+	}
+
+	// idx_vector with an index out of bounds
+	if( true )
+	{
+		memory_data_destination dd;
+		if( true )
+		{
+			write_stream<memory_data_destination> ws( dd );
+			ASSERT_EQ( serialize( ws, std::vector<u32>( { 1, 2, 3 } ) ), status::ok );
+			ASSERT_EQ( serialize( ws, std::vector<i32>( { 0, 3 } ) ), status::ok );
+			ASSERT_EQ( ws.end(), status::ok );
+		}
+		const std::vector<u8> data = dd.to_vector();
+		memory_data_source ds( data.data(), data.size() );
+		read_stream<memory_data_source> rs( ds );
+		idx_vector<u32> ivec;
+		EXPECT_EQ( deserialize( rs, ivec ), status::corrupted );
+	}
+}
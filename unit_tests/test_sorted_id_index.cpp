@@ -0,0 +1,129 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/sorted_id_index.h>
+#include <ctle/uuid.h>
+#include <ctle/digest.h>
+
+#include "unit_tests.h"
+
+#include <algorithm>
+
+using namespace ctle;
+
+template<size_t _Size>
+static digest<_Size> random_digest()
+{
+	digest<_Size> val;
+	for( size_t inx=0; inx<_Size/64; ++inx )
+	{
+		val._data_q[inx] = random_value<uint64_t>();
+	}
+	return val;
+}
+
+template<class _IdTy, class _KeyGen>
+static void test_radix_sort( _KeyGen keygen, size_t count )
+{
+	// add some ids with a shared prefix, and some duplicates
+	std::vector<_IdTy> ids( count );
+	for( size_t inx = 0; inx < count; ++inx )
+	{
+		ids[inx] = keygen();
+		if( inx % 7 == 0 )
+			memset( ids[inx].data, 0xab, sizeof( ids[inx].data ) / 2 );
+		if( inx % 13 == 0 && inx > 0 )
+			ids[inx] = ids[inx / 2];
+	}
+	std::vector<u32> payload( count );
+	for( size_t inx = 0; inx < count; ++inx )
+		payload[inx] = (u32)inx;
+
+	std::vector<_IdTy> ref = ids;
+	std::vector<_IdTy> orig = ids;
+	std::stable_sort( ref.begin(), ref.end() );
+
+	radix_sort( ids, payload );
+	EXPECT_TRUE( ids == ref );
+	for( size_t inx = 0; inx < count; ++inx )
+	{
+		// the payload must follow the id, and equal ids keep their order (stable)
+		EXPECT_TRUE( orig[payload[inx]] == ids[inx] );
+		if( inx > 0 && ids[inx] == ids[inx - 1] )
+		{
+			EXPECT_LT( payload[inx - 1], payload[inx] );
+		}
+	}
+
+	std::vector<_IdTy> ids2 = orig;
+	radix_sort( ids2 );
+	EXPECT_TRUE( ids2 == ref );
+}
+
+TEST( sorted_id_index, radix_sort )
+{
+	test_radix_sort<uuid>( []() { return uuid::generate(); }, 10 );
+	test_radix_sort<uuid>( []() { return uuid::generate(); }, 20000 );
+	test_radix_sort<digest<64>>( []() { return random_digest<64>(); }, 20000 );
+	test_radix_sort<digest<128>>( []() { return random_digest<128>(); }, 20000 );
+	test_radix_sort<digest<256>>( []() { return random_digest<256>(); }, 20000 );
+	test_radix_sort<digest<512>>( []() { return random_digest<512>(); }, 5000 );
+}
+
+template<class _IdTy, class _KeyGen>
+static void test_sorted_id_index( _KeyGen keygen, size_t count )
+{
+	std::vector<_IdTy> ids( count );
+	for( size_t inx = 0; inx < count; ++inx )
+		ids[inx] = keygen();
+
+	sorted_id_index<_IdTy> index( ids );
+	EXPECT_EQ( index.size(), count );
+
+	std::vector<_IdTy> sorted = ids;
+	std::sort( sorted.begin(), sorted.end() );
+
+	// single lookups
+	for( size_t inx = 0; inx < count; ++inx )
+	{
+		EXPECT_EQ( index.find( sorted[inx] ), inx );
+		EXPECT_TRUE( index.contains( sorted[inx] ) );
+	}
+	EXPECT_FALSE( index.contains( keygen() ) );
+
+	// batch lookups, mixed with missing ids
+	std::vector<_IdTy> queries;
+	for( size_t inx = 0; inx < count; ++inx )
+	{
+		queries.push_back( sorted[inx] );
+		queries.push_back( keygen() );
+	}
+	std::vector<u32> positions = index.find( queries );
+	ASSERT_EQ( positions.size(), queries.size() );
+	for( size_t inx = 0; inx < count; ++inx )
+	{
+		EXPECT_EQ( positions[inx * 2], inx );
+		EXPECT_EQ( positions[inx * 2 + 1], sorted_id_index<_IdTy>::npos );
+	}
+}
+
+TEST( sorted_id_index, basic_test )
+{
+	for( size_t count : { 0, 1, 2, 3, 7, 8, 100, 1023, 1024, 10000 } )
+	{
+		test_sorted_id_index<uuid>( []() { return uuid::generate(); }, count );
+	}
+	test_sorted_id_index<digest<256>>( []() { return random_digest<256>(); }, 5000 );
+
+	// duplicates are removed
+	std::vector<uuid> ids = { uuid::generate(), uuid::generate() };
+	ids.push_back( ids[0] );
+	sorted_id_index<uuid> index( ids );
+	EXPECT_EQ( index.size(), 2 );
+	EXPECT_TRUE( index.contains( ids[0] ) );
+	EXPECT_TRUE( index.contains( ids[1] ) );
+
+	index.clear();
+	EXPECT_TRUE( index.empty() );
+	EXPECT_FALSE( index.contains( ids[0] ) );
+}
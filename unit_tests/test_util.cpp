@@ -3,6 +3,8 @@
 
 #include <ctle/util.h>
 
+#include <set>
+
 #include "unit_tests.h"
 
 using namespace ctle;
@@ -21,3 +23,50 @@ TEST( util, basic_test )
 	auto &ref2 = nil_object::ref<std::vector<std::unique_ptr<int>>>();
 	EXPECT_TRUE( nil_object::is_nil( ref2 ) );
 }
+
+TEST( util, hash_mix )
+{
+	// the mix is a bijection, so the mixed values of distinct values must be distinct 
+	std::set<u64> mixed;
+	for( u64 inx = 0; inx < 1000; ++inx )
+	{
+		mixed.insert( hash_mix_64( inx ) );
+	}
+	EXPECT_EQ( mixed.size(), 1000 );
+
+	// words which xor to the same value must not hash to the same value
+	std::set<u64> mixed_words;
+	for( u64 inx = 0; inx < 1000; ++inx )
+	{
+		const u64 words[2] = { inx, inx };
+		mixed_words.insert( hash_mix_64( words, 2 ) );
+	}
+	EXPECT_EQ( mixed_words.size(), 1000 );
+
+	// the low bits should be well distributed for sequential values
+	std::set<u64> low_bits;
+	for( u64 inx = 0; inx < 1024; ++inx )
+	{
+		const u64 words[2] = { inx << 48, 0 };
+		low_bits.insert( hash_mix_64( words, 2 ) & 0xff );
+	}
+	EXPECT_GT( low_bits.size(), 200 );
+}
+
+TEST( util, aligned_allocator )
+{
+	for( size_t size = 1; size < 100000; size = size * 3 + 1 )
+	{
+		std::vector<u8, aligned_allocator<u8, 4096>> buffer( size, 0xcd );
+		EXPECT_EQ( (uintptr_t)buffer.data() % 4096, 0 );
+		EXPECT_EQ( buffer[size - 1], 0xcd );
+	}
+
+	std::vector<u64, aligned_allocator<u64, 64>> values;
+	for( u64 inx = 0; inx < 1000; ++inx )
+	{
+		values.push_back( inx );
+		EXPECT_EQ( (uintptr_t)values.data() % 64, 0 );
+	}
+	EXPECT_EQ( values[999], 999 );
+}
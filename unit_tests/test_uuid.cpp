@@ -6,6 +6,9 @@
 
 #include "unit_tests.h"
 
+#include <unordered_map>
+#include <unordered_set>
+
 using namespace ctle;
 
 TEST( uuid, basic_test )
@@ -103,3 +106,50 @@ TEST( uuid, basic_test )
 		EXPECT_EQ( idmap.size(), 1000 );
 	}
 }
+
+TEST( uuid, ordering )
+{
+	// compare against a byte-wise compare, since the uuid is stored big-endian.
+	// copy a random number of leading bytes, so that the values share a prefix
+	for( size_t inx = 0; inx < 1000; ++inx )
+	{
+		uuid a = uuid::generate();
+		uuid b = uuid::generate();
+		const size_t prefix = rand() % 17;
+		memcpy( b.data, a.data, prefix );
+
+		const int cmp = memcmp( a.data, b.data, 16 );
+		EXPECT_EQ( a < b, cmp < 0 );
+		EXPECT_EQ( b < a, cmp > 0 );
+		EXPECT_FALSE( a < a );
+	}
+}
+
+TEST( uuid, hashing )
+{
+	// uuids with equal words should not collide in the default hash
+	std::unordered_set<size_t> hashes;
+	for( u64 inx = 0; inx < 1000; ++inx )
+	{
+		uuid id;
+		id._data_q[0] = inx;
+		id._data_q[1] = inx;
+		hashes.insert( std::hash<uuid>{}( id ) );
+	}
+	EXPECT_EQ( hashes.size(), 1000 );
+
+	// the identity hash can be used for random uuids
+	std::unordered_map<uuid, u64, identity_hash<uuid>> idmap;
+	std::vector<uuid> ids;
+	for( u64 inx = 0; inx < 1000; ++inx )
+	{
+		ids.push_back( uuid::generate() );
+		idmap[ids.back()] = inx;
+	}
+	EXPECT_EQ( idmap.size(), 1000 );
+	for( u64 inx = 0; inx < 1000; ++inx )
+	{
+		EXPECT_EQ( idmap[ids[inx]], inx );
+	}
+	EXPECT_EQ( identity_hash<uuid>{}( ids[0] ), ids[0]._data_q[0] ^ ids[0]._data_q[1] );
+}
@@ -0,0 +1,111 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/varint.h>
+
+#include "unit_tests.h"
+
+using namespace ctle;
+
+TEST( varint, varint_codec )
+{
+	// edge values, and the boundaries of each encoded length
+	std::vector<u64> values = { 0, 1, 127, 128, 255, 256, 16383, 16384, 0xffffffffull, 0x100000000ull, 0x7fffffffffffffffull, 0xffffffffffffffffull };
+	for( size_t inx = 0; inx < 1000; ++inx )
+		values.push_back( random_value<u64>() >> ( random_value<u32>() % 64 ) );
+
+	for( const u64 value : values )
+	{
+		u8 encoded[varint_max_size];
+		const size_t count = varint_encode( value, encoded );
+		EXPECT_GE( count, 1 );
+		EXPECT_LE( count, varint_max_size );
+		size_t expected_count = 1;
+		for( u64 rest = value >> 7; rest != 0; rest >>= 7 )
+			++expected_count;
+		EXPECT_EQ( count, expected_count );
+
+		u64 decoded = 0;
+		EXPECT_EQ( varint_decode( encoded, count, decoded ), count );
+		EXPECT_EQ( decoded, value );
+
+		// truncated varints are not valid
+		EXPECT_EQ( varint_decode( encoded, count - 1, decoded ), 0 );
+	}
+
+	// too long varints are not valid
+	u8 too_long[12];
+	memset( too_long, 0x80, sizeof( too_long ) );
+	u64 decoded = 0;
+	EXPECT_EQ( varint_decode( too_long, sizeof( too_long ), decoded ), 0 );
+
+	// a max length varint with bits above bit 63 is not valid
+	u8 overflow[varint_max_size];
+	memset( overflow, 0xff, sizeof( overflow ) );
+	overflow[varint_max_size - 1] = 0x01;
+	EXPECT_EQ( varint_decode( overflow, sizeof( overflow ), decoded ), varint_max_size );
+	EXPECT_EQ( decoded, 0xffffffffffffffffull );
+	overflow[varint_max_size - 1] = 0x02;
+	EXPECT_EQ( varint_decode( overflow, sizeof( overflow ), decoded ), 0 );
+	overflow[varint_max_size - 1] = 0x7f;
+	EXPECT_EQ( varint_decode( overflow, sizeof( overflow ), decoded ), 0 );
+
+	// zigzag maps small magnitudes to small values
+	EXPECT_EQ( zigzag_encode( 0 ), 0 );
+	EXPECT_EQ( zigzag_encode( -1 ), 1 );
+	EXPECT_EQ( zigzag_encode( 1 ), 2 );
+	EXPECT_EQ( zigzag_encode( -2 ), 3 );
+	const i64 signed_values[] = { 0, -1, 1, 63, -64, 64, -65, std::numeric_limits<i64>::max(), std::numeric_limits<i64>::min() };
+	for( const i64 value : signed_values )
+		EXPECT_EQ( zigzag_decode( zigzag_encode( value ) ), value );
+}
+
+TEST( varint, stream_vbyte_codec )
+{
+	for( size_t count : { 0, 1, 3, 4, 5, 17, 1000, 100003 } )
+	{
+		// values of mixed byte lengths
+		std::vector<u32> values( count );
+		for( auto &value : values )
+			value = random_value<u32>() >> ( 8 * ( random_value<u32>() % 4 ) );
+
+		std::vector<u8> encoded( stream_vbyte_bound( count ) );
+		const size_t encoded_size = stream_vbyte_encode( values.data(), count, encoded.data() );
+		EXPECT_LE( encoded_size, encoded.size() );
+		EXPECT_EQ( encoded_size, stream_vbyte_control_size( count ) + stream_vbyte_data_size( encoded.data(), count ) );
+
+		std::vector<u32> decoded( count );
+		auto result = stream_vbyte_decode( encoded.data(), encoded_size, decoded.data(), count );
+		ASSERT_EQ( result.status(), status::ok );
+		EXPECT_EQ( result.value(), encoded_size );
+		EXPECT_TRUE( decoded == values );
+
+		// truncated data is detected
+		if( count > 0 )
+		{
+			EXPECT_EQ( stream_vbyte_decode( encoded.data(), encoded_size - 1, decoded.data(), count ).status(), status::corrupted );
+		}
+
+		// a sorted sequence with small gaps, delta coded, encodes to about 1 byte per value
+		std::vector<u32> sorted( count );
+		u32 current = random_value<u32>() % 1000;
+		for( auto &value : sorted )
+		{
+			current += random_value<u32>() % 200;
+			value = current;
+		}
+		const size_t delta_size = stream_vbyte_encode( sorted.data(), count, encoded.data(), true );
+		if( count >= 1000 )
+		{
+			EXPECT_LT( delta_size, count + count / 2 );
+		}
+		std::fill( decoded.begin(), decoded.end(), 0 );
+		ASSERT_EQ( stream_vbyte_decode( encoded.data(), delta_size, decoded.data(), count, true ).status(), status::ok );
+		EXPECT_TRUE( decoded == sorted );
+
+		// delta coding also round trips non-monotone sequences (the deltas wrap around)
+		const size_t wrapped_size = stream_vbyte_encode( values.data(), count, encoded.data(), true );
+		ASSERT_EQ( stream_vbyte_decode( encoded.data(), wrapped_size, decoded.data(), count, true ).status(), status::ok );
+		EXPECT_TRUE( decoded == values );
+	}
+}
@@ -0,0 +1,124 @@
+// ctle Copyright (c) 2024 Ulrik Lindahl
+// Licensed under the MIT license https://github.com/Cooolrik/ctle/blob/main/LICENSE
+
+#include <ctle/vector_view.h>
+
+#include "unit_tests.h"
+
+#include <ctle/serialization.h>
+#include <ctle/ntup.h>
+#include <ctle/file_funcs.h>
+#include <ctle/read_stream.h>
+#include <ctle/data_source.h>
+#include <ctle/write_stream.h>
+#include <ctle/data_destination.h>
+
+using namespace ctle;
+
+TEST( vector_view, basic_test )
+{
+	const std::vector<u32> values = random_vector<u32>( 10 );
+	const std::vector<i32> index = { 0, 9, 5, 5, 1 };
+
+	vector_view<u32> vview( values.data(), values.size() );
+	EXPECT_EQ( vview.size(), values.size() );
+	EXPECT_FALSE( vview.empty() );
+	EXPECT_EQ( vview.data(), values.data() );
+	EXPECT_TRUE( std::equal( vview.begin(), vview.end(), values.begin() ) );
+	EXPECT_EQ( vview.at( 3 ), values[3] );
+	EXPECT_THROW( vview.at( 10 ), std::out_of_range );
+	EXPECT_TRUE( vector_view<u32>().empty() );
+
+	idx_vector_view<u32> iview( vview, vector_view<i32>( index.data(), index.size() ) );
+	EXPECT_EQ( iview.size(), index.size() );
+	EXPECT_TRUE( iview.is_valid() );
+	for( size_t inx = 0; inx < index.size(); ++inx )
+	{
+		EXPECT_EQ( iview[inx], values[index[inx]] );
+	}
+
+	const std::vector<i32> bad_index = { 0, -1 };
+	EXPECT_FALSE( ( idx_vector_view<u32>( vview, vector_view<i32>( bad_index.data(), bad_index.size() ) ).is_valid() ) );
+
+	optional_vector_view<u32> oview;
+	EXPECT_FALSE( oview.has_value() );
+	EXPECT_EQ( oview.size(), 0 );
+	EXPECT_THROW( oview.vector(), bad_optional_value_access );
+	oview.set( vview );
+	EXPECT_TRUE( oview.has_value() );
+	EXPECT_EQ( oview[2], values[2] );
+	oview.reset();
+	EXPECT_FALSE( oview.has_value() );
+}
+
+TEST( vector_view, mapped_file_views )
+{
+	idx_vector<n_tup<f32, 3>> mesh;
+	mesh.values() = random_vector<n_tup<f32, 3>>( 50000 );
+	for( size_t inx = 0; inx < 150000; ++inx )
+		mesh.index().push_back( i32( random_value<u32>() % 50000 ) );
+	optional_vector<u64> empty_ovec;
+	optional_vector<u64> ovec;
+	ovec.set( random_vector<u64>( 1000 ) );
+	const std::vector<u8> bytes = random_vector<u8>( 3 );
+	const std::vector<digest<256>> digests( 5 );
+
+	if( true )
+	{
+		file_data_destination dd( "./vector_view_mapped_file.dat" );
+		write_stream<file_data_destination> ws( dd );
+		ASSERT_EQ( write_serialization_header( ws ), status::ok );
+		ASSERT_EQ( serialize( ws, bytes ), status::ok );
+		ASSERT_EQ( serialize( ws, mesh ), status::ok );
+		ASSERT_EQ( serialize( ws, empty_ovec ), status::ok );
+		ASSERT_EQ( serialize( ws, ovec ), status::ok );
+		ASSERT_EQ( serialize( ws, digests ), status::ok );
+		ASSERT_EQ( ws.end(), status::ok );
+	}
+
+	mapped_file file;
+	ASSERT_EQ( file.open( "./vector_view_mapped_file.dat" ), status::ok );
+	memory_data_source ds( file.data(), file.size() );
+	read_stream<memory_data_source> rs( ds );
+	ASSERT_EQ( read_serialization_header( rs ), status::ok );
+
+	vector_view<u8> bytes_view;
+	ASSERT_EQ( deserialize_view( rs, bytes_view ), status::ok );
+	EXPECT_TRUE( std::equal( bytes_view.begin(), bytes_view.end(), bytes.begin(), bytes.end() ) );
+
+	// the views point directly into the mapped file
+	idx_vector_view<n_tup<f32, 3>> mesh_view;
+	ASSERT_EQ( deserialize_view( rs, mesh_view ), status::ok );
+	EXPECT_GE( (const u8 *)mesh_view.values().data(), file.data() );
+	EXPECT_LT( (const u8 *)mesh_view.values().data(), file.data() + file.size() );
+	EXPECT_TRUE( mesh_view.is_valid() );
+	ASSERT_EQ( mesh_view.size(), mesh.size() );
+	EXPECT_TRUE( std::equal( mesh_view.values().begin(), mesh_view.values().end(), mesh.values().begin(), mesh.values().end() ) );
+	EXPECT_TRUE( std::equal( mesh_view.index().begin(), mesh_view.index().end(), mesh.index().begin(), mesh.index().end() ) );
+	for( size_t inx = 0; inx < mesh.size(); inx += 97 )
+	{
+		EXPECT_EQ( mesh_view[inx], mesh[inx] );
+	}
+
+	optional_vector_view<u64> empty_oview;
+	ASSERT_EQ( deserialize_view( rs, empty_oview ), status::ok );
+	EXPECT_FALSE( empty_oview.has_value() );
+
+	optional_vector_view<u64> oview;
+	ASSERT_EQ( deserialize_view( rs, oview ), status::ok );
+	ASSERT_TRUE( oview.has_value() );
+	EXPECT_TRUE( std::equal( oview.values().begin(), oview.values().end(), ovec.values().begin(), ovec.values().end() ) );
+
+	vector_view<digest<256>> digests_view;
+	ASSERT_EQ( deserialize_view( rs, digests_view ), status::ok );
+	EXPECT_TRUE( std::equal( digests_view.begin(), digests_view.end(), digests.begin(), digests.end() ) );
+	EXPECT_TRUE( rs.has_ended() );
+
+	// the views can not be set up from a stream which is not in the host byte order
+	const byte_order other_order = ( host_byte_order == byte_order::little_endian ) ? byte_order::big_endian : byte_order::little_endian;
+	memory_data_source ds2( file.data(), file.size() );
+	read_stream<memory_data_source> rs2( ds2, other_order );
+	ASSERT_EQ( rs2.skip( 8 ), status::ok );
+	ASSERT_EQ( deserialize_view( rs2, bytes_view ), status::ok );
+	EXPECT_EQ( deserialize_view( rs2, mesh_view ), status::invalid_param );
+}
@@ -11,23 +11,17 @@
 #include <ctle/data_source.h>
 #include <ctle/write_stream.h>
 #include <ctle/data_destination.h>
+#include <ctle/serialization.h>
 		
 template<class _Ty> ctle::status _read_from_stream( ctle::read_stream<ctle::file_data_source,ctle::hasher_xxh128> &strm, std::vector<_Ty> &data )
 {
-	u32 cnt = 0;
-	ctle::status res = strm.read<u32>( &cnt, 1 );
-	if( !res ) 
-  		return res; 
-	data.resize(cnt);
-	return strm.read<_Ty>( data.data(), data.size() );
+	static_assert( ctle::is_bulk_serializable<_Ty>::value, "all variant types must be bulk serializable" );
+	return ctle::deserialize( strm, data );
 }
 		
 template<class _Ty> ctle::status _write_to_stream( ctle::write_stream<ctle::file_data_destination,ctle::hasher_xxh128> &strm, const std::vector<_Ty> &data )
 {
-	ctle::status res = strm.write<u32>( (u32)data.size() );
-	if( !res ) 
-  		return res; 
-	return strm.write<_Ty>( data.data(), data.size() );
+	return ctle::serialize( strm, data );
 }
 		
 bool _are_equal( const variant &a , const variant &b )